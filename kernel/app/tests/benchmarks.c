@@ -17,6 +17,7 @@
 #include <kernel/semaphore.h>
 #include <kernel/event.h>
 #include <platform.h>
+#include <arch/ops.h>
 
 const size_t BUFSIZE = (1024*1024);
 const uint ITER = 1024;
@@ -122,6 +123,91 @@ __NO_INLINE static void bench_memcpy(void)
     free(buf);
 }
 
+/* Throughput of the string routines for a range of sizes, each run for
+ * about the same number of bytes in total so the small sizes show the
+ * per-call overhead and the large ones the memory bandwidth. */
+static const size_t string_bench_sizes[] = {
+    8, 64, 256, 1024, 4096, 64*1024, 1024*1024,
+};
+#define STRING_BENCH_BYTES (64*1024*1024)
+
+enum string_bench_op {
+    STRING_BENCH_MEMCPY,
+    STRING_BENCH_MEMCPY_UNALIGNED,
+    STRING_BENCH_MEMSET,
+    STRING_BENCH_MEMCMP,
+};
+
+static const char *string_bench_names[] = {
+    "memcpy", "memcpy+1", "memset", "memcmp",
+};
+
+__NO_INLINE static void bench_string_op(enum string_bench_op op, uint8_t *dst, uint8_t *src, size_t size)
+{
+    uint iter = STRING_BENCH_BYTES / size;
+    volatile int result = 0;
+
+    lk_bigtime_t t = current_time_hires();
+    for (uint i = 0; i < iter; i++) {
+        switch (op) {
+            case STRING_BENCH_MEMCPY:
+                memcpy(dst, src, size);
+                break;
+            case STRING_BENCH_MEMCPY_UNALIGNED:
+                memcpy(dst + 1, src, size);
+                break;
+            case STRING_BENCH_MEMSET:
+                memset(dst, 0, size);
+                break;
+            case STRING_BENCH_MEMCMP:
+                result += memcmp(dst, src, size);
+                break;
+        }
+    }
+    t = current_time_hires() - t;
+    if (t == 0)
+        t = 1;
+
+    /* bytes per microsecond is MB/s */
+    uint64_t mb_sec = ((uint64_t)iter * size) / t;
+    printf("%-9s %8zu bytes: %llu.%03llu GB/s\n", string_bench_names[op], size,
+           mb_sec / 1000, mb_sec % 1000);
+}
+
+__NO_INLINE static void bench_string_ops(void)
+{
+    size_t max = string_bench_sizes[countof(string_bench_sizes) - 1];
+    uint8_t *src = malloc(max);
+    uint8_t *dst = malloc(max + 1);
+    if (!src || !dst) {
+        printf("not enough memory for string benchmarks\n");
+        goto out;
+    }
+    memset(src, 0x55, max);
+    memset(dst, 0x55, max + 1);
+
+    for (uint op = STRING_BENCH_MEMCPY; op <= STRING_BENCH_MEMCMP; op++) {
+        for (uint i = 0; i < countof(string_bench_sizes); i++)
+            bench_string_op(op, dst, src, string_bench_sizes[i]);
+    }
+
+    /* arch_zero_page against the memset it replaces for page zeroing */
+    uint pages = max / PAGE_SIZE;
+    lk_bigtime_t t = current_time_hires();
+    for (uint i = 0; i < STRING_BENCH_BYTES / max; i++) {
+        for (uint j = 0; j < pages; j++)
+            arch_zero_page(src + j * PAGE_SIZE);
+    }
+    t = current_time_hires() - t;
+    uint64_t mb_sec = STRING_BENCH_BYTES / (t ? t : 1);
+    printf("%-9s %8u bytes: %llu.%03llu GB/s\n", "zero_page", (uint)PAGE_SIZE,
+           mb_sec / 1000, mb_sec % 1000);
+
+out:
+    free(src);
+    free(dst);
+}
+
 #if ARCH_ARM
 __NO_INLINE static void arm_bench_cset_stm(void)
 {
@@ -219,6 +305,7 @@ void benchmarks(void)
     bench_set_overhead();
     bench_memset();
     bench_memcpy();
+    bench_string_ops();
 
     bench_cset_uint8_t();
     bench_cset_uint16_t();
@@ -5,3 +5,11 @@
 // license that can be found in the LICENSE file or at
 // https://opensource.org/licenses/MIT
 
+#include <arch/defines.h>
+#include <arch/ops.h>
+#include <string.h>
+
+void arch_zero_page(void *page)
+{
+    memset(page, 0, PAGE_SIZE);
+}
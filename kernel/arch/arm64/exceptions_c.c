@@ -12,6 +12,7 @@
 #include <arch/arch_ops.h>
 #include <arch/arm64.h>
 #include <kernel/thread.h>
+#include <lib/kprof.h>
 
 #if WITH_LIB_MAGENTA
 #include <lib/user_copy.h>
@@ -227,6 +228,9 @@ void arm64_irq(struct arm64_iframe_long *iframe, uint exception_flags)
 
     enum handler_return ret = platform_irq(iframe);
 
+    /* the short irq frame does not save x29, so only the pc is sampled */
+    KPROF_IRQ_EXIT(iframe->elr, 0, exception_flags & ARM64_EXCEPTION_FLAG_LOWER_EL);
+
     /* if we came from user space, check to see if we have any signals to handle */
     if (unlikely(exception_flags & ARM64_EXCEPTION_FLAG_LOWER_EL)) {
         /* in the case of receiving a kill signal, this function may not return,
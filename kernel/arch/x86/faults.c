@@ -14,6 +14,8 @@
 #include <arch/x86/descriptor.h>
 #include <kernel/thread.h>
 
+#include <lib/kprof.h>
+#include <lib/ktrace.h>
 #include <lib/user_copy.h>
 
 #if WITH_LIB_MAGENTA
@@ -268,6 +270,10 @@ void x86_exception_handler(x86_iframe_t *frame)
     // deliver the interrupt
     enum handler_return ret = INT_NO_RESCHEDULE;
 
+    bool is_irq = frame->vector > X86_INT_MAX_INTEL_DEFINED;
+    if (is_irq)
+        KTRACE(KTRACE_TAG_IRQ_ENTER, frame->vector, 0);
+
     switch (frame->vector) {
         case X86_INT_INVALID_OP:
             x86_invop_handler(frame);
@@ -333,6 +339,15 @@ void x86_exception_handler(x86_iframe_t *frame)
             x86_unhandled_exception(frame);
     }
 
+    if (is_irq) {
+        KTRACE(KTRACE_TAG_IRQ_EXIT, frame->vector, 0);
+#if ARCH_X86_64
+        KPROF_IRQ_EXIT(frame->ip, frame->rbp, from_user);
+#else
+        KPROF_IRQ_EXIT(frame->ip, 0, from_user);
+#endif
+    }
+
     /* if we came from user space, check to see if we have any signals to handle */
     if (unlikely(from_user)) {
         /* in the case of receiving a kill signal, this function may not return,
@@ -88,6 +88,11 @@ static inline bool x86_feature_test(struct x86_cpuid_bit bit)
 
 void x86_feature_debug(void);
 
+/* Whether rep movsb/stosb are the fastest way to copy and set memory,
+ * cached for the assembly string and user copy routines.  False until
+ * x86_feature_init() has run. */
+extern bool x86_feature_erms;
+
 /* add feature bits to test here */
 #define X86_FEATURE_SSE3         X86_CPUID_BIT(0x1, 2, 0)
 #define X86_FEATURE_SSSE3        X86_CPUID_BIT(0x1, 2, 9)
@@ -106,9 +111,11 @@ void x86_feature_debug(void);
 #define X86_FEATURE_TSC_ADJUST   X86_CPUID_BIT(0x7, 1, 1)
 #define X86_FEATURE_AVX2         X86_CPUID_BIT(0x7, 1, 5)
 #define X86_FEATURE_SMEP         X86_CPUID_BIT(0x7, 1, 7)
+#define X86_FEATURE_ERMS         X86_CPUID_BIT(0x7, 1, 9)
 #define X86_FEATURE_RDSEED       X86_CPUID_BIT(0x7, 1, 18)
 #define X86_FEATURE_SMAP         X86_CPUID_BIT(0x7, 1, 20)
 #define X86_FEATURE_PKU          X86_CPUID_BIT(0x7, 2, 3)
+#define X86_FEATURE_FSRM         X86_CPUID_BIT(0x7, 3, 4)
 #define X86_FEATURE_SYSCALL      X86_CPUID_BIT(0x80000001, 3, 11)
 #define X86_FEATURE_NX           X86_CPUID_BIT(0x80000001, 3, 20)
 #define X86_FEATURE_HUGE_PAGE    X86_CPUID_BIT(0x80000001, 3, 26)
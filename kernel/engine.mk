@@ -93,6 +93,8 @@ GLOBAL_MODULE_LDFLAGS :=
 # Kernel compile flags
 KERNEL_INCLUDES := $(BUILDDIR) $(addsuffix /include,$(LKINC))
 KERNEL_COMPILEFLAGS := -fno-pic -ffreestanding -include $(KERNEL_CONFIG_HEADER)
+# kprof walks kernel stacks by frame pointer
+KERNEL_COMPILEFLAGS += -fno-omit-frame-pointer
 KERNEL_CFLAGS :=
 KERNEL_CPPFLAGS :=
 KERNEL_ASMFLAGS :=
@@ -51,6 +51,10 @@ void arch_clean_invalidate_cache_range(addr_t start, size_t len);
 void arch_invalidate_cache_range(addr_t start, size_t len);
 void arch_sync_cache_range(addr_t start, size_t len);
 
+/* Zero a page aligned, PAGE_SIZE block of memory.  Where the cpu allows,
+ * this avoids pulling the page into the cache. */
+void arch_zero_page(void *page);
+
 /* Used to suspend work on a CPU until it is further shutdown.
  * This will only be invoked with interrupts disabled.  This function
  * must not re-enter the scheduler.
@@ -0,0 +1,55 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <arch/spinlock.h>
+#include <magenta/compiler.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#if WITH_LOCK_STATS
+#include <magenta/syscalls-types.h>
+#endif
+
+/* Lock contention statistics, enabled by building with LOCK_STATS=1.
+ *
+ * Every spinlock and mutex acquisition is attributed to the pc it was
+ * made from, and each such lock site accumulates the number of
+ * acquisitions, how many of them had to wait, the total time spent
+ * waiting and the longest time the lock was then held.  The console
+ * command "lockstat" dumps the busiest sites; object_get_info with
+ * MX_INFO_LOCK_STATS on the root resource returns them all.
+ */
+
+__BEGIN_CDECLS
+
+#if WITH_LOCK_STATS
+
+struct mutex;
+
+/* the maximum number of distinct lock sites tracked */
+#define LOCKSTAT_MAX_SITES 1024
+
+/* These are out of line so that, called from the inline lock functions,
+ * their return address is the lock site. */
+void lockstat_spin_lock(spin_lock_t *lock);
+int lockstat_spin_trylock(spin_lock_t *lock);
+void lockstat_spin_unlock(spin_lock_t *lock);
+
+uint64_t lockstat_now(void);
+void lockstat_mutex_acquired(struct mutex *m, uintptr_t pc, bool contended, uint64_t start);
+void lockstat_mutex_released(struct mutex *m);
+void lockstat_mutex_reacquired(struct mutex *m);
+
+/* Copies up to |max| lock sites into |stats|, returning how many. */
+size_t lockstat_read(mx_lock_stats_t *stats, size_t max);
+void lockstat_reset(void);
+
+#endif
+
+__END_CDECLS
@@ -23,6 +23,10 @@ typedef struct mutex {
     thread_t *holder;
     int count;
     wait_queue_t wait;
+#if WITH_LOCK_STATS
+    struct lockstat_site *lockstat_site;
+    uint64_t lockstat_acquired;
+#endif
 } mutex_t;
 
 #define MUTEX_INITIAL_VALUE(m) \
@@ -102,6 +102,17 @@ typedef struct thread {
      * THREAD_RUNNING state, this excludes the time it has accrued since it
      * left the scheduler. */
     lk_bigtime_t runtime_us;
+    /* When the thread last became ready to run, and the total time it has
+     * spent ready but waiting for a cpu. */
+    lk_bigtime_t last_ready_us;
+    lk_bigtime_t wait_time_us;
+    /* Times the thread left the cpu because it blocked, slept or exited,
+     * and times it left while still runnable (preempted or yielded). */
+    uint64_t voluntary_switches;
+    uint64_t involuntary_switches;
+    /* bumped by the thread itself, so they need no locking */
+    uint64_t page_faults;
+    uint64_t syscalls;
 
     /* if blocked, a pointer to the wait queue */
     struct wait_queue *blocking_wait_queue;
@@ -151,6 +162,16 @@ typedef struct thread {
 #define thread_set_pinned_cpu(t, c) do {} while(0)
 #endif
 
+/* a consistent snapshot of a thread's accounting information */
+typedef struct thread_accounting {
+    lk_bigtime_t runtime_us;
+    lk_bigtime_t wait_time_us;
+    uint64_t voluntary_switches;
+    uint64_t involuntary_switches;
+    uint64_t page_faults;
+    uint64_t syscalls;
+} thread_accounting_t;
+
 /* thread priority */
 #define NUM_PRIORITIES 32
 #define LOWEST_PRIORITY 0
@@ -204,6 +225,8 @@ void thread_kill(thread_t *t, bool block);
 /* process pending signals, may never return because of kill signal */
 void thread_process_pending_signals(void);
 
+void thread_get_accounting(thread_t *t, thread_accounting_t *acct);
+
 void dump_thread(thread_t *t);
 void arch_dump_thread(thread_t *t);
 void dump_all_threads(void);
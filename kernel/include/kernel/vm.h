@@ -79,6 +79,9 @@ enum vm_page_state {
     VM_PAGE_STATE_MMU, /* allocated to serve arch-specific mmu purposes */
 };
 
+/* vm_page flags */
+#define VM_PAGE_FLAG_ZEROED (0x1) /* free page known to be filled with zeros */
+
 /* kernel address space */
 #ifndef KERNEL_ASPACE_BASE
 #define KERNEL_ASPACE_BASE ((vaddr_t)0x80000000UL)
@@ -133,6 +136,7 @@ status_t pmm_add_arena(pmm_arena_t* arena) __NONNULL((1));
 /* flags for allocation routines below */
 #define PMM_ALLOC_FLAG_ANY (0x0)  /* no restrictions on which arena to allocate from */
 #define PMM_ALLOC_FLAG_KMAP (0x1) /* allocate only from arenas marked KMAP */
+#define PMM_ALLOC_FLAG_ZERO (0x2) /* return zeroed pages, preferring the pre-zeroed pool */
 
 /* Allocate count pages of physical memory, adding to the tail of the passed list.
  * The list must be initialized.
@@ -164,6 +168,36 @@ size_t pmm_free(struct list_node* list) __NONNULL((1));
 /* Helper routine for the above. */
 size_t pmm_free_page(vm_page_t* page) __NONNULL((1));
 
+/* Return the number of free pages across all arenas. */
+size_t pmm_count_free_pages(void);
+
+/* Return the number of pages managed by all arenas. */
+size_t pmm_count_total_pages(void);
+
+/* Statistics for the pool of free pages that are zeroed in the background
+ * and handed out first to PMM_ALLOC_FLAG_ZERO allocations. */
+typedef struct pmm_zero_pool_stats {
+    size_t zeroed_pages;   /* free pages currently known to be zero */
+    size_t target_pages;   /* how many the zeroing threads try to keep */
+    uint64_t pool_hits;    /* zeroed allocations served from the pool */
+    uint64_t pool_misses;  /* zeroed allocations that had to zero a page */
+    uint64_t bg_zeroed;    /* pages zeroed by the background threads */
+} pmm_zero_pool_stats_t;
+
+void pmm_get_zero_pool_stats(pmm_zero_pool_stats_t* stats) __NONNULL((1));
+
+/* Memory pressure levels, from the number of free pages against two
+ * watermarks.  A level is only left again once free memory has climbed
+ * some way back above its watermark, so the level does not flap. */
+#define PMM_PRESSURE_NORMAL   0
+#define PMM_PRESSURE_WARNING  1
+#define PMM_PRESSURE_CRITICAL 2
+
+uint pmm_pressure_level(void);
+
+/* Block until the pressure level is no longer level, and return the new one. */
+uint pmm_pressure_wait(uint level);
+
 /* Allocate a run of pages out of the kernel area and return the pointer in kernel space.
  * If the optional list is passed, append the allocate page structures to the tail of the list.
  * If the optional physical address pointer is passed, return the address.
@@ -187,6 +221,10 @@ paddr_t vm_page_to_paddr(const vm_page_t* page);
 /* paddr to vm_page_t */
 vm_page_t* paddr_to_vm_page(paddr_t addr);
 
+/* A single page of zeros, shared read-only by every vm object for pages
+ * that have been read but never written.  It is never freed. */
+vm_page_t* vm_get_zero_page(void);
+
 /* C friendly opaque handle to the internals of the VMM.
  * Never defined, just used as a handle for C apis.
  */
@@ -85,6 +85,11 @@ public:
 
     void Dump() const;
 
+    // count the pages backing the address space: those committed in the objects
+    // mapped into it, and those actually mapped in its page tables. an object
+    // page mapped more than once is counted once per mapping
+    void GetMemoryUsage(size_t* committed_pages, size_t* mapped_pages);
+
 private:
     using RegionTree = mxtl::WAVLTree<vaddr_t, mxtl::RefPtr<VmRegion>>;
 
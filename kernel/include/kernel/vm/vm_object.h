@@ -9,9 +9,11 @@
 #include <assert.h>
 #include <kernel/mutex.h>
 #include <kernel/vm.h>
+#include <kernel/vm/vm_region.h>
 #include <list.h>
 #include <stdint.h>
 #include <mxtl/array.h>
+#include <mxtl/intrusive_double_list.h>
 #include <mxtl/ref_counted.h>
 #include <mxtl/ref_ptr.h>
 
@@ -37,12 +39,52 @@ public:
     // find a contiguous run of physical pages to back the range of the object
     int64_t CommitRangeContiguous(uint64_t offset, uint64_t len, uint8_t alignment_log2 = 0);
 
+    // free the pages backing the range of the object, unmapping them from any region
+    // that maps them. offset must be page aligned, the end is rounded up to a page.
+    // returns the number of bytes released.
+    int64_t DecommitRange(uint64_t offset, uint64_t len);
+
+    // fill pa_list with the physical address of each page in the range, which must all be
+    // committed. the range is widened to page boundaries and count must cover every page.
+    // a range that runs past the end of the object is an error rather than trimmed.
+    status_t Lookup(uint64_t offset, uint64_t len, paddr_t* pa_list, size_t count);
+
+    // cache maintenance on the committed pages of a range, through their kernel mappings
+    enum class CacheOpType { Invalidate, Clean, CleanInvalidate, Sync };
+    status_t CacheOp(uint64_t offset, uint64_t len, CacheOpType type);
+
     // get a pointer to a page at a given offset
     vm_page_t* GetPage(uint64_t offset);
 
+    // remove the page at a page aligned offset from the object, unmapping it from any
+    // region, and hand ownership to the caller. returns null if no page is committed there.
+    vm_page_t* TakePage(uint64_t offset);
+
+    // install a page at a page aligned offset, unmapping and freeing any page already there
+    status_t ReplacePage(uint64_t offset, vm_page_t* p);
+
     // fault in a page at a given offset with PF_FLAGS
     vm_page_t* FaultPage(uint64_t offset, uint pf_flags);
 
+    // variants of the above for callers already holding lock()
+    vm_page_t* GetPageLocked(uint64_t offset);
+    vm_page_t* FaultPageLocked(uint64_t offset, uint pf_flags);
+
+    // track the regions that map this object, so pages can be unmapped when decommitted
+    void AddMapping(VmRegion* r);
+    void RemoveMapping(VmRegion* r);
+    void RemoveMappingLocked(VmRegion* r);
+
+    // Anonymous memory created for user space, once no handle reaches it and it is mapped
+    // just once, can have pages moved in and out of it: only that mapping sees the change.
+    void set_anonymous();
+    void set_user_handles(bool present);
+    bool CanMovePages();
+
+    // the object lock, which must be held across looking up a page and mapping it
+    // so that it cannot be decommitted in between
+    mutex_t* lock() { return &lock_; }
+
     // read/write operators against kernel pointers only
     status_t Read(void* ptr, uint64_t offset, size_t len, size_t* bytes_read);
     status_t Write(const void* ptr, uint64_t offset, size_t len, size_t* bytes_written);
@@ -65,12 +107,16 @@ private:
     ~VmObject();
     friend mxtl::RefPtr<VmObject>;
 
-    // fault in a page at a given offset with PF_FLAGS
-    vm_page_t* FaultPageLocked(uint64_t offset, uint pf_flags);
-
     // internal page list routine
     void AddPageToArray(size_t index, vm_page_t* p);
 
+    // unmap a range of the object from every region mapping it
+    void UnmapRangeLocked(uint64_t offset, uint64_t len);
+
+    // unmap a range of uncommitted pages, which regions can only be mapping as the shared
+    // zero page, and only if it was ever handed out for this object
+    void UnmapZeroPagesLocked(uint64_t offset, uint64_t len);
+
     // internal read/write routine that takes a templated copy function to help share some code
     template <typename T>
     status_t ReadWriteInternal(uint64_t offset, size_t len, size_t* bytes_copied, bool write,
@@ -97,4 +143,14 @@ private:
 
     // list of all allocated pages
     list_node page_list_ = LIST_INITIAL_VALUE(page_list_);
+
+    // list of regions that map this object
+    mxtl::DoublyLinkedList<VmRegion*, VmRegionObjectListTraits> mapping_list_;
+
+    // set once FaultPageLocked() has handed out the shared zero page for this object
+    bool zero_page_mapped_ = false;
+
+    // see CanMovePages()
+    bool anonymous_ = false;
+    bool user_handles_ = false;
 };
@@ -8,6 +8,7 @@
 
 #include <assert.h>
 #include <stdint.h>
+#include <mxtl/intrusive_double_list.h>
 #include <mxtl/intrusive_wavl_tree.h>
 #include <mxtl/ref_counted.h>
 #include <mxtl/ref_ptr.h>
@@ -54,8 +55,17 @@ public:
     // page fault in an address into the region
     status_t PageFault(vaddr_t va, uint pf_flags);
 
+    // unmap any pages in this region that back the given range of the vm object
+    // must be called with the object's lock held
+    status_t UnmapObjectRangeLocked(uint64_t offset, uint64_t len);
+
     mxtl::RefPtr<VmObject> vmo();
 
+    // count the pages of a range of the region that are committed in its object and
+    // that are mapped in the address space. must be called with the aspace lock held
+    void GetMemoryUsage(size_t offset, size_t len, size_t* committed_pages,
+                        size_t* mapped_pages);
+
     // WAVL tree key function
     vaddr_t GetKey() const { return base(); }
 
@@ -86,4 +96,16 @@ private:
     uint64_t object_offset_ = 0;
 
     char name_[32];
+
+    // node for the list of regions that map the vm object
+    friend struct VmRegionObjectListTraits;
+    mxtl::DoublyLinkedListNodeState<VmRegion*> object_list_node_state_;
+};
+
+// For use by VmObject to track the regions that map it. (We don't use the default traits since
+// regions already sit in their address space's WAVL tree.)
+struct VmRegionObjectListTraits {
+    inline static mxtl::DoublyLinkedListNodeState<VmRegion*>& node_state(VmRegion& obj) {
+        return obj.object_list_node_state_;
+    }
 };
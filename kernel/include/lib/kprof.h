@@ -0,0 +1,44 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <magenta/compiler.h>
+#include <magenta/kprof.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+__BEGIN_CDECLS
+
+// Nonzero while the profiler is running, so the hook in the interrupt
+// path costs one load and one branch otherwise.
+extern volatile int kprof_active;
+
+// Called by the architecture's interrupt path once the interrupt has been
+// handled, with the state of the interrupted context.  Takes a sample if
+// the profiling timer fired on this cpu.  |fp| may be zero if the frame
+// pointer of the interrupted context is not known.
+void kprof_irq_exit(uintptr_t pc, uintptr_t fp, bool user);
+
+status_t kprof_control(uint32_t action, uint32_t options);
+
+// Copies up to |len| bytes of the profile (see <magenta/kprof.h>) starting
+// at |offset| into |ptr|, which is a user pointer if |user| is set.
+// Returns the number of bytes copied, or with a NULL |ptr| the total size.
+ssize_t kprof_read(void* ptr, size_t offset, size_t len, bool user);
+
+#if WITH_LIB_KPROF
+#define KPROF_IRQ_EXIT(pc, fp, user)                                          \
+    do {                                                                      \
+        if (unlikely(kprof_active))                                           \
+            kprof_irq_exit((uintptr_t)(pc), (uintptr_t)(fp), (user));         \
+    } while (0)
+#else
+#define KPROF_IRQ_EXIT(pc, fp, user) do { } while (0)
+#endif
+
+__END_CDECLS
@@ -0,0 +1,40 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <magenta/compiler.h>
+#include <magenta/ktrace.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+__BEGIN_CDECLS
+
+// Mask of KTRACE_GRP_* whose probes are live.  Zero unless tracing has
+// been started, so a disabled probe costs one load and one branch.
+extern volatile uint32_t ktrace_grpmask;
+
+void ktrace_write(uint32_t tag, uint64_t a, uint64_t b);
+
+status_t ktrace_control(uint32_t action, uint32_t options);
+
+// Copies up to |len| bytes of the trace (see <magenta/ktrace.h>) starting
+// at |offset| into |ptr|, which is a user pointer if |user| is set.
+// Returns the number of bytes copied, or with a NULL |ptr| the total size.
+ssize_t ktrace_read(void* ptr, size_t offset, size_t len, bool user);
+
+#if WITH_LIB_KTRACE
+#define KTRACE(grp_tag, a, b)                                                 \
+    do {                                                                      \
+        if (unlikely(ktrace_grpmask & KTRACE_TAG_GROUP(grp_tag)))             \
+            ktrace_write((grp_tag), (uint64_t)(a), (uint64_t)(b));            \
+    } while (0)
+#else
+#define KTRACE(grp_tag, a, b) do { } while (0)
+#endif
+
+__END_CDECLS
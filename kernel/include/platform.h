@@ -74,6 +74,13 @@ void platform_quiesce(void);
  */
 void *platform_get_ramdisk(size_t *size);
 
+/* describes a free-running counter that user mode can read directly, such
+ * that current_time_hires() in nanoseconds is (counter * mult) >> shift.
+ * Returns false if there is no such counter.
+ */
+bool platform_usermode_counter(uint64_t *ticks_to_ns_mult,
+                               uint32_t *ticks_to_ns_shift);
+
 __END_CDECLS;
 
 #endif
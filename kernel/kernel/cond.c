@@ -9,6 +9,7 @@
 #include <assert.h>
 #include <debug.h>
 #include <err.h>
+#include <kernel/lockstat.h>
 #include <kernel/mutex.h>
 #include <kernel/thread.h>
 
@@ -34,6 +35,12 @@ status_t cond_wait_timeout(cond_t *cond, mutex_t *mutex, lk_time_t timeout)
     DEBUG_ASSERT(cond->magic == COND_MAGIC);
     DEBUG_ASSERT(mutex->magic == MUTEX_MAGIC);
 
+#if WITH_LOCK_STATS
+    // The time spent waiting on the condition does not count as holding
+    // the mutex.
+    lockstat_mutex_released(mutex);
+#endif
+
     THREAD_LOCK(state);
 
     // We specifically want reschedule=false here, otherwise the
@@ -47,6 +54,10 @@ status_t cond_wait_timeout(cond_t *cond, mutex_t *mutex, lk_time_t timeout)
 
     THREAD_UNLOCK(state);
 
+#if WITH_LOCK_STATS
+    lockstat_mutex_reacquired(mutex);
+#endif
+
     return result;
 }
 
@@ -0,0 +1,284 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <kernel/lockstat.h>
+
+#include <arch/ops.h>
+#include <debug.h>
+#include <err.h>
+#include <kernel/mutex.h>
+#include <lib/console.h>
+#include <platform.h>
+#include <stdlib.h>
+#include <string.h>
+
+#if ARCH_X86
+#include <arch/x86.h>
+#endif
+
+/* This file sits underneath every lock in the kernel, so nothing here may
+ * take a lock.  Lock sites live in an open-addressed hash table and are
+ * claimed with a compare and swap on the pc; the counters are updated
+ * with atomics.  Spinlock hold times are measured with a small stack per
+ * cpu of the spinlocks held there, since a spinlock is released on the
+ * cpu that acquired it.  Mutex hold times are kept in the mutex itself.
+ */
+
+#define LOCKSTAT_MAX_PROBES 32
+#define LOCKSTAT_MAX_HELD 8
+
+typedef struct lockstat_site {
+    volatile unsigned long long pc;
+    uint32_t type;
+    volatile unsigned long long acquisitions;
+    volatile unsigned long long contended;
+    volatile unsigned long long wait_ticks;
+    volatile unsigned long long max_hold_ticks;
+} lockstat_site_t;
+
+typedef struct lockstat_held {
+    spin_lock_t *lock;
+    lockstat_site_t *site;
+    uint64_t start;
+} lockstat_held_t;
+
+typedef struct lockstat_cpu {
+    uint depth;
+    lockstat_held_t held[LOCKSTAT_MAX_HELD];
+} __CPU_ALIGN lockstat_cpu_t;
+
+static lockstat_site_t lockstat_sites[LOCKSTAT_MAX_SITES];
+static lockstat_cpu_t lockstat_cpus[SMP_MAX_CPUS];
+
+/* acquisitions that found no free slot in the table */
+static volatile int lockstat_overflow;
+
+uint64_t lockstat_now(void)
+{
+#if ARCH_X86
+    return rdtsc();
+#else
+    return current_time_hires();
+#endif
+}
+
+static uint64_t lockstat_ticks_to_ns(uint64_t ticks)
+{
+#if ARCH_X86
+    uint64_t mult;
+    uint32_t shift;
+    if (!platform_usermode_counter(&mult, &shift))
+        return ticks; /* no stable counter rate; report raw cycles */
+    return (uint64_t)(((unsigned __int128)ticks * mult) >> shift);
+#else
+    return ticks * 1000;
+#endif
+}
+
+static lockstat_site_t *lockstat_find(uintptr_t pc, uint32_t type)
+{
+    uint32_t hash = (uint32_t)((pc >> 2) ^ (pc >> 12)) * 0x9e3779b1u;
+    for (uint i = 0; i < LOCKSTAT_MAX_PROBES; i++) {
+        lockstat_site_t *site = &lockstat_sites[(hash + i) % LOCKSTAT_MAX_SITES];
+        unsigned long long cur = atomic_load_u64(&site->pc);
+        if (cur == pc)
+            return site;
+        if (cur == 0) {
+            unsigned long long expected = 0;
+            if (atomic_cmpxchg_u64(&site->pc, &expected, pc)) {
+                site->type = type;
+                return site;
+            }
+            if (expected == pc)
+                return site;
+        }
+    }
+    atomic_add(&lockstat_overflow, 1);
+    return NULL;
+}
+
+static void lockstat_update_max(volatile unsigned long long *max, uint64_t value)
+{
+    unsigned long long cur = atomic_load_u64(max);
+    while (value > cur) {
+        if (atomic_cmpxchg_u64(max, &cur, value))
+            break;
+    }
+}
+
+static void lockstat_record(lockstat_site_t *site, bool contended, uint64_t wait)
+{
+    atomic_add_u64(&site->acquisitions, 1);
+    if (contended) {
+        atomic_add_u64(&site->contended, 1);
+        atomic_add_u64(&site->wait_ticks, wait);
+    }
+}
+
+static void lockstat_push_held(spin_lock_t *lock, lockstat_site_t *site)
+{
+    lockstat_cpu_t *c = &lockstat_cpus[arch_curr_cpu_num()];
+    if (c->depth < LOCKSTAT_MAX_HELD) {
+        lockstat_held_t *h = &c->held[c->depth];
+        h->lock = lock;
+        h->site = site;
+        h->start = lockstat_now();
+    }
+    c->depth++;
+}
+
+void lockstat_spin_lock(spin_lock_t *lock)
+{
+    uintptr_t pc = (uintptr_t)__builtin_return_address(0);
+    bool contended = false;
+    uint64_t wait = 0;
+
+    if (arch_spin_trylock(lock) != 0) {
+        uint64_t start = lockstat_now();
+        arch_spin_lock(lock);
+        contended = true;
+        wait = lockstat_now() - start;
+    }
+
+    lockstat_site_t *site = lockstat_find(pc, MX_LOCK_TYPE_SPINLOCK);
+    if (site)
+        lockstat_record(site, contended, wait);
+    lockstat_push_held(lock, site);
+}
+
+int lockstat_spin_trylock(spin_lock_t *lock)
+{
+    uintptr_t pc = (uintptr_t)__builtin_return_address(0);
+
+    int ret = arch_spin_trylock(lock);
+    if (ret == 0) {
+        lockstat_site_t *site = lockstat_find(pc, MX_LOCK_TYPE_SPINLOCK);
+        if (site)
+            lockstat_record(site, false, 0);
+        lockstat_push_held(lock, site);
+    }
+    return ret;
+}
+
+void lockstat_spin_unlock(spin_lock_t *lock)
+{
+    lockstat_cpu_t *c = &lockstat_cpus[arch_curr_cpu_num()];
+
+    /* Spinlocks are usually, but not always, released in reverse order. */
+    uint depth = MIN(c->depth, LOCKSTAT_MAX_HELD);
+    for (uint i = depth; i-- > 0;) {
+        lockstat_held_t *h = &c->held[i];
+        if (h->lock != lock)
+            continue;
+        if (h->site)
+            lockstat_update_max(&h->site->max_hold_ticks, lockstat_now() - h->start);
+        memmove(h, h + 1, (depth - i - 1) * sizeof(*h));
+        break;
+    }
+    if (c->depth > 0)
+        c->depth--;
+
+    arch_spin_unlock(lock);
+}
+
+void lockstat_mutex_acquired(mutex_t *m, uintptr_t pc, bool contended, uint64_t start)
+{
+    uint64_t now = lockstat_now();
+    lockstat_site_t *site = lockstat_find(pc, MX_LOCK_TYPE_MUTEX);
+    if (site)
+        lockstat_record(site, contended, now - start);
+    m->lockstat_site = site;
+    m->lockstat_acquired = now;
+}
+
+void lockstat_mutex_released(mutex_t *m)
+{
+    if (m->lockstat_site)
+        lockstat_update_max(&m->lockstat_site->max_hold_ticks, lockstat_now() - m->lockstat_acquired);
+}
+
+void lockstat_mutex_reacquired(mutex_t *m)
+{
+    m->lockstat_acquired = lockstat_now();
+}
+
+size_t lockstat_read(mx_lock_stats_t *stats, size_t max)
+{
+    size_t n = 0;
+    for (uint i = 0; i < LOCKSTAT_MAX_SITES && n < max; i++) {
+        lockstat_site_t *site = &lockstat_sites[i];
+        unsigned long long pc = atomic_load_u64(&site->pc);
+        if (pc == 0)
+            continue;
+        mx_lock_stats_t *s = &stats[n++];
+        s->pc = pc;
+        s->type = site->type;
+        s->reserved = 0;
+        s->acquisitions = site->acquisitions;
+        s->contended = site->contended;
+        s->wait_time = lockstat_ticks_to_ns(site->wait_ticks);
+        s->max_hold_time = lockstat_ticks_to_ns(site->max_hold_ticks);
+    }
+    return n;
+}
+
+/* Clears the counters but keeps the sites, which may be in use. */
+void lockstat_reset(void)
+{
+    for (uint i = 0; i < LOCKSTAT_MAX_SITES; i++) {
+        lockstat_site_t *site = &lockstat_sites[i];
+        atomic_store_u64(&site->acquisitions, 0);
+        atomic_store_u64(&site->contended, 0);
+        atomic_store_u64(&site->wait_ticks, 0);
+        atomic_store_u64(&site->max_hold_ticks, 0);
+    }
+    atomic_store(&lockstat_overflow, 0);
+}
+
+#if WITH_LIB_CONSOLE
+
+static int lockstat_compare_wait(const void *a, const void *b)
+{
+    const mx_lock_stats_t *sa = a;
+    const mx_lock_stats_t *sb = b;
+    if (sa->wait_time != sb->wait_time)
+        return sa->wait_time < sb->wait_time ? 1 : -1;
+    return sa->acquisitions < sb->acquisitions ? 1 : -1;
+}
+
+static int cmd_lockstat(int argc, const cmd_args *argv)
+{
+    if (argc > 1 && !strcmp(argv[1].str, "reset")) {
+        lockstat_reset();
+        return NO_ERROR;
+    }
+    size_t rows = (argc > 1) ? argv[1].u : 20;
+
+    mx_lock_stats_t *stats = calloc(LOCKSTAT_MAX_SITES, sizeof(mx_lock_stats_t));
+    if (!stats)
+        return ERR_NO_MEMORY;
+    size_t n = lockstat_read(stats, LOCKSTAT_MAX_SITES);
+    qsort(stats, n, sizeof(mx_lock_stats_t), lockstat_compare_wait);
+
+    printf("%zu lock sites, %d acquisitions untracked, by total wait time:\n",
+           n, atomic_load(&lockstat_overflow));
+    printf("%-18s %-5s %12s %12s %14s %14s\n",
+           "pc", "type", "acquired", "contended", "wait ns", "max hold ns");
+    for (size_t i = 0; i < MIN(n, rows); i++) {
+        printf("%#-18llx %-5s %12llu %12llu %14llu %14llu\n",
+               stats[i].pc, stats[i].type == MX_LOCK_TYPE_MUTEX ? "mutex" : "spin",
+               stats[i].acquisitions, stats[i].contended,
+               stats[i].wait_time, stats[i].max_hold_time);
+    }
+    free(stats);
+    return NO_ERROR;
+}
+
+STATIC_COMMAND_START
+STATIC_COMMAND("lockstat", "lock contention statistics: lockstat [rows|reset]", &cmd_lockstat)
+STATIC_COMMAND_END(lockstat);
+
+#endif
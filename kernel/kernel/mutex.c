@@ -19,6 +19,7 @@
 #include <debug.h>
 #include <assert.h>
 #include <err.h>
+#include <kernel/lockstat.h>
 #include <kernel/thread.h>
 
 /**
@@ -98,9 +99,22 @@ status_t mutex_acquire_timeout(mutex_t *m, lk_time_t timeout)
               get_current_thread(), get_current_thread()->name, m);
 #endif
 
+#if WITH_LOCK_STATS
+    uintptr_t pc = (uintptr_t)__builtin_return_address(0);
+    uint64_t start = lockstat_now();
+#endif
+
     THREAD_LOCK(state);
+#if WITH_LOCK_STATS
+    bool contended = m->count > 0;
+#endif
     status_t ret = mutex_acquire_timeout_internal(m, timeout);
     THREAD_UNLOCK(state);
+
+#if WITH_LOCK_STATS
+    if (ret == NO_ERROR)
+        lockstat_mutex_acquired(m, pc, contended, start);
+#endif
     return ret;
 }
 
@@ -128,6 +142,10 @@ void mutex_release(mutex_t *m)
     }
 #endif
 
+#if WITH_LOCK_STATS
+    lockstat_mutex_released(m);
+#endif
+
     THREAD_LOCK(state);
     mutex_release_internal(m, true);
     THREAD_UNLOCK(state);
@@ -28,6 +28,14 @@ MODULE_SRCS := \
 	$(LOCAL_DIR)/cmdline.c \
 
 
+# Build with LOCK_STATS=1 to record contention statistics for every lock
+# site; see kernel/lockstat.h.
+LOCK_STATS ?= 0
+ifeq ($(call TOBOOL,$(LOCK_STATS)),true)
+KERNEL_DEFINES += WITH_LOCK_STATS=1
+MODULE_SRCS += $(LOCAL_DIR)/lockstat.c
+endif
+
 ifeq ($(WITH_KERNEL_VM),1)
 MODULE_DEPS += kernel/vm
 else
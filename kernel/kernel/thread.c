@@ -29,6 +29,7 @@
 #include <platform.h>
 #include <target.h>
 #include <lib/heap.h>
+#include <lib/ktrace.h>
 #if WITH_KERNEL_VM
 #include <kernel/vm.h>
 #endif
@@ -83,6 +84,7 @@ static void insert_in_run_queue_head(thread_t *t)
     DEBUG_ASSERT(arch_ints_disabled());
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
+    t->last_ready_us = current_time_hires();
     list_add_head(&run_queue[t->priority], &t->queue_node);
     run_queue_bitmap |= (1<<t->priority);
 }
@@ -95,6 +97,7 @@ static void insert_in_run_queue_tail(thread_t *t)
     DEBUG_ASSERT(arch_ints_disabled());
     DEBUG_ASSERT(spin_lock_held(&thread_lock));
 
+    t->last_ready_us = current_time_hires();
     list_add_tail(&run_queue[t->priority], &t->queue_node);
     run_queue_bitmap |= (1<<t->priority);
 }
@@ -632,10 +635,23 @@ void thread_resched(void)
     if (newthread == oldthread)
         return;
 
+    KTRACE(KTRACE_TAG_CONTEXT_SWITCH, (uintptr_t)newthread, oldthread->state);
+
     lk_bigtime_t now = current_time_hires();
     oldthread->runtime_us += now - oldthread->last_started_running_us;
     newthread->last_started_running_us = now;
 
+    /* a thread still ready to run was preempted or yielded */
+    if (oldthread->state == THREAD_READY) {
+        oldthread->involuntary_switches++;
+    } else {
+        oldthread->voluntary_switches++;
+    }
+    /* the idle thread is picked without passing through the run queue */
+    if (!thread_is_idle(newthread)) {
+        newthread->wait_time_us += now - newthread->last_ready_us;
+    }
+
     /* set up quantum for the new thread if it was consumed */
     if (newthread->remaining_quantum <= 0) {
         newthread->remaining_quantum = 5; // XXX make this smarter
@@ -1154,6 +1170,33 @@ static const char *thread_state_to_str(enum thread_state state)
     }
 }
 
+/**
+ * @brief  Take a snapshot of a thread's accounting information.
+ *
+ * The runtime includes the time the thread has accrued so far if it is
+ * currently running, and the wait time includes the current wait if it
+ * is ready to run.
+ */
+void thread_get_accounting(thread_t *t, thread_accounting_t *acct)
+{
+    DEBUG_ASSERT(t->magic == THREAD_MAGIC);
+
+    THREAD_LOCK(state);
+    lk_bigtime_t now = current_time_hires();
+    acct->runtime_us = t->runtime_us;
+    acct->wait_time_us = t->wait_time_us;
+    if (t->state == THREAD_RUNNING) {
+        acct->runtime_us += now - t->last_started_running_us;
+    } else if (t->state == THREAD_READY) {
+        acct->wait_time_us += now - t->last_ready_us;
+    }
+    acct->voluntary_switches = t->voluntary_switches;
+    acct->involuntary_switches = t->involuntary_switches;
+    acct->page_faults = t->page_faults;
+    acct->syscalls = t->syscalls;
+    THREAD_UNLOCK(state);
+}
+
 /**
  * @brief  Dump debugging info about the specified thread.
  */
@@ -1173,6 +1216,8 @@ void dump_thread(thread_t *t)
             thread_state_to_str(t->state), t->priority, t->remaining_quantum);
 #endif
     dprintf(INFO, "\truntime_us %lld, runtime_s %lld\n", runtime, runtime / 1000000);
+    dprintf(INFO, "\twait_time_us %lld, switches %llu voluntary %llu involuntary\n",
+            t->wait_time_us, t->voluntary_switches, t->involuntary_switches);
     dprintf(INFO, "\tstack %p, stack_size %zd\n", t->stack, t->stack_size);
     dprintf(INFO, "\tentry %p, arg %p, flags 0x%x %s%s%s%s%s%s\n", t->entry, t->arg, t->flags,
             (t->flags & THREAD_FLAG_DETACHED) ? "Dt" :"",
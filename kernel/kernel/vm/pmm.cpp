@@ -6,14 +6,20 @@
 // https://opensource.org/licenses/MIT
 
 #include "vm_priv.h"
+#include <arch/ops.h>
 #include <assert.h>
 #include <err.h>
 #include <kernel/auto_lock.h>
+#include <kernel/cmdline.h>
+#include <kernel/event.h>
 #include <kernel/mutex.h>
+#include <kernel/thread.h>
 #include <kernel/vm.h>
 #include <lib/console.h>
 #include <list.h>
+#include <lk/init.h>
 #include <pow2.h>
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <trace.h>
@@ -23,6 +29,38 @@
 static struct list_node arena_list = LIST_INITIAL_VALUE(arena_list);
 static mutex_t lock = MUTEX_INITIAL_VALUE(lock);
 
+/* Free pages that are known to be zero are flagged VM_PAGE_FLAG_ZEROED and
+ * kept at the tail of their arena's free list.  Freed pages go on the head,
+ * so every free list is its dirty pages followed by its zeroed ones.
+ * Allocations that need zeroed pages take from the tail and the rest take
+ * from the head, leaving the zeroed pages for those that want them.
+ *
+ * A thread on each cpu, running just above the idle thread, takes dirty
+ * pages off the heads and puts them back zeroed on the tails until
+ * zero_pool_target pages are zeroed.  The pool bookkeeping is protected
+ * by the pmm lock. */
+#define ZERO_POOL_DEFAULT_PAGES 4096
+
+static size_t zeroed_count;
+static size_t zero_pool_target;
+static uint64_t zero_pool_hits;
+static uint64_t zero_pool_misses;
+static uint64_t zero_pool_bg_zeroed;
+static event_t zero_pool_event = EVENT_INITIAL_VALUE(zero_pool_event, false, 0);
+
+/* The pressure level is recomputed whenever the free page count moves
+ * across a watermark.  Leaving a level needs free pages an eighth above
+ * its watermark.  Waiters in pmm_pressure_wait() are woken on every
+ * change; all of this is protected by the pmm lock. */
+#define PRESSURE_WARNING_DEFAULT_PCT 10
+#define PRESSURE_CRITICAL_DEFAULT_PCT 4
+
+static size_t free_count;
+static size_t pressure_warning_pages;
+static size_t pressure_critical_pages;
+static uint pressure_level = PMM_PRESSURE_NORMAL;
+static event_t pressure_event = EVENT_INITIAL_VALUE(pressure_event, false, 0);
+
 #define PAGE_BELONGS_TO_ARENA(page, arena)                    \
     (((uintptr_t)(page) >= (uintptr_t)(arena)->page_array) && \
      ((uintptr_t)(page) <                                     \
@@ -39,6 +77,81 @@ static inline bool page_is_free(const vm_page_t* page) {
     return page->state == VM_PAGE_STATE_FREE;
 }
 
+/* wake the zeroing threads if the pool has run low; called with the lock held */
+static void zero_pool_check_locked(void) {
+    if (zeroed_count < zero_pool_target / 2 && !zero_pool_event.signalled)
+        event_signal(&zero_pool_event, false);
+}
+
+/* recompute the pressure level after the free count changed; called with the lock held */
+static void pressure_check_locked(void) {
+    uint level = pressure_level;
+    if (free_count < pressure_critical_pages) {
+        level = PMM_PRESSURE_CRITICAL;
+    } else if (free_count < pressure_warning_pages) {
+        if (level == PMM_PRESSURE_NORMAL ||
+            free_count >= pressure_critical_pages + pressure_critical_pages / 8)
+            level = PMM_PRESSURE_WARNING;
+    } else if (free_count >= pressure_warning_pages + pressure_warning_pages / 8) {
+        level = PMM_PRESSURE_NORMAL;
+    } else if (level == PMM_PRESSURE_CRITICAL) {
+        level = PMM_PRESSURE_WARNING;
+    }
+
+    if (level != pressure_level) {
+        pressure_level = level;
+        event_signal(&pressure_event, false);
+    }
+}
+
+/* remove a page from its arena's free list; called with the lock held */
+static void remove_free_page_locked(pmm_arena_t* a, vm_page_t* page, uint alloc_flags) {
+    DEBUG_ASSERT(page_is_free(page));
+    DEBUG_ASSERT(list_in_list(&page->node));
+
+    list_delete(&page->node);
+    a->free_count--;
+    free_count--;
+    page->state = VM_PAGE_STATE_ALLOC;
+
+    if (page->flags & VM_PAGE_FLAG_ZEROED) {
+        zeroed_count--;
+        if (alloc_flags & PMM_ALLOC_FLAG_ZERO)
+            zero_pool_hits++;
+        zero_pool_check_locked();
+    } else if (alloc_flags & PMM_ALLOC_FLAG_ZERO) {
+        zero_pool_misses++;
+    }
+
+    /* PMM_ALLOC_FLAG_ZERO allocations clear the flag once they have made
+     * sure the page is zero, outside the lock. */
+    if (!(alloc_flags & PMM_ALLOC_FLAG_ZERO))
+        page->flags &= (uint8_t)~VM_PAGE_FLAG_ZEROED;
+}
+
+/* take the page an allocation with these flags prefers from an arena */
+static vm_page_t* alloc_page_locked(pmm_arena_t* a, uint alloc_flags) {
+    vm_page_t* page;
+    if (alloc_flags & PMM_ALLOC_FLAG_ZERO) {
+        page = list_peek_tail_type(&a->free_list, vm_page_t, node);
+    } else {
+        page = list_peek_head_type(&a->free_list, vm_page_t, node);
+    }
+    if (page)
+        remove_free_page_locked(a, page, alloc_flags);
+    return page;
+}
+
+/* finish a PMM_ALLOC_FLAG_ZERO allocation of a page */
+static void zero_allocated_page(vm_page_t* page, paddr_t pa) {
+    if (!(page->flags & VM_PAGE_FLAG_ZEROED)) {
+        void* ptr = paddr_to_kvaddr(pa);
+        DEBUG_ASSERT(ptr);
+        arch_zero_page(ptr);
+    }
+    page->flags &= (uint8_t)~VM_PAGE_FLAG_ZEROED;
+}
+
 paddr_t vm_page_to_paddr(const vm_page_t* page) {
     pmm_arena_t* a;
     list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
@@ -101,43 +214,51 @@ done_add:
 
         arena->free_count++;
     }
+    free_count += page_count;
 
     return NO_ERROR;
 }
 
 vm_page_t* pmm_alloc_page(uint alloc_flags, paddr_t* pa) {
-    AutoLock al(lock);
+    vm_page_t* page = nullptr;
+    paddr_t page_pa = 0;
 
-    /* walk the arenas in order until we find one with a free page */
-    pmm_arena_t* a;
-    list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a->flags & PMM_ARENA_FLAG_KMAP) == 0)
-                continue;
-        }
-        vm_page_t* page = list_remove_head_type(&a->free_list, vm_page_t, node);
-        if (!page)
-            continue;
-
-        a->free_count--;
+    {
+        AutoLock al(lock);
 
-        DEBUG_ASSERT(page_is_free(page));
-
-        page->state = VM_PAGE_STATE_ALLOC;
+        /* walk the arenas in order until we find one with a free page */
+        pmm_arena_t* a;
+        list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
+            /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
+            if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
+                if ((a->flags & PMM_ARENA_FLAG_KMAP) == 0)
+                    continue;
+            }
+            page = alloc_page_locked(a, alloc_flags);
+            if (!page)
+                continue;
 
-        if (pa) {
             /* compute the physical address of the page based on its offset into the arena */
-            *pa = PAGE_ADDRESS_FROM_ARENA(page, a);
+            page_pa = PAGE_ADDRESS_FROM_ARENA(page, a);
+            break;
         }
 
-        LTRACEF("allocating page %p, pa 0x%lx\n", page, PAGE_ADDRESS_FROM_ARENA(page, a));
+        pressure_check_locked();
+    }
 
-        return page;
+    if (!page) {
+        LTRACEF("failed to allocate page\n");
+        return nullptr;
     }
 
-    LTRACEF("failed to allocate page\n");
-    return nullptr;
+    LTRACEF("allocating page %p, pa 0x%lx\n", page, page_pa);
+
+    if (alloc_flags & PMM_ALLOC_FLAG_ZERO)
+        zero_allocated_page(page, page_pa);
+
+    if (pa)
+        *pa = page_pa;
+    return page;
 }
 
 size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
@@ -150,29 +271,38 @@ size_t pmm_alloc_pages(size_t count, uint alloc_flags, struct list_node* list) {
     if (count == 0)
         return 0;
 
-    AutoLock al(lock);
+    /* the pages we add follow whatever was already on the list */
+    struct list_node* prev_tail = list->prev;
 
-    /* walk the arenas in order, allocating as many pages as we can from each */
-    pmm_arena_t* a;
-    list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
-        /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
-        if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
-            if ((a->flags & PMM_ARENA_FLAG_KMAP) == 0)
-                continue;
-        }
-        while (allocated < count) {
-            vm_page_t* page = list_remove_head_type(&a->free_list, vm_page_t, node);
-            if (!page)
-                return allocated;
+    {
+        AutoLock al(lock);
 
-            a->free_count--;
+        /* walk the arenas in order, allocating as many pages as we can from each */
+        pmm_arena_t* a;
+        list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
+            /* skip the arena if it's not KMAP and the KMAP only allocation flag was passed */
+            if (alloc_flags & PMM_ALLOC_FLAG_KMAP) {
+                if ((a->flags & PMM_ARENA_FLAG_KMAP) == 0)
+                    continue;
+            }
+            while (allocated < count) {
+                vm_page_t* page = alloc_page_locked(a, alloc_flags);
+                if (!page)
+                    break;
 
-            DEBUG_ASSERT(page_is_free(page));
+                list_add_tail(list, &page->node);
 
-            page->state = VM_PAGE_STATE_ALLOC;
-            list_add_tail(list, &page->node);
+                allocated++;
+            }
+        }
 
-            allocated++;
+        pressure_check_locked();
+    }
+
+    if (alloc_flags & PMM_ALLOC_FLAG_ZERO) {
+        for (struct list_node* node = prev_tail->next; node != list; node = node->next) {
+            vm_page_t* page = containerof(node, vm_page_t, node);
+            zero_allocated_page(page, vm_page_to_paddr(page));
         }
     }
 
@@ -204,15 +334,11 @@ size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
                 break;
             }
 
-            DEBUG_ASSERT(list_in_list(&page->node));
-
-            list_delete(&page->node);
-            page->state = VM_PAGE_STATE_ALLOC;
+            remove_free_page_locked(a, page, 0);
 
             if (list)
                 list_add_tail(list, &page->node);
 
-            a->free_count--;
             allocated++;
             address += PAGE_SIZE;
         }
@@ -221,6 +347,8 @@ size_t pmm_alloc_range(paddr_t address, size_t count, struct list_node* list) {
             break;
     }
 
+    pressure_check_locked();
+
     return allocated;
 }
 
@@ -280,12 +408,7 @@ size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_lo
             /* remove the pages from the run out of the free list */
             for (paddr_t i = start; i < start + count; i++) {
                 p = &a->page_array[i];
-                DEBUG_ASSERT(page_is_free(p));
-                DEBUG_ASSERT(list_in_list(&p->node));
-
-                list_delete(&p->node);
-                p->state = VM_PAGE_STATE_ALLOC;
-                a->free_count--;
+                remove_free_page_locked(a, p, 0);
 
                 if (list)
                     list_add_tail(list, &p->node);
@@ -294,6 +417,8 @@ size_t pmm_alloc_contiguous(size_t count, uint alloc_flags, uint8_t alignment_lo
             if (pa)
                 *pa = a->base + start * PAGE_SIZE;
 
+            pressure_check_locked();
+
             return count;
         }
     }
@@ -389,15 +514,23 @@ size_t pmm_free(struct list_node* list) {
         list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
             if (PAGE_BELONGS_TO_ARENA(page, a)) {
                 page->state = VM_PAGE_STATE_FREE;
+                page->flags &= (uint8_t)~VM_PAGE_FLAG_ZEROED;
 
                 list_add_head(&a->free_list, &page->node);
                 a->free_count++;
+                free_count++;
                 count++;
                 break;
             }
         }
     }
 
+    pressure_check_locked();
+
+    /* there may be dirty pages to zero now */
+    if (zeroed_count < zero_pool_target && !zero_pool_event.signalled)
+        event_signal(&zero_pool_event, false);
+
     return count;
 }
 
@@ -410,6 +543,173 @@ size_t pmm_free_page(vm_page_t* page) {
     return pmm_free(&list);
 }
 
+size_t pmm_count_free_pages(void) {
+    AutoLock al(lock);
+
+    size_t count = 0;
+    pmm_arena_t* a;
+    list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
+        count += a->free_count;
+    }
+    return count;
+}
+
+size_t pmm_count_total_pages(void) {
+    AutoLock al(lock);
+
+    size_t count = 0;
+    pmm_arena_t* a;
+    list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
+        count += a->size / PAGE_SIZE;
+    }
+    return count;
+}
+
+void pmm_get_zero_pool_stats(pmm_zero_pool_stats_t* stats) {
+    AutoLock al(lock);
+
+    stats->zeroed_pages = zeroed_count;
+    stats->target_pages = zero_pool_target;
+    stats->pool_hits = zero_pool_hits;
+    stats->pool_misses = zero_pool_misses;
+    stats->bg_zeroed = zero_pool_bg_zeroed;
+}
+
+uint pmm_pressure_level(void) {
+    AutoLock al(lock);
+    return pressure_level;
+}
+
+uint pmm_pressure_wait(uint level) {
+    for (;;) {
+        {
+            AutoLock al(lock);
+            if (pressure_level != level)
+                return pressure_level;
+            event_unsignal(&pressure_event);
+        }
+        event_wait(&pressure_event);
+    }
+}
+
+/* Take a dirty page from the head of a free list to be zeroed, if the pool
+ * is short of its target.  Called with the lock held. */
+static vm_page_t* zero_pool_take_locked(pmm_arena_t** arena, paddr_t* pa) {
+    if (zeroed_count >= zero_pool_target)
+        return nullptr;
+
+    pmm_arena_t* a;
+    list_for_every_entry (&arena_list, a, pmm_arena_t, node) {
+        /* the page is zeroed through the kernel's mapping of it */
+        if ((a->flags & PMM_ARENA_FLAG_KMAP) == 0)
+            continue;
+
+        vm_page_t* page = list_peek_head_type(&a->free_list, vm_page_t, node);
+        if (!page || (page->flags & VM_PAGE_FLAG_ZEROED))
+            continue;
+
+        remove_free_page_locked(a, page, 0);
+        *arena = a;
+        *pa = PAGE_ADDRESS_FROM_ARENA(page, a);
+        return page;
+    }
+    return nullptr;
+}
+
+/* Put a freshly zeroed page on the tail of the free list it came from.
+ * Called with the lock held. */
+static void zero_pool_return_locked(pmm_arena_t* a, vm_page_t* page) {
+    DEBUG_ASSERT(PAGE_BELONGS_TO_ARENA(page, a));
+
+    page->state = VM_PAGE_STATE_FREE;
+    page->flags |= VM_PAGE_FLAG_ZEROED;
+
+    list_add_tail(&a->free_list, &page->node);
+    a->free_count++;
+    free_count++;
+    zeroed_count++;
+    zero_pool_bg_zeroed++;
+}
+
+/* The zeroing threads run just above idle, so one preempted while holding
+ * the pmm lock would stall every allocation behind whatever else is
+ * runnable.  They take the lock at the highest priority instead, for
+ * constant work each time: the page just zeroed goes back and the next
+ * one comes off, and the zeroing itself is done with the lock dropped. */
+#define ZERO_POOL_PRIORITY (LOWEST_PRIORITY + 1)
+
+static int zero_pool_thread(void* arg) {
+    vm_page_t* page = nullptr;
+    pmm_arena_t* a = nullptr;
+    paddr_t pa;
+
+    for (;;) {
+        thread_set_priority(HIGHEST_PRIORITY);
+        {
+            AutoLock al(lock);
+            if (page)
+                zero_pool_return_locked(a, page);
+            page = zero_pool_take_locked(&a, &pa);
+            if (!page)
+                event_unsignal(&zero_pool_event);
+        }
+        thread_set_priority(ZERO_POOL_PRIORITY);
+
+        if (!page) {
+            event_wait(&zero_pool_event);
+            continue;
+        }
+
+        arch_zero_page(paddr_to_kvaddr(pa));
+    }
+    return 0;
+}
+
+static void zero_pool_init(uint level) {
+    uint32_t target = cmdline_get_uint32("pmm.zero_pool_pages", ZERO_POOL_DEFAULT_PAGES);
+    if (target == 0)
+        return;
+
+    {
+        AutoLock al(lock);
+        zero_pool_target = target;
+    }
+
+    for (uint cpu = 0; cpu < arch_max_num_cpus(); cpu++) {
+        char name[THREAD_NAME_LENGTH];
+        snprintf(name, sizeof(name), "zero pool %u", cpu);
+
+        thread_t* t = thread_create(name, zero_pool_thread, nullptr, ZERO_POOL_PRIORITY,
+                                    DEFAULT_STACK_SIZE);
+        if (!t)
+            break;
+        thread_set_pinned_cpu(t, cpu);
+        thread_detach_and_resume(t);
+    }
+
+    event_signal(&zero_pool_event, true);
+}
+
+LK_INIT_HOOK(pmm_zero_pool, &zero_pool_init, LK_INIT_LEVEL_APPS - 1);
+
+static void pressure_init(uint level) {
+    uint32_t warning_pct = cmdline_get_uint32("pmm.pressure_warning_pct",
+                                              PRESSURE_WARNING_DEFAULT_PCT);
+    uint32_t critical_pct = cmdline_get_uint32("pmm.pressure_critical_pct",
+                                               PRESSURE_CRITICAL_DEFAULT_PCT);
+    if (critical_pct > warning_pct)
+        critical_pct = warning_pct;
+
+    size_t total = pmm_count_total_pages();
+
+    AutoLock al(lock);
+    pressure_warning_pages = total / 100 * warning_pct;
+    pressure_critical_pages = total / 100 * critical_pct;
+    pressure_check_locked();
+}
+
+LK_INIT_HOOK(pmm_pressure, &pressure_init, LK_INIT_LEVEL_VM);
+
 static const char* page_state_to_str(const vm_page_t* page) {
     switch (page->state) {
     case VM_PAGE_STATE_FREE:
@@ -475,6 +775,8 @@ static int cmd_pmm(int argc, const cmd_args* argv) {
         printf("%s alloc_contig <count> <alignment>\n", argv[0].str);
         printf("%s dump_alloced\n", argv[0].str);
         printf("%s free_alloced\n", argv[0].str);
+        printf("%s zero_pool\n", argv[0].str);
+        printf("%s pressure\n", argv[0].str);
         return ERR_INTERNAL;
     }
 
@@ -554,6 +856,19 @@ static int cmd_pmm(int argc, const cmd_args* argv) {
     } else if (!strcmp(argv[1].str, "free_alloced")) {
         size_t err = pmm_free(&allocated);
         printf("pmm_free returns %zu\n", err);
+    } else if (!strcmp(argv[1].str, "zero_pool")) {
+        pmm_zero_pool_stats_t stats;
+        pmm_get_zero_pool_stats(&stats);
+        printf("zeroed pages %zu, target %zu\n", stats.zeroed_pages, stats.target_pages);
+        printf("zeroed allocations: %llu from the pool, %llu zeroed on demand\n",
+               stats.pool_hits, stats.pool_misses);
+        printf("pages zeroed in the background %llu\n", stats.bg_zeroed);
+    } else if (!strcmp(argv[1].str, "pressure")) {
+        static const char* const names[] = {"normal", "warning", "critical"};
+        AutoLock al(lock);
+        printf("pressure %s: free pages %zu, warning below %zu, critical below %zu\n",
+               names[pressure_level], free_count, pressure_warning_pages,
+               pressure_critical_pages);
     } else {
         printf("unknown command\n");
         goto usage;
@@ -32,6 +32,8 @@ extern int __data_end;
 extern int __bss_start;
 extern int __bss_end;
 
+static vm_page_t* zero_page;
+
 // mark the physical pages backing a range of virtual as in use.
 // allocate the physical pages and throw them away
 static void mark_pages_in_use(vaddr_t va, size_t len) {
@@ -187,6 +189,17 @@ void vm_init_postheap(uint level) {
             vaddr = next_kernel_region_end;
         }
     }
+
+    // the shared zero page, mapped read-only in place of pages that have
+    // only been read
+    paddr_t zero_page_paddr;
+    zero_page = pmm_alloc_page(PMM_ALLOC_FLAG_KMAP | PMM_ALLOC_FLAG_ZERO, &zero_page_paddr);
+    ASSERT(zero_page);
+    LTRACEF("zero page %p, pa %#lx\n", zero_page, zero_page_paddr);
+}
+
+vm_page_t* vm_get_zero_page(void) {
+    return zero_page;
 }
 
 void* paddr_to_kvaddr(paddr_t pa) {
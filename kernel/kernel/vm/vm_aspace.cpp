@@ -696,6 +696,43 @@ void VmAspace::Dump() const {
     }
 }
 
+// the most pages counted at once by GetMemoryUsage(), with the lock held
+#define MEMORY_USAGE_CHUNK_PAGES 512
+
+void VmAspace::GetMemoryUsage(size_t* committed_pages, size_t* mapped_pages) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+
+    *committed_pages = 0;
+    *mapped_pages = 0;
+
+    // count a chunk at a time, dropping the lock in between so that faults and
+    // mappings are not held up behind a large address space. each chunk picks up
+    // at whatever region now holds the next address, or the one after it
+    vaddr_t va = base_;
+    for (;;) {
+        AutoLock a(lock_);
+
+        mxtl::RefPtr<VmRegion> r = FindRegionLocked(va);
+        if (!r) {
+            auto iter = regions_.lower_bound(va);
+            if (!iter.IsValid())
+                break;
+            r = iter.CopyPointer();
+            va = r->base();
+        }
+
+        size_t offset = va - r->base();
+        size_t len = MIN(r->size() - offset, MEMORY_USAGE_CHUNK_PAGES * PAGE_SIZE);
+        r->GetMemoryUsage(offset, len, committed_pages, mapped_pages);
+
+        va += len;
+        if (va < r->base()) {
+            // the region runs to the very top of the address space
+            break;
+        }
+    }
+}
+
 void DumpAllAspaces() {
     AutoLock a(aspace_list_lock);
 
@@ -7,6 +7,7 @@
 #include "kernel/vm/vm_object.h"
 
 #include "vm_priv.h"
+#include <arch/ops.h>
 #include <assert.h>
 #include <err.h>
 #include <kernel/auto_lock.h>
@@ -23,7 +24,7 @@ static void ZeroPage(paddr_t pa) {
     void* ptr = paddr_to_kvaddr(pa);
     DEBUG_ASSERT(ptr);
 
-    memset(ptr, 0, PAGE_SIZE);
+    arch_zero_page(ptr);
 }
 
 static void ZeroPage(vm_page_t* p) {
@@ -48,6 +49,9 @@ VmObject::~VmObject() {
     DEBUG_ASSERT(magic_ == MAGIC);
     LTRACEF("%p\n", this);
 
+    // regions hold a reference to us, so none can still be mapping us
+    DEBUG_ASSERT(mapping_list_.is_empty());
+
     list_node list;
     list_initialize(&list);
 
@@ -171,6 +175,9 @@ status_t VmObject::AddPage(vm_page_t* p, uint64_t offset) {
 
     size_t index = OffsetToIndex(offset);
 
+    // drop any mappings of the shared zero page standing in for this one
+    UnmapZeroPagesLocked(ROUNDDOWN(offset, PAGE_SIZE), PAGE_SIZE);
+
     AddPageToArray(index, p);
 
     return NO_ERROR;
@@ -180,6 +187,13 @@ vm_page_t* VmObject::GetPage(uint64_t offset) {
     DEBUG_ASSERT(magic_ == MAGIC);
     AutoLock a(lock_);
 
+    return GetPageLocked(offset);
+}
+
+vm_page_t* VmObject::GetPageLocked(uint64_t offset) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    DEBUG_ASSERT(is_mutex_held(&lock_));
+
     if (offset >= size_)
         return nullptr;
 
@@ -188,6 +202,121 @@ vm_page_t* VmObject::GetPage(uint64_t offset) {
     return page_array_[index];
 }
 
+vm_page_t* VmObject::TakePage(uint64_t offset) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    LTRACEF("vmo %p, offset 0x%llx\n", this, offset);
+
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset));
+
+    AutoLock a(lock_);
+
+    if (offset >= size_)
+        return nullptr;
+
+    size_t index = OffsetToIndex(offset);
+    vm_page_t* p = page_array_[index];
+    if (!p)
+        return nullptr;
+
+    UnmapRangeLocked(offset, PAGE_SIZE);
+
+    page_array_[index] = nullptr;
+    DEBUG_ASSERT(list_in_list(&p->node));
+    list_delete(&p->node);
+
+    return p;
+}
+
+status_t VmObject::ReplacePage(uint64_t offset, vm_page_t* p) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    LTRACEF("vmo %p, offset 0x%llx, page %p (0x%lx)\n", this, offset, p, vm_page_to_paddr(p));
+
+    DEBUG_ASSERT(p);
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset));
+
+    AutoLock a(lock_);
+
+    if (offset >= size_)
+        return ERR_OUT_OF_RANGE;
+
+    size_t index = OffsetToIndex(offset);
+    vm_page_t* old = page_array_[index];
+
+    // with no page here, regions may still be mapping the shared zero page
+    if (old)
+        UnmapRangeLocked(offset, PAGE_SIZE);
+    else
+        UnmapZeroPagesLocked(offset, PAGE_SIZE);
+
+    if (old) {
+        page_array_[index] = nullptr;
+        list_delete(&old->node);
+        pmm_free_page(old);
+    }
+
+    AddPageToArray(index, p);
+
+    return NO_ERROR;
+}
+
+void VmObject::UnmapRangeLocked(uint64_t offset, uint64_t len) {
+    DEBUG_ASSERT(is_mutex_held(&lock_));
+
+    for (auto& r : mapping_list_) {
+        r.UnmapObjectRangeLocked(offset, len);
+    }
+}
+
+void VmObject::UnmapZeroPagesLocked(uint64_t offset, uint64_t len) {
+    DEBUG_ASSERT(is_mutex_held(&lock_));
+
+    if (zero_page_mapped_)
+        UnmapRangeLocked(offset, len);
+}
+
+void VmObject::AddMapping(VmRegion* r) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    AutoLock a(lock_);
+
+    mapping_list_.push_front(r);
+}
+
+void VmObject::RemoveMapping(VmRegion* r) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    AutoLock a(lock_);
+
+    RemoveMappingLocked(r);
+}
+
+void VmObject::RemoveMappingLocked(VmRegion* r) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    DEBUG_ASSERT(is_mutex_held(&lock_));
+
+    // the region may have left the list already when it was unmapped
+    if (VmRegionObjectListTraits::node_state(*r).InContainer())
+        mapping_list_.erase(*r);
+}
+
+void VmObject::set_anonymous() {
+    AutoLock a(lock_);
+    anonymous_ = true;
+}
+
+void VmObject::set_user_handles(bool present) {
+    AutoLock a(lock_);
+    user_handles_ = present;
+}
+
+bool VmObject::CanMovePages() {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    AutoLock a(lock_);
+
+    if (!anonymous_ || user_handles_ || mapping_list_.is_empty())
+        return false;
+    auto it = mapping_list_.begin();
+    return ++it == mapping_list_.end();
+}
+
 vm_page_t* VmObject::FaultPageLocked(uint64_t offset, uint pf_flags) {
     DEBUG_ASSERT(magic_ == MAGIC);
     DEBUG_ASSERT(is_mutex_held(&lock_));
@@ -203,14 +332,23 @@ vm_page_t* VmObject::FaultPageLocked(uint64_t offset, uint pf_flags) {
     if (p)
         return p;
 
+    // a read of a page that was never written sees the shared zero page,
+    // which the caller must only map read-only; nothing is committed until
+    // the first write
+    if (!(pf_flags & VMM_PF_FLAG_WRITE)) {
+        LTRACEF("zero page for offset 0x%llx\n", offset);
+        zero_page_mapped_ = true;
+        return vm_get_zero_page();
+    }
+
     // allocate a page
     paddr_t pa;
-    p = pmm_alloc_page(pmm_alloc_flags_, &pa);
+    p = pmm_alloc_page(pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZERO, &pa);
     if (!p)
         return nullptr;
 
-    // TODO: remove once pmm returns zeroed pages
-    ZeroPage(pa);
+    // regions that read this page earlier have the zero page mapped here
+    UnmapZeroPagesLocked(ROUNDDOWN(offset, PAGE_SIZE), PAGE_SIZE);
 
     AddPageToArray(index, p);
 
@@ -259,23 +397,25 @@ int64_t VmObject::CommitRange(uint64_t offset, uint64_t len) {
     list_node page_list;
     list_initialize(&page_list);
 
-    size_t allocated = pmm_alloc_pages(count, pmm_alloc_flags_, &page_list);
+    size_t allocated = pmm_alloc_pages(count, pmm_alloc_flags_ | PMM_ALLOC_FLAG_ZERO, &page_list);
     if (allocated < count) {
         LTRACEF("failed to allocate enough pages (asked for %zu, got %zu)\n", count, allocated);
         pmm_free(&page_list);
         return ERR_NO_MEMORY;
     }
 
+    // regions may have the shared zero page mapped over the holes
+    UnmapZeroPagesLocked(ROUNDDOWN(offset, PAGE_SIZE), end - ROUNDDOWN(offset, PAGE_SIZE));
+
     // add them to the appropriate range of the object
     for (uint64_t o = offset; o < end; o += PAGE_SIZE) {
         size_t index = OffsetToIndex(o);
+        if (page_array_[index])
+            continue;
 
         vm_page_t* p = list_remove_head_type(&page_list, vm_page_t, node);
         DEBUG_ASSERT(p);
 
-        // TODO: remove once pmm returns zeroed pages
-        ZeroPage(p);
-
         AddPageToArray(index, p);
     }
 
@@ -329,6 +469,8 @@ int64_t VmObject::CommitRangeContiguous(uint64_t offset, uint64_t len, uint8_t a
 
     DEBUG_ASSERT(list_length(&page_list) == allocated);
 
+    UnmapZeroPagesLocked(ROUNDDOWN(offset, PAGE_SIZE), end - ROUNDDOWN(offset, PAGE_SIZE));
+
     // add them to the appropriate range of the object
     for (uint64_t o = offset; o < end; o += PAGE_SIZE) {
         size_t index = OffsetToIndex(o);
@@ -345,6 +487,130 @@ int64_t VmObject::CommitRangeContiguous(uint64_t offset, uint64_t len, uint8_t a
     return count * PAGE_SIZE;
 }
 
+int64_t VmObject::DecommitRange(uint64_t offset, uint64_t len) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    LTRACEF("offset 0x%llx, len 0x%llx\n", offset, len);
+
+    if (!IS_PAGE_ALIGNED(offset))
+        return ERR_INVALID_ARGS;
+
+    AutoLock a(lock_);
+
+    // trim the size
+    if (!TrimRange(offset, len, size_))
+        return ERR_OUT_OF_RANGE;
+
+    // was in range, just zero length
+    if (len == 0)
+        return 0;
+
+    // compute a page aligned end to do our searches in to make sure we cover all the pages
+    uint64_t end = ROUNDUP_PAGE_SIZE(offset + len);
+    DEBUG_ASSERT(end > offset);
+
+    // pull the pages out of every mapping first, so nobody can touch them once freed
+    UnmapRangeLocked(offset, end - offset);
+
+    // move the pages to a temporary list and hand them back to the pmm
+    list_node list;
+    list_initialize(&list);
+
+    size_t count = 0;
+    for (uint64_t o = offset; o < end; o += PAGE_SIZE) {
+        size_t index = OffsetToIndex(o);
+
+        vm_page_t* p = page_array_[index];
+        if (!p)
+            continue;
+
+        LTRACEF("freeing page %p (0x%lx)\n", p, vm_page_to_paddr(p));
+
+        page_array_[index] = nullptr;
+
+        DEBUG_ASSERT(list_in_list(&p->node));
+        list_delete(&p->node);
+        list_add_tail(&list, &p->node);
+        count++;
+    }
+
+    __UNUSED auto freed = pmm_free(&list);
+    DEBUG_ASSERT(freed == count);
+
+    return count * PAGE_SIZE;
+}
+
+status_t VmObject::Lookup(uint64_t offset, uint64_t len, paddr_t* pa_list, size_t count) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    LTRACEF("offset 0x%llx, len 0x%llx, count %zu\n", offset, len, count);
+
+    AutoLock a(lock_);
+
+    // unlike the other range operations this does not trim, since every entry of pa_list
+    // the caller asked for has to be filled in
+    if (offset + len < offset || offset + len > ROUNDUP_PAGE_SIZE(size_))
+        return ERR_OUT_OF_RANGE;
+
+    if (len == 0)
+        return NO_ERROR;
+
+    uint64_t start = ROUNDDOWN(offset, PAGE_SIZE);
+    uint64_t end = ROUNDUP_PAGE_SIZE(offset + len);
+    if ((end - start) / PAGE_SIZE > count)
+        return ERR_NOT_ENOUGH_BUFFER;
+
+    for (uint64_t o = start; o < end; o += PAGE_SIZE) {
+        vm_page_t* p = page_array_[OffsetToIndex(o)];
+        if (!p)
+            return ERR_BAD_STATE;
+
+        *pa_list++ = vm_page_to_paddr(p);
+    }
+
+    return NO_ERROR;
+}
+
+status_t VmObject::CacheOp(uint64_t offset, uint64_t len, CacheOpType type) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    LTRACEF("offset 0x%llx, len 0x%llx, type %d\n", offset, len, static_cast<int>(type));
+
+    AutoLock a(lock_);
+
+    // trim the size
+    if (!TrimRange(offset, len, size_))
+        return ERR_OUT_OF_RANGE;
+
+    // walk the range a page at a time; holes have nothing in the cache to operate on
+    uint64_t end = offset + len;
+    while (offset < end) {
+        size_t page_offset = offset % PAGE_SIZE;
+        size_t op_len = static_cast<size_t>(MIN(PAGE_SIZE - page_offset, end - offset));
+
+        vm_page_t* p = page_array_[OffsetToIndex(offset)];
+        if (p) {
+            addr_t va = reinterpret_cast<addr_t>(paddr_to_kvaddr(vm_page_to_paddr(p))) + page_offset;
+
+            switch (type) {
+            case CacheOpType::Invalidate:
+                arch_invalidate_cache_range(va, op_len);
+                break;
+            case CacheOpType::Clean:
+                arch_clean_cache_range(va, op_len);
+                break;
+            case CacheOpType::CleanInvalidate:
+                arch_clean_invalidate_cache_range(va, op_len);
+                break;
+            case CacheOpType::Sync:
+                arch_sync_cache_range(va, op_len);
+                break;
+            }
+        }
+
+        offset += op_len;
+    }
+
+    return NO_ERROR;
+}
+
 // perform some sort of copy in/out on a range of the object using a passed in lambda
 // for the copy routine
 template <typename T>
@@ -370,7 +636,8 @@ status_t VmObject::ReadWriteInternal(uint64_t offset, size_t len, size_t* bytes_
         size_t page_offset = offset % PAGE_SIZE;
         size_t tocopy = MIN(PAGE_SIZE - page_offset, len);
 
-        // fault in the page
+        // fault in the page; reads of holes copy from the shared zero page
+        // and leave them uncommitted
         vm_page_t* p = FaultPageLocked(offset, write ? VMM_PF_FLAG_WRITE : 0);
         if (!p)
             return ERR_NO_MEMORY;
@@ -9,6 +9,7 @@
 #include "vm_priv.h"
 #include <assert.h>
 #include <err.h>
+#include <kernel/auto_lock.h>
 #include <kernel/vm.h>
 #include <kernel/vm/vm_aspace.h>
 #include <kernel/vm/vm_object.h>
@@ -48,7 +49,10 @@ status_t VmRegion::Destroy() {
     LTRACEF("%p '%s'\n", this, name_);
 
     // detach from any object we have mapped
-    object_.reset();
+    if (object_) {
+        object_->RemoveMapping(this);
+        object_.reset();
+    }
 
     return NO_ERROR;
 }
@@ -80,8 +84,17 @@ int VmRegion::Unmap() {
     DEBUG_ASSERT(magic_ == MAGIC);
     LTRACEF("%p '%s'\n", this, name_);
 
-    // unmap the section of address space we cover
-    return arch_mmu_unmap(&aspace_->arch_aspace(), base_, size_ / PAGE_SIZE);
+    if (!object_) {
+        // unmap the section of address space we cover
+        return arch_mmu_unmap(&aspace_->arch_aspace(), base_, size_ / PAGE_SIZE);
+    }
+
+    // leave the object's mapping list in the same step, so that a decommit of the object
+    // cannot unmap our old range after it has been handed out again
+    AutoLock a(object_->lock());
+    int ret = arch_mmu_unmap(&aspace_->arch_aspace(), base_, size_ / PAGE_SIZE);
+    object_->RemoveMappingLocked(this);
+    return ret;
 }
 
 status_t VmRegion::SetObject(mxtl::RefPtr<VmObject> o, uint64_t offset) {
@@ -95,6 +108,34 @@ status_t VmRegion::SetObject(mxtl::RefPtr<VmObject> o, uint64_t offset) {
     object_ = o;
     object_offset_ = offset;
 
+    object_->AddMapping(this);
+
+    return NO_ERROR;
+}
+
+status_t VmRegion::UnmapObjectRangeLocked(uint64_t offset, uint64_t len) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    DEBUG_ASSERT(object_);
+    DEBUG_ASSERT(is_mutex_held(object_->lock()));
+    LTRACEF("%p '%s', offset 0x%llx, len 0x%llx\n", this, name_, offset, len);
+
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(offset));
+    DEBUG_ASSERT(IS_PAGE_ALIGNED(len));
+
+    // intersect the object range with the part of the object we map
+    uint64_t start = MAX(offset, object_offset_);
+    uint64_t end = MIN(offset + len, object_offset_ + size_);
+    if (start >= end)
+        return NO_ERROR;
+
+    vaddr_t va = base_ + static_cast<vaddr_t>(start - object_offset_);
+    auto ret = arch_mmu_unmap(&aspace_->arch_aspace(), va,
+                              static_cast<size_t>((end - start) / PAGE_SIZE));
+    if (ret < 0) {
+        TRACEF("error %d unmapping object range at va 0x%lx\n", ret, va);
+        return ret;
+    }
+
     return NO_ERROR;
 }
 
@@ -146,24 +187,26 @@ status_t VmRegion::MapRange(size_t offset, size_t len, bool commit) {
         return ERR_NO_MEMORY;
     }
 
+    // hold the object lock so pages cannot be decommitted between lookup and mapping
+    AutoLock a(object_->lock());
+
     // iterate through the range, grabbing a page from the underlying object and mapping it in
     size_t o;
     for (o = offset; o < offset + len; o += PAGE_SIZE) {
         uint64_t vmo_offset = object_offset_ + o;
-        vm_page_t* p = object_->GetPage(vmo_offset);
-        if (!p) {
-            if (!commit) {
+        vm_page_t* p;
+        if (commit) {
+            p = object_->FaultPageLocked(vmo_offset, VMM_PF_FLAG_WRITE);
+            if (!p) {
+                LTRACEF("error committing memory for region\n");
+                return ERR_NO_MEMORY;
+            }
+        } else {
+            p = object_->GetPageLocked(vmo_offset);
+            if (!p) {
                 // no page to map, skip ahead
                 continue;
             }
-
-            int64_t committed = object_->CommitRange(vmo_offset, PAGE_SIZE);
-            if (committed < 0 || committed != PAGE_SIZE) {
-                LTRACEF("error committing memory for region\n");
-                return (status_t)committed;
-            }
-
-            p = object_->GetPage(vmo_offset);
         }
 
         DEBUG_ASSERT(p);
@@ -207,10 +250,16 @@ status_t VmRegion::PageFault(vaddr_t va, uint pf_flags) {
         return ERR_ACCESS_DENIED;
     }
 
-    if (!(pf_flags & VMM_PF_FLAG_NOT_PRESENT)) {
+    if (!(pf_flags & VMM_PF_FLAG_NOT_PRESENT) && !(pf_flags & VMM_PF_FLAG_USER) &&
+        aspace_->is_user()) {
         // kernel attempting to access userspace, and permissions were fine, so
-        // architecture prevented the cross-privilege access
-        if (!(pf_flags & VMM_PF_FLAG_USER) && aspace_->is_user()) {
+        // architecture prevented the cross-privilege access.  the one exception is
+        // a write (through copy_to_user) over the shared zero page, which is mapped
+        // read-only until the first write and is handled below like any other.
+        paddr_t pa;
+        if (!(pf_flags & VMM_PF_FLAG_WRITE) ||
+            arch_mmu_query(&aspace_->arch_aspace(), va, &pa, nullptr) < 0 ||
+            pa != vm_page_to_paddr(vm_get_zero_page())) {
             TRACEF("ERROR: kernel faulted on user address\n");
             return ERR_ACCESS_DENIED;
         }
@@ -222,14 +271,23 @@ status_t VmRegion::PageFault(vaddr_t va, uint pf_flags) {
         return ERR_NO_MEMORY;
     }
 
+    // hold the object lock until the page is mapped, so it cannot be decommitted underneath us
+    AutoLock a(object_->lock());
+
     // fault in or grab an existing page
-    vm_page_t* new_p = object_->FaultPage(vmo_offset, pf_flags);
+    vm_page_t* new_p = object_->FaultPageLocked(vmo_offset, pf_flags);
     if (!new_p) {
         TRACEF("ERROR: failed to fault in or grab existing page\n");
         return ERR_NO_MEMORY;
     }
     paddr_t new_pa = vm_page_to_paddr(new_p);
 
+    // the shared zero page is always mapped read-only, so the first write
+    // faults again and gets a page of its own
+    uint mmu_flags = arch_mmu_flags_;
+    if (new_p == vm_get_zero_page())
+        mmu_flags &= ~ARCH_MMU_FLAG_PERM_WRITE;
+
     // see if something is mapped here now
     // this may happen if we are one of multiple threads racing on a single address
     uint page_flags;
@@ -239,11 +297,11 @@ status_t VmRegion::PageFault(vaddr_t va, uint pf_flags) {
         LTRACEF("queried va, page at pa 0x%lx, flags 0x%x is already there\n", pa, page_flags);
         if (pa == new_pa) {
             // page was already mapped, are the permissions compatible?
-            if (page_flags == arch_mmu_flags_)
+            if (page_flags == mmu_flags)
                 return NO_ERROR;
 
             // same page, different permission
-            auto ret = arch_mmu_protect(&aspace_->arch_aspace(), va, 1, arch_mmu_flags_);
+            auto ret = arch_mmu_protect(&aspace_->arch_aspace(), va, 1, mmu_flags);
             if (ret < 0) {
                 TRACEF("failed to modify permissions on existing mapping\n");
                 return ERR_NO_MEMORY;
@@ -260,7 +318,7 @@ status_t VmRegion::PageFault(vaddr_t va, uint pf_flags) {
     } else {
         // nothing was mapped there before, map it now
         LTRACEF("mapping pa 0x%lx to va 0x%lx\n", new_pa, va);
-        auto ret = arch_mmu_map(&aspace_->arch_aspace(), va, new_pa, 1, arch_mmu_flags_);
+        auto ret = arch_mmu_map(&aspace_->arch_aspace(), va, new_pa, 1, mmu_flags);
         if (ret < 0) {
             TRACEF("failed to map page\n");
             return ERR_NO_MEMORY;
@@ -271,3 +329,24 @@ status_t VmRegion::PageFault(vaddr_t va, uint pf_flags) {
 }
 
 mxtl::RefPtr<VmObject> VmRegion::vmo() { return object_; }
+
+void VmRegion::GetMemoryUsage(size_t offset, size_t len, size_t* committed_pages,
+                              size_t* mapped_pages) {
+    DEBUG_ASSERT(magic_ == MAGIC);
+    DEBUG_ASSERT(offset <= size_ && len <= size_ - offset);
+
+    size_t end = offset + len;
+    for (size_t o = offset; o < end; o += PAGE_SIZE) {
+        paddr_t pa;
+        if (arch_mmu_query(&aspace_->arch_aspace(), base_ + o, &pa, nullptr) >= 0)
+            (*mapped_pages)++;
+    }
+
+    if (object_) {
+        AutoLock a(object_->lock());
+        for (size_t o = offset; o < end; o += PAGE_SIZE) {
+            if (object_->GetPageLocked(object_offset_ + o))
+                (*committed_pages)++;
+        }
+    }
+}
@@ -14,6 +14,7 @@
 #include <kernel/vm/vm_aspace.h>
 #include <kernel/vm/vm_region.h>
 #include <lib/console.h>
+#include <lib/ktrace.h>
 #include <string.h>
 #include <trace.h>
 
@@ -151,6 +152,9 @@ status_t vmm_page_fault_handler(vaddr_t addr, uint flags) {
            flags);
 #endif
 
+    KTRACE(KTRACE_TAG_PAGE_FAULT, addr, flags);
+    get_current_thread()->page_faults++;
+
     // get the address space object this pointer is in
     VmAspace* aspace = vmm_aspace_to_obj(vaddr_to_aspace((void*)addr));
     if (!aspace)
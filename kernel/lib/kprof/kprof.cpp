@@ -0,0 +1,278 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/kprof.h>
+
+#include <arch/mmu.h>
+#include <arch/ops.h>
+#include <assert.h>
+#include <err.h>
+#include <kernel/cmdline.h>
+#include <kernel/mp.h>
+#include <kernel/mutex.h>
+#include <kernel/thread.h>
+#include <kernel/timer.h>
+#include <kernel/vm.h>
+#include <lib/recbuf.h>
+#include <magenta/process_dispatcher.h>
+#include <magenta/user_thread.h>
+#include <string.h>
+#include <trace.h>
+
+#define LOCAL_TRACE 0
+
+#define KPROF_DEFAULT_BUFSIZE_KB 512
+
+static_assert(SMP_MAX_CPUS <= KPROF_MAX_CPUS, "too many cpus for kprof header");
+
+// Each CPU has its own timer and its own buffer, which only that CPU's
+// interrupt path writes, so taking a sample needs no locks or atomics.
+// The timer callback cannot see the interrupted context, so it just marks
+// a sample as due and kprof_irq_exit() takes it on the way out of the
+// interrupt.  The buffers fill up rather than wrap, since the start of a
+// profile is as interesting as its end.
+typedef struct kprof_cpu {
+    recbuf_t buf;
+    volatile bool pending;
+    timer_t timer;
+} __CPU_ALIGN kprof_cpu_t;
+
+volatile int kprof_active;
+
+static kprof_cpu_t kprof_cpus[SMP_MAX_CPUS];
+static uint32_t kprof_num_cpus;
+static uint32_t kprof_cpu_capacity;
+static uint32_t kprof_hz;
+static volatile int kprof_dropped;
+
+static mutex_t kprof_lock = MUTEX_INITIAL_VALUE(kprof_lock);
+
+static uint kprof_walk_kernel(thread_t* t, uintptr_t fp, uint64_t* frames, uint max) {
+    uintptr_t lo = reinterpret_cast<uintptr_t>(t->stack);
+    uintptr_t hi = lo + t->stack_size;
+
+    uint n = 0;
+    while (n < max && fp >= lo && fp <= hi - 2 * sizeof(uintptr_t) &&
+           IS_ALIGNED(fp, sizeof(uintptr_t))) {
+        const uintptr_t* frame = reinterpret_cast<const uintptr_t*>(fp);
+        if (frame[1] == 0)
+            break;
+        frames[n++] = frame[1];
+        // Stacks grow down, so the caller's frame is always higher.
+        if (frame[0] <= fp)
+            break;
+        fp = frame[0];
+    }
+    return n;
+}
+
+// We are in an interrupt handler and must not take a page fault, so user
+// memory is read through the page tables and the kernel's physical map.
+static bool kprof_read_user_frame(arch_aspace_t* aspace, uintptr_t fp, uintptr_t frame[2]) {
+    if (!IS_ALIGNED(fp, 2 * sizeof(uintptr_t)))
+        return false;
+
+    paddr_t pa;
+    uint flags;
+    if (arch_mmu_query(aspace, fp, &pa, &flags) != NO_ERROR ||
+        !(flags & ARCH_MMU_FLAG_PERM_USER))
+        return false;
+
+    const uintptr_t* p = reinterpret_cast<const uintptr_t*>(paddr_to_kvaddr(pa));
+    if (p == nullptr)
+        return false;
+    frame[0] = p[0];
+    frame[1] = p[1];
+    return true;
+}
+
+static uint kprof_walk_user(thread_t* t, uintptr_t fp, uint64_t* frames, uint max) {
+    if (t->aspace == nullptr)
+        return 0;
+    arch_aspace_t* aspace = vmm_get_arch_aspace(t->aspace);
+
+    uint n = 0;
+    uintptr_t frame[2];
+    while (n < max && fp != 0 && kprof_read_user_frame(aspace, fp, frame)) {
+        if (frame[1] == 0)
+            break;
+        frames[n++] = frame[1];
+        if (frame[0] <= fp)
+            break;
+        fp = frame[0];
+    }
+    return n;
+}
+
+void kprof_irq_exit(uintptr_t pc, uintptr_t fp, bool user) {
+    uint cpu = arch_curr_cpu_num();
+    kprof_cpu_t* kc = &kprof_cpus[cpu];
+    if (!kc->pending)
+        return;
+    kc->pending = false;
+
+    unsigned long long count = kc->buf.count;
+    if (kc->buf.recs == nullptr || count == kprof_cpu_capacity) {
+        atomic_add(&kprof_dropped, 1);
+        return;
+    }
+
+    kprof_sample_t* s = static_cast<kprof_sample_t*>(kc->buf.recs) + count;
+    s->cpu = cpu;
+    s->flags = user ? KPROF_SAMPLE_USER : 0;
+
+    thread_t* t = get_current_thread();
+    UserThread* ut = reinterpret_cast<UserThread*>(t->user_thread);
+    if (ut != nullptr) {
+        s->pid = ut->process()->get_koid();
+        s->tid = ut->get_koid();
+    } else {
+        s->pid = 0;
+        s->tid = reinterpret_cast<uintptr_t>(t);
+    }
+
+    s->frames[0] = pc;
+    uint n = 1;
+    if (user) {
+        n += kprof_walk_user(t, fp, &s->frames[1], KPROF_MAX_FRAMES - 1);
+    } else {
+        n += kprof_walk_kernel(t, fp, &s->frames[1], KPROF_MAX_FRAMES - 1);
+    }
+    s->num_frames = static_cast<uint16_t>(n);
+
+    atomic_store_u64(&kc->buf.count, count + 1);
+}
+
+static enum handler_return kprof_timer(timer_t* timer, lk_time_t now, void* arg) {
+    kprof_cpus[arch_curr_cpu_num()].pending = true;
+    return INT_NO_RESCHEDULE;
+}
+
+static void kprof_start_cpu(void* arg) {
+    kprof_cpu_t* kc = &kprof_cpus[arch_curr_cpu_num()];
+    lk_time_t period = *static_cast<lk_time_t*>(arg);
+
+    kc->pending = false;
+    timer_initialize(&kc->timer);
+    timer_set_periodic(&kc->timer, period, kprof_timer, nullptr);
+}
+
+static void kprof_stop_cpu(void* arg) {
+    kprof_cpu_t* kc = &kprof_cpus[arch_curr_cpu_num()];
+
+    timer_cancel(&kc->timer);
+    kc->pending = false;
+}
+
+// The buffers are only allocated the first time the profiler is started.
+static status_t kprof_alloc_locked() {
+    if (kprof_cpu_capacity != 0)
+        return NO_ERROR;
+
+    uint32_t kb = cmdline_get_uint32("kprof.bufsize", KPROF_DEFAULT_BUFSIZE_KB);
+    uint32_t capacity = static_cast<uint32_t>((kb * 1024u) / sizeof(kprof_sample_t));
+    if (capacity == 0)
+        return ERR_NOT_SUPPORTED;
+
+    uint32_t num_cpus = arch_max_num_cpus();
+    for (uint32_t cpu = 0; cpu < num_cpus; cpu++) {
+        status_t status = recbuf_alloc(&kprof_cpus[cpu].buf, capacity, sizeof(kprof_sample_t));
+        if (status != NO_ERROR) {
+            while (cpu-- > 0)
+                recbuf_free(&kprof_cpus[cpu].buf);
+            return status;
+        }
+    }
+    kprof_num_cpus = num_cpus;
+    kprof_cpu_capacity = capacity;
+
+    dprintf(INFO, "kprof: %u samples per cpu on %u cpus\n", capacity, num_cpus);
+    return NO_ERROR;
+}
+
+status_t kprof_control(uint32_t action, uint32_t options) {
+    status_t status = NO_ERROR;
+    mutex_acquire(&kprof_lock);
+    switch (action) {
+    case KPROF_ACTION_START: {
+        uint32_t hz = options ? options : KPROF_DEFAULT_HZ;
+        if (hz > KPROF_MAX_HZ) {
+            status = ERR_INVALID_ARGS;
+            break;
+        }
+        if (kprof_active) {
+            status = ERR_BAD_STATE;
+            break;
+        }
+        status = kprof_alloc_locked();
+        if (status != NO_ERROR)
+            break;
+
+        // Starting discards the previous profile.
+        for (uint32_t cpu = 0; cpu < kprof_num_cpus; cpu++)
+            atomic_store_u64(&kprof_cpus[cpu].buf.count, 0);
+        kprof_dropped = 0;
+
+        // Timers have millisecond resolution, so report the rate we get.
+        lk_time_t period = 1000 / hz;
+        kprof_hz = 1000 / period;
+
+        kprof_active = 1;
+        smp_wmb();
+        mp_sync_exec(MP_CPU_ALL, kprof_start_cpu, &period);
+        break;
+    }
+    case KPROF_ACTION_STOP:
+        if (!kprof_active)
+            break;
+        mp_sync_exec(MP_CPU_ALL, kprof_stop_cpu, nullptr);
+        kprof_active = 0;
+        break;
+    default:
+        status = ERR_INVALID_ARGS;
+        break;
+    }
+    mutex_release(&kprof_lock);
+
+    LTRACEF("action %u options %u status %d\n", action, options, status);
+    return status;
+}
+
+ssize_t kprof_read(void* ptr, size_t offset, size_t len, bool user) {
+    kprof_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = KPROF_MAGIC;
+    hdr.version = KPROF_VERSION;
+    hdr.sample_size = sizeof(kprof_sample_t);
+
+    mutex_acquire(&kprof_lock);
+
+    hdr.num_cpus = kprof_num_cpus;
+    hdr.hz = kprof_hz;
+    hdr.dropped = kprof_dropped;
+    unsigned long long count[SMP_MAX_CPUS];
+    size_t total = sizeof(hdr);
+    for (uint32_t cpu = 0; cpu < kprof_num_cpus; cpu++) {
+        count[cpu] = atomic_load_u64(&kprof_cpus[cpu].buf.count);
+        hdr.cpu_samples[cpu] = recbuf_held(count[cpu], kprof_cpu_capacity);
+        total += hdr.cpu_samples[cpu] * sizeof(kprof_sample_t);
+    }
+
+    ssize_t result = total;
+    if (ptr != nullptr) {
+        recbuf_reader_t r;
+        recbuf_reader_init(&r, ptr, offset, len, user);
+        recbuf_emit(&r, &hdr, sizeof(hdr));
+        for (uint32_t cpu = 0; cpu < kprof_num_cpus; cpu++) {
+            recbuf_emit_records(&r, &kprof_cpus[cpu].buf, count[cpu],
+                                kprof_cpu_capacity, sizeof(kprof_sample_t));
+        }
+        result = recbuf_reader_result(&r);
+    }
+
+    mutex_release(&kprof_lock);
+    return result;
+}
@@ -0,0 +1,187 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/ktrace.h>
+
+#include <arch/ops.h>
+#include <assert.h>
+#include <err.h>
+#include <kernel/cmdline.h>
+#include <kernel/mutex.h>
+#include <kernel/thread.h>
+#include <lib/recbuf.h>
+#include <lk/init.h>
+#include <platform.h>
+#include <string.h>
+#include <trace.h>
+
+#if ARCH_X86
+#include <arch/x86.h>
+#endif
+
+#define LOCAL_TRACE 0
+
+#define KTRACE_DEFAULT_BUFSIZE_KB 128
+
+static_assert(SMP_MAX_CPUS <= KTRACE_MAX_CPUS, "too many cpus for ktrace header");
+
+// Each CPU writes its own ring, so writers on different CPUs never touch
+// the same cache lines.  A writer claims a slot by bumping the ring's count
+// atomically, which also keeps a writer that migrated or was interrupted
+// mid-record from colliding with another.  The rings overwrite their
+// oldest records when full.  Readers are expected to stop tracing first;
+// records being written while a read is in progress may appear torn.
+typedef struct ktrace_cpu {
+    recbuf_t buf;
+} __CPU_ALIGN ktrace_cpu_t;
+
+volatile uint32_t ktrace_grpmask;
+
+static ktrace_cpu_t ktrace_cpus[SMP_MAX_CPUS];
+static uint32_t ktrace_num_cpus;
+static uint32_t ktrace_cpu_capacity;
+static bool ktrace_use_counter;
+
+static mutex_t ktrace_lock = MUTEX_INITIAL_VALUE(ktrace_lock);
+
+static inline uint64_t ktrace_timestamp(void) {
+#if ARCH_X86
+    if (ktrace_use_counter)
+        return rdtsc();
+#endif
+    return current_time_hires();
+}
+
+void ktrace_write(uint32_t tag, uint64_t a, uint64_t b) {
+    uint cpu = arch_curr_cpu_num();
+    ktrace_cpu_t* kc = &ktrace_cpus[cpu];
+    if (unlikely(kc->buf.recs == NULL))
+        return;
+
+    unsigned long long n = atomic_add_u64(&kc->buf.count, 1);
+    ktrace_record_t* rec = (ktrace_record_t*)kc->buf.recs + n % ktrace_cpu_capacity;
+    rec->tag = tag;
+    rec->cpu = cpu;
+    rec->ts = ktrace_timestamp();
+    rec->thread = (uintptr_t)get_current_thread();
+    rec->a = a;
+    rec->b = b;
+}
+
+status_t ktrace_control(uint32_t action, uint32_t options) {
+    if (ktrace_cpu_capacity == 0)
+        return ERR_NOT_SUPPORTED;
+
+    status_t status = NO_ERROR;
+    mutex_acquire(&ktrace_lock);
+    switch (action) {
+    case KTRACE_ACTION_START:
+        if (options == 0 || (options & ~KTRACE_GRP_ALL)) {
+            status = ERR_INVALID_ARGS;
+            break;
+        }
+        ktrace_grpmask = options;
+        break;
+    case KTRACE_ACTION_STOP:
+        ktrace_grpmask = 0;
+        break;
+    case KTRACE_ACTION_REWIND:
+        if (ktrace_grpmask != 0) {
+            status = ERR_BAD_STATE;
+            break;
+        }
+        for (uint32_t cpu = 0; cpu < ktrace_num_cpus; cpu++)
+            atomic_store_u64(&ktrace_cpus[cpu].buf.count, 0);
+        break;
+    default:
+        status = ERR_INVALID_ARGS;
+        break;
+    }
+    mutex_release(&ktrace_lock);
+
+    LTRACEF("action %u options %#x status %d\n", action, options, status);
+    return status;
+}
+
+ssize_t ktrace_read(void* ptr, size_t offset, size_t len, bool user) {
+    if (ktrace_cpu_capacity == 0)
+        return ERR_NOT_SUPPORTED;
+
+    ktrace_header_t hdr;
+    memset(&hdr, 0, sizeof(hdr));
+    hdr.magic = KTRACE_MAGIC;
+    hdr.version = KTRACE_VERSION;
+    hdr.record_size = sizeof(ktrace_record_t);
+    hdr.num_cpus = ktrace_num_cpus;
+    if (!ktrace_use_counter ||
+        !platform_usermode_counter(&hdr.ticks_to_ns_mult,
+                                   &hdr.ticks_to_ns_shift)) {
+        // Timestamps are from current_time_hires(), in microseconds.
+        hdr.ticks_to_ns_mult = 1000;
+        hdr.ticks_to_ns_shift = 0;
+    }
+
+    mutex_acquire(&ktrace_lock);
+
+    unsigned long long count[SMP_MAX_CPUS];
+    size_t total = sizeof(hdr);
+    for (uint32_t cpu = 0; cpu < ktrace_num_cpus; cpu++) {
+        count[cpu] = atomic_load_u64(&ktrace_cpus[cpu].buf.count);
+        hdr.cpu_records[cpu] = recbuf_held(count[cpu], ktrace_cpu_capacity);
+        total += hdr.cpu_records[cpu] * sizeof(ktrace_record_t);
+    }
+
+    ssize_t result = total;
+    if (ptr != NULL) {
+        recbuf_reader_t r;
+        recbuf_reader_init(&r, ptr, offset, len, user);
+        recbuf_emit(&r, &hdr, sizeof(hdr));
+        for (uint32_t cpu = 0; cpu < ktrace_num_cpus; cpu++) {
+            recbuf_emit_records(&r, &ktrace_cpus[cpu].buf, count[cpu],
+                                ktrace_cpu_capacity, sizeof(ktrace_record_t));
+        }
+        result = recbuf_reader_result(&r);
+    }
+
+    mutex_release(&ktrace_lock);
+    return result;
+}
+
+static void ktrace_init(uint level) {
+    uint32_t kb = cmdline_get_uint32("ktrace.bufsize", KTRACE_DEFAULT_BUFSIZE_KB);
+    uint32_t capacity = (uint32_t)((kb * 1024u) / sizeof(ktrace_record_t));
+    if (capacity == 0) {
+        dprintf(INFO, "ktrace: disabled\n");
+        return;
+    }
+
+    uint64_t mult;
+    uint32_t shift;
+    ktrace_use_counter = platform_usermode_counter(&mult, &shift);
+
+    uint32_t num_cpus = arch_max_num_cpus();
+    for (uint32_t cpu = 0; cpu < num_cpus; cpu++) {
+        if (recbuf_alloc(&ktrace_cpus[cpu].buf, capacity,
+                         sizeof(ktrace_record_t)) != NO_ERROR) {
+            dprintf(CRITICAL, "ktrace: cannot allocate %u KB for cpu %u\n",
+                    kb, cpu);
+            break;
+        }
+        ktrace_num_cpus = cpu + 1;
+    }
+    if (ktrace_num_cpus == 0)
+        return;
+    ktrace_cpu_capacity = capacity;
+
+    dprintf(INFO, "ktrace: %u records per cpu on %u cpus\n",
+            capacity, ktrace_num_cpus);
+
+    uint32_t grpmask = cmdline_get_uint32("ktrace.grpmask", 0);
+    if (grpmask != 0)
+        ktrace_control(KTRACE_ACTION_START, grpmask);
+}
+
+LK_INIT_HOOK(ktrace, ktrace_init, LK_INIT_LEVEL_APPS - 2);
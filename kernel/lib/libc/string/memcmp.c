@@ -8,14 +8,29 @@
 #include <string.h>
 #include <sys/types.h>
 
+typedef unsigned long word;
+
+#define lsize sizeof(word)
+#define lmask (lsize - 1)
+
 int
 memcmp(const void *cs, const void *ct, size_t count)
 {
-    const unsigned char *su1, *su2;
-    signed char res = 0;
+    const unsigned char *su1 = cs, *su2 = ct;
+
+    // When both are equally aligned, skip over equal words; the first
+    // word that differs is then compared a byte at a time below.
+    if ((((long)su1 ^ (long)su2) & lmask) == 0) {
+        for (; ((long)su1 & lmask) && count > 0; ++su1, ++su2, count--)
+            if (*su1 != *su2)
+                return *su1 - *su2;
+        for (; count >= lsize; su1 += lsize, su2 += lsize, count -= lsize)
+            if (*(const word *)su1 != *(const word *)su2)
+                break;
+    }
 
-    for (su1 = cs, su2 = ct; 0 < count; ++su1, ++su2, count--)
-        if ((res = *su1 - *su2) != 0)
-            break;
-    return res;
+    for (; count > 0; ++su1, ++su2, count--)
+        if (*su1 != *su2)
+            return *su1 - *su2;
+    return 0;
 }
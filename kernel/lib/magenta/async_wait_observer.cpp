@@ -0,0 +1,92 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <magenta/async_wait_observer.h>
+
+#include <assert.h>
+#include <err.h>
+#include <new.h>
+
+#include <magenta/dispatcher.h>
+#include <magenta/handle.h>
+#include <magenta/io_port_client.h>
+#include <magenta/io_port_dispatcher.h>
+#include <magenta/state_tracker.h>
+
+mx_status_t AsyncWaitObserver::Create(Handle* handle, mxtl::RefPtr<IOPortDispatcher> io_port,
+                                      uint64_t key, mx_signals_t watched_signals,
+                                      bool repeating) {
+    auto state_tracker = handle->dispatcher()->get_state_tracker();
+    if (!state_tracker || !state_tracker->is_waitable())
+        return ERR_NOT_SUPPORTED;
+
+    AllocChecker ac;
+    auto observer = new (&ac) AsyncWaitObserver(handle, mxtl::move(io_port), key,
+                                                watched_signals, repeating);
+    if (!ac.check())
+        return ERR_NO_MEMORY;
+
+    // |observer| may already be gone when this returns if it fired immediately.
+    return state_tracker->AddObserver(observer);
+}
+
+AsyncWaitObserver::AsyncWaitObserver(Handle* handle, mxtl::RefPtr<IOPortDispatcher> io_port,
+                                     uint64_t key, mx_signals_t watched_signals, bool repeating)
+    : handle_(handle), io_port_(mxtl::move(io_port)), key_(key),
+      watched_signals_(watched_signals), repeating_(repeating) {}
+
+AsyncWaitObserver::~AsyncWaitObserver() {}
+
+bool AsyncWaitObserver::OnInitialize(mx_signals_state_t initial_state) {
+    return MaybeQueue(initial_state);
+}
+
+bool AsyncWaitObserver::OnStateChange(mx_signals_state_t new_state) {
+    return MaybeQueue(new_state);
+}
+
+bool AsyncWaitObserver::MaybeQueue(mx_signals_state_t state) {
+    if (done_)
+        return false;
+
+    // The port cannot tell us when it closes, so look on every state change rather than
+    // only when a packet would be sent.
+    if (!io_port_->HasClients()) {
+        done_ = true;
+        return false;
+    }
+
+    mx_signals_t asserted = state.satisfied & watched_signals_;
+    mx_signals_t rising = asserted & ~asserted_;
+    asserted_ = asserted;
+    if (!rising)
+        return false;
+
+    auto status = SendIOPortPacket(io_port_.get(), key_, state.satisfied);
+    // ERR_NOT_AVAILABLE means nobody can read the port anymore, so stop watching. On other
+    // failures a repeating wait is kept and tries again on the next rising edge.
+    if (!repeating_ || status == ERR_NOT_AVAILABLE)
+        done_ = true;
+    // IOPortDispatcher::Queue() does its own yielding.
+    return false;
+}
+
+bool AsyncWaitObserver::OnCancel(Handle* handle, bool* should_remove, bool* call_did_cancel) {
+    if (handle != handle_)
+        return false;
+    *should_remove = true;
+    *call_did_cancel = true;
+    return false;
+}
+
+bool AsyncWaitObserver::OnCancelAsyncWait(Handle* handle, const IOPortDispatcher* io_port,
+                                          uint64_t key) {
+    return handle == handle_ && io_port == io_port_.get() && key == key_;
+}
+
+void AsyncWaitObserver::OnDidCancel() {
+    delete this;
+}
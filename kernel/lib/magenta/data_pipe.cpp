@@ -12,6 +12,7 @@
 #include <stddef.h>
 
 #include <kernel/auto_lock.h>
+#include <kernel/vm.h>
 #include <kernel/vm/vm_aspace.h>
 #include <kernel/vm/vm_object.h>
 
@@ -21,7 +22,13 @@
 #include <magenta/magenta.h>
 
 const auto kDP_Map_Perms = ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_WRITE | ARCH_MMU_FLAG_PERM_USER;
-const auto kDP_Map_Perms_RO = kDP_Map_Perms | ARCH_MMU_FLAG_PERM_READ;
+const auto kDP_Map_Perms_RO = ARCH_MMU_FLAG_PERM_READ | ARCH_MMU_FLAG_PERM_USER;
+
+// Consumed pages are returned to the pmm once free memory drops below the pmm's
+// warning watermark.
+static bool UnderMemoryPressure() {
+    return pmm_pressure_level() != PMM_PRESSURE_NORMAL;
+}
 
 mx_status_t DataPipe::Create(mx_size_t element_size,
                              mx_size_t capacity,
@@ -89,18 +96,23 @@ mx_size_t DataPipe::ComputeSize(mx_size_t from, mx_size_t to, mx_size_t requeste
 mx_status_t DataPipe::MapVMOIfNeededNoLock(EndPoint* ep, mxtl::RefPtr<VmAspace> aspace) {
     DEBUG_ASSERT(vmo_);
 
-    if (ep->aspace && (ep->aspace != aspace)) {
+    // The mapping is kept for the life of the endpoint, so repeated two-phase
+    // operations from the same process reuse it.
+    if (ep->aspace == aspace)
+        return NO_ERROR;
+
+    if (ep->aspace) {
         // We have been transfered to another process. Unmap and free.
         // TODO(cpu): Do this at a better time.
         ep->aspace->FreeRegion(reinterpret_cast<vaddr_t>(ep->vad_start));
         ep->aspace.reset();
     }
 
-    // For large requests we can use demand page here instead of commit.
+    // Pages are demand faulted; only the parts of the pipe actually touched get committed.
     auto perms = ep->read_only ? kDP_Map_Perms_RO : kDP_Map_Perms;
     auto status = aspace->MapObject(vmo_, "datapipe", 0u, capacity_,
                                     reinterpret_cast<void**>(&ep->vad_start), 0,
-                                    VMM_FLAG_COMMIT, perms);
+                                    0u, perms);
     if (status < 0)
         return status;
 
@@ -108,6 +120,24 @@ mx_status_t DataPipe::MapVMOIfNeededNoLock(EndPoint* ep, mxtl::RefPtr<VmAspace>
     return NO_ERROR;
 }
 
+void DataPipe::DecommitConsumedNoLock(mx_size_t offset, mx_size_t len) {
+    if (!vmo_ || !UnderMemoryPressure())
+        return;
+
+    if (free_space_ == capacity_ && !producer_.expected) {
+        // Nothing is buffered and no write is in flight, so every page can go.
+        vmo_->DecommitRange(0u, vmo_->size());
+        return;
+    }
+
+    // Only whole pages inside the consumed range; the pages at either edge can still
+    // hold unread data or be part of a pending two-phase write.
+    mx_size_t start = ROUNDUP(offset, PAGE_SIZE);
+    mx_size_t end = ROUNDDOWN(offset + len, PAGE_SIZE);
+    if (start < end)
+        vmo_->DecommitRange(start, end - start);
+}
+
 void DataPipe::UpdateSignalsNoLock() {
     // TODO(vtl): Should be non-writable during a two-phase write and non-readable during a
     // two-phase read.
@@ -259,6 +289,7 @@ mx_status_t DataPipe::ConsumerReadFromUser(void* ptr,
     }
 
     free_space_ += *requested;
+    DecommitConsumedNoLock(consumer_.cursor, *requested);
     consumer_.cursor += *requested;
 
     if (consumer_.cursor == capacity_)
@@ -320,6 +351,7 @@ mx_status_t DataPipe::ConsumerReadEnd(mx_size_t read) {
     }
 
     free_space_ += read;
+    DecommitConsumedNoLock(consumer_.cursor, read);
     consumer_.cursor += read;
     consumer_.expected = 0u;
 
@@ -0,0 +1,65 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdint.h>
+
+#include <magenta/state_observer.h>
+#include <magenta/types.h>
+
+#include <mxtl/ref_ptr.h>
+
+class Dispatcher;
+class Handle;
+class IOPortDispatcher;
+
+// Delivers an IO port packet when watched signals on an object become satisfied, without a
+// thread blocking on the object. It works for any object with a waitable StateTracker, and
+// any number of them may be attached to one object.
+//
+// A one-shot observer queues a single packet and then removes itself. A repeating observer
+// queues a packet every time one of the watched signals goes from clear to set. Either kind
+// is removed when the handle it was registered through is closed or transferred. A port
+// losing all its handles is only noticed at the next state change of the object, so until
+// then the observer (and its port reference) stays attached. The observer owns itself and
+// is deleted on removal.
+class AsyncWaitObserver final : public StateObserver {
+public:
+    // Must be called under the handle table lock. On success the observer is owned by the
+    // state tracker of |handle|'s object.
+    static mx_status_t Create(Handle* handle, mxtl::RefPtr<IOPortDispatcher> io_port,
+                              uint64_t key, mx_signals_t watched_signals, bool repeating);
+
+private:
+    AsyncWaitObserver(Handle* handle, mxtl::RefPtr<IOPortDispatcher> io_port,
+                      uint64_t key, mx_signals_t watched_signals, bool repeating);
+    ~AsyncWaitObserver();
+
+    AsyncWaitObserver(const AsyncWaitObserver&) = delete;
+    AsyncWaitObserver& operator=(const AsyncWaitObserver&) = delete;
+
+    // StateObserver implementation:
+    bool OnInitialize(mx_signals_state_t initial_state) final;
+    bool OnStateChange(mx_signals_state_t new_state) final;
+    bool OnCancel(Handle* handle, bool* should_remove, bool* call_did_cancel) final;
+    void OnDidCancel() final;
+    bool ShouldRemove() final { return done_; }
+    bool OnCancelAsyncWait(Handle* handle, const IOPortDispatcher* io_port,
+                           uint64_t key) final;
+
+    bool MaybeQueue(mx_signals_state_t state);
+
+    Handle* const handle_;
+    mxtl::RefPtr<IOPortDispatcher> io_port_;
+    const uint64_t key_;
+    const mx_signals_t watched_signals_;
+    const bool repeating_;
+
+    // The watched signals that were set at the last state change.
+    mx_signals_t asserted_ = 0u;
+    bool done_ = false;
+};
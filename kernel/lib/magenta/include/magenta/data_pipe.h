@@ -72,6 +72,7 @@ private:
 
     // Must be called under |lock_|:
     mx_status_t MapVMOIfNeededNoLock(EndPoint* ep, mxtl::RefPtr<VmAspace> aspace);
+    void DecommitConsumedNoLock(mx_size_t offset, mx_size_t len);
     void UpdateSignalsNoLock();
 
     const mx_size_t element_size_;
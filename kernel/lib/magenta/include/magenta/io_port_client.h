@@ -17,6 +17,9 @@
 class IOPortDispatcher;
 class Mutex;
 
+// Queues an MX_PORT_PKT_TYPE_IOSN packet reporting |signals| to |io_port|.
+mx_status_t SendIOPortPacket(IOPortDispatcher* io_port, uint64_t key, mx_signals_t signals);
+
 class IOPortClient {
 public:
     IOPortClient(mxtl::RefPtr<IOPortDispatcher> io_port, uint64_t key, mx_signals_t signals);
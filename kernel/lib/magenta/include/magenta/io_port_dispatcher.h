@@ -50,6 +50,9 @@ public:
     mx_status_t Queue(IOP_Packet* packet);
     mx_status_t Wait(IOP_Packet** packet);
 
+    // False once the port has lost all its handles; nothing queued after that is delivered.
+    bool HasClients();
+
 private:
     IOPortDispatcher(uint32_t options);
     void FreePackets_NoLock();
@@ -40,6 +40,10 @@ mx_status_t SetSystemExceptionPort(mxtl::RefPtr<ExceptionPort> eport);
 void ResetSystemExceptionPort();
 mxtl::RefPtr<ExceptionPort> GetSystemExceptionPort();
 
+// The event whose MX_MEMORY_PRESSURE_* signals follow the pmm pressure level.
+// Null until the thread that updates it has started.
+mxtl::RefPtr<Dispatcher> GetMemoryPressureEvent();
+
 struct handle_delete {
     inline void operator()(Handle* h) const {
         DeleteHandle(h);
@@ -127,6 +127,8 @@ public:
     void Kill();
 
     status_t GetInfo(mx_process_info_t* info);
+    status_t GetStats(mx_process_stats_info_t* info);
+    status_t GetMemoryInfo(mx_process_memory_info_t* info);
 
     status_t CreateUserThread(mxtl::StringPiece name, uint32_t flags, mxtl::RefPtr<UserThread>* user_thread);
 
@@ -139,6 +141,11 @@ public:
     // called from diagnostics code.
     uint32_t ThreadCount() const;
 
+    // Copy the koids of up to |count| live threads of this process, or of
+    // all processes, into |koids|.  Returns the total number there are.
+    size_t GetThreadKoids(mx_koid_t* koids, size_t count) const;
+    static size_t GetProcessKoids(mx_koid_t* koids, size_t count);
+
     // Look up a process given its koid.
     // Returns nullptr if not found.
     static mxtl::RefPtr<ProcessDispatcher> LookupProcessById(mx_koid_t koid);
@@ -196,6 +203,10 @@ private:
     // list of threads in this process
     mxtl::DoublyLinkedList<UserThread*> thread_list_;
 
+    // accounting of the threads that have left thread_list_, guarded by
+    // thread_list_lock_
+    mx_task_stats_t exited_stats_ = {};
+
     // a ref to the main thread
     mxtl::RefPtr<UserThread> main_thread_;
 
@@ -12,6 +12,7 @@
 
 #include <magenta/dispatcher.h>
 #include <magenta/state_tracker.h>
+#include <magenta/syscalls-types.h>
 #include <magenta/types.h>
 
 #include <mxtl/ref_counted.h>
@@ -32,13 +33,21 @@ public:
 
     // Socket methods.
     mx_ssize_t Write(const void* src, mx_size_t len, bool from_user) {
-        return WriteHelper(src, len, from_user, false);
+        mx_iovec_t iov = {const_cast<void*>(src), len};
+        return WriteHelper(&iov, 1u, from_user, 0u);
     }
-    mx_ssize_t OOB_Write(const void* src, mx_size_t len, bool from_user) {
-        return WriteHelper(src, len, from_user, true);
+    mx_ssize_t OOB_Write(const void* src, mx_size_t len, bool from_user);
+
+    // Vectored variants; |iov| has already been copied in and points at user buffers.
+    mx_ssize_t WriteV(const mx_iovec_t* iov, uint32_t count, uint32_t flags) {
+        return WriteHelper(iov, count, true, flags);
     }
+    mx_ssize_t ReadV(const mx_iovec_t* iov, uint32_t count);
 
-    mx_ssize_t Read(void* dest, mx_size_t len, bool from_user);
+    mx_ssize_t Read(void* dest, mx_size_t len, bool from_user) {
+        mx_iovec_t iov = {dest, len};
+        return ReadHelper(&iov, 1u, from_user);
+    }
     mx_ssize_t OOB_Read(void* dest, mx_size_t len, bool from_user);
 
     void OnPeerZeroHandles();
@@ -48,12 +57,15 @@ private:
     public:
         ~CBuf();
         bool Init(uint32_t len);
-        mx_size_t Write(const void* src, mx_size_t len, bool from_user);
+        mx_size_t Write(const void* src, mx_size_t len, bool from_user, bool move_pages);
         mx_size_t Read(void* dest, mx_size_t len, bool from_user);
         mx_size_t free() const;
         bool empty() const;
 
     private:
+        mx_size_t MovePagesFromUser(const char* src, mx_size_t len);
+        mx_size_t MovePagesToUser(char* dest, mx_size_t len);
+
         mx_size_t head_ = 0u;
         mx_size_t tail_ = 0u;
         uint32_t len_pow2_ = 0u;
@@ -63,8 +75,10 @@ private:
 
     SocketDispatcher(uint32_t flags);
     mx_status_t Init(mxtl::RefPtr<SocketDispatcher> other);
-    mx_ssize_t WriteHelper(const void* src, mx_size_t len, bool from_user, bool is_oob);
-    mx_ssize_t WriteSelf(const void* src, mx_size_t len, bool from_user);
+    mxtl::RefPtr<SocketDispatcher> GetPeer();
+    mx_ssize_t WriteHelper(const mx_iovec_t* iov, uint32_t count, bool from_user, uint32_t flags);
+    mx_ssize_t ReadHelper(const mx_iovec_t* iov, uint32_t count, bool from_user);
+    mx_ssize_t WriteSelf(const mx_iovec_t* iov, uint32_t count, bool from_user, uint32_t flags);
     mx_ssize_t OOB_WriteSelf(const void* src, mx_size_t len, bool from_user);
 
     const uint32_t flags_;
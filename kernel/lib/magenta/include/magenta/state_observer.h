@@ -11,6 +11,7 @@
 #include <mxtl/intrusive_double_list.h>
 
 class Handle;
+class IOPortDispatcher;
 
 // Observer base class for state maintained by StateTracker.
 class StateObserver {
@@ -44,6 +45,21 @@ public:
     // under the StateTracker's mutex.
     virtual void OnDidCancel() = 0;
 
+    // Checked after OnInitialize() and OnStateChange(). If it returns true the observer is
+    // removed from the StateTracker, which then calls OnDidCancel() as above. This lets
+    // one-shot observers retire themselves.
+    // WARNING: This is called under StateTracker's mutex.
+    virtual bool ShouldRemove() { return false; }
+
+    // Called by StateTracker::CancelAsyncWait(). Returns true if the observer was registered
+    // through |handle| to deliver packets with |key| to |io_port|, in which case it is removed
+    // and OnDidCancel() is called.
+    // WARNING: This is called under StateTracker's mutex.
+    virtual bool OnCancelAsyncWait(Handle* handle, const IOPortDispatcher* io_port,
+                                   uint64_t key) {
+        return false;
+    }
+
 protected:
     ~StateObserver() {}
 
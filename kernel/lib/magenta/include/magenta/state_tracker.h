@@ -49,6 +49,10 @@ class WaitEvent;
 //      IOP_Packet pk;
 //      io_port->Wait(&pk);
 //
+//  The signals state is kept in a single atomic word. While no observers are attached,
+//  UpdateState() publishes the new state with a compare-and-swap and never takes |lock_|.
+//  Observers are only walked (and threads only woken) while someone is observing.
+//
 
 class StateTracker {
 public:
@@ -64,7 +68,7 @@ public:
     // Set the initial signals state. This is an alternative to provide the initial signals state to
     // the constructor. This does no locking and does not notify anything.
     void set_initial_signals_state(mx_signals_state_t signals_state) {
-        signals_state_ = signals_state;
+        signals_ = PackSignals(signals_state);
     }
 
     bool is_waitable() const { return is_waitable_; }
@@ -80,6 +84,10 @@ public:
     // destroyed or transferred.
     void Cancel(Handle* handle);
 
+    // Removes the async waits registered through |handle| that deliver packets with |key| to
+    // |io_port|. Returns ERR_NOT_FOUND if there were none.
+    mx_status_t CancelAsyncWait(Handle* handle, const IOPortDispatcher* io_port, uint64_t key);
+
     // Notify others of a change in state (possibly waking them). (Clearing satisfied signals or
     // setting satisfiable signals should not wake anyone.) Returns true if some thread was awoken.
     void UpdateState(mx_signals_t satisfied_clear_mask,
@@ -94,13 +102,41 @@ public:
 private:
     static bool SendIOPortPacket(IOPortDispatcher* io_port, uint64_t key, mx_signals_t signals);
 
+    // |satisfied| lives in the low half of the packed word and |satisfiable| in the high half.
+    static uint64_t PackSignals(mx_signals_state_t signals_state) {
+        return static_cast<uint64_t>(signals_state.satisfiable) << 32 | signals_state.satisfied;
+    }
+    static mx_signals_state_t UnpackSignals(uint64_t signals) {
+        return mx_signals_state_t{static_cast<mx_signals_t>(signals),
+                                  static_cast<mx_signals_t>(signals >> 32)};
+    }
+
+    mx_signals_state_t GetSignalsState();
+
+    using ObserverList = mxtl::DoublyLinkedList<StateObserver*, StateObserverListTraits>;
+
+    // Removes |observer| after it asked to be via ShouldRemove() or a cancel hook, queueing it
+    // on |did_cancel_list| for OnDidCancel().
+    void RemoveObserverLocked(StateObserver* observer, ObserverList* did_cancel_list);
+    static void NotifyDidCancel(ObserverList* did_cancel_list);
+
+    // Atomically applies the masks to |signals_|. Returns false if the state did not change.
+    bool UpdateSignals(mx_signals_t satisfied_clear_mask,
+                       mx_signals_t satisfied_set_mask,
+                       mx_signals_t satisfiable_clear_mask,
+                       mx_signals_t satisfiable_set_mask);
+
     const bool is_waitable_;
 
     mutex_t lock_;  // Protects the members below.
 
     // Active observers are elements in |observers_|.
-    mxtl::DoublyLinkedList<StateObserver*, StateObserverListTraits> observers_;
+    ObserverList observers_;
+
+    // Number of elements in |observers_|. Only modified with |lock_| held, but read without it
+    // by UpdateState().
+    volatile int observer_count_ = 0;
 
-    // mojo-style signaling.
-    mx_signals_state_t signals_state_;
+    // mojo-style signaling, packed by PackSignals(). Updated atomically.
+    volatile uint64_t signals_;
 };
@@ -6,6 +6,7 @@
 
 #pragma once
 
+#include <magenta/syscalls-types.h>
 #include <mxtl/string_piece.h>
 
 status_t magenta_copy_from_user(const void* src, void* dest, size_t len);
@@ -14,3 +15,18 @@ status_t magenta_copy_user_string(const char* src, size_t src_len, char* buf, si
                                   mxtl::StringPiece* sp);
 
 status_t magenta_copy_user_dynamic(const void* src, void** dst, size_t len, size_t max_len);
+
+// Copies an array of |count| iovecs from user space into |dest| (which must hold
+// MX_IOVEC_MAX entries), checking that every buffer lies in user space. The sum of
+// the lengths is returned in |total|.
+status_t magenta_copy_user_iovec(const mx_iovec_t* src, uint32_t count, mx_iovec_t* dest,
+                                 mx_size_t* total);
+
+// Copies |len| bytes out of the user buffers described by an iovec array that was
+// validated by magenta_copy_user_iovec() into the kernel buffer |dest|.
+status_t magenta_gather_user_iovec(const mx_iovec_t* iov, uint32_t count, void* dest, size_t len);
+
+// Copies |len| bytes from the kernel buffer |src| into the user buffers described by
+// a validated iovec array. |len| must not exceed the iovec total.
+status_t magenta_scatter_user_iovec(const mx_iovec_t* iov, uint32_t count, const void* src,
+                                    size_t len);
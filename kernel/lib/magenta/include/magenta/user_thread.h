@@ -72,6 +72,9 @@ public:
     status_t ExceptionHandlerExchange(mxtl::RefPtr<ExceptionPort> eport, const mx_exception_report_t* report);
     status_t MarkExceptionHandled(mx_exception_status_t status);
 
+    // Fills in the CPU and scheduler accounting for this thread.
+    void GetStats(mx_task_stats_t* stats);
+
     mx_koid_t get_koid() const { return koid_; }
     void set_dispatcher(ThreadDispatcher* dispatcher) { dispatcher_ = dispatcher; }
 
@@ -9,6 +9,8 @@
 #include <magenta/dispatcher.h>
 #include <magenta/state_tracker.h>
 
+#include <mxtl/user_ptr.h>
+
 #include <sys/types.h>
 
 class VmObject;
@@ -21,11 +23,14 @@ public:
 
     ~VmObjectDispatcher() final;
     mx_obj_type_t get_type() const final { return MX_OBJ_TYPE_VMEM; }
+    void on_zero_handles() final;
 
     mx_ssize_t Read(void* user_data, mx_size_t length, uint64_t offset);
     mx_ssize_t Write(const void* user_data, mx_size_t length, uint64_t offset);
     mx_status_t SetSize(uint64_t);
     mx_status_t GetSize(uint64_t* size);
+    mx_status_t RangeOp(uint32_t op, uint64_t offset, uint64_t size,
+                        mxtl::user_ptr<void> buffer, mx_size_t buffer_size, mx_rights_t rights);
 
     // XXX really belongs in process
     mx_status_t Map(mxtl::RefPtr<VmAspace> aspace, uint32_t vmo_rights, uint64_t offset, mx_size_t len,
@@ -100,6 +100,11 @@ void IOPortDispatcher::on_zero_handles() {
     FreePackets_NoLock();
 }
 
+bool IOPortDispatcher::HasClients() {
+    AutoLock al(&lock_);
+    return !no_clients_;
+}
+
 mx_status_t IOPortDispatcher::Queue(IOP_Packet* packet) {
     int wake_count = 0;
     mx_status_t status = NO_ERROR;
@@ -0,0 +1,86 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <magenta/magenta.h>
+
+#include <assert.h>
+#include <err.h>
+#include <trace.h>
+
+#include <kernel/auto_lock.h>
+#include <kernel/mutex.h>
+#include <kernel/thread.h>
+#include <kernel/vm.h>
+#include <lk/init.h>
+
+#include <magenta/event_dispatcher.h>
+
+#define LOCAL_TRACE 0
+
+// The pmm lock is held wherever the pressure level changes, too deep to be
+// waking up waiters on a dispatcher, so a thread follows the level instead
+// and mirrors it into the signals of a single event shared with userspace.
+
+static mutex_t pressure_event_lock = MUTEX_INITIAL_VALUE(pressure_event_lock);
+static mxtl::RefPtr<Dispatcher> pressure_event;
+
+static mx_signals_t level_to_signal(uint level) {
+    switch (level) {
+    case PMM_PRESSURE_WARNING:
+        return MX_MEMORY_PRESSURE_WARNING;
+    case PMM_PRESSURE_CRITICAL:
+        return MX_MEMORY_PRESSURE_CRITICAL;
+    default:
+        return MX_MEMORY_PRESSURE_NORMAL;
+    }
+}
+
+static int memory_pressure_thread(void* arg) {
+    auto event = static_cast<Dispatcher*>(arg);
+
+    const mx_signals_t all = MX_MEMORY_PRESSURE_NORMAL | MX_MEMORY_PRESSURE_WARNING |
+                             MX_MEMORY_PRESSURE_CRITICAL;
+
+    uint level = pmm_pressure_level();
+    for (;;) {
+        LTRACEF("memory pressure level %u\n", level);
+        event->get_state_tracker()->UpdateSatisfied(all & ~level_to_signal(level),
+                                                    level_to_signal(level));
+        level = pmm_pressure_wait(level);
+    }
+    return 0;
+}
+
+mxtl::RefPtr<Dispatcher> GetMemoryPressureEvent() {
+    AutoLock lock(&pressure_event_lock);
+    return pressure_event;
+}
+
+static void memory_pressure_init(uint level) {
+    mxtl::RefPtr<Dispatcher> event;
+    mx_rights_t rights;
+    status_t status = EventDispatcher::Create(0u, &event, &rights);
+    if (status != NO_ERROR) {
+        TRACEF("failed to create memory pressure event: %d\n", status);
+        return;
+    }
+
+    // pressure_event keeps the event alive for the thread, which never exits
+    thread_t* t = thread_create("memory pressure", memory_pressure_thread, event.get(),
+                                HIGH_PRIORITY, DEFAULT_STACK_SIZE);
+    if (!t) {
+        TRACEF("failed to create memory pressure thread\n");
+        return;
+    }
+
+    {
+        AutoLock lock(&pressure_event_lock);
+        pressure_event = event;
+    }
+    thread_detach_and_resume(t);
+}
+
+LK_INIT_HOOK(memory_pressure, memory_pressure_init, LK_INIT_LEVEL_APPS - 1);
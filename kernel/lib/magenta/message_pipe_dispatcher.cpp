@@ -14,6 +14,7 @@
 #include <trace.h>
 
 #include <kernel/auto_lock.h>
+#include <lib/ktrace.h>
 
 #include <magenta/handle.h>
 #include <magenta/message_pipe.h>
@@ -91,11 +92,13 @@ status_t MessagePipeDispatcher::AcceptRead(mxtl::Array<uint8_t>* data,
         *data = mxtl::move(msg->data);
         *handles = mxtl::move(msg->handles);
     }
+    KTRACE(KTRACE_TAG_MSGPIPE_READ, get_inner_koid(), data->size());
     return NO_ERROR;
 }
 
 status_t MessagePipeDispatcher::Write(mxtl::Array<uint8_t> data, mxtl::Array<Handle*> handles) {
     LTRACE_ENTRY;
+    KTRACE(KTRACE_TAG_MSGPIPE_WRITE, get_inner_koid(), data.size());
     AllocChecker ac;
     mxtl::unique_ptr<MessagePacket> msg(
         new (&ac) MessagePacket(mxtl::move(data), mxtl::move(handles)));
@@ -40,6 +40,14 @@ mutex_t ProcessDispatcher::global_process_list_mutex_ =
     MUTEX_INITIAL_VALUE(global_process_list_mutex_);
 mxtl::DoublyLinkedList<ProcessDispatcher*> ProcessDispatcher::global_process_list_;
 
+static void AddTaskStats(mx_task_stats_t* sum, const mx_task_stats_t& stats) {
+    sum->runtime += stats.runtime;
+    sum->wait_time += stats.wait_time;
+    sum->voluntary_switches += stats.voluntary_switches;
+    sum->involuntary_switches += stats.involuntary_switches;
+    sum->page_faults += stats.page_faults;
+    sum->syscalls += stats.syscalls;
+}
 
 mx_handle_t map_handle_to_value(const Handle* handle, mx_handle_t mixer) {
     // Ensure that the last bit of the result is not zero and that
@@ -231,11 +239,15 @@ void ProcessDispatcher::RemoveThread(UserThread* t) {
     // we're going to check for state and possibly transition below
     AutoLock state_lock(&state_lock_);
 
-    // remove the thread from our list
+    // remove the thread from our list, keeping its accounting
     AutoLock lock(&thread_list_lock_);
     DEBUG_ASSERT(t != nullptr);
     thread_list_.erase(*t);
 
+    mx_task_stats_t stats;
+    t->GetStats(&stats);
+    AddTaskStats(&exited_stats_, stats);
+
     // drop the ref from the main_thread_ pointer if its being removed
     if (t == main_thread_.get()) {
         main_thread_.reset();
@@ -372,6 +384,38 @@ status_t ProcessDispatcher::GetInfo(mx_process_info_t* info) {
     return NO_ERROR;
 }
 
+status_t ProcessDispatcher::GetStats(mx_process_stats_info_t* info) {
+    memset(info, 0, sizeof(*info));
+    strlcpy(info->name, name_, sizeof(info->name));
+
+    AutoLock lock(&thread_list_lock_);
+    info->stats = exited_stats_;
+    for (auto& thread : thread_list_) {
+        mx_task_stats_t stats;
+        thread.GetStats(&stats);
+        AddTaskStats(&info->stats, stats);
+        info->thread_count++;
+    }
+
+    return NO_ERROR;
+}
+
+status_t ProcessDispatcher::GetMemoryInfo(mx_process_memory_info_t* info) {
+    memset(info, 0, sizeof(*info));
+
+    auto aspace = aspace_;
+    if (!aspace)
+        return ERR_BAD_STATE;
+
+    size_t committed_pages;
+    size_t mapped_pages;
+    aspace->GetMemoryUsage(&committed_pages, &mapped_pages);
+
+    info->committed_bytes = static_cast<uint64_t>(committed_pages) * PAGE_SIZE;
+    info->mapped_bytes = static_cast<uint64_t>(mapped_pages) * PAGE_SIZE;
+    return NO_ERROR;
+}
+
 status_t ProcessDispatcher::CreateUserThread(mxtl::StringPiece name, uint32_t flags, mxtl::RefPtr<UserThread>* user_thread) {
     AllocChecker ac;
     auto ut = mxtl::AdoptRef(new (&ac) UserThread(GenerateKernelObjectId(),
@@ -446,6 +490,28 @@ mxtl::RefPtr<UserThread> ProcessDispatcher::LookupThreadById(mx_koid_t koid) {
     return mxtl::WrapRefPtr(iter.CopyPointer());
 }
 
+size_t ProcessDispatcher::GetThreadKoids(mx_koid_t* koids, size_t count) const {
+    AutoLock lock(&thread_list_lock_);
+    size_t n = 0;
+    for (const auto& thread : thread_list_) {
+        if (n < count)
+            koids[n] = thread.get_koid();
+        n++;
+    }
+    return n;
+}
+
+size_t ProcessDispatcher::GetProcessKoids(mx_koid_t* koids, size_t count) {
+    AutoLock lock(&global_process_list_mutex_);
+    size_t n = 0;
+    for (const auto& process : global_process_list_) {
+        if (n < count)
+            koids[n] = process.get_koid();
+        n++;
+    }
+    return n;
+}
+
 mx_status_t ProcessDispatcher::set_bad_handle_policy(uint32_t new_policy) {
     if (new_policy > MX_POLICY_BAD_HANDLE_EXIT)
         return ERR_NOT_SUPPORTED;
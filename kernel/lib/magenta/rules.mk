@@ -10,6 +10,7 @@ LOCAL_DIR := $(GET_LOCAL_DIR)
 MODULE := $(LOCAL_DIR)
 
 MODULE_SRCS := \
+    $(LOCAL_DIR)/async_wait_observer.cpp \
     $(LOCAL_DIR)/data_pipe.cpp \
     $(LOCAL_DIR)/data_pipe_producer_dispatcher.cpp \
     $(LOCAL_DIR)/data_pipe_consumer_dispatcher.cpp \
@@ -27,6 +28,7 @@ MODULE_SRCS := \
     $(LOCAL_DIR)/io_port_dispatcher.cpp \
     $(LOCAL_DIR)/log_dispatcher.cpp \
     $(LOCAL_DIR)/magenta.cpp \
+    $(LOCAL_DIR)/memory_pressure.cpp \
     $(LOCAL_DIR)/message_pipe_dispatcher.cpp \
     $(LOCAL_DIR)/message_pipe.cpp \
     $(LOCAL_DIR)/pci_device_dispatcher.cpp \
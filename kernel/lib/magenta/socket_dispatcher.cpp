@@ -19,8 +19,10 @@
 #include <kernel/auto_lock.h>
 #include <kernel/vm/vm_aspace.h>
 #include <kernel/vm/vm_object.h>
+#include <kernel/vm/vm_region.h>
 
 #include <magenta/handle.h>
+#include <magenta/process_dispatcher.h>
 #include <magenta/user_copy.h>
 
 #define LOCAL_TRACE 0
@@ -70,7 +72,77 @@ bool SocketDispatcher::CBuf::empty() const {
     return tail_ == head_;
 }
 
-mx_size_t SocketDispatcher::CBuf::Write(const void* src, mx_size_t len, bool from_user) {
+namespace {
+// Finds the vm object and offset backing the user page at |va| in the current process. Only
+// writable mappings of objects nothing else can see qualify, since moving a page changes what
+// that mapping shows; anything else is copied.
+mxtl::RefPtr<VmObject> UserPageObject(const void* va, uint64_t* offset) {
+    auto aspace = ProcessDispatcher::GetCurrent()->aspace();
+    auto region = aspace->FindRegion(reinterpret_cast<vaddr_t>(va));
+    if (!region)
+        return nullptr;
+
+    const uint kNeeded = ARCH_MMU_FLAG_PERM_USER | ARCH_MMU_FLAG_PERM_WRITE;
+    if ((region->arch_mmu_flags() & kNeeded) != kNeeded)
+        return nullptr;
+
+    auto vmo = region->vmo();
+    if (!vmo || !vmo->CanMovePages())
+        return nullptr;
+
+    *offset = reinterpret_cast<vaddr_t>(va) - region->base() + region->object_offset();
+    return vmo;
+}
+}
+
+// Moves whole pages from the user buffer into the ring at |head_|. Returns the number of
+// bytes moved, which is zero if the buffer or the ring position is not page aligned.
+mx_size_t SocketDispatcher::CBuf::MovePagesFromUser(const char* src, mx_size_t len) {
+    if (!IS_PAGE_ALIGNED(head_) || !IS_PAGE_ALIGNED(src))
+        return 0u;
+
+    mx_size_t moved = 0u;
+    while (len - moved >= PAGE_SIZE) {
+        uint64_t offset;
+        auto uvmo = UserPageObject(src + moved, &offset);
+        if (!uvmo)
+            break;
+        vm_page_t* p = uvmo->TakePage(offset);
+        if (!p)
+            break;
+        __UNUSED auto st = vmo_->ReplacePage(head_ + moved, p);
+        DEBUG_ASSERT(st == NO_ERROR);
+        moved += PAGE_SIZE;
+    }
+    return moved;
+}
+
+// Moves whole pages from the ring at |tail_| into the user buffer. Returns the number of
+// bytes moved, which is zero if the buffer or the ring position is not page aligned.
+mx_size_t SocketDispatcher::CBuf::MovePagesToUser(char* dest, mx_size_t len) {
+    if (!IS_PAGE_ALIGNED(tail_) || !IS_PAGE_ALIGNED(dest))
+        return 0u;
+
+    mx_size_t moved = 0u;
+    while (len - moved >= PAGE_SIZE) {
+        uint64_t offset;
+        auto uvmo = UserPageObject(dest + moved, &offset);
+        if (!uvmo)
+            break;
+        vm_page_t* p = vmo_->TakePage(tail_ + moved);
+        if (!p)
+            break;
+        if (uvmo->ReplacePage(offset, p) != NO_ERROR) {
+            vmo_->ReplacePage(tail_ + moved, p);
+            break;
+        }
+        moved += PAGE_SIZE;
+    }
+    return moved;
+}
+
+mx_size_t SocketDispatcher::CBuf::Write(const void* src, mx_size_t len, bool from_user,
+                                        bool move_pages) {
     const char *buf = (const char*)src;
 
     size_t write_len;
@@ -82,13 +154,17 @@ mx_size_t SocketDispatcher::CBuf::Write(const void* src, mx_size_t len, bool fro
         } else {
             write_len = MIN(tail_ - head_ - 1, len - pos);
         }
+        write_len = MIN(write_len, free());
 
         // if it's full, abort and return how much we've written
         if (write_len == 0) {
             break;
         }
 
-        if (from_user)
+        mx_size_t moved = (from_user && move_pages) ? MovePagesFromUser(buf + pos, write_len) : 0u;
+        if (moved)
+            write_len = moved;
+        else if (from_user)
             vmo_->WriteUser(buf + pos, head_, write_len, nullptr);
         else
             memcpy(buf_ + head_, buf + pos, write_len);
@@ -118,7 +194,11 @@ mx_size_t SocketDispatcher::CBuf::Read(void* dest, mx_size_t len, bool from_user
                 read_len = MIN(valpow2(len_pow2_) - tail_, len - pos);
             }
 
-            if (from_user)
+            // whole pages are handed over rather than copied when the reader's buffer lines up
+            mx_size_t moved = from_user ? MovePagesToUser(buf + pos, read_len) : 0u;
+            if (moved)
+                read_len = moved;
+            else if (from_user)
                 vmo_->ReadUser(buf + pos, tail_, read_len, nullptr);
             else
                 memcpy(buf + pos, buf_ + tail_, read_len);
@@ -138,6 +218,14 @@ status_t SocketDispatcher::Create(uint32_t flags,
                                   mx_rights_t* rights) {
     LTRACE_ENTRY;
 
+    if (flags & ~MX_SOCKET_SIZE_LOG2_MASK)
+        return ERR_INVALID_ARGS;
+
+    uint32_t size_log2 = MX_SOCKET_SIZE_LOG2(flags);
+    if (size_log2 != 0u &&
+        (size_log2 < MX_SOCKET_MIN_SIZE_LOG2 || size_log2 > MX_SOCKET_MAX_SIZE_LOG2))
+        return ERR_INVALID_ARGS;
+
     AllocChecker ac;
     auto socket0 = mxtl::AdoptRef(new (&ac) SocketDispatcher(flags));
     if (!ac.check())
@@ -173,7 +261,10 @@ SocketDispatcher::~SocketDispatcher() {
 
 mx_status_t SocketDispatcher::Init(mxtl::RefPtr<SocketDispatcher> other) {
     other_ = mxtl::move(other);
-    return cbuf_.Init(kDeFaultSocketBufferSize) ? NO_ERROR : ERR_NO_MEMORY;
+
+    uint32_t size_log2 = MX_SOCKET_SIZE_LOG2(flags_);
+    uint32_t size = size_log2 ? (1u << size_log2) : kDeFaultSocketBufferSize;
+    return cbuf_.Init(size) ? NO_ERROR : ERR_NO_MEMORY;
 }
 
 void SocketDispatcher::on_zero_handles() {
@@ -197,39 +288,53 @@ void SocketDispatcher::OnPeerZeroHandles() {
                                MX_SIGNAL_WRITABLE, 0u);
 }
 
-mx_ssize_t SocketDispatcher::WriteHelper(const void* src, mx_size_t len,
-                                         bool from_user, bool is_oob) {
-    mxtl::RefPtr<SocketDispatcher> other;
-    {
-        AutoLock lock(&lock_);
-        if (!other_)
-            return ERR_REMOTE_CLOSED;
-        other = other_;
-    }
+mxtl::RefPtr<SocketDispatcher> SocketDispatcher::GetPeer() {
+    AutoLock lock(&lock_);
+    return other_;
+}
+
+mx_ssize_t SocketDispatcher::WriteHelper(const mx_iovec_t* iov, uint32_t count,
+                                         bool from_user, uint32_t flags) {
+    auto other = GetPeer();
+    if (!other)
+        return ERR_REMOTE_CLOSED;
 
-    auto st = is_oob ?
-        other->OOB_WriteSelf(src, len, from_user) :
-        other->WriteSelf(src, len, from_user);
-    return st;
+    return other->WriteSelf(iov, count, from_user, flags);
 }
 
-mx_ssize_t SocketDispatcher::WriteSelf(const void* src, mx_size_t len, bool from_user) {
+mx_ssize_t SocketDispatcher::OOB_Write(const void* src, mx_size_t len, bool from_user) {
+    auto other = GetPeer();
+    if (!other)
+        return ERR_REMOTE_CLOSED;
+
+    return other->OOB_WriteSelf(src, len, from_user);
+}
+
+mx_ssize_t SocketDispatcher::WriteSelf(const mx_iovec_t* iov, uint32_t count,
+                                       bool from_user, uint32_t flags) {
     AutoLock lock(&lock_);
 
     if (!cbuf_.free())
         return ERR_SHOULD_WAIT;
 
     bool was_empty = cbuf_.empty();
+    bool move_pages = (flags & MX_SOCKET_MOVE_PAGES) != 0u;
 
-    auto st = cbuf_.Write(src, len, from_user);
+    mx_size_t st = 0u;
+    for (uint32_t i = 0; i < count; ++i) {
+        mx_size_t written = cbuf_.Write(iov[i].base, iov[i].len, from_user, move_pages);
+        st += written;
+        if (written < iov[i].len)
+            break;
+    }
 
     if (was_empty && (st > 0))
         state_tracker_.UpdateSatisfied(0u, MX_SIGNAL_READABLE);
 
-    if (!cbuf_.free())
+    if (!cbuf_.free() && other_)
         other_->state_tracker_.UpdateSatisfied(MX_SIGNAL_WRITABLE, 0u);
 
-    return st;
+    return static_cast<mx_ssize_t>(st);
 }
 
 mx_ssize_t SocketDispatcher::OOB_WriteSelf(const void* src, mx_size_t len, bool from_user) {
@@ -251,22 +356,28 @@ mx_ssize_t SocketDispatcher::OOB_WriteSelf(const void* src, mx_size_t len, bool
     return len;
 }
 
-mx_ssize_t SocketDispatcher::Read(void* dest, mx_size_t len, bool from_user) {
+mx_ssize_t SocketDispatcher::ReadV(const mx_iovec_t* iov, uint32_t count) {
+    return ReadHelper(iov, count, true);
+}
+
+mx_ssize_t SocketDispatcher::ReadHelper(const mx_iovec_t* iov, uint32_t count, bool from_user) {
     AutoLock lock(&lock_);
     if (cbuf_.empty())
         return ERR_SHOULD_WAIT;
 
     bool was_full = cbuf_.free() == 0u;
 
-    auto st = cbuf_.Read(dest, len, from_user);
+    mx_size_t st = 0u;
+    for (uint32_t i = 0; i < count && !cbuf_.empty(); ++i)
+        st += cbuf_.Read(iov[i].base, iov[i].len, from_user);
 
     if (cbuf_.empty())
         state_tracker_.UpdateSatisfied(MX_SIGNAL_READABLE, 0u);
 
-    if (was_full && (st > 0))
+    if (was_full && (st > 0) && other_)
         other_->state_tracker_.UpdateSatisfied(0u, MX_SIGNAL_WRITABLE);
 
-    return st;
+    return static_cast<mx_ssize_t>(st);
 }
 
 mx_ssize_t SocketDispatcher::OOB_Read(void* dest, mx_size_t len, bool from_user) {
@@ -6,6 +6,7 @@
 
 #include <magenta/state_tracker.h>
 
+#include <arch/ops.h>
 #include <kernel/auto_lock.h>
 
 #include <magenta/wait_event.h>
@@ -14,7 +15,7 @@
 
 StateTracker::StateTracker(bool is_waitable, mx_signals_state_t signals_state)
     : is_waitable_(is_waitable),
-      signals_state_(signals_state) {
+      signals_(PackSignals(signals_state)) {
     mutex_init(&lock_);
 }
 
@@ -24,12 +25,18 @@ StateTracker::~StateTracker() {
 
 mx_status_t StateTracker::AddObserver(StateObserver* observer) {
     bool awoke_threads = false;
+    ObserverList did_cancel_list;
     {
         AutoLock lock(&lock_);
 
         observers_.push_front(observer);
-        awoke_threads = observer->OnInitialize(signals_state_);
+        // The count must be raised before the state is read. See UpdateState().
+        atomic_add(&observer_count_, 1);
+        awoke_threads = observer->OnInitialize(GetSignalsState());
+        if (observer->ShouldRemove())
+            RemoveObserverLocked(observer, &did_cancel_list);
     }
+    NotifyDidCancel(&did_cancel_list);
     if (awoke_threads)
         thread_yield();
     return NO_ERROR;
@@ -39,32 +46,84 @@ mx_signals_state_t StateTracker::RemoveObserver(StateObserver* observer) {
     AutoLock lock(&lock_);
     DEBUG_ASSERT(observer != nullptr);
     observers_.erase(*observer);
-    return signals_state_;
+    atomic_add(&observer_count_, -1);
+    return GetSignalsState();
+}
+
+void StateTracker::RemoveObserverLocked(StateObserver* observer, ObserverList* did_cancel_list) {
+    observers_.erase(*observer);
+    atomic_add(&observer_count_, -1);
+    did_cancel_list->push_front(observer);
+}
+
+void StateTracker::NotifyDidCancel(ObserverList* did_cancel_list) {
+    while (!did_cancel_list->is_empty()) {
+        auto observer = did_cancel_list->pop_front();
+        observer->OnDidCancel();
+    }
+}
+
+mx_signals_state_t StateTracker::GetSignalsState() {
+    return UnpackSignals(atomic_load_u64(&signals_));
+}
+
+bool StateTracker::UpdateSignals(mx_signals_t satisfied_clear_mask,
+                                 mx_signals_t satisfied_set_mask,
+                                 mx_signals_t satisfiable_clear_mask,
+                                 mx_signals_t satisfiable_set_mask) {
+    uint64_t old_signals = atomic_load_u64(&signals_);
+    uint64_t new_signals;
+    do {
+        auto signals_state = UnpackSignals(old_signals);
+        signals_state.satisfied &= ~satisfied_clear_mask;
+        signals_state.satisfied |= satisfied_set_mask;
+        signals_state.satisfiable &= ~satisfiable_clear_mask;
+        signals_state.satisfiable |= satisfiable_set_mask;
+
+        new_signals = PackSignals(signals_state);
+        if (new_signals == old_signals)
+            return false;
+    } while (!atomic_cmpxchg_u64(&signals_, &old_signals, new_signals));
+    return true;
 }
 
 void StateTracker::UpdateState(mx_signals_t satisfied_clear_mask,
                                mx_signals_t satisfied_set_mask,
                                mx_signals_t satisfiable_clear_mask,
                                mx_signals_t satisfiable_set_mask) {
+    // Fast path: with no observers the new state only has to be published. The count is
+    // checked again after the swap because AddObserver() raises it before reading the state,
+    // so an observer racing with us either sees the new state or is notified below.
+    bool observed = atomic_load(&observer_count_) != 0;
+    if (!observed) {
+        if (!UpdateSignals(satisfied_clear_mask, satisfied_set_mask,
+                           satisfiable_clear_mask, satisfiable_set_mask))
+            return;
+        if (atomic_load(&observer_count_) == 0)
+            return;
+    }
+
     bool awoke_threads = false;
+    ObserverList did_cancel_list;
     {
         AutoLock lock(&lock_);
 
-        auto previous_signals_state = signals_state_;
-        signals_state_.satisfied &= ~satisfied_clear_mask;
-        signals_state_.satisfied |= satisfied_set_mask;
-        signals_state_.satisfiable &= ~satisfiable_clear_mask;
-        signals_state_.satisfiable |= satisfiable_set_mask;
-
-        if (previous_signals_state.satisfied == signals_state_.satisfied &&
-            previous_signals_state.satisfiable == signals_state_.satisfiable)
+        // Updating under the lock keeps observers from missing a transient state.
+        if (observed && !UpdateSignals(satisfied_clear_mask, satisfied_set_mask,
+                                       satisfiable_clear_mask, satisfiable_set_mask))
             return;
 
-        for (auto& observer : observers_) {
-            awoke_threads |= observer.OnStateChange(signals_state_);
+        auto signals_state = GetSignalsState();
+        for (auto it = observers_.begin(); it != observers_.end();) {
+            auto& observer = *it;
+            ++it;
+            awoke_threads |= observer.OnStateChange(signals_state);
+            if (observer.ShouldRemove())
+                RemoveObserverLocked(&observer, &did_cancel_list);
         }
 
     }
+    NotifyDidCancel(&did_cancel_list);
     if (awoke_threads)
         thread_yield();
 }
@@ -73,7 +132,7 @@ void StateTracker::Cancel(Handle* handle) {
     bool awoke_threads = false;
     StateObserver* observer = nullptr;
 
-    mxtl::DoublyLinkedList<StateObserver*, StateObserverListTraits> did_cancel_list;
+    ObserverList did_cancel_list;
 
     {
         AutoLock lock(&lock_);
@@ -85,6 +144,7 @@ void StateTracker::Cancel(Handle* handle) {
                 auto to_remove = it;
                 ++it;
                 observer = observers_.erase(to_remove);
+                atomic_add(&observer_count_, -1);
                 if (call_did_cancel)
                     did_cancel_list.push_front(observer);
             } else {
@@ -93,11 +153,28 @@ void StateTracker::Cancel(Handle* handle) {
         }
     }
 
-    while (!did_cancel_list.is_empty()) {
-        auto observer = did_cancel_list.pop_front();
-        observer->OnDidCancel();
-    }
+    NotifyDidCancel(&did_cancel_list);
 
     if (awoke_threads)
         thread_yield();
 }
+
+mx_status_t StateTracker::CancelAsyncWait(Handle* handle, const IOPortDispatcher* io_port,
+                                          uint64_t key) {
+    ObserverList did_cancel_list;
+    {
+        AutoLock lock(&lock_);
+        for (auto it = observers_.begin(); it != observers_.end();) {
+            auto& observer = *it;
+            ++it;
+            if (observer.OnCancelAsyncWait(handle, io_port, key))
+                RemoveObserverLocked(&observer, &did_cancel_list);
+        }
+    }
+
+    if (did_cancel_list.is_empty())
+        return ERR_NOT_FOUND;
+
+    NotifyDidCancel(&did_cancel_list);
+    return NO_ERROR;
+}
@@ -6,7 +6,9 @@
 
 #include <new.h>
 #include <stdint.h>
+#include <stdlib.h>
 
+#include <kernel/vm.h>
 #include <lib/user_copy.h>
 #include <magenta/user_copy.h>
 
@@ -51,3 +53,57 @@ status_t magenta_copy_user_dynamic(const void* src, void** dest, size_t len, siz
     *dest = buf;
     return NO_ERROR;
 }
+
+status_t magenta_copy_user_iovec(const mx_iovec_t* src, uint32_t count, mx_iovec_t* dest,
+                                 mx_size_t* total) {
+    if (count > MX_IOVEC_MAX) return ERR_INVALID_ARGS;
+
+    *total = 0u;
+    if (count == 0u) return NO_ERROR;
+
+    status_t status = magenta_copy_from_user(src, dest, count * sizeof(mx_iovec_t));
+    if (status != NO_ERROR) return status;
+
+    mx_size_t sum = 0u;
+    for (uint32_t i = 0; i < count; ++i) {
+        mx_size_t len = dest[i].len;
+        if (len == 0u) continue;
+
+        vaddr_t base = reinterpret_cast<vaddr_t>(dest[i].base);
+        if (!is_user_address(base) || !is_user_address(base + len - 1) ||
+            (base + len - 1 < base))
+            return ERR_INVALID_ARGS;
+
+        if (sum + len < sum) return ERR_INVALID_ARGS;
+        sum += len;
+    }
+    *total = sum;
+    return NO_ERROR;
+}
+
+status_t magenta_gather_user_iovec(const mx_iovec_t* iov, uint32_t count, void* dest, size_t len) {
+    uint8_t* dst = reinterpret_cast<uint8_t*>(dest);
+    for (uint32_t i = 0; i < count && len > 0u; ++i) {
+        size_t chunk = MIN(iov[i].len, len);
+        if (chunk == 0u) continue;
+        if (copy_from_user_unsafe(dst, iov[i].base, chunk) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+        dst += chunk;
+        len -= chunk;
+    }
+    return len == 0u ? NO_ERROR : ERR_INVALID_ARGS;
+}
+
+status_t magenta_scatter_user_iovec(const mx_iovec_t* iov, uint32_t count, const void* src,
+                                    size_t len) {
+    const uint8_t* s = reinterpret_cast<const uint8_t*>(src);
+    for (uint32_t i = 0; i < count && len > 0u; ++i) {
+        size_t chunk = MIN(iov[i].len, len);
+        if (chunk == 0u) continue;
+        if (copy_to_user_unsafe(iov[i].base, s, chunk) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+        s += chunk;
+        len -= chunk;
+    }
+    return len == 0u ? NO_ERROR : ERR_INVALID_ARGS;
+}
@@ -189,6 +189,18 @@ static void ThreadCleanupDpc(dpc_t *d) {
     delete t;
 }
 
+void UserThread::GetStats(mx_task_stats_t* stats) {
+    thread_accounting_t acct;
+    thread_get_accounting(&thread_, &acct);
+
+    stats->runtime = acct.runtime_us * 1000;
+    stats->wait_time = acct.wait_time_us * 1000;
+    stats->voluntary_switches = acct.voluntary_switches;
+    stats->involuntary_switches = acct.involuntary_switches;
+    stats->page_faults = acct.page_faults;
+    stats->syscalls = acct.syscalls;
+}
+
 void UserThread::Exiting() {
     LTRACE_ENTRY_OBJ;
 
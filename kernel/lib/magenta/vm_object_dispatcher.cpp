@@ -12,8 +12,11 @@
 #include <assert.h>
 #include <new.h>
 #include <err.h>
+#include <lib/user_copy.h>
 #include <trace.h>
 
+#define LOCAL_TRACE 0
+
 constexpr mx_rights_t kDefaultVmoRights =
     MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER | MX_RIGHT_READ | MX_RIGHT_WRITE | MX_RIGHT_EXECUTE;
 
@@ -31,10 +34,16 @@ status_t VmObjectDispatcher::Create(mxtl::RefPtr<VmObject> vmo,
 }
 
 VmObjectDispatcher::VmObjectDispatcher(mxtl::RefPtr<VmObject> vmo)
-    : vmo_(vmo) {}
+    : vmo_(vmo) {
+    vmo_->set_user_handles(true);
+}
 
 VmObjectDispatcher::~VmObjectDispatcher() {}
 
+void VmObjectDispatcher::on_zero_handles() {
+    vmo_->set_user_handles(false);
+}
+
 mx_ssize_t VmObjectDispatcher::Read(void* user_data, mx_size_t length, uint64_t offset) {
 
     size_t bytes_read;
@@ -65,6 +74,86 @@ mx_status_t VmObjectDispatcher::GetSize(uint64_t* size) {
     return NO_ERROR;
 }
 
+mx_status_t VmObjectDispatcher::RangeOp(uint32_t op, uint64_t offset, uint64_t size,
+                                        mxtl::user_ptr<void> buffer, mx_size_t buffer_size,
+                                        mx_rights_t rights) {
+    LTRACEF("op %u offset 0x%llx, size 0x%llx, buffer %p, buffer_size %zu\n",
+            op, offset, size, buffer.get(), buffer_size);
+
+    switch (op) {
+    case MX_VMO_OP_COMMIT: {
+        if ((rights & MX_RIGHT_WRITE) == 0)
+            return ERR_ACCESS_DENIED;
+
+        auto committed = vmo_->CommitRange(offset, size);
+        return (committed < 0) ? static_cast<mx_status_t>(committed) : NO_ERROR;
+    }
+    case MX_VMO_OP_DECOMMIT: {
+        if ((rights & MX_RIGHT_WRITE) == 0)
+            return ERR_ACCESS_DENIED;
+
+        // the pages come back zero filled the next time they are touched
+        auto released = vmo_->DecommitRange(offset, size);
+        return (released < 0) ? static_cast<mx_status_t>(released) : NO_ERROR;
+    }
+    case MX_VMO_OP_LOOKUP: {
+        // physical addresses are only useful for pointing a device at the pages, which
+        // may then write them, so this needs the rights for both directions
+        if ((rights & (MX_RIGHT_READ | MX_RIGHT_WRITE)) != (MX_RIGHT_READ | MX_RIGHT_WRITE))
+            return ERR_ACCESS_DENIED;
+        if (size == 0)
+            return NO_ERROR;
+
+        // look the pages up a batch at a time to bound the stack use
+        const size_t kBatch = 32;
+        paddr_t pa_list[kBatch];
+
+        uint64_t start = ROUNDDOWN(offset, PAGE_SIZE);
+        uint64_t end = ROUNDUP_PAGE_SIZE(offset + size);
+        if (end < start)
+            return ERR_OUT_OF_RANGE;
+        if ((end - start) / PAGE_SIZE > buffer_size / sizeof(mx_paddr_t))
+            return ERR_NOT_ENOUGH_BUFFER;
+
+        mx_paddr_t* out = buffer.reinterpret<mx_paddr_t>().get();
+        for (uint64_t o = start; o < end; o += kBatch * PAGE_SIZE) {
+            uint64_t len = MIN(end - o, kBatch * PAGE_SIZE);
+            // fails rather than filling fewer entries if the range runs past the end
+            status_t status = vmo_->Lookup(o, len, pa_list, kBatch);
+            if (status < 0)
+                return status;
+
+            size_t count = static_cast<size_t>(len / PAGE_SIZE);
+            static_assert(sizeof(paddr_t) == sizeof(mx_paddr_t), "");
+            if (copy_to_user(mxtl::user_ptr<mx_paddr_t>(out), pa_list,
+                             count * sizeof(mx_paddr_t)) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+            out += count;
+        }
+        return NO_ERROR;
+    }
+    case MX_VMO_OP_CACHE_SYNC:
+        if ((rights & MX_RIGHT_READ) == 0)
+            return ERR_ACCESS_DENIED;
+        return vmo_->CacheOp(offset, size, VmObject::CacheOpType::Sync);
+    case MX_VMO_OP_CACHE_INVALIDATE:
+        // discarding dirty lines can lose data, so this is a write
+        if ((rights & MX_RIGHT_WRITE) == 0)
+            return ERR_ACCESS_DENIED;
+        return vmo_->CacheOp(offset, size, VmObject::CacheOpType::Invalidate);
+    case MX_VMO_OP_CACHE_CLEAN:
+        if ((rights & MX_RIGHT_READ) == 0)
+            return ERR_ACCESS_DENIED;
+        return vmo_->CacheOp(offset, size, VmObject::CacheOpType::Clean);
+    case MX_VMO_OP_CACHE_CLEAN_INVALIDATE:
+        if ((rights & MX_RIGHT_READ) == 0)
+            return ERR_ACCESS_DENIED;
+        return vmo_->CacheOp(offset, size, VmObject::CacheOpType::CleanInvalidate);
+    default:
+        return ERR_INVALID_ARGS;
+    }
+}
+
 mx_status_t VmObjectDispatcher::Map(mxtl::RefPtr<VmAspace> aspace, uint32_t vmo_rights, uint64_t offset, mx_size_t len,
                                     uintptr_t* _ptr, uint32_t flags) {
     DEBUG_ASSERT(aspace);
@@ -0,0 +1,57 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <magenta/compiler.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+__BEGIN_CDECLS
+
+// A buffer of fixed-size records written by one CPU, as used by ktrace and
+// kprof.  |count| is the number of records ever written to it; a writer
+// that wraps keeps the newest |capacity| of them, one that stops when full
+// keeps the first.  Either way the buffer holds MIN(count, capacity).
+typedef struct recbuf {
+    void* recs;
+    volatile unsigned long long count;
+} recbuf_t;
+
+status_t recbuf_alloc(recbuf_t* rb, uint32_t capacity, size_t rec_size);
+void recbuf_free(recbuf_t* rb);
+
+static inline uint32_t recbuf_held(unsigned long long count, uint32_t capacity) {
+    return (count < capacity) ? (uint32_t)count : capacity;
+}
+
+// Copies a window of a stream made of a header followed by the contents
+// of a set of recbufs, as read by ktrace_read() and kprof_read().  The
+// stream is fed to the reader in order and only the part of it that falls
+// within [offset, offset + len) is copied out.
+typedef struct recbuf_reader {
+    uint8_t* ptr;
+    size_t offset;
+    size_t len;
+    size_t done;
+    bool user;
+    status_t status;
+} recbuf_reader_t;
+
+void recbuf_reader_init(recbuf_reader_t* r, void* ptr, size_t offset, size_t len, bool user);
+
+// Feed the next |size| bytes of the stream to the reader.
+void recbuf_emit(recbuf_reader_t* r, const void* src, size_t size);
+
+// Feed the records |rb| held when its count was |count|, oldest first.
+void recbuf_emit_records(recbuf_reader_t* r, const recbuf_t* rb, unsigned long long count,
+                         uint32_t capacity, size_t rec_size);
+
+// Returns the number of bytes copied, or the first error.
+ssize_t recbuf_reader_result(const recbuf_reader_t* r);
+
+__END_CDECLS
@@ -0,0 +1,70 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#include <lib/recbuf.h>
+
+#include <err.h>
+#include <lib/user_copy.h>
+#include <stdlib.h>
+#include <string.h>
+
+status_t recbuf_alloc(recbuf_t* rb, uint32_t capacity, size_t rec_size) {
+    void* recs = calloc(capacity, rec_size);
+    if (recs == NULL)
+        return ERR_NO_MEMORY;
+    rb->recs = recs;
+    rb->count = 0;
+    return NO_ERROR;
+}
+
+void recbuf_free(recbuf_t* rb) {
+    free(rb->recs);
+    rb->recs = NULL;
+    rb->count = 0;
+}
+
+void recbuf_reader_init(recbuf_reader_t* r, void* ptr, size_t offset, size_t len, bool user) {
+    r->ptr = ptr;
+    r->offset = offset;
+    r->len = len;
+    r->done = 0;
+    r->user = user;
+    r->status = NO_ERROR;
+}
+
+void recbuf_emit(recbuf_reader_t* r, const void* src, size_t size) {
+    if (r->status != NO_ERROR || r->done == r->len)
+        return;
+    if (r->offset >= size) {
+        r->offset -= size;
+        return;
+    }
+    size_t take = MIN(size - r->offset, r->len - r->done);
+    const uint8_t* from = (const uint8_t*)src + r->offset;
+    if (r->user) {
+        r->status = copy_to_user_unsafe(r->ptr + r->done, from, take);
+    } else {
+        memcpy(r->ptr + r->done, from, take);
+    }
+    r->done += take;
+    r->offset = 0;
+}
+
+void recbuf_emit_records(recbuf_reader_t* r, const recbuf_t* rb, unsigned long long count,
+                         uint32_t capacity, size_t rec_size) {
+    // A ring that has wrapped holds its oldest records at the slot the
+    // next write goes to, making the stream two pieces.
+    const uint8_t* recs = rb->recs;
+    uint32_t n = recbuf_held(count, capacity);
+    uint32_t first = (uint32_t)((count - n) % capacity);
+    uint32_t run = MIN(n, capacity - first);
+    recbuf_emit(r, recs + first * rec_size, run * rec_size);
+    recbuf_emit(r, recs, (n - run) * rec_size);
+}
+
+ssize_t recbuf_reader_result(const recbuf_reader_t* r) {
+    return (r->status != NO_ERROR) ? r->status : (ssize_t)r->done;
+}
@@ -12,6 +12,8 @@ MODULE := $(LOCAL_DIR)
 MODULE_DEPS := \
     lib/console \
     lib/crypto \
+    lib/kprof \
+    lib/ktrace \
     lib/magenta \
     lib/user_copy \
 
@@ -5,6 +5,7 @@
 // https://opensource.org/licenses/MIT
 
 #include <err.h>
+#include <lib/ktrace.h>
 #include <lib/user_copy.h>
 
 #include <magenta/magenta.h>
@@ -68,8 +69,11 @@ extern "C" void arm_syscall_handler(struct arm_fault_frame* frame) {
     }
 
     /* call the routine */
+    get_current_thread()->syscalls++;
+    KTRACE(KTRACE_TAG_SYSCALL_ENTER, syscall_num, 0);
     ret = sfunc(frame->r[0], frame->r[1], frame->r[2], frame->r[3], frame->r[4],
                          frame->r[5], frame->r[6], frame->r[7]);
+    KTRACE(KTRACE_TAG_SYSCALL_EXIT, syscall_num, ret);
 
     LTRACEF_LEVEL(2, "ret 0x%llx\n", ret);
 
@@ -121,8 +125,11 @@ extern "C" void arm64_syscall(struct arm64_iframe_long* frame, bool is_64bit, ui
     }
 
     /* call the routine */
+    get_current_thread()->syscalls++;
+    KTRACE(KTRACE_TAG_SYSCALL_ENTER, syscall_num, 0);
     uint64_t ret = sfunc(frame->r[0], frame->r[1], frame->r[2], frame->r[3], frame->r[4],
                          frame->r[5], frame->r[6], frame->r[7]);
+    KTRACE(KTRACE_TAG_SYSCALL_EXIT, syscall_num, ret);
 
     LTRACEF_LEVEL(2, "ret 0x%llx\n", ret);
 
@@ -177,7 +184,10 @@ extern "C" uint64_t x86_64_syscall(uint64_t arg1, uint64_t arg2, uint64_t arg3,
     }
 
     /* call the routine */
+    get_current_thread()->syscalls++;
+    KTRACE(KTRACE_TAG_SYSCALL_ENTER, syscall_num, 0);
     uint64_t ret = sfunc(arg1, arg2, arg3, arg4, arg5, arg6, arg7, arg8);
+    KTRACE(KTRACE_TAG_SYSCALL_EXIT, syscall_num, ret);
 
     /* check to see if there are any pending signals */
     thread_process_pending_signals();
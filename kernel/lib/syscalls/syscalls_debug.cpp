@@ -19,6 +19,8 @@
 #include <mxtl/user_ptr.h>
 
 #include <lib/console.h>
+#include <lib/kprof.h>
+#include <lib/ktrace.h>
 #include <lib/user_copy.h>
 
 #include <lk/init.h>
@@ -34,6 +36,7 @@
 
 constexpr uint32_t kMaxDebugWriteSize = 256u;
 constexpr mx_size_t kMaxDebugReadBlock = 64 * 1024u * 1024u;
+constexpr uint32_t kMaxDebugChildren = 4096u;
 
 #if WITH_LIB_DEBUGLOG
 #include <lib/debuglog.h>
@@ -105,6 +108,78 @@ int sys_debug_send_command(mx_handle_t handle, const void* ptr, uint32_t len) {
     return console_run_script(buf);
 }
 
+mx_status_t sys_ktrace_read(mx_handle_t handle, mxtl::user_ptr<void> ptr,
+                            uint32_t offset, uint32_t len,
+                            mxtl::user_ptr<uint32_t> actual) {
+    LTRACEF("ptr %p, offset %u, len %u\n", ptr.get(), offset, len);
+
+    // TODO: finer grained validation
+    mx_status_t status;
+    if ((status = validate_resource_handle(handle)) < 0) {
+        return status;
+    }
+
+    if (!actual)
+        return ERR_INVALID_ARGS;
+
+    // With no buffer, just report how big the trace is.
+    ssize_t result = ktrace_read(ptr.get(), offset, ptr ? len : 0, true);
+    if (result < 0)
+        return static_cast<mx_status_t>(result);
+
+    if (copy_to_user_u32(actual, static_cast<uint32_t>(result)) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+    return NO_ERROR;
+}
+
+mx_status_t sys_ktrace_control(mx_handle_t handle, uint32_t action, uint32_t options) {
+    LTRACEF("action %u, options %#x\n", action, options);
+
+    // TODO: finer grained validation
+    mx_status_t status;
+    if ((status = validate_resource_handle(handle)) < 0) {
+        return status;
+    }
+
+    return ktrace_control(action, options);
+}
+
+mx_status_t sys_kprof_read(mx_handle_t handle, mxtl::user_ptr<void> ptr,
+                           uint32_t offset, uint32_t len,
+                           mxtl::user_ptr<uint32_t> actual) {
+    LTRACEF("ptr %p, offset %u, len %u\n", ptr.get(), offset, len);
+
+    // TODO: finer grained validation
+    mx_status_t status;
+    if ((status = validate_resource_handle(handle)) < 0) {
+        return status;
+    }
+
+    if (!actual)
+        return ERR_INVALID_ARGS;
+
+    // With no buffer, just report how big the profile is.
+    ssize_t result = kprof_read(ptr.get(), offset, ptr ? len : 0, true);
+    if (result < 0)
+        return static_cast<mx_status_t>(result);
+
+    if (copy_to_user_u32(actual, static_cast<uint32_t>(result)) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+    return NO_ERROR;
+}
+
+mx_status_t sys_kprof_control(mx_handle_t handle, uint32_t action, uint32_t options) {
+    LTRACEF("action %u, options %u\n", action, options);
+
+    // TODO: finer grained validation
+    mx_status_t status;
+    if ((status = validate_resource_handle(handle)) < 0) {
+        return status;
+    }
+
+    return kprof_control(action, options);
+}
+
 // Given a task (job or process), obtain a handle to that task's child
 // which has the matching koid.  For now, a handle of MX_HANDLE_INVALID
 // is the "root" handle that is the parent of processes.  This will
@@ -159,6 +234,45 @@ mx_handle_t sys_debug_task_get_child(mx_handle_t handle, uint64_t koid) {
     return ERR_WRONG_TYPE;
 }
 
+// Lists the koids of the children of a task, which can be passed to
+// sys_debug_task_get_child.  As there, MX_HANDLE_INVALID stands for the
+// root and lists every process.  Returns the number of children, which
+// may be more than |count|.
+mx_ssize_t sys_debug_task_get_children(mx_handle_t handle, mxtl::user_ptr<mx_koid_t> _koids,
+                                       uint32_t count) {
+    if (count > kMaxDebugChildren)
+        count = kMaxDebugChildren;
+
+    mxtl::unique_ptr<mx_koid_t[]> koids;
+    if (count > 0) {
+        if (!_koids)
+            return ERR_INVALID_ARGS;
+        AllocChecker ac;
+        koids.reset(new (&ac) mx_koid_t[count]);
+        if (!ac.check())
+            return ERR_NO_MEMORY;
+    }
+
+    size_t total;
+    if (handle == MX_HANDLE_INVALID) {
+        total = ProcessDispatcher::GetProcessKoids(koids.get(), count);
+    } else {
+        auto up = ProcessDispatcher::GetCurrent();
+        mxtl::RefPtr<ProcessDispatcher> process;
+        mx_status_t status = up->GetDispatcher(handle, &process, MX_RIGHT_READ);
+        if (status != NO_ERROR)
+            return status;
+        total = process->GetThreadKoids(koids.get(), count);
+    }
+
+    size_t n = MIN(total, count);
+    if (n > 0 &&
+        copy_to_user(_koids.reinterpret<uint8_t>(), koids.get(), n * sizeof(mx_koid_t)) != NO_ERROR)
+        return ERR_INVALID_ARGS;
+
+    return total;
+}
+
 mx_handle_t sys_debug_transfer_handle(mx_handle_t proc, mx_handle_t src_handle) {
     auto up = ProcessDispatcher::GetCurrent();
 
@@ -18,6 +18,7 @@
 #include <list.h>
 #include <mxtl/user_ptr.h>
 
+#include <magenta/async_wait_observer.h>
 #include <magenta/data_pipe.h>
 #include <magenta/data_pipe_consumer_dispatcher.h>
 #include <magenta/data_pipe_producer_dispatcher.h>
@@ -400,6 +401,108 @@ mx_ssize_t sys_object_get_info(mx_handle_t handle, uint32_t topic, mxtl::user_pt
 
             return sizeof(mx_process_info_t);
         }
+        case MX_INFO_THREAD_STATS: {
+            if (!_info)
+                return ERR_INVALID_ARGS;
+
+            if (info_size < sizeof(mx_thread_stats_info_t))
+                return ERR_NOT_ENOUGH_BUFFER;
+
+            auto thread = dispatcher->get_specific<ThreadDispatcher>();
+            if (!thread)
+                return ERR_WRONG_TYPE;
+
+            if (!magenta_rights_check(rights, MX_RIGHT_READ))
+                return ERR_ACCESS_DENIED;
+
+            mx_thread_stats_info_t info = {};
+            strlcpy(info.name, thread->thread()->name().data(), sizeof(info.name));
+            thread->thread()->GetStats(&info.stats);
+
+            if (copy_to_user(_info.reinterpret<uint8_t>(), &info, sizeof(info)) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+
+            return sizeof(mx_thread_stats_info_t);
+        }
+        case MX_INFO_PROCESS_STATS: {
+            if (!_info)
+                return ERR_INVALID_ARGS;
+
+            if (info_size < sizeof(mx_process_stats_info_t))
+                return ERR_NOT_ENOUGH_BUFFER;
+
+            auto process = dispatcher->get_specific<ProcessDispatcher>();
+            if (!process)
+                return ERR_WRONG_TYPE;
+
+            if (!magenta_rights_check(rights, MX_RIGHT_READ))
+                return ERR_ACCESS_DENIED;
+
+            mx_process_stats_info_t info;
+            auto err = process->GetStats(&info);
+            if (err != NO_ERROR)
+                return err;
+
+            if (copy_to_user(_info.reinterpret<uint8_t>(), &info, sizeof(info)) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+
+            return sizeof(mx_process_stats_info_t);
+        }
+        case MX_INFO_PROCESS_MEMORY: {
+            if (!_info)
+                return ERR_INVALID_ARGS;
+
+            if (info_size < sizeof(mx_process_memory_info_t))
+                return ERR_NOT_ENOUGH_BUFFER;
+
+            auto process = dispatcher->get_specific<ProcessDispatcher>();
+            if (!process)
+                return ERR_WRONG_TYPE;
+
+            if (!magenta_rights_check(rights, MX_RIGHT_READ))
+                return ERR_ACCESS_DENIED;
+
+            mx_process_memory_info_t info;
+            auto err = process->GetMemoryInfo(&info);
+            if (err != NO_ERROR)
+                return err;
+
+            if (copy_to_user(_info.reinterpret<uint8_t>(), &info, sizeof(info)) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+
+            return sizeof(mx_process_memory_info_t);
+        }
+        case MX_INFO_LOCK_STATS: {
+            if (!_info)
+                return ERR_INVALID_ARGS;
+
+            auto resource = dispatcher->get_specific<ResourceDispatcher>();
+            if (!resource)
+                return ERR_WRONG_TYPE;
+
+            if (!magenta_rights_check(rights, MX_RIGHT_READ))
+                return ERR_ACCESS_DENIED;
+
+#if WITH_LOCK_STATS
+            size_t max = MIN(info_size / sizeof(mx_lock_stats_t), (size_t)LOCKSTAT_MAX_SITES);
+            if (max == 0)
+                return ERR_NOT_ENOUGH_BUFFER;
+
+            AllocChecker ac;
+            mxtl::unique_ptr<mx_lock_stats_t[]> stats(new (&ac) mx_lock_stats_t[max]);
+            if (!ac.check())
+                return ERR_NO_MEMORY;
+
+            size_t count = lockstat_read(stats.get(), max);
+            size_t bytes = count * sizeof(mx_lock_stats_t);
+            if (copy_to_user(_info.reinterpret<uint8_t>(), stats.get(), bytes) != NO_ERROR)
+                return ERR_INVALID_ARGS;
+
+            return bytes;
+#else
+            return ERR_NOT_SUPPORTED;
+#endif
+        }
         default:
             return ERR_INVALID_ARGS;
     }
@@ -476,12 +579,13 @@ mx_status_t sys_object_set_property(mx_handle_t handle_value, uint32_t property,
     return status;
 }
 
-mx_status_t sys_msgpipe_read(mx_handle_t handle_value, mxtl::user_ptr<void> _bytes,
-                             mxtl::user_ptr<uint32_t> _num_bytes, mxtl::user_ptr<mx_handle_t> _handles,
-                             mxtl::user_ptr<uint32_t> _num_handles, uint32_t flags) {
-    LTRACEF("handle %d bytes %p num_bytes %p handles %p num_handles %p flags 0x%x\n",
-            handle_value, _bytes.get(), _num_bytes.get(), _handles.get(), _num_handles.get(), flags);
-
+// Shared by msgpipe_read and msgpipe_readv. The message bytes are scattered into the
+// |iov_count| user buffers in |iov|, which together hold |capacity| bytes.
+static mx_status_t msgpipe_read(mx_handle_t handle_value,
+                                const mx_iovec_t* iov, uint32_t iov_count, uint32_t capacity,
+                                mxtl::user_ptr<uint32_t> _num_bytes,
+                                mxtl::user_ptr<mx_handle_t> _handles,
+                                mxtl::user_ptr<uint32_t> _num_handles) {
     auto up = ProcessDispatcher::GetCurrent();
 
     mxtl::RefPtr<MessagePipeDispatcher> msg_pipe;
@@ -490,21 +594,13 @@ mx_status_t sys_msgpipe_read(mx_handle_t handle_value, mxtl::user_ptr<void> _byt
     if (status != NO_ERROR)
         return status;
 
-    uint32_t num_bytes = 0;
     uint32_t num_handles = 0;
 
-    if (_num_bytes) {
-        if (copy_from_user_u32(&num_bytes, _num_bytes) != NO_ERROR)
-            return ERR_INVALID_ARGS;
-    }
-
     if (_num_handles) {
         if (copy_from_user_u32(&num_handles, _num_handles) != NO_ERROR)
             return ERR_INVALID_ARGS;
     }
 
-    if (_bytes != 0u && !_num_bytes)
-        return ERR_INVALID_ARGS;
     if (_handles != 0u && !_num_handles)
         return ERR_INVALID_ARGS;
 
@@ -534,7 +630,7 @@ mx_status_t sys_msgpipe_read(mx_handle_t handle_value, mxtl::user_ptr<void> _byt
     }
 
     // If the caller provided buffers are too small, abort the read so the caller can try again.
-    if (num_bytes < next_message_size || num_handles < next_message_num_handles)
+    if (capacity < next_message_size || num_handles < next_message_num_handles)
         return ERR_NOT_ENOUGH_BUFFER;
 
     // OK, now we can accept the message.
@@ -543,8 +639,8 @@ mx_status_t sys_msgpipe_read(mx_handle_t handle_value, mxtl::user_ptr<void> _byt
 
     result = msg_pipe->AcceptRead(&bytes, &handle_list);
 
-    if (_bytes) {
-        if (copy_to_user(_bytes.reinterpret<uint8_t>(), bytes.get(), num_bytes) != NO_ERROR) {
+    if (iov_count) {
+        if (magenta_scatter_user_iovec(iov, iov_count, bytes.get(), next_message_size) != NO_ERROR) {
             // $$$ free handles.
             return ERR_INVALID_ARGS;
         }
@@ -570,11 +666,49 @@ mx_status_t sys_msgpipe_read(mx_handle_t handle_value, mxtl::user_ptr<void> _byt
     return result;
 }
 
-mx_status_t sys_msgpipe_write(mx_handle_t handle_value, mxtl::user_ptr<const void> _bytes, uint32_t num_bytes,
-                              mxtl::user_ptr<const mx_handle_t> _handles, uint32_t num_handles, uint32_t flags) {
-    LTRACEF("handle %d bytes %p num_bytes %u handles %p num_handles %u flags 0x%x\n",
-            handle_value, _bytes.get(), num_bytes, _handles.get(), num_handles, flags);
+mx_status_t sys_msgpipe_read(mx_handle_t handle_value, mxtl::user_ptr<void> _bytes,
+                             mxtl::user_ptr<uint32_t> _num_bytes, mxtl::user_ptr<mx_handle_t> _handles,
+                             mxtl::user_ptr<uint32_t> _num_handles, uint32_t flags) {
+    LTRACEF("handle %d bytes %p num_bytes %p handles %p num_handles %p flags 0x%x\n",
+            handle_value, _bytes.get(), _num_bytes.get(), _handles.get(), _num_handles.get(), flags);
+
+    uint32_t num_bytes = 0;
+
+    if (_num_bytes) {
+        if (copy_from_user_u32(&num_bytes, _num_bytes) != NO_ERROR)
+            return ERR_INVALID_ARGS;
+    }
 
+    if (_bytes != 0u && !_num_bytes)
+        return ERR_INVALID_ARGS;
+
+    mx_iovec_t iov = {_bytes.get(), num_bytes};
+    return msgpipe_read(handle_value, &iov, _bytes ? 1u : 0u, num_bytes,
+                        _num_bytes, _handles, _num_handles);
+}
+
+mx_status_t sys_msgpipe_readv(mx_handle_t handle_value, const mx_iovec_t* _iov, uint32_t iov_count,
+                              mxtl::user_ptr<uint32_t> _num_bytes, mxtl::user_ptr<mx_handle_t> _handles,
+                              mxtl::user_ptr<uint32_t> _num_handles, uint32_t flags) {
+    LTRACEF("handle %d iov_count %u num_bytes %p handles %p num_handles %p flags 0x%x\n",
+            handle_value, iov_count, _num_bytes.get(), _handles.get(), _num_handles.get(), flags);
+
+    mx_iovec_t iov[MX_IOVEC_MAX];
+    mx_size_t total;
+    mx_status_t status = magenta_copy_user_iovec(_iov, iov_count, iov, &total);
+    if (status != NO_ERROR)
+        return status;
+
+    // Space beyond the largest possible message is never used.
+    uint32_t capacity = static_cast<uint32_t>(MIN(total, kMaxMessageSize));
+    return msgpipe_read(handle_value, iov, iov_count, capacity,
+                        _num_bytes, _handles, _num_handles);
+}
+
+// Shared by msgpipe_write and msgpipe_writev once the message bytes have been
+// copied in. Validates and transfers the handles, then queues the message.
+static mx_status_t msgpipe_write(mx_handle_t handle_value, mxtl::Array<uint8_t> bytes,
+                                 mxtl::user_ptr<const mx_handle_t> _handles, uint32_t num_handles) {
     auto up = ProcessDispatcher::GetCurrent();
 
     mxtl::RefPtr<MessagePipeDispatcher> msg_pipe;
@@ -585,26 +719,13 @@ mx_status_t sys_msgpipe_write(mx_handle_t handle_value, mxtl::user_ptr<const voi
 
     bool is_reply_pipe = msg_pipe->is_reply_pipe();
 
-    if (num_bytes != 0u && !_bytes)
-        return ERR_INVALID_ARGS;
     if (num_handles != 0u && !_handles)
         return ERR_INVALID_ARGS;
 
-    if (num_bytes > kMaxMessageSize)
-        return ERR_TOO_BIG;
     if (num_handles > kMaxMessageHandles)
         return ERR_TOO_BIG;
 
     status_t result;
-    mxtl::Array<uint8_t> bytes;
-
-    if (num_bytes) {
-        void* copy;
-        result = magenta_copy_user_dynamic(_bytes.get(), &copy, num_bytes, kMaxMessageSize);
-        if (result != NO_ERROR)
-            return result;
-        bytes.reset(reinterpret_cast<uint8_t*>(copy), num_bytes);
-    }
 
     mxtl::unique_ptr<mx_handle_t[], mxtl::free_delete> handles;
     if (num_handles) {
@@ -687,6 +808,63 @@ mx_status_t sys_msgpipe_write(mx_handle_t handle_value, mxtl::user_ptr<const voi
     return result;
 }
 
+mx_status_t sys_msgpipe_write(mx_handle_t handle_value, mxtl::user_ptr<const void> _bytes, uint32_t num_bytes,
+                              mxtl::user_ptr<const mx_handle_t> _handles, uint32_t num_handles, uint32_t flags) {
+    LTRACEF("handle %d bytes %p num_bytes %u handles %p num_handles %u flags 0x%x\n",
+            handle_value, _bytes.get(), num_bytes, _handles.get(), num_handles, flags);
+
+    if (num_bytes != 0u && !_bytes)
+        return ERR_INVALID_ARGS;
+
+    if (num_bytes > kMaxMessageSize)
+        return ERR_TOO_BIG;
+
+    mxtl::Array<uint8_t> bytes;
+
+    if (num_bytes) {
+        void* copy;
+        status_t result = magenta_copy_user_dynamic(_bytes.get(), &copy, num_bytes, kMaxMessageSize);
+        if (result != NO_ERROR)
+            return result;
+        bytes.reset(reinterpret_cast<uint8_t*>(copy), num_bytes);
+    }
+
+    return msgpipe_write(handle_value, mxtl::move(bytes), _handles, num_handles);
+}
+
+mx_status_t sys_msgpipe_writev(mx_handle_t handle_value, const mx_iovec_t* _iov, uint32_t iov_count,
+                               mxtl::user_ptr<const mx_handle_t> _handles, uint32_t num_handles,
+                               uint32_t flags) {
+    LTRACEF("handle %d iov_count %u handles %p num_handles %u flags 0x%x\n",
+            handle_value, iov_count, _handles.get(), num_handles, flags);
+
+    mx_iovec_t iov[MX_IOVEC_MAX];
+    mx_size_t total;
+    mx_status_t status = magenta_copy_user_iovec(_iov, iov_count, iov, &total);
+    if (status != NO_ERROR)
+        return status;
+
+    if (total > kMaxMessageSize)
+        return ERR_TOO_BIG;
+
+    // Gather the segments straight into the message buffer.
+    mxtl::Array<uint8_t> bytes;
+
+    if (total) {
+        AllocChecker ac;
+        uint8_t* copy = new (&ac) uint8_t[total];
+        if (!ac.check())
+            return ERR_NO_MEMORY;
+        bytes.reset(copy, total);
+
+        status = magenta_gather_user_iovec(iov, iov_count, copy, total);
+        if (status != NO_ERROR)
+            return status;
+    }
+
+    return msgpipe_write(handle_value, mxtl::move(bytes), _handles, num_handles);
+}
+
 mx_status_t sys_msgpipe_create(mxtl::user_ptr<mx_handle_t> out_handle /* array of size 2 */,
                                uint32_t flags) {
     LTRACEF("entry out_handle[] %p\n", out_handle.get());
@@ -981,6 +1159,7 @@ mx_handle_t sys_vmo_create(uint64_t size) {
     mxtl::RefPtr<VmObject> vmo = VmObject::Create(0, size);
     if (!vmo)
         return ERR_NO_MEMORY;
+    vmo->set_anonymous();
 
     // create a Vm Object dispatcher
     mxtl::RefPtr<Dispatcher> dispatcher;
@@ -1032,6 +1211,74 @@ mx_ssize_t sys_vmo_write(mx_handle_t handle, const void* data, uint64_t offset,
     return vmo->Write(data, len, offset);
 }
 
+mx_ssize_t sys_vmo_readv(mx_handle_t handle, const mx_iovec_t* _iov, uint32_t iov_count,
+                         uint64_t offset) {
+    LTRACEF("handle %d, iov_count %u, offset 0x%llx\n", handle, iov_count, offset);
+
+    mx_iovec_t iov[MX_IOVEC_MAX];
+    mx_size_t total;
+    mx_status_t status = magenta_copy_user_iovec(_iov, iov_count, iov, &total);
+    if (status != NO_ERROR)
+        return status;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // lookup the dispatcher from handle
+    mxtl::RefPtr<VmObjectDispatcher> vmo;
+    status = up->GetDispatcher(handle, &vmo, MX_RIGHT_READ);
+    if (status != NO_ERROR)
+        return status;
+
+    // scatter consecutive ranges of the object, stopping at the end of it
+    mx_ssize_t count = 0;
+    for (uint32_t i = 0; i < iov_count; ++i) {
+        if (iov[i].len == 0u)
+            continue;
+        mx_ssize_t r = vmo->Read(iov[i].base, iov[i].len, offset);
+        if (r < 0)
+            return count ? count : r;
+        count += r;
+        offset += r;
+        if (static_cast<mx_size_t>(r) < iov[i].len)
+            break;
+    }
+    return count;
+}
+
+mx_ssize_t sys_vmo_writev(mx_handle_t handle, const mx_iovec_t* _iov, uint32_t iov_count,
+                          uint64_t offset) {
+    LTRACEF("handle %d, iov_count %u, offset 0x%llx\n", handle, iov_count, offset);
+
+    mx_iovec_t iov[MX_IOVEC_MAX];
+    mx_size_t total;
+    mx_status_t status = magenta_copy_user_iovec(_iov, iov_count, iov, &total);
+    if (status != NO_ERROR)
+        return status;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // lookup the dispatcher from handle
+    mxtl::RefPtr<VmObjectDispatcher> vmo;
+    status = up->GetDispatcher(handle, &vmo, MX_RIGHT_WRITE);
+    if (status != NO_ERROR)
+        return status;
+
+    // gather into consecutive ranges of the object, stopping at the end of it
+    mx_ssize_t count = 0;
+    for (uint32_t i = 0; i < iov_count; ++i) {
+        if (iov[i].len == 0u)
+            continue;
+        mx_ssize_t r = vmo->Write(iov[i].base, iov[i].len, offset);
+        if (r < 0)
+            return count ? count : r;
+        count += r;
+        offset += r;
+        if (static_cast<mx_size_t>(r) < iov[i].len)
+            break;
+    }
+    return count;
+}
+
 mx_status_t sys_vmo_get_size(mx_handle_t handle, mxtl::user_ptr<uint64_t> _size) {
     LTRACEF("handle %d, sizep %p\n", handle, _size.get());
 
@@ -1071,6 +1318,51 @@ mx_status_t sys_vmo_set_size(mx_handle_t handle, uint64_t size) {
     return vmo->SetSize(size);
 }
 
+mx_status_t sys_vmo_op_range(mx_handle_t handle, uint32_t op, uint64_t offset, uint64_t size,
+                             mxtl::user_ptr<void> buffer, mx_size_t buffer_size) {
+    LTRACEF("handle %d op %u offset 0x%llx size 0x%llx buffer %p buffer_size %zu\n",
+            handle, op, offset, size, buffer.get(), buffer_size);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    // lookup the dispatcher from handle; which rights are needed depends on the op
+    mxtl::RefPtr<VmObjectDispatcher> vmo;
+    mx_rights_t rights;
+    mx_status_t status = up->GetDispatcher(handle, &vmo, &rights);
+    if (status != NO_ERROR)
+        return status;
+
+    return vmo->RangeOp(op, offset, size, buffer, buffer_size, rights);
+}
+
+mx_handle_t sys_system_get_event(uint32_t kind) {
+    LTRACEF("kind %u\n", kind);
+
+    mxtl::RefPtr<Dispatcher> event;
+    switch (kind) {
+    case MX_SYSTEM_EVENT_MEMORY_PRESSURE:
+        event = GetMemoryPressureEvent();
+        break;
+    default:
+        return ERR_INVALID_ARGS;
+    }
+    if (!event)
+        return ERR_NOT_SUPPORTED;
+
+    // the kernel owns the signals; holders may only wait on them
+    HandleUniquePtr handle(MakeHandle(mxtl::move(event),
+                                      MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER | MX_RIGHT_READ));
+    if (!handle)
+        return ERR_NO_MEMORY;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mx_handle_t hv = up->MapHandleToValue(handle.get());
+    up->AddHandle(mxtl::move(handle));
+
+    return hv;
+}
+
 mx_status_t sys_process_map_vm(mx_handle_t proc_handle, mx_handle_t vmo_handle,
                                uint64_t offset, mx_size_t len, mxtl::user_ptr<uintptr_t> user_ptr,
                                uint32_t flags) {
@@ -1330,6 +1622,61 @@ mx_status_t sys_port_bind(mx_handle_t handle, uint64_t key, mx_handle_t source,
     return msg_pipe->SetIOPort(mxtl::move(ioport), key, signals);
  }
 
+mx_status_t sys_object_wait_async(mx_handle_t handle_value, mx_handle_t port_handle,
+                                  uint64_t key, mx_signals_t signals, uint32_t options) {
+    LTRACEF("handle %d port %d signals 0x%x options 0x%x\n",
+            handle_value, port_handle, signals, options);
+
+    if (!signals)
+        return ERR_INVALID_ARGS;
+    if (options & ~MX_WAIT_ASYNC_REPEATING)
+        return ERR_INVALID_ARGS;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<IOPortDispatcher> ioport;
+    mx_status_t status = up->GetDispatcher(port_handle, &ioport, MX_RIGHT_WRITE);
+    if (status != NO_ERROR)
+        return status;
+
+    // The handle table lock keeps |handle| alive until the observer is attached; after that
+    // closing the handle cancels the wait.
+    AutoLock lock(up->handle_table_lock());
+
+    Handle* handle = up->GetHandle_NoLock(handle_value);
+    if (!handle)
+        return up->BadHandle(handle_value, ERR_BAD_HANDLE);
+    if (!magenta_rights_check(handle->rights(), MX_RIGHT_READ))
+        return up->BadHandle(handle_value, ERR_ACCESS_DENIED);
+
+    return AsyncWaitObserver::Create(handle, mxtl::move(ioport), key, signals,
+                                     (options & MX_WAIT_ASYNC_REPEATING) != 0u);
+}
+
+mx_status_t sys_object_wait_cancel(mx_handle_t handle_value, mx_handle_t port_handle,
+                                   uint64_t key) {
+    LTRACEF("handle %d port %d\n", handle_value, port_handle);
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<IOPortDispatcher> ioport;
+    mx_status_t status = up->GetDispatcher(port_handle, &ioport, MX_RIGHT_WRITE);
+    if (status != NO_ERROR)
+        return status;
+
+    AutoLock lock(up->handle_table_lock());
+
+    Handle* handle = up->GetHandle_NoLock(handle_value);
+    if (!handle)
+        return up->BadHandle(handle_value, ERR_BAD_HANDLE);
+
+    auto state_tracker = handle->dispatcher()->get_state_tracker();
+    if (!state_tracker)
+        return ERR_NOT_FOUND;
+
+    return state_tracker->CancelAsyncWait(handle, ioport.get(), key);
+}
+
 // TODO(vtl): _consumer_handle should presumably be an mxtl::user_ptr instead. Also, do we want to
 // provide the producer handle as an out parameter (possibly in the same way as in msgpipe_create,
 // instead of overloading the return value)?
@@ -1405,6 +1752,42 @@ mx_ssize_t sys_datapipe_write(mx_handle_t producer_handle, uint32_t flags, mx_si
     return written;
 }
 
+mx_ssize_t sys_datapipe_writev(mx_handle_t producer_handle, uint32_t flags,
+                               const mx_iovec_t* _iov, uint32_t iov_count) {
+    LTRACEF("handle %d iov_count %u\n", producer_handle, iov_count);
+
+    mx_iovec_t iov[MX_IOVEC_MAX];
+    mx_size_t total;
+    mx_status_t status = magenta_copy_user_iovec(_iov, iov_count, iov, &total);
+    if (status != NO_ERROR)
+        return status;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<DataPipeProducerDispatcher> producer;
+    status = up->GetDispatcher(producer_handle, &producer, MX_RIGHT_WRITE);
+    if (status != NO_ERROR)
+        return status;
+
+    // TODO(vtl): Handle write flags.
+
+    // Each segment must be a whole number of elements. Stop at the first short
+    // write, since the pipe is then full.
+    mx_ssize_t count = 0;
+    for (uint32_t i = 0; i < iov_count; ++i) {
+        if (iov[i].len == 0u)
+            continue;
+        mx_size_t written = iov[i].len;
+        status = producer->Write(iov[i].base, &written);
+        if (status < 0)
+            return count ? count : status;
+        count += written;
+        if (written < iov[i].len)
+            break;
+    }
+    return count;
+}
+
 mx_ssize_t sys_datapipe_read(mx_handle_t consumer_handle, uint32_t flags, mx_size_t requested,
                              void* _buffer) {
     LTRACEF("handle %d\n", consumer_handle);
@@ -1683,9 +2066,6 @@ mx_status_t sys_socket_create(mx_handle_t out_handle[2], uint32_t flags) {
     if (!out_handle)
         return ERR_INVALID_ARGS;
 
-    if (flags != 0u)
-        return ERR_INVALID_ARGS;
-
     mxtl::RefPtr<Dispatcher> socket0, socket1;
     mx_rights_t rights;
     status_t result = SocketDispatcher::Create(flags, &socket0, &socket1, &rights);
@@ -1726,9 +2106,37 @@ mx_ssize_t sys_socket_write(mx_handle_t handle, uint32_t flags,
     if (status != NO_ERROR)
         return status;
 
-    return flags == MX_SOCKET_CONTROL?
-        socket->OOB_Write(_buffer, size, true) :
-        socket->Write(_buffer, size, true);
+    if (flags == MX_SOCKET_CONTROL)
+        return socket->OOB_Write(_buffer, size, true);
+
+    if (flags & ~MX_SOCKET_MOVE_PAGES)
+        return ERR_INVALID_ARGS;
+
+    mx_iovec_t iov = {const_cast<void*>(_buffer), size};
+    return socket->WriteV(&iov, 1u, flags);
+}
+
+mx_ssize_t sys_socket_writev(mx_handle_t handle, uint32_t flags,
+                             const mx_iovec_t* _iov, uint32_t iov_count) {
+    LTRACEF("handle %d iov_count %u\n", handle, iov_count);
+
+    if (flags & ~MX_SOCKET_MOVE_PAGES)
+        return ERR_INVALID_ARGS;
+
+    mx_iovec_t iov[MX_IOVEC_MAX];
+    mx_size_t total;
+    mx_status_t status = magenta_copy_user_iovec(_iov, iov_count, iov, &total);
+    if (status != NO_ERROR)
+        return status;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<SocketDispatcher> socket;
+    status = up->GetDispatcher(handle, &socket, MX_RIGHT_WRITE);
+    if (status != NO_ERROR)
+        return status;
+
+    return socket->WriteV(iov, iov_count, flags);
 }
 
 mx_ssize_t sys_socket_read(mx_handle_t handle, uint32_t flags,
@@ -1749,3 +2157,26 @@ mx_ssize_t sys_socket_read(mx_handle_t handle, uint32_t flags,
         socket->OOB_Read(_buffer, size, true) :
         socket->Read(_buffer, size, true);
 }
+
+mx_ssize_t sys_socket_readv(mx_handle_t handle, uint32_t flags,
+                            const mx_iovec_t* _iov, uint32_t iov_count) {
+    LTRACEF("handle %d iov_count %u\n", handle, iov_count);
+
+    if (flags != 0u)
+        return ERR_INVALID_ARGS;
+
+    mx_iovec_t iov[MX_IOVEC_MAX];
+    mx_size_t total;
+    mx_status_t status = magenta_copy_user_iovec(_iov, iov_count, iov, &total);
+    if (status != NO_ERROR)
+        return status;
+
+    auto up = ProcessDispatcher::GetCurrent();
+
+    mxtl::RefPtr<SocketDispatcher> socket;
+    status = up->GetDispatcher(handle, &socket, MX_RIGHT_READ);
+    if (status != NO_ERROR)
+        return status;
+
+    return socket->ReadV(iov, iov_count);
+}
@@ -24,6 +24,7 @@
 #include <magenta/resource_dispatcher.h>
 #include <magenta/stack.h>
 #include <magenta/thread_dispatcher.h>
+#include <magenta/vdso-data.h>
 #include <magenta/vm_object_dispatcher.h>
 
 #include "code-start.h"
@@ -77,6 +78,45 @@ static mxtl::RefPtr<VmObject> make_vmo_from_memory(const void* data,
     return vmo;
 }
 
+// Fill in the vDSO's data page, which user mode reads in place of making
+// some syscalls.  The page is one of the kernel's own image pages, now
+// also part of vdso_vmo, so every process mapping the vDSO sees it.  The
+// kernel's mapping of its image is read-only, so write it through the
+// physical map instead.
+static void update_vdso_data() {
+    static_assert(VDSO_DATA_START % PAGE_SIZE == 0,
+                  "vDSO data must be page-aligned");
+    static_assert(VDSO_DATA_START + sizeof(vdso_data_page) <= VDSO_CODE_START,
+                  "vDSO data must be in its read-only segment");
+    static_assert(sizeof(vdso_data_page) == PAGE_SIZE,
+                  "vDSO data must fill exactly one page");
+
+    paddr_t pa = vaddr_to_paddr(vdso_image + VDSO_DATA_START);
+    ASSERT(pa != 0);
+    auto data = reinterpret_cast<vdso_data*>(paddr_to_kvaddr(pa));
+    ASSERT(data);
+
+    uint64_t mult;
+    uint32_t shift;
+    bool usermode_counter = platform_usermode_counter(&mult, &shift);
+
+    // Readers retry while seq is odd or if it changed under them.
+    vdso_time_data* time = &data->time;
+    time->seq = time->seq + 1;
+    smp_wmb();
+    time->flags = usermode_counter ? VDSO_TIME_USERMODE_COUNTER : 0;
+    time->ticks_to_ns_mult = usermode_counter ? mult : 0;
+    time->ticks_to_ns_shift = usermode_counter ? shift : 0;
+    time->base_ticks = 0;
+    time->base_ns = 0;
+    data->version = VDSO_DATA_VERSION;
+    smp_wmb();
+    time->seq = time->seq + 1;
+
+    dprintf(SPEW, "userboot: vDSO clock %s\n",
+            usermode_counter ? "reads the counter directly" : "uses syscall");
+}
+
 // Get a handle to a VM object, with full rights except perhaps for writing.
 static mx_status_t get_vmo_handle(mxtl::RefPtr<VmObject> vmo, bool readonly,
                                   mxtl::RefPtr<VmObjectDispatcher>* disp_ptr,
@@ -286,6 +326,8 @@ static int attempt_userboot(const void* bootfs, size_t bfslen) {
     if (!vdso_vmo || !userboot_vmo || !stack_vmo)
         return ERR_NO_MEMORY;
 
+    update_vdso_data();
+
     HandleUniquePtr handles[BOOTSTRAP_HANDLES];
     bootfs_vmo = make_vmo_from_memory(bootfs, bfslen);
     mx_status_t status = get_vmo_handle(bootfs_vmo, false, NULL,
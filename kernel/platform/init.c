@@ -35,3 +35,9 @@ __WEAK void *platform_get_ramdisk(size_t *size)
     *size = 0;
     return NULL;
 }
+
+__WEAK bool platform_usermode_counter(uint64_t *ticks_to_ns_mult,
+                                      uint32_t *ticks_to_ns_shift)
+{
+    return false;
+}
@@ -105,6 +105,19 @@ lk_bigtime_t current_time_hires(void)
     return time;
 }
 
+bool platform_usermode_counter(uint64_t *ticks_to_ns_mult,
+                               uint32_t *ticks_to_ns_shift)
+{
+    if (!invariant_tsc)
+        return false;
+
+    // Use the same divisor as current_time_hires() so that the two
+    // agree to within its microsecond granularity.
+    *ticks_to_ns_mult = (1000ULL << 32) / (tsc_ticks_per_ms / 1000);
+    *ticks_to_ns_shift = 32;
+    return true;
+}
+
 // The PIT timer will keep track of wall time if we aren't using the TSC
 static enum handler_return pit_timer_tick(void *arg)
 {
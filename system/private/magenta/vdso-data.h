@@ -0,0 +1,51 @@
+// Copyright 2016 The Fuchsia Authors
+//
+// Use of this source code is governed by a MIT-style
+// license that can be found in the LICENSE file or at
+// https://opensource.org/licenses/MIT
+
+#pragma once
+
+#include <stdint.h>
+
+// The vDSO image reserves one page of its read-only segment (the
+// .vdso_data section, located by the DATA_START symbol) for this
+// structure.  The kernel fills it in through its own mapping of the
+// physical page; every process sees it through its mapping of the vDSO.
+//
+// Readers follow the usual seqlock protocol: read seq, read the fields,
+// then read seq again, and retry if it was odd or changed.  The kernel
+// makes seq odd while it is rewriting the fields.
+
+#define VDSO_DATA_VERSION 1
+
+// Set in flags when user mode can read the counter and compute the time
+// itself.  When it is clear, mx_current_time() makes the syscall.
+#define VDSO_TIME_USERMODE_COUNTER (1u << 0)
+
+struct vdso_time_data {
+    volatile uint32_t seq;
+    uint32_t flags;
+
+    // current_time in nanoseconds is
+    //     base_ns + (((counter - base_ticks) * ticks_to_ns_mult) >> ticks_to_ns_shift)
+    // where the product is computed with 128 bits of precision.
+    uint64_t ticks_to_ns_mult;
+    uint32_t ticks_to_ns_shift;
+    uint32_t reserved;
+    uint64_t base_ticks;
+    uint64_t base_ns;
+};
+
+struct vdso_data {
+    uint32_t version;
+    uint32_t reserved;
+    struct vdso_time_data time;
+};
+
+// The vDSO's .vdso_data section holds exactly one of these, so the page
+// is its own on every architecture.
+union vdso_data_page {
+    struct vdso_data data;
+    char page[4096];
+};
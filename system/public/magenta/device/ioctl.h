@@ -18,6 +18,7 @@
 #define IOCTL_FAMILY_RESERVED       0x00
 #define IOCTL_FAMILY_DEVICE         0x01
 #define IOCTL_FAMILY_DEVMGR         0x02
+#define IOCTL_FAMILY_VFS            0x03
 
 // device protocol families
 #define IOCTL_FAMILY_CONSOLE        0x10
@@ -28,6 +29,8 @@
 #define IOCTL_FAMILY_TPM            0x15
 #define IOCTL_FAMILY_USB            0x16
 #define IOCTL_FAMILY_HID            0x17
+#define IOCTL_FAMILY_KTRACE         0x18
+#define IOCTL_FAMILY_KPROF          0x19
 
 // IOCTL constructor
 // --K-FFNN
@@ -0,0 +1,18 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <magenta/device/ioctl.h>
+
+// Reading /dev/kprof returns the last profile in the format described in
+// <magenta/kprof.h>.
+
+// in: uint32_t samples per second, or 0 for the default
+// Discards the previous profile.
+#define IOCTL_KPROF_START \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_KPROF, 1)
+
+#define IOCTL_KPROF_STOP \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_KPROF, 2)
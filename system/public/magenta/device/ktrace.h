@@ -0,0 +1,21 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <magenta/device/ioctl.h>
+
+// Reading /dev/ktrace returns the kernel trace in the format described in
+// <magenta/ktrace.h>.
+
+// in: uint32_t mask of KTRACE_GRP_* to enable
+#define IOCTL_KTRACE_START \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_KTRACE, 1)
+
+#define IOCTL_KTRACE_STOP \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_KTRACE, 2)
+
+// Discards all records; tracing must be stopped.
+#define IOCTL_KTRACE_REWIND \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_KTRACE, 3)
@@ -0,0 +1,39 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <magenta/device/ioctl.h>
+#include <stdint.h>
+
+// out: vfs_cache_info_t
+#define IOCTL_VFS_GET_CACHE_INFO \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_VFS, 1)
+
+// in: vfs_allocate_t
+#define IOCTL_VFS_ALLOCATE \
+    IOCTL(IOCTL_KIND_DEFAULT, IOCTL_FAMILY_VFS, 2)
+
+// Allocate storage for a range of a file, growing the file if the
+// range goes past its end.  Parts of the range not written before
+// read back as zeros.
+typedef struct vfs_allocate {
+    uint64_t offset;
+    uint64_t length;
+} vfs_allocate_t;
+
+typedef struct vfs_cache_info {
+    uint64_t hits;          // lookups satisfied from the cache
+    uint64_t misses;        // lookups that read from the device
+    uint64_t writes;        // dirty blocks written back
+    uint32_t block_size;
+    uint32_t blocks;        // blocks currently allocated
+    uint32_t target;        // blocks the cache is allowed to hold now
+    uint32_t limit;         // blocks allowed without memory pressure
+    uint32_t dirty;         // blocks waiting to be written back
+    uint32_t logged;        // blocks in the journal, not yet written back
+    uint64_t commits;       // journal records written
+    uint64_t logged_writes; // blocks written to the journal
+    uint64_t read_ahead;    // blocks read before they were looked up
+} vfs_cache_info_t;
@@ -0,0 +1,64 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ask clang format not to mess up the indentation:
+// clang-format off
+
+// Sampling profile format, as returned by mx_kprof_read().
+//
+// The data starts with a kprof_header_t, followed by header.num_cpus
+// runs of kprof_sample_t, one per CPU, in the order they were taken.
+// header.cpu_samples[] gives the length of each run.
+
+#define KPROF_MAGIC             0x4b50524fu   // "KPRO"
+#define KPROF_VERSION           1u
+#define KPROF_MAX_CPUS          32
+#define KPROF_MAX_FRAMES        30
+
+#define KPROF_DEFAULT_HZ        1000u
+#define KPROF_MAX_HZ            1000u
+
+// Set in kprof_sample_t.flags when the cpu was interrupted in user mode,
+// in which case the frames are user addresses.
+#define KPROF_SAMPLE_USER       (1u << 0)
+
+typedef struct kprof_sample {
+    uint32_t cpu;
+    uint16_t flags;
+    uint16_t num_frames;
+    // Koids of the interrupted process and thread.  For kernel threads
+    // pid is zero and tid is the kernel thread's address.
+    uint64_t pid;
+    uint64_t tid;
+    // The interrupted pc, followed by the return addresses found by
+    // following the frame pointer chain, innermost first.
+    uint64_t frames[KPROF_MAX_FRAMES];
+} kprof_sample_t;
+
+typedef struct kprof_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t sample_size;
+    uint32_t num_cpus;
+    uint32_t hz;
+    // Samples that did not fit in the buffers.
+    uint32_t dropped;
+    uint32_t cpu_samples[KPROF_MAX_CPUS];
+} kprof_header_t;
+
+// Actions for mx_kprof_control().
+#define KPROF_ACTION_START      1u  // options: samples per second, or 0 for the default
+#define KPROF_ACTION_STOP       2u
+
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,78 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#pragma once
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// ask clang format not to mess up the indentation:
+// clang-format off
+
+// Binary kernel trace format, as returned by mx_ktrace_read().
+//
+// The data starts with a ktrace_header_t, followed by header.num_cpus
+// runs of ktrace_record_t, one per CPU.  Each run holds that CPU's
+// records oldest first; header.cpu_records[] gives the length of each.
+// Timestamps are raw counter values; nanoseconds are
+// (ts * ticks_to_ns_mult) >> ticks_to_ns_shift.
+
+#define KTRACE_MAGIC            0x4b545243u   // "KTRC"
+#define KTRACE_VERSION          1u
+#define KTRACE_MAX_CPUS         32
+
+// Groups of probes, enabled with mx_ktrace_control(KTRACE_ACTION_START).
+#define KTRACE_GRP_SCHED        (1u << 0)
+#define KTRACE_GRP_SYSCALL      (1u << 1)
+#define KTRACE_GRP_IRQ          (1u << 2)
+#define KTRACE_GRP_VM           (1u << 3)
+#define KTRACE_GRP_IPC          (1u << 4)
+#define KTRACE_GRP_ALL          0x1fu
+
+// Record tags.  The group a tag belongs to is in its top 8 bits.
+#define KTRACE_TAG(grp, n)      (((grp) << 24) | (n))
+#define KTRACE_TAG_GROUP(tag)   ((tag) >> 24)
+
+//                                                          a            b
+#define KTRACE_TAG_CONTEXT_SWITCH KTRACE_TAG(KTRACE_GRP_SCHED, 1)   // new thread   old state
+#define KTRACE_TAG_SYSCALL_ENTER  KTRACE_TAG(KTRACE_GRP_SYSCALL, 1) // syscall #    -
+#define KTRACE_TAG_SYSCALL_EXIT   KTRACE_TAG(KTRACE_GRP_SYSCALL, 2) // syscall #    return value
+#define KTRACE_TAG_IRQ_ENTER      KTRACE_TAG(KTRACE_GRP_IRQ, 1)     // vector       -
+#define KTRACE_TAG_IRQ_EXIT       KTRACE_TAG(KTRACE_GRP_IRQ, 2)     // vector       -
+#define KTRACE_TAG_PAGE_FAULT     KTRACE_TAG(KTRACE_GRP_VM, 1)      // address      flags
+#define KTRACE_TAG_MSGPIPE_WRITE  KTRACE_TAG(KTRACE_GRP_IPC, 1)     // pipe koid    bytes
+#define KTRACE_TAG_MSGPIPE_READ   KTRACE_TAG(KTRACE_GRP_IPC, 2)     // pipe koid    bytes
+
+typedef struct ktrace_record {
+    uint32_t tag;
+    uint32_t cpu;
+    uint64_t ts;
+    // Kernel thread that was running when the record was written.
+    uint64_t thread;
+    uint64_t a;
+    uint64_t b;
+} ktrace_record_t;
+
+typedef struct ktrace_header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t record_size;
+    uint32_t num_cpus;
+    uint64_t ticks_to_ns_mult;
+    uint32_t ticks_to_ns_shift;
+    uint32_t reserved;
+    uint32_t cpu_records[KTRACE_MAX_CPUS];
+} ktrace_header_t;
+
+// Actions for mx_ktrace_control().
+#define KTRACE_ACTION_START     1u  // options: mask of KTRACE_GRP_* to enable
+#define KTRACE_ACTION_STOP      2u
+#define KTRACE_ACTION_REWIND    3u  // discard all records; tracing must be stopped
+
+#ifdef __cplusplus
+}
+#endif
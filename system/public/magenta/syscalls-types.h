@@ -141,6 +141,10 @@ typedef enum {
     MX_INFO_HANDLE_VALID,
     MX_INFO_HANDLE_BASIC,
     MX_INFO_PROCESS,
+    MX_INFO_THREAD_STATS,
+    MX_INFO_PROCESS_STATS,
+    MX_INFO_LOCK_STATS,
+    MX_INFO_PROCESS_MEMORY,
 } mx_object_info_topic_t;
 
 typedef enum {
@@ -182,6 +186,57 @@ typedef struct mx_process_info {
     int return_code;
 } mx_process_info_t;
 
+// CPU and scheduler accounting for a thread, or summed over a process's
+// threads.  Times are in nanoseconds.
+typedef struct mx_task_stats {
+    uint64_t runtime;               // time spent running
+    uint64_t wait_time;             // time spent ready to run, waiting for a cpu
+    uint64_t voluntary_switches;    // left the cpu to block, sleep or exit
+    uint64_t involuntary_switches;  // preempted or yielded while runnable
+    uint64_t page_faults;
+    uint64_t syscalls;
+} mx_task_stats_t;
+
+// Returned for topic MX_INFO_THREAD_STATS
+typedef struct mx_thread_stats_info {
+    char name[MX_MAX_NAME_LEN];
+    mx_task_stats_t stats;
+} mx_thread_stats_info_t;
+
+// Returned for topic MX_INFO_PROCESS_STATS.  The stats include threads
+// that have already exited.
+typedef struct mx_process_stats_info {
+    char name[MX_MAX_NAME_LEN];
+    uint32_t thread_count;          // live threads
+    uint32_t reserved;
+    mx_task_stats_t stats;
+} mx_process_stats_info_t;
+
+// Returned for topic MX_INFO_PROCESS_MEMORY.  Committed memory is what the
+// VMOs mapped into the process have allocated over the mapped ranges;
+// mapped memory is what is currently present in its page tables.  Memory
+// mapped more than once is counted once per mapping.
+typedef struct mx_process_memory_info {
+    uint64_t committed_bytes;
+    uint64_t mapped_bytes;
+} mx_process_memory_info_t;
+
+// An array of these is returned for topic MX_INFO_LOCK_STATS, one per
+// kernel lock site, when the kernel is built with lock statistics.
+// Times are in nanoseconds.
+typedef struct mx_lock_stats {
+    uint64_t pc;                    // where the lock was acquired
+    uint32_t type;                  // MX_LOCK_TYPE_*
+    uint32_t reserved;
+    uint64_t acquisitions;
+    uint64_t contended;             // acquisitions that had to wait
+    uint64_t wait_time;             // total time spent waiting
+    uint64_t max_hold_time;         // longest time the lock was held
+} mx_lock_stats_t;
+
+#define MX_LOCK_TYPE_SPINLOCK       1u
+#define MX_LOCK_TYPE_MUTEX          2u
+
 
 // Defines and structures related to mx_pci_*()
 // Info returned to dev manager for PCIe devices when probing.
@@ -273,6 +328,10 @@ typedef struct mx_log_record {
 #define MX_PORT_PKT_TYPE_USER      2u
 #define MX_PORT_PKT_TYPE_EXCEPTION 3u
 
+// Options for mx_object_wait_async()
+#define MX_WAIT_ASYNC_ONCE         0u
+#define MX_WAIT_ASYNC_REPEATING    1u
+
 typedef struct mx_packet_header {
     uint64_t key;
     uint32_t type;
@@ -327,6 +386,26 @@ typedef struct mx_waitset_result {
 #define MX_SOCKET_CONTROL                1u
 #define MX_SOCKET_CONTROL_MAX_LEN     1024u
 
+// Write flag: whole, page aligned pages of the source buffer may be moved
+// into the socket instead of copied. Their contents are zero afterwards.
+#define MX_SOCKET_MOVE_PAGES             2u
+
+// Creation flags: the low bits hold log2 of the buffer size, zero selects
+// the default size.
+#define MX_SOCKET_SIZE_LOG2_MASK      0x3fu
+#define MX_SOCKET_SIZE_LOG2(n)        ((uint32_t)(n) & MX_SOCKET_SIZE_LOG2_MASK)
+#define MX_SOCKET_MIN_SIZE_LOG2         12u
+#define MX_SOCKET_MAX_SIZE_LOG2         24u
+
+// Scatter/gather descriptors for the vectored read and write calls.
+
+typedef struct mx_iovec {
+    void* base;
+    mx_size_t len;
+} mx_iovec_t;
+
+#define MX_IOVEC_MAX                    16u
+
 #ifndef DEPRECATE_COMPAT_SYSCALLS
 typedef struct mx_waitset_result mx_wait_set_result_t;
 #define MX_IO_PORT_MAX_PKT_SIZE MX_PORT_MAX_PKT_SIZE
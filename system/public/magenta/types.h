@@ -63,6 +63,23 @@ typedef uint32_t mx_rights_t;
 #define MX_VM_FLAG_PERM_WRITE     (1u << 2)
 #define MX_VM_FLAG_PERM_EXECUTE   (1u << 3)
 
+// operations for vmo_op_range
+#define MX_VMO_OP_COMMIT                 1u
+#define MX_VMO_OP_DECOMMIT               2u
+#define MX_VMO_OP_LOOKUP                 3u
+#define MX_VMO_OP_CACHE_SYNC             4u
+#define MX_VMO_OP_CACHE_INVALIDATE       5u
+#define MX_VMO_OP_CACHE_CLEAN            6u
+#define MX_VMO_OP_CACHE_CLEAN_INVALIDATE 7u
+
+// events for system_get_event
+#define MX_SYSTEM_EVENT_MEMORY_PRESSURE  1u
+
+// signals of the memory pressure event; exactly one is asserted at a time
+#define MX_MEMORY_PRESSURE_NORMAL        MX_SIGNAL_SIGNAL0
+#define MX_MEMORY_PRESSURE_WARNING       MX_SIGNAL_SIGNAL1
+#define MX_MEMORY_PRESSURE_CRITICAL      MX_SIGNAL_SIGNAL2
+
 // flags to message pipe routines
 #define MX_FLAG_REPLY_PIPE        (1u << 0)
 
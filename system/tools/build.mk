@@ -9,10 +9,13 @@ BOOTSERVER := $(BUILDDIR)/tools/bootserver
 LOGLISTENER := $(BUILDDIR)/tools/loglistener
 NETRUNCMD := $(BUILDDIR)/tools/netruncmd
 NETCP:= $(BUILDDIR)/tools/netcp
+KTRACE2JSON := $(BUILDDIR)/tools/ktrace2json
+KPROF2FOLDED := $(BUILDDIR)/tools/kprof2folded
 
 TOOLS_CFLAGS := -std=c11 -Wall -Isystem/public -Isystem/private
 
-ALL_TOOLS := $(MKBOOTFS) $(BOOTSERVER) $(LOGLISTENER) $(NETRUNCMD) $(NETCP)
+ALL_TOOLS := $(MKBOOTFS) $(BOOTSERVER) $(LOGLISTENER) $(NETRUNCMD) $(NETCP) \
+             $(KTRACE2JSON) $(KPROF2FOLDED)
 
 $(BUILDDIR)/tools/%: system/tools/%.c
 	@echo compiling $@
@@ -0,0 +1,224 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Converts a profile saved with "kprof save" on the target into the
+// folded stack format read by flamegraph.pl and similar tools: one line
+// per distinct call stack, outermost frame first, followed by the number
+// of samples that hit it.
+//
+// Each stack is rooted at "kernel" for kernel threads, or at the process
+// koid, then "[kernel]" or "[user]" for the mode that was interrupted.
+// If the kernel image is given with -k, kernel addresses are resolved to
+// function names with addr2line; other addresses are printed in hex.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <magenta/kprof.h>
+
+static const char* appname;
+
+typedef struct symbol {
+    uint64_t addr;
+    char* name;
+} symbol_t;
+
+static symbol_t* symbols;
+static size_t num_symbols;
+
+static void* xrealloc(void* ptr, size_t size) {
+    ptr = realloc(ptr, size);
+    if (ptr == NULL) {
+        fprintf(stderr, "%s: out of memory\n", appname);
+        exit(1);
+    }
+    return ptr;
+}
+
+static int compare_symbols(const void* a, const void* b) {
+    uint64_t x = ((const symbol_t*)a)->addr;
+    uint64_t y = ((const symbol_t*)b)->addr;
+    return x < y ? -1 : x > y;
+}
+
+static int compare_stacks(const void* a, const void* b) {
+    return strcmp(*(char* const*)a, *(char* const*)b);
+}
+
+// The address looked up for a frame.  Return addresses point after the
+// call, so back them up into it.
+static uint64_t lookup_addr(const kprof_sample_t* s, unsigned frame) {
+    return frame == 0 ? s->frames[0] : s->frames[frame] - 1;
+}
+
+// Resolve every distinct kernel address with a single addr2line run.
+static int load_symbols(const char* elf, const kprof_sample_t* samples, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        if (samples[i].flags & KPROF_SAMPLE_USER)
+            continue;
+        for (unsigned f = 0; f < samples[i].num_frames; f++) {
+            symbols = xrealloc(symbols, (num_symbols + 1) * sizeof(symbol_t));
+            symbols[num_symbols].addr = lookup_addr(&samples[i], f);
+            symbols[num_symbols].name = NULL;
+            num_symbols++;
+        }
+    }
+    qsort(symbols, num_symbols, sizeof(symbol_t), compare_symbols);
+    size_t n = 0;
+    for (size_t i = 0; i < num_symbols; i++) {
+        if (n == 0 || symbols[n - 1].addr != symbols[i].addr)
+            symbols[n++] = symbols[i];
+    }
+    num_symbols = n;
+    if (num_symbols == 0)
+        return 0;
+
+    char tmpname[] = "/tmp/kprof2folded.XXXXXX";
+    int fd = mkstemp(tmpname);
+    if (fd < 0) {
+        fprintf(stderr, "%s: cannot create temporary file\n", appname);
+        return -1;
+    }
+    FILE* addrs = fdopen(fd, "w");
+    for (size_t i = 0; i < num_symbols; i++)
+        fprintf(addrs, "%#" PRIx64 "\n", symbols[i].addr);
+    fclose(addrs);
+
+    char cmd[1024];
+    snprintf(cmd, sizeof(cmd), "addr2line -f -C -e '%s' < %s", elf, tmpname);
+    FILE* out = popen(cmd, "r");
+    if (out == NULL) {
+        fprintf(stderr, "%s: cannot run addr2line\n", appname);
+        unlink(tmpname);
+        return -1;
+    }
+    // addr2line -f prints two lines per address: the function, then the
+    // file and line.
+    char func[512];
+    char loc[1024];
+    for (size_t i = 0; i < num_symbols; i++) {
+        if (fgets(func, sizeof(func), out) == NULL || fgets(loc, sizeof(loc), out) == NULL)
+            break;
+        func[strcspn(func, "\n")] = '\0';
+        if (strcmp(func, "??"))
+            symbols[i].name = strdup(func);
+    }
+    pclose(out);
+    unlink(tmpname);
+    return 0;
+}
+
+static const char* symbol_name(uint64_t addr) {
+    size_t lo = 0;
+    size_t hi = num_symbols;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (symbols[mid].addr < addr) {
+            lo = mid + 1;
+        } else if (symbols[mid].addr > addr) {
+            hi = mid;
+        } else {
+            return symbols[mid].name;
+        }
+    }
+    return NULL;
+}
+
+static char* fold_sample(const kprof_sample_t* s) {
+    char text[KPROF_MAX_FRAMES * 128 + 64];
+    size_t len;
+    bool user = s->flags & KPROF_SAMPLE_USER;
+    if (s->pid == 0) {
+        len = snprintf(text, sizeof(text), "kernel");
+    } else {
+        len = snprintf(text, sizeof(text), "pid %" PRIu64 ";%s", s->pid,
+                       user ? "[user]" : "[kernel]");
+    }
+
+    unsigned num_frames = s->num_frames;
+    if (num_frames > KPROF_MAX_FRAMES)
+        num_frames = KPROF_MAX_FRAMES;
+    for (unsigned f = num_frames; f-- > 0;) {
+        uint64_t addr = lookup_addr(s, f);
+        const char* name = user ? NULL : symbol_name(addr);
+        if (name != NULL) {
+            len += snprintf(text + len, sizeof(text) - len, ";%s", name);
+        } else {
+            len += snprintf(text + len, sizeof(text) - len, ";%#" PRIx64, addr);
+        }
+        if (len >= sizeof(text))
+            break;
+    }
+    return strdup(text);
+}
+
+int main(int argc, char** argv) {
+    appname = argv[0];
+    const char* elf = NULL;
+    if (argc == 4 && !strcmp(argv[1], "-k")) {
+        elf = argv[2];
+        argv += 2;
+        argc -= 2;
+    }
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s [-k <kernel-elf>] <kprof-file>\n", appname);
+        return -1;
+    }
+
+    FILE* fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "%s: cannot open '%s'\n", appname, argv[1]);
+        return -1;
+    }
+
+    kprof_header_t hdr;
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 || hdr.magic != KPROF_MAGIC) {
+        fprintf(stderr, "%s: '%s' is not a kernel profile\n", appname, argv[1]);
+        return -1;
+    }
+    if (hdr.version != KPROF_VERSION ||
+        hdr.sample_size != sizeof(kprof_sample_t) ||
+        hdr.num_cpus > KPROF_MAX_CPUS) {
+        fprintf(stderr, "%s: unsupported profile version %u\n", appname, hdr.version);
+        return -1;
+    }
+
+    size_t total = 0;
+    for (uint32_t n = 0; n < hdr.num_cpus; n++)
+        total += hdr.cpu_samples[n];
+    kprof_sample_t* samples = xrealloc(NULL, (total ? total : 1) * sizeof(kprof_sample_t));
+    size_t count = fread(samples, sizeof(kprof_sample_t), total, fp);
+    fclose(fp);
+    if (count != total)
+        fprintf(stderr, "%s: profile is truncated\n", appname);
+
+    if (elf != NULL && load_symbols(elf, samples, count) < 0)
+        return -1;
+
+    // Sorting brings identical stacks together, so they can be counted.
+    char** stacks = xrealloc(NULL, (count ? count : 1) * sizeof(char*));
+    for (size_t i = 0; i < count; i++)
+        stacks[i] = fold_sample(&samples[i]);
+    qsort(stacks, count, sizeof(char*), compare_stacks);
+
+    size_t num_stacks = 0;
+    for (size_t i = 0; i < count;) {
+        size_t j = i + 1;
+        while (j < count && !strcmp(stacks[i], stacks[j]))
+            j++;
+        printf("%s %zu\n", stacks[i], j - i);
+        num_stacks++;
+        i = j;
+    }
+
+    fprintf(stderr, "%s: %zu samples at %u Hz from %u cpus, %u dropped, %zu stacks\n",
+            appname, count, hdr.hz, hdr.num_cpus, hdr.dropped, num_stacks);
+    return 0;
+}
@@ -0,0 +1,165 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Converts a kernel trace saved with "ktrace save" on the target into the
+// Trace Event JSON format understood by chrome://tracing and similar
+// timeline viewers.
+//
+// Process 0 has one track per CPU showing which thread ran when, process 1
+// has one track per thread showing its syscalls, page faults and message
+// pipe traffic, and process 2 has one track per CPU showing interrupts.
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <magenta/ktrace.h>
+
+#define PID_CPUS 0
+#define PID_THREADS 1
+#define PID_IRQS 2
+
+static const char* appname;
+
+static ktrace_header_t hdr;
+static int first_event = 1;
+
+static double ts_us(uint64_t ts) {
+    uint64_t ns = (uint64_t)(((unsigned __int128)ts * hdr.ticks_to_ns_mult) >>
+                             hdr.ticks_to_ns_shift);
+    return ns / 1000.0;
+}
+
+// Kernel thread pointers make poor track ids; fold them to 32 bits.
+static uint32_t thread_id(uint64_t thread) {
+    return (uint32_t)(thread ^ (thread >> 32));
+}
+
+static void event_start(const char* ph, const char* name, int pid, uint32_t tid,
+                        double ts) {
+    printf("%s\n{\"ph\":\"%s\",\"name\":\"%s\",\"pid\":%d,\"tid\":%" PRIu32
+           ",\"ts\":%.3f",
+           first_event ? "" : ",", ph, name, pid, tid, ts);
+    first_event = 0;
+}
+
+static void metadata(const char* name, int pid) {
+    event_start("M", "process_name", pid, 0, 0);
+    printf(",\"args\":{\"name\":\"%s\"}}", name);
+}
+
+typedef struct cpu_state {
+    uint64_t thread;
+    double since;
+    int running;
+} cpu_state_t;
+
+static void emit_record(const ktrace_record_t* rec, cpu_state_t* cpu) {
+    double ts = ts_us(rec->ts);
+    uint32_t tid = thread_id(rec->thread);
+    char name[64];
+
+    switch (rec->tag) {
+    case KTRACE_TAG_CONTEXT_SWITCH:
+        // The record is written by the outgoing thread.
+        if (cpu->running) {
+            snprintf(name, sizeof(name), "thread %#" PRIx64, cpu->thread);
+            event_start("X", name, PID_CPUS, rec->cpu, cpu->since);
+            printf(",\"dur\":%.3f}", ts - cpu->since);
+        }
+        cpu->thread = rec->a;
+        cpu->since = ts;
+        cpu->running = 1;
+        break;
+    case KTRACE_TAG_SYSCALL_ENTER:
+        snprintf(name, sizeof(name), "syscall %" PRIu64, rec->a);
+        event_start("B", name, PID_THREADS, tid, ts);
+        printf("}");
+        break;
+    case KTRACE_TAG_SYSCALL_EXIT:
+        snprintf(name, sizeof(name), "syscall %" PRIu64, rec->a);
+        event_start("E", name, PID_THREADS, tid, ts);
+        printf(",\"args\":{\"ret\":%" PRId64 "}}", (int64_t)rec->b);
+        break;
+    case KTRACE_TAG_IRQ_ENTER:
+    case KTRACE_TAG_IRQ_EXIT:
+        snprintf(name, sizeof(name), "irq %" PRIu64, rec->a);
+        event_start(rec->tag == KTRACE_TAG_IRQ_ENTER ? "B" : "E",
+                    name, PID_IRQS, rec->cpu, ts);
+        printf("}");
+        break;
+    case KTRACE_TAG_PAGE_FAULT:
+        event_start("i", "page fault", PID_THREADS, tid, ts);
+        printf(",\"s\":\"t\",\"args\":{\"addr\":\"%#" PRIx64
+               "\",\"flags\":\"%#" PRIx64 "\"}}", rec->a, rec->b);
+        break;
+    case KTRACE_TAG_MSGPIPE_WRITE:
+    case KTRACE_TAG_MSGPIPE_READ:
+        event_start("i", rec->tag == KTRACE_TAG_MSGPIPE_WRITE ?
+                    "msgpipe write" : "msgpipe read", PID_THREADS, tid, ts);
+        printf(",\"s\":\"t\",\"args\":{\"pipe\":%" PRIu64
+               ",\"bytes\":%" PRIu64 "}}", rec->a, rec->b);
+        break;
+    default:
+        fprintf(stderr, "%s: skipping record with unknown tag %#x\n",
+                appname, rec->tag);
+        break;
+    }
+}
+
+int main(int argc, char** argv) {
+    appname = argv[0];
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <ktrace-file>\n", appname);
+        return -1;
+    }
+
+    FILE* fp = fopen(argv[1], "rb");
+    if (fp == NULL) {
+        fprintf(stderr, "%s: cannot open '%s'\n", appname, argv[1]);
+        return -1;
+    }
+
+    if (fread(&hdr, sizeof(hdr), 1, fp) != 1 ||
+        hdr.magic != KTRACE_MAGIC) {
+        fprintf(stderr, "%s: '%s' is not a kernel trace\n", appname, argv[1]);
+        return -1;
+    }
+    if (hdr.version != KTRACE_VERSION ||
+        hdr.record_size != sizeof(ktrace_record_t) ||
+        hdr.num_cpus > KTRACE_MAX_CPUS) {
+        fprintf(stderr, "%s: unsupported trace version %u\n", appname,
+                hdr.version);
+        return -1;
+    }
+
+    printf("{\"traceEvents\":[");
+    metadata("cpus", PID_CPUS);
+    metadata("threads", PID_THREADS);
+    metadata("irqs", PID_IRQS);
+
+    size_t total = 0;
+    for (uint32_t n = 0; n < hdr.num_cpus; n++) {
+        cpu_state_t cpu = { 0 };
+        for (uint32_t i = 0; i < hdr.cpu_records[n]; i++) {
+            ktrace_record_t rec;
+            if (fread(&rec, sizeof(rec), 1, fp) != 1) {
+                fprintf(stderr, "%s: trace is truncated\n", appname);
+                n = hdr.num_cpus;
+                break;
+            }
+            emit_record(&rec, &cpu);
+            total++;
+        }
+    }
+    printf("\n],\"displayTimeUnit\":\"ns\"}\n");
+    fclose(fp);
+
+    fprintf(stderr, "%s: converted %zu records from %u cpus\n",
+            appname, total, hdr.num_cpus);
+    return 0;
+}
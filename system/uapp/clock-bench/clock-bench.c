@@ -0,0 +1,46 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Measures how many mx_current_time() calls per second a thread can make,
+// and checks that the clock it reads never goes backwards.  On machines
+// where the vDSO reads the counter itself this involves no syscalls.
+
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <magenta/syscalls.h>
+
+#define DEFAULT_ITERATIONS 1000000
+
+int main(int argc, char** argv) {
+    int iterations = (argc > 1) ? atoi(argv[1]) : DEFAULT_ITERATIONS;
+    if (iterations <= 0) {
+        printf("usage: clock-bench [iterations]\n");
+        return 1;
+    }
+
+    int backwards = 0;
+    mx_time_t start = mx_current_time();
+    mx_time_t last = start;
+    for (int i = 0; i < iterations; i++) {
+        mx_time_t now = mx_current_time();
+        if (now < last)
+            backwards++;
+        last = now;
+    }
+    mx_time_t elapsed = last - start;
+    if (elapsed == 0)
+        elapsed = 1;
+
+    printf("%d calls in %" PRIu64 " us, %" PRIu64 " ns each, %" PRIu64
+           " calls/sec\n",
+           iterations, elapsed / 1000u, elapsed / iterations,
+           (uint64_t)iterations * 1000000000u / elapsed);
+    if (backwards) {
+        printf("clock went backwards %d times\n", backwards);
+        return 1;
+    }
+    return 0;
+}
@@ -449,6 +449,10 @@ static mx_status_t _vfs_handler(mxrio_msg_t* msg, mx_handle_t rh, void* cookie)
     }
     case MXRIO_UNLINK:
         return vn->ops->unlink(vn, (const char*)msg->data, len);
+    case MXRIO_SYNC:
+    case MXRIO_TRUNCATE:
+    case MXRIO_MMAP:
+        return vfs_handle_rio(vn, msg, len, &ios->io_off);
     default:
         return ERR_NOT_SUPPORTED;
     }
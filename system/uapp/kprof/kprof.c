@@ -0,0 +1,90 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Controls the kernel's sampling profiler through /dev/kprof and saves
+// the samples to a file, which the kprof2folded host tool can turn into
+// flame graph input.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <magenta/device/kprof.h>
+#include <magenta/kprof.h>
+#include <mxio/io.h>
+
+#define KPROF_DEV "/dev/kprof"
+
+static int usage(void) {
+    fprintf(stderr,
+            "usage: kprof start [hz]    - start sampling (default %u per second, max %u)\n"
+            "       kprof stop          - stop sampling\n"
+            "       kprof save <file>   - stop sampling and save the samples\n",
+            KPROF_DEFAULT_HZ, KPROF_MAX_HZ);
+    return 1;
+}
+
+static int save(int fd, const char* path) {
+    int out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        fprintf(stderr, "kprof: cannot create '%s'\n", path);
+        return 1;
+    }
+    char buf[8192];
+    size_t total = 0;
+    ssize_t r;
+    while ((r = read(fd, buf, sizeof(buf))) > 0) {
+        if (write(out, buf, r) != r) {
+            fprintf(stderr, "kprof: write to '%s' failed\n", path);
+            close(out);
+            return 1;
+        }
+        total += r;
+    }
+    close(out);
+    if (r < 0) {
+        fprintf(stderr, "kprof: read failed: %zd\n", r);
+        return 1;
+    }
+    printf("kprof: saved %zu bytes to %s\n", total, path);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2)
+        return usage();
+
+    int fd = open(KPROF_DEV, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "kprof: cannot open " KPROF_DEV "\n");
+        return 1;
+    }
+
+    ssize_t r;
+    if (!strcmp(argv[1], "start")) {
+        uint32_t hz = (argc > 2) ? strtoul(argv[2], NULL, 0) : 0;
+        r = mxio_ioctl(fd, IOCTL_KPROF_START, &hz, sizeof(hz), NULL, 0);
+    } else if (!strcmp(argv[1], "stop")) {
+        r = mxio_ioctl(fd, IOCTL_KPROF_STOP, NULL, 0, NULL, 0);
+    } else if (!strcmp(argv[1], "save") && argc > 2) {
+        r = mxio_ioctl(fd, IOCTL_KPROF_STOP, NULL, 0, NULL, 0);
+        if (r >= 0) {
+            int status = save(fd, argv[2]);
+            close(fd);
+            return status;
+        }
+    } else {
+        close(fd);
+        return usage();
+    }
+    close(fd);
+
+    if (r < 0) {
+        fprintf(stderr, "kprof: %s failed: %zd\n", argv[1], r);
+        return 1;
+    }
+    return 0;
+}
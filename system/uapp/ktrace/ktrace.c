@@ -0,0 +1,94 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Controls kernel tracing through /dev/ktrace and saves the trace to a
+// file, which the ktrace2json host tool can turn into a timeline.
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <magenta/device/ktrace.h>
+#include <magenta/ktrace.h>
+#include <mxio/io.h>
+
+#define KTRACE_DEV "/dev/ktrace"
+
+static int usage(void) {
+    fprintf(stderr,
+            "usage: ktrace start [grpmask]  - start tracing (default: all groups)\n"
+            "       ktrace stop             - stop tracing\n"
+            "       ktrace rewind           - discard the trace (while stopped)\n"
+            "       ktrace save <file>      - stop tracing and save the trace\n"
+            "groups: sched=%#x syscall=%#x irq=%#x vm=%#x ipc=%#x\n",
+            KTRACE_GRP_SCHED, KTRACE_GRP_SYSCALL, KTRACE_GRP_IRQ,
+            KTRACE_GRP_VM, KTRACE_GRP_IPC);
+    return 1;
+}
+
+static int save(int fd, const char* path) {
+    int out = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (out < 0) {
+        fprintf(stderr, "ktrace: cannot create '%s'\n", path);
+        return 1;
+    }
+    char buf[8192];
+    size_t total = 0;
+    ssize_t r;
+    while ((r = read(fd, buf, sizeof(buf))) > 0) {
+        if (write(out, buf, r) != r) {
+            fprintf(stderr, "ktrace: write to '%s' failed\n", path);
+            close(out);
+            return 1;
+        }
+        total += r;
+    }
+    close(out);
+    if (r < 0) {
+        fprintf(stderr, "ktrace: read failed: %zd\n", r);
+        return 1;
+    }
+    printf("ktrace: saved %zu bytes to %s\n", total, path);
+    return 0;
+}
+
+int main(int argc, char** argv) {
+    if (argc < 2)
+        return usage();
+
+    int fd = open(KTRACE_DEV, O_RDONLY);
+    if (fd < 0) {
+        fprintf(stderr, "ktrace: cannot open " KTRACE_DEV "\n");
+        return 1;
+    }
+
+    ssize_t r;
+    if (!strcmp(argv[1], "start")) {
+        uint32_t grpmask = (argc > 2) ? strtoul(argv[2], NULL, 0) : KTRACE_GRP_ALL;
+        r = mxio_ioctl(fd, IOCTL_KTRACE_START, &grpmask, sizeof(grpmask), NULL, 0);
+    } else if (!strcmp(argv[1], "stop")) {
+        r = mxio_ioctl(fd, IOCTL_KTRACE_STOP, NULL, 0, NULL, 0);
+    } else if (!strcmp(argv[1], "rewind")) {
+        r = mxio_ioctl(fd, IOCTL_KTRACE_REWIND, NULL, 0, NULL, 0);
+    } else if (!strcmp(argv[1], "save") && argc > 2) {
+        r = mxio_ioctl(fd, IOCTL_KTRACE_STOP, NULL, 0, NULL, 0);
+        if (r >= 0) {
+            int status = save(fd, argv[2]);
+            close(fd);
+            return status;
+        }
+    } else {
+        close(fd);
+        return usage();
+    }
+    close(fd);
+
+    if (r < 0) {
+        fprintf(stderr, "ktrace: %s failed: %zd\n", argv[1], r);
+        return 1;
+    }
+    return 0;
+}
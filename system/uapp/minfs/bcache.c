@@ -6,8 +6,10 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
 #include <unistd.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include <magenta/listnode.h>
 
@@ -20,57 +22,133 @@
 
 #define BLOCK_FLAGS 0xF
 
-static int readblk(int fd, uint32_t bno, void* data) {
+struct block {
+    list_node_t hashnode;
+    list_node_t listnode;
+    uint32_t flags;
+    uint32_t bno;
+    uint32_t jnl_bno;   // where its last committed copy is, if BLOCK_LOGGED
+    void* data;
+};
+
+// The number of a block recently evicted from the cold queue.
+typedef struct ghost {
+    list_node_t hashnode;
+    list_node_t listnode;
+    uint32_t bno;
+} ghost_t;
+
+// With a journal, dirty blocks holding file data are written in place
+// as before, but all other dirty blocks are first written to the
+// journal together as one record, and stay on the logged list until
+// a checkpoint writes them in place and empties the journal.  File
+// data is always written before the record that may refer to it.
+// Records are only written when no transaction is in progress, once
+// enough metadata is dirty, or on bcache_sync(), and checkpoints
+// only happen when the journal is half full or the cache needs the
+// blocks, so a block modified many times in a row is usually written
+// in place just once.
+//
+// Replacement follows the simplified 2Q scheme: a block read for the
+// first time goes on the cold queue, and is evicted from there first,
+// leaving its number behind on the ghost queue.  A block read again
+// while its number is still a ghost goes on the hot queue, an LRU
+// which only loses blocks once the cold queue is down to a quarter of
+// the cache.  A long sequential read therefore only churns the cold
+// queue and leaves frequently used metadata alone.
+//
+// Any number of threads may use the cache.  bc->lock guards all of
+// it, but is dropped while a missing block is read in, which stays
+// busy meanwhile, so that threads reading different blocks are not
+// held up by each other.  Commits need every transaction to have
+// ended, so once one is due, transactions not nested in another one
+// wait for it before they begin.
+struct bcache {
+    list_node_t list_busy;  // between bcache_get() and bcache_put()
+    list_node_t list_dirty; // waiting for write
+    list_node_t list_cold;  // clean, seen once, in fifo order
+    list_node_t list_hot;   // clean, seen again, in lru order
+    list_node_t list_free;  // allocated, holding no block
+    list_node_t list_ghost; // recently evicted from cold, oldest first
+    list_node_t list_logged;// clean, in the journal but not yet in place
+    list_node_t* hash;
+    list_node_t* ghost_hash;
+    uint32_t hashbits;
+    mtx_t lock;
+    cnd_t idle;             // signalled whenever a block is released
+    cnd_t txn_idle;         // signalled when transactions may begin or have ended
+    uint32_t txns;          // transactions in progress
+    uint32_t quiesce;       // callers waiting for every transaction to end
+    bool commit_due;        // hold off new transactions until a commit
+    int fd;
+    uint32_t blocksize;
+    uint32_t blockmax;
+    uint32_t count;         // blocks allocated
+    uint32_t target;        // blocks the cache may hold now
+    uint32_t limit;         // blocks the cache may hold at most
+    uint32_t cold;          // blocks on list_cold
+    uint32_t dirty;         // blocks on list_dirty
+    uint32_t meta;          // blocks on list_dirty bound for the journal
+    uint32_t logged;        // blocks on list_logged
+    bool unsynced;          // blocks written in place since the last barrier
+    uint32_t ghosts;        // entries on list_ghost
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t read_ahead;    // blocks read before they were asked for
+    uint64_t writes;
+    uint64_t commits;
+    uint64_t logged_writes;
+    block_t** flushlist;    // scratch space for sorting dirty blocks
+    uint32_t flushmax;
+
+    uint32_t jnl_start;     // first block of the journal
+    uint32_t jnl_count;     // size of the journal, 0 if there is none
+    uint32_t jnl_head;      // where the next record goes, from jnl_start
+    uint64_t jnl_seq;       // sequence number of the next record
+    void* jnl_buf;          // scratch block for journal headers
+};
+
+// The device is only ever read and written at explicit offsets, so
+// threads need not coordinate their io with each other.
+static int readblk(bcache_t* bc, uint32_t bno, void* data) {
     off_t off = bno * MINFS_BLOCK_SIZE;
     trace(IO, "readblk() bno=%u off=%#llx\n", bno, (unsigned long long)off);
-    if (lseek(fd, off, SEEK_SET) < 0) {
-        error("minfs: cannot seek to block %u\n", bno);
-        return -1;
-    }
-    if (read(fd, data, MINFS_BLOCK_SIZE) != MINFS_BLOCK_SIZE) {
+    if (pread(bc->fd, data, MINFS_BLOCK_SIZE, off) != MINFS_BLOCK_SIZE) {
         error("minfs: cannot read block %u\n", bno);
         return -1;
     }
     return 0;
 }
 
-static int writeblk(int fd, uint32_t bno, void* data) {
+// read count blocks starting at bno with a single vectored read
+static int readblks(bcache_t* bc, uint32_t bno, struct iovec* iov, int count) {
     off_t off = bno * MINFS_BLOCK_SIZE;
-    trace(IO, "writeblk() bno=%u off=%#llx\n", bno, (unsigned long long)off);
-    if (lseek(fd, off, SEEK_SET) < 0) {
-        error("minfs: cannot seek to block %u\n", bno);
+    trace(IO, "readblks() bno=%u count=%d off=%#llx\n", bno, count, (unsigned long long)off);
+    if (preadv(bc->fd, iov, count, off) != (ssize_t)count * MINFS_BLOCK_SIZE) {
+        error("minfs: cannot read blocks %u..%u\n", bno, bno + count - 1);
         return -1;
     }
-    if (write(fd, data, MINFS_BLOCK_SIZE) != MINFS_BLOCK_SIZE) {
-        error("minfs: cannot write block %u\n", bno);
+    return 0;
+}
+
+// write count blocks starting at bno with a single vectored write
+static int writeblks(bcache_t* bc, uint32_t bno, struct iovec* iov, int count) {
+    off_t off = bno * MINFS_BLOCK_SIZE;
+    trace(IO, "writeblks() bno=%u count=%d off=%#llx\n", bno, count, (unsigned long long)off);
+    if (pwritev(bc->fd, iov, count, off) != (ssize_t)count * MINFS_BLOCK_SIZE) {
+        error("minfs: cannot write blocks %u..%u\n", bno, bno + count - 1);
         return -1;
     }
     return 0;
 }
 
-struct block {
-    list_node_t hashnode;
-    list_node_t listnode;
-    uint32_t flags;
-    uint32_t bno;
-    void* data;
-};
-
-struct bcache {
-    list_node_t list_busy;  // between bcache_get() and bcache_put()
-    list_node_t list_dirty; // waiting for write
-    list_node_t list_lru;   // available for re-use
-    list_node_t list_free;  // never been used
-    list_node_t hash[MINFS_BUCKETS];
-    int fd;
-    uint32_t blocksize;
-    uint32_t blockmax;
-};
+// longest run of blocks handed to a single preadv() or pwritev()
+#define BCACHE_MAX_RUN 64
 
-#define bno_hash(bno) fnv1a_tiny(bno, MINFS_HASH_BITS)
+// the cache never shrinks below this many blocks
+#define BCACHE_MIN_BLOCKS 16
 
-static_assert((1<<MINFS_HASH_BITS) == MINFS_BUCKETS,
-              "minfs constants disagree");
+#define bno_hash(bc, bno) fnv1a_tiny(bno, (bc)->hashbits)
 
 uint32_t bcache_max_block(bcache_t* bc) {
     return bc->blockmax;
@@ -90,20 +168,593 @@ static const char* modestr(uint32_t mode) {
 }
 
 #define BLOCK_BUSY 0x10
+#define BLOCK_HOT 0x20
+#define BLOCK_LOGGED 0x40   // in the journal, not yet written in place
+
+// Dirty blocks bound for the journal.  Data blocks last committed to
+// the journal, before being freed and reused, go there one more time
+// so that replaying the older record cannot overwrite them.
+static inline bool block_is_meta(block_t* blk) {
+    return !(blk->flags & BLOCK_DATA) || (blk->flags & BLOCK_LOGGED);
+}
+
+static block_t* block_new(bcache_t* bc) {
+    if (bc->count == bc->flushmax) {
+        uint32_t max = bc->flushmax ? bc->flushmax * 2 : BCACHE_MIN_BLOCKS;
+        block_t** list;
+        if ((list = realloc(bc->flushlist, max * sizeof(block_t*))) == NULL) {
+            return NULL;
+        }
+        bc->flushlist = list;
+        bc->flushmax = max;
+    }
+    block_t* blk;
+    if ((blk = calloc(1, sizeof(block_t))) == NULL) {
+        return NULL;
+    }
+    if ((blk->data = malloc(bc->blocksize)) == NULL) {
+        free(blk);
+        return NULL;
+    }
+    bc->count++;
+    return blk;
+}
+
+static void block_free(bcache_t* bc, block_t* blk) {
+    free(blk->data);
+    free(blk);
+    bc->count--;
+}
+
+static bool ghost_remove(bcache_t* bc, uint32_t bno) {
+    ghost_t* g;
+    list_for_every_entry(bc->ghost_hash + bno_hash(bc, bno), g, ghost_t, hashnode) {
+        if (g->bno == bno) {
+            list_delete(&g->hashnode);
+            list_delete(&g->listnode);
+            free(g);
+            bc->ghosts--;
+            return true;
+        }
+    }
+    return false;
+}
+
+// remember bno for about half a cache's worth of evictions
+static void ghost_add(bcache_t* bc, uint32_t bno) {
+    ghost_t* g;
+    if (bc->ghosts >= (bc->target / 2)) {
+        if ((g = list_remove_head_type(&bc->list_ghost, ghost_t, listnode)) == NULL) {
+            return;
+        }
+        list_delete(&g->hashnode);
+    } else {
+        if ((g = malloc(sizeof(ghost_t))) == NULL) {
+            return;
+        }
+        bc->ghosts++;
+    }
+    g->bno = bno;
+    list_add_tail(bc->ghost_hash + bno_hash(bc, bno), &g->hashnode);
+    list_add_tail(&bc->list_ghost, &g->listnode);
+}
+
+static void ghost_trim(bcache_t* bc) {
+    ghost_t* g;
+    while (bc->ghosts > (bc->target / 2)) {
+        g = list_remove_head_type(&bc->list_ghost, ghost_t, listnode);
+        list_delete(&g->hashnode);
+        free(g);
+        bc->ghosts--;
+    }
+}
+
+static int bno_compare(const void* a, const void* b) {
+    uint32_t x = (*(block_t* const*) a)->bno;
+    uint32_t y = (*(block_t* const*) b)->bno;
+    return (x > y) - (x < y);
+}
+
+// put a clean, idle block on the queue it belongs to
+static void bcache_add_clean_locked(bcache_t* bc, block_t* blk) {
+    if (blk->flags & BLOCK_HOT) {
+        list_add_tail(&bc->list_hot, &blk->listnode);
+    } else {
+        list_add_tail(&bc->list_cold, &blk->listnode);
+        bc->cold++;
+    }
+}
+
+// take a clean, idle block out of the cache to be reused or freed
+static block_t* bcache_evict_locked(bcache_t* bc) {
+    block_t* blk;
+    if (((bc->cold > (bc->target / 4)) || list_is_empty(&bc->list_hot)) &&
+        ((blk = list_remove_head_type(&bc->list_cold, block_t, listnode)) != NULL)) {
+        bc->cold--;
+        ghost_add(bc, blk->bno);
+    } else if ((blk = list_remove_head_type(&bc->list_hot, block_t, listnode)) == NULL) {
+        return NULL;
+    }
+    // remove from hash, bno to be reassigned
+    list_delete(&blk->hashnode);
+    return blk;
+}
+
+// Write flushlist[0..count) in place, in order of block number,
+// each run of consecutive blocks with a single vectored write.  The
+// entries of a run that could not be written are set to NULL, so that
+// those blocks stay dirty and a later sync tries them again.
+static mx_status_t bcache_write_locked(bcache_t* bc, uint32_t count) {
+    if (count == 0) {
+        return NO_ERROR;
+    }
+    trace(BCACHE, "[ writing %u blocks ]\n", count);
+    qsort(bc->flushlist, count, sizeof(block_t*), bno_compare);
+
+    mx_status_t status = NO_ERROR;
+    struct iovec iov[BCACHE_MAX_RUN];
+    for (uint32_t n = 0; n < count;) {
+        uint32_t bno = bc->flushlist[n]->bno;
+        int run = 0;
+        while ((n + run < count) && (run < BCACHE_MAX_RUN) &&
+               (bc->flushlist[n + run]->bno == bno + run)) {
+            iov[run].iov_base = bc->flushlist[n + run]->data;
+            iov[run].iov_len = bc->blocksize;
+            run++;
+        }
+        if (writeblks(bc, bno, iov, run) < 0) {
+            error("block write error!\n");
+            status = ERR_IO;
+            for (int i = 0; i < run; i++) {
+                bc->flushlist[n + i] = NULL;
+            }
+        }
+        n += run;
+    }
+    bc->writes += count;
+    bc->unsynced = true;
+    return status;
+}
+
+// make sure everything written so far is on the disk
+static mx_status_t bcache_barrier(bcache_t* bc) {
+    if (fsync(bc->fd) < 0) {
+        error("minfs: cannot flush device\n");
+        return ERR_IO;
+    }
+    bc->unsynced = false;
+    return NO_ERROR;
+}
+
+// a dirty block has been written back, in place or to the journal
+static void bcache_clean_locked(bcache_t* bc, block_t* blk, uint32_t flags) {
+    list_delete(&blk->listnode);
+    bc->dirty--;
+    blk->flags = (blk->flags & (~(BLOCK_DIRTY | BLOCK_DATA))) | flags;
+    if (blk->flags & BLOCK_LOGGED) {
+        list_add_tail(&bc->list_logged, &blk->listnode);
+        bc->logged++;
+    } else {
+        bcache_add_clean_locked(bc, blk);
+    }
+}
+
+// mark the blocks bcache_write_locked() wrote in place as clean,
+// returning how many there were
+static uint32_t bcache_clean_written_locked(bcache_t* bc, uint32_t count) {
+    uint32_t written = 0;
+    for (uint32_t n = 0; n < count; n++) {
+        if (bc->flushlist[n] != NULL) {
+            bcache_clean_locked(bc, bc->flushlist[n], 0);
+            written++;
+        }
+    }
+    return written;
+}
+
+// Write back the dirty blocks which need no journal, which is all
+// of them if there is none, and set *written to how many were
+// written.  Fails if any of them could not be.
+static mx_status_t bcache_write_data_locked(bcache_t* bc, uint32_t* written) {
+    block_t* blk;
+    uint32_t count = 0;
+    list_for_every_entry(&bc->list_dirty, blk, block_t, listnode) {
+        if ((bc->jnl_count == 0) || !block_is_meta(blk)) {
+            bc->flushlist[count++] = blk;
+        }
+    }
+    mx_status_t status = bcache_write_locked(bc, count);
+    *written = bcache_clean_written_locked(bc, count);
+    if (bc->jnl_count == 0) {
+        bc->meta = 0;
+    }
+    return status;
+}
+
+static void bcache_journal_checksum(bcache_t* bc, minfs_journal_record_t* rec, uint32_t count) {
+    uint32_t sum = FNV32_OFFSET_BASIS;
+    const uint8_t* p;
+    rec->checksum = 0;
+    for (uint32_t n = 0; n <= count; n++) {
+        p = n ? bc->flushlist[n - 1]->data : (void*) rec;
+        for (uint32_t i = 0; i < bc->blocksize; i++) {
+            sum = (sum ^ p[i]) * FNV32_PRIME;
+        }
+    }
+    rec->checksum = sum;
+}
+
+// write an empty journal starting with record seq
+static mx_status_t bcache_journal_reset_locked(bcache_t* bc, uint64_t seq) {
+    minfs_journal_info_t* ji = bc->jnl_buf;
+    memset(ji, 0, bc->blocksize);
+    ji->magic = MINFS_MAGIC_JOURNAL;
+    ji->seq = seq;
+    struct iovec iov = {
+        .iov_base = ji,
+        .iov_len = bc->blocksize,
+    };
+    if (writeblks(bc, bc->jnl_start, &iov, 1) < 0) {
+        return ERR_IO;
+    }
+    bc->jnl_head = 1;
+    bc->jnl_seq = seq;
+    return bcache_barrier(bc);
+}
+
+// Blocks changed again since they were last committed hold newer data
+// than the journal, so the committed copy is read back from there and
+// written in place, a block at a time by way of jnl_buf.
+static mx_status_t bcache_checkpoint_block_locked(bcache_t* bc, block_t* blk) {
+    struct iovec iov = {
+        .iov_base = bc->jnl_buf,
+        .iov_len = bc->blocksize,
+    };
+    if ((readblk(bc, blk->jnl_bno, bc->jnl_buf) < 0) ||
+        (writeblks(bc, blk->bno, &iov, 1) < 0)) {
+        error("minfs: cannot checkpoint block %u\n", blk->bno);
+        return ERR_IO;
+    }
+    bc->unsynced = true;
+    return NO_ERROR;
+}
 
+// Write every logged block in place and empty the journal.  Only
+// called with no transaction in progress.
+static mx_status_t bcache_checkpoint_locked(bcache_t* bc) {
+    block_t* blk;
+    mx_status_t status;
+    list_for_every_entry(&bc->list_dirty, blk, block_t, listnode) {
+        if ((blk->flags & BLOCK_LOGGED) &&
+            ((status = bcache_checkpoint_block_locked(bc, blk)) < 0)) {
+            return status;
+        }
+    }
+    uint32_t count = 0;
+    list_for_every_entry(&bc->list_logged, blk, block_t, listnode) {
+        bc->flushlist[count++] = blk;
+    }
+    // busy blocks are only being read, as no transaction is open
+    list_for_every_entry(&bc->list_busy, blk, block_t, listnode) {
+        if (!(blk->flags & BLOCK_LOGGED)) {
+            continue;
+        }
+        if (!(blk->flags & BLOCK_DIRTY)) {
+            bc->flushlist[count++] = blk;
+        } else if ((status = bcache_checkpoint_block_locked(bc, blk)) < 0) {
+            return status;
+        }
+    }
+    trace(BCACHE, "[ checkpoint of %u blocks ]\n", count);
+    if (((status = bcache_write_locked(bc, count)) < 0) ||
+        ((status = bcache_barrier(bc)) < 0) ||
+        ((status = bcache_journal_reset_locked(bc, bc->jnl_seq)) < 0)) {
+        return status;
+    }
+    while ((blk = list_remove_head_type(&bc->list_logged, block_t, listnode)) != NULL) {
+        blk->flags &= (~BLOCK_LOGGED);
+        bcache_add_clean_locked(bc, blk);
+    }
+    list_for_every_entry(&bc->list_busy, blk, block_t, listnode) {
+        blk->flags &= (~BLOCK_LOGGED);
+    }
+    // dirty data blocks out of the journal no longer need to go through it
+    list_for_every_entry(&bc->list_dirty, blk, block_t, listnode) {
+        if (blk->flags & BLOCK_LOGGED) {
+            blk->flags &= (~BLOCK_LOGGED);
+            bc->meta -= !block_is_meta(blk);
+        }
+    }
+    bc->logged = 0;
+    return NO_ERROR;
+}
+
+// put the dirty blocks bound for the journal on the flush list
+static uint32_t bcache_gather_meta_locked(bcache_t* bc) {
+    block_t* blk;
+    uint32_t count = 0;
+    list_for_every_entry(&bc->list_dirty, blk, block_t, listnode) {
+        if (block_is_meta(blk)) {
+            bc->flushlist[count++] = blk;
+        }
+    }
+    return count;
+}
+
+// Write the dirty blocks bound for the journal as one record.
+static mx_status_t bcache_commit_locked(bcache_t* bc) {
+    uint32_t count = bcache_gather_meta_locked(bc);
+    if (count == 0) {
+        return NO_ERROR;
+    }
+    mx_status_t status;
+    if ((count >= (bc->jnl_count - bc->jnl_head)) && (bc->jnl_head > 1)) {
+        // Make room by emptying the journal.  Data blocks that only
+        // went to the journal because it held an older copy are then
+        // written in place, still ahead of the record.
+        trace(BCACHE, "[ checkpoint to fit %u blocks ]\n", count);
+        uint32_t written;
+        if (((status = bcache_checkpoint_locked(bc)) < 0) ||
+            ((status = bcache_write_data_locked(bc, &written)) < 0)) {
+            return status;
+        }
+        if ((count = bcache_gather_meta_locked(bc)) == 0) {
+            return NO_ERROR;
+        }
+    }
+    if (count >= (bc->jnl_count - bc->jnl_head)) {
+        // Too much for even an empty journal.  Write it all in place
+        // instead, which a crash part way through may leave inconsistent.
+        warn("minfs: %u blocks do not fit the journal\n", count);
+        status = bcache_write_locked(bc, count);
+        bc->meta = count - bcache_clean_written_locked(bc, count);
+        if (status < 0) {
+            return status;
+        }
+        return bcache_checkpoint_locked(bc);
+    }
+
+    // file data the record refers to must reach the disk before it does
+    if (bc->unsynced && ((status = bcache_barrier(bc)) < 0)) {
+        return status;
+    }
+
+    minfs_journal_record_t* rec = bc->jnl_buf;
+    memset(rec, 0, bc->blocksize);
+    rec->magic = MINFS_MAGIC_JOURNAL_REC;
+    rec->count = count;
+    rec->seq = bc->jnl_seq;
+    for (uint32_t n = 0; n < count; n++) {
+        rec->bno[n] = bc->flushlist[n]->bno;
+    }
+    bcache_journal_checksum(bc, rec, count);
+    trace(BCACHE, "[ commit #%llu of %u blocks ]\n", (unsigned long long)rec->seq, count);
+
+    // the record is contiguous, so it goes out in as few writes as possible
+    struct iovec iov[BCACHE_MAX_RUN];
+    uint32_t bno = bc->jnl_start + bc->jnl_head;
+    for (uint32_t n = 0; n <= count;) {
+        int run = 0;
+        while ((n + run <= count) && (run < BCACHE_MAX_RUN)) {
+            iov[run].iov_base = (n + run) ? bc->flushlist[n + run - 1]->data : (void*) rec;
+            iov[run].iov_len = bc->blocksize;
+            run++;
+        }
+        if (writeblks(bc, bno + n, iov, run) < 0) {
+            error("minfs: journal write error!\n");
+            return ERR_IO;
+        }
+        n += run;
+    }
+    if ((status = bcache_barrier(bc)) < 0) {
+        return status;
+    }
+    bc->jnl_head += count + 1;
+    bc->jnl_seq++;
+    bc->commits++;
+    bc->logged_writes += count;
+    for (uint32_t n = 0; n < count; n++) {
+        bc->flushlist[n]->jnl_bno = bno + 1 + n;
+        bcache_clean_locked(bc, bc->flushlist[n], BLOCK_LOGGED);
+    }
+    bc->meta = 0;
+    return NO_ERROR;
+}
+
+// Write back every dirty block, by way of the journal if there is
+// one, which is then checkpointed if half full or if checkpoint is
+// set.  Only called with no transaction in progress.
+static mx_status_t bcache_flush_locked(bcache_t* bc, bool checkpoint) {
+    // no metadata is committed while data it may refer to is unwritten
+    uint32_t written;
+    mx_status_t status;
+    if (((status = bcache_write_data_locked(bc, &written)) < 0) ||
+        (bc->jnl_count == 0)) {
+        return status;
+    }
+    if ((status = bcache_commit_locked(bc)) < 0) {
+        return status;
+    }
+    if (checkpoint || (bc->jnl_head > (bc->jnl_count / 2))) {
+        return bcache_checkpoint_locked(bc);
+    }
+    return NO_ERROR;
+}
+
+// Write back some idle blocks so that they may be evicted, which
+// inside a transaction means only those that need no journal.
+// Returns the number of blocks written.
+static uint32_t bcache_writeback_locked(bcache_t* bc) {
+    if ((bc->txns > 0) && (bc->jnl_count > 0)) {
+        uint32_t written;
+        bcache_write_data_locked(bc, &written);
+        return written;
+    }
+    uint32_t count = bc->dirty + bc->logged;
+    if ((count == 0) || (bcache_flush_locked(bc, true) < 0)) {
+        return 0;
+    }
+    return count;
+}
+
+// Hold off new transactions and wait for those in progress to end,
+// so a commit includes all or nothing of each.
+static void bcache_quiesce_locked(bcache_t* bc) {
+    bc->quiesce++;
+    while (bc->txns > 0) {
+        cnd_wait(&bc->txn_idle, &bc->lock);
+    }
+}
+
+static void bcache_resume_locked(bcache_t* bc) {
+    if (--bc->quiesce == 0) {
+        cnd_broadcast(&bc->txn_idle);
+    }
+}
+
+// free idle blocks until we are back within the target size
+static void bcache_trim_locked(bcache_t* bc) {
+    block_t* blk;
+    while (bc->count > bc->target) {
+        if ((blk = list_remove_head_type(&bc->list_free, block_t, listnode)) == NULL) {
+            if ((blk = bcache_evict_locked(bc)) == NULL) {
+                break;
+            }
+        }
+        block_free(bc, blk);
+    }
+    ghost_trim(bc);
+}
+
+// find a block that is free, may be added, or is clean and idle
+static block_t* bcache_alloc_idle_locked(bcache_t* bc) {
+    block_t* blk;
+    if ((blk = list_remove_head_type(&bc->list_free, block_t, listnode)) != NULL) {
+        return blk;
+    }
+    if ((bc->count < bc->target) && ((blk = block_new(bc)) != NULL)) {
+        return blk;
+    }
+    return bcache_evict_locked(bc);
+}
+
+// Find a block to hold a new bno.  Returns NULL if it had to wait for
+// a busy block to be released, in which case the caller must look for
+// bno again, as another thread may have brought it in meanwhile.
+static block_t* bcache_alloc_locked(bcache_t* bc) {
+    block_t* blk;
+    for (;;) {
+        if ((blk = bcache_alloc_idle_locked(bc)) != NULL) {
+            return blk;
+        }
+        // every idle block is dirty or logged, write them back together
+        if (bcache_writeback_locked(bc) == 0) {
+            if (bc->txns > 0) {
+                // the rest can go once the open transactions end
+                bc->commit_due = true;
+            }
+            break;
+        }
+    }
+    // every block is busy, go over the target rather than wait
+    // if we can, the excess is freed as blocks are released
+    if ((blk = block_new(bc)) != NULL) {
+        return blk;
+    }
+    cnd_wait(&bc->idle, &bc->lock);
+    return NULL;
+}
+
+mx_status_t bcache_sync(bcache_t* bc) {
+    mtx_lock(&bc->lock);
+    bcache_quiesce_locked(bc);
+    mx_status_t status = bcache_flush_locked(bc, false);
+    bcache_resume_locked(bc);
+    mtx_unlock(&bc->lock);
+    return status;
+}
+
+// how deeply the calling thread's transactions are nested
+static thread_local uint32_t txn_depth;
+
+void bcache_txn_begin(bcache_t* bc) {
+    mtx_lock(&bc->lock);
+    if (txn_depth++ == 0) {
+        while ((bc->quiesce > 0) || bc->commit_due) {
+            cnd_wait(&bc->txn_idle, &bc->lock);
+        }
+    }
+    bc->txns++;
+    mtx_unlock(&bc->lock);
+}
+
+void bcache_txn_end(bcache_t* bc) {
+    mtx_lock(&bc->lock);
+    txn_depth--;
+    // keep records well within what the journal can hold
+    if ((bc->jnl_count > 0) && (bc->meta >= (bc->jnl_count / 4))) {
+        bc->commit_due = true;
+    }
+    if (--bc->txns == 0) {
+        if (bc->commit_due && (bc->quiesce == 0)) {
+            bcache_flush_locked(bc, false);
+        }
+        bc->commit_due = false;
+        cnd_broadcast(&bc->txn_idle);
+    }
+    mtx_unlock(&bc->lock);
+}
+
+void bcache_resize(bcache_t* bc, uint32_t num) {
+    if (num > bc->limit) {
+        num = bc->limit;
+    }
+    if (num < BCACHE_MIN_BLOCKS) {
+        num = BCACHE_MIN_BLOCKS;
+    }
+    mtx_lock(&bc->lock);
+    trace(BCACHE, "[ resize from %u to %u blocks ]\n", bc->target, num);
+    bc->target = num;
+    if (bc->count > bc->target) {
+        bcache_quiesce_locked(bc);
+        bcache_flush_locked(bc, true);
+        bcache_trim_locked(bc);
+        bcache_resume_locked(bc);
+    }
+    mtx_unlock(&bc->lock);
+}
+
+void bcache_get_info(bcache_t* bc, vfs_cache_info_t* info) {
+    mtx_lock(&bc->lock);
+    memset(info, 0, sizeof(*info));
+    info->hits = bc->hits;
+    info->misses = bc->misses;
+    info->read_ahead = bc->read_ahead;
+    info->writes = bc->writes;
+    info->block_size = bc->blocksize;
+    info->blocks = bc->count;
+    info->target = bc->target;
+    info->limit = bc->limit;
+    info->dirty = bc->dirty;
+    info->logged = bc->logged;
+    info->commits = bc->commits;
+    info->logged_writes = bc->logged_writes;
+    mtx_unlock(&bc->lock);
+}
 
 void bcache_invalidate(bcache_t* bc) {
     block_t* blk;
     uint32_t n = 0;
-    while ((blk = list_remove_head_type(&bc->list_lru, block_t, listnode)) != NULL) {
-        if (blk->flags & BLOCK_BUSY) {
-            panic("blk %p bno %u is busy on lru\n", blk, blk->bno);
-        }
+    mtx_lock(&bc->lock);
+    while (((blk = list_remove_head_type(&bc->list_cold, block_t, listnode)) != NULL) ||
+           ((blk = list_remove_head_type(&bc->list_hot, block_t, listnode)) != NULL)) {
         // remove from hash, bno to be reassigned
         list_delete(&blk->hashnode);
         list_add_tail(&bc->list_free, &blk->listnode);
         n++;
     }
+    bc->cold = 0;
+    mtx_unlock(&bc->lock);
     trace(BCACHE, "[ %d blocks dropped ]\n", n);
 }
 
@@ -113,40 +764,61 @@ static block_t* _bcache_get(bcache_t* bc, uint32_t bno, void** data, uint32_t mo
         return NULL;
     }
     block_t* blk;
-    uint32_t bucket = bno_hash(bno);
-    list_for_every_entry(bc->hash + bucket, blk, block_t, hashnode) {
+    list_node_t* bucket = bc->hash + bno_hash(bc, bno);
+    mtx_lock(&bc->lock);
+restart:
+    list_for_every_entry(bucket, blk, block_t, hashnode) {
         if (blk->bno == bno) {
             if (blk->flags & BLOCK_BUSY) {
-                panic("blk %p bno %u is busy\n", blk, bno);
+                // wait for whoever has it to release it
+                cnd_wait(&bc->idle, &bc->lock);
+                goto restart;
             }
-            // remove from dirty or lru
+            // remove from dirty, logged, cold, or hot
             list_delete(&blk->listnode);
+            if (blk->flags & BLOCK_DIRTY) {
+                bc->dirty--;
+                bc->meta -= block_is_meta(blk);
+            } else if (blk->flags & BLOCK_LOGGED) {
+                bc->logged--;
+            } else if (!(blk->flags & BLOCK_HOT)) {
+                bc->cold--;
+            }
+            if (mode == MODE_ZERO) {
+                if (!(blk->flags & BLOCK_DIRTY)) {
+                    blk->flags |= BLOCK_DIRTY | BLOCK_DATA;
+                }
+                memset(blk->data, 0, bc->blocksize);
+            }
+            bc->hits++;
             goto done;
         }
     }
     if (mode == MODE_FIND) {
         blk = NULL;
     } else {
-        if ((blk = list_remove_head_type(&bc->list_free, block_t, listnode)) != NULL) {
-            // nothing extra to do
-        } else if ((blk = list_remove_head_type(&bc->list_lru, block_t, listnode)) != NULL) {
-            if (blk->flags & BLOCK_BUSY) {
-                panic("blk %p bno %u is busy on lru\n", blk, blk->bno);
-            }
-            // remove from hash, bno to be reassigned
-            list_delete(&blk->hashnode);
-        } else {
-            panic("bcache: out of blocks\n");
+        if ((blk = bcache_alloc_locked(bc)) == NULL) {
+            goto restart;
         }
         blk->bno = bno;
-        list_add_tail(bc->hash + bucket, &blk->hashnode);
+        blk->flags = ghost_remove(bc, bno) ? BLOCK_HOT : 0;
+        list_add_tail(bucket, &blk->hashnode);
         if (mode == MODE_ZERO) {
-            blk->flags |= BLOCK_DIRTY;
+            // nothing refers to it yet, so it may be written anytime
+            blk->flags |= BLOCK_DIRTY | BLOCK_DATA;
             memset(blk->data, 0, bc->blocksize);
         } else {
-            if (readblk(bc->fd, bno, blk->data) < 0) {
+            bc->misses++;
+            // busy already, so others looking for it wait for the read
+            blk->flags |= BLOCK_BUSY;
+            list_add_tail(&bc->list_busy, &blk->listnode);
+            mtx_unlock(&bc->lock);
+            if (readblk(bc, bno, blk->data) < 0) {
                 panic("bcache: bno %u read error!\n", bno);
             }
+            *data = blk->data;
+            trace(BCACHE, "bcache_get bno=%u %p\n", bno, blk);
+            return blk;
         }
     }
 done:
@@ -155,10 +827,89 @@ done:
         list_add_tail(&bc->list_busy, &blk->listnode);
         *data = blk->data;
     }
+    mtx_unlock(&bc->lock);
     trace(BCACHE, "bcache_get bno=%u %p\n", bno, blk);
     return blk;
 }
 
+static block_t* bcache_find_locked(bcache_t* bc, uint32_t bno) {
+    block_t* blk;
+    list_for_every_entry(bc->hash + bno_hash(bc, bno), blk, block_t, hashnode) {
+        if (blk->bno == bno) {
+            return blk;
+        }
+    }
+    return NULL;
+}
+
+// Bring count blocks from bno on into the cache, as few reads as
+// possible, before anyone asks for them.  Blocks already cached are
+// skipped, and it gives up rather than write back or wait for room.
+// They go on the cold queue, so a long sequential read that is never
+// looked at again still only displaces other blocks seen once.
+void bcache_readahead(bcache_t* bc, uint32_t bno, uint32_t count) {
+    trace(BCACHE, "bcache_readahead() bno=%u count=%u\n", bno, count);
+    if (bno >= bc->blockmax) {
+        return;
+    }
+    if (count > (bc->blockmax - bno)) {
+        count = bc->blockmax - bno;
+    }
+    block_t* run[BCACHE_MAX_RUN];
+    struct iovec iov[BCACHE_MAX_RUN];
+    mtx_lock(&bc->lock);
+    // never more than the cold queue is meant to hold
+    if (count > (bc->target / 4)) {
+        count = bc->target / 4;
+    }
+    while (count > 0) {
+        if (bcache_find_locked(bc, bno) != NULL) {
+            bno++;
+            count--;
+            continue;
+        }
+        // busy already, so others looking for them wait for the read
+        uint32_t n = 0;
+        block_t* blk;
+        while ((n < count) && (n < BCACHE_MAX_RUN) &&
+               (bcache_find_locked(bc, bno + n) == NULL) &&
+               ((blk = bcache_alloc_idle_locked(bc)) != NULL)) {
+            blk->bno = bno + n;
+            blk->flags = (ghost_remove(bc, blk->bno) ? BLOCK_HOT : 0) | BLOCK_BUSY;
+            list_add_tail(bc->hash + bno_hash(bc, blk->bno), &blk->hashnode);
+            list_add_tail(&bc->list_busy, &blk->listnode);
+            iov[n].iov_base = blk->data;
+            iov[n].iov_len = bc->blocksize;
+            run[n++] = blk;
+        }
+        if (n == 0) {
+            break;
+        }
+        mtx_unlock(&bc->lock);
+        int r = readblks(bc, bno, iov, n);
+        mtx_lock(&bc->lock);
+        for (uint32_t i = 0; i < n; i++) {
+            blk = run[i];
+            list_delete(&blk->listnode);
+            blk->flags &= (~BLOCK_BUSY);
+            if (r < 0) {
+                list_delete(&blk->hashnode);
+                list_add_tail(&bc->list_free, &blk->listnode);
+            } else {
+                bcache_add_clean_locked(bc, blk);
+            }
+        }
+        cnd_broadcast(&bc->idle);
+        if (r < 0) {
+            break;
+        }
+        bc->read_ahead += n;
+        bno += n;
+        count -= n;
+    }
+    mtx_unlock(&bc->lock);
+}
+
 block_t* bcache_get(bcache_t* bc, uint32_t bno, void** bdata) {
     return _bcache_get(bc, bno, bdata, MODE_LOAD);
 }
@@ -169,20 +920,39 @@ block_t* bcache_get_zero(bcache_t* bc, uint32_t bno, void** bdata) {
 
 void bcache_put(bcache_t* bc, block_t* blk, uint32_t flags) {
     trace(BCACHE, "bcache_put() bno=%u%s\n", blk->bno, (flags & BLOCK_DIRTY) ? " DIRTY" : "");
+    mtx_lock(&bc->lock);
     if (!(blk->flags & BLOCK_BUSY)) {
         panic("bcache_put() bno=%u NOT BUSY!\n", blk->bno);
     }
     // remove from busy list
     list_delete(&blk->listnode);
-    if ((flags | blk->flags) & BLOCK_DIRTY) {
-        if (writeblk(bc->fd, blk->bno, blk->data) < 0) {
-            error("block write error!\n");
+    blk->flags &= (~BLOCK_BUSY);
+    if (flags & BLOCK_DIRTY) {
+        if (!(blk->flags & BLOCK_DIRTY)) {
+            blk->flags |= BLOCK_DIRTY | (flags & BLOCK_DATA);
+        } else if (!(flags & BLOCK_DATA)) {
+            // once metadata, dirty until it is written back
+            blk->flags &= (~BLOCK_DATA);
         }
-        blk->flags &= (~(BLOCK_DIRTY|BLOCK_BUSY));
+    }
+    if (blk->flags & BLOCK_DIRTY) {
+        // written back on eviction, bcache_sync(), or by the flusher
+        list_add_tail(&bc->list_dirty, &blk->listnode);
+        bc->dirty++;
+        bc->meta += block_is_meta(blk);
+    } else if (blk->flags & BLOCK_LOGGED) {
+        // written in place by the next checkpoint
+        list_add_tail(&bc->list_logged, &blk->listnode);
+        bc->logged++;
+    } else if (bc->count > bc->target) {
+        // the cache is shrinking or went over while everything was busy
+        list_delete(&blk->hashnode);
+        block_free(bc, blk);
     } else {
-        blk->flags &= (~BLOCK_BUSY);
+        bcache_add_clean_locked(bc, blk);
     }
-    list_add_tail(&bc->list_lru, &blk->listnode);
+    cnd_broadcast(&bc->idle);
+    mtx_unlock(&bc->lock);
 }
 
 mx_status_t bcache_read(bcache_t* bc, uint32_t bno, void* data, uint32_t off, uint32_t len) {
@@ -201,33 +971,183 @@ mx_status_t bcache_read(bcache_t* bc, uint32_t bno, void* data, uint32_t off, ui
     }
 }
 
+mx_status_t bcache_journal_init(bcache_t* bc, uint32_t start, uint32_t count) {
+    minfs_journal_info_t* ji;
+    block_t* blk;
+    if ((blk = bcache_get_zero(bc, start, (void**) &ji)) == NULL) {
+        return ERR_IO;
+    }
+    ji->magic = MINFS_MAGIC_JOURNAL;
+    ji->seq = 1;
+    bcache_put(bc, blk, BLOCK_DIRTY);
+    // so that nothing left over from before looks like a record
+    void* data;
+    if ((blk = bcache_get_zero(bc, start + 1, &data)) == NULL) {
+        return ERR_IO;
+    }
+    bcache_put(bc, blk, BLOCK_DIRTY);
+    return NO_ERROR;
+}
+
+// Check the record at the journal head, with its header in
+// bc->jnl_buf, and return how many blocks it holds, or 0 if it
+// is not valid and so ends the journal.
+static uint32_t bcache_journal_check(bcache_t* bc, uint32_t start, uint32_t count) {
+    minfs_journal_record_t* rec = bc->jnl_buf;
+    if ((rec->magic != MINFS_MAGIC_JOURNAL_REC) || (rec->seq != bc->jnl_seq) ||
+        (rec->count == 0) || (rec->count >= (count - bc->jnl_head))) {
+        return 0;
+    }
+    uint32_t sum = rec->checksum;
+    uint32_t check = FNV32_OFFSET_BASIS;
+    void* data;
+    if ((data = malloc(bc->blocksize)) == NULL) {
+        return 0;
+    }
+    rec->checksum = 0;
+    const uint8_t* p = (void*) rec;
+    for (uint32_t n = 0; n <= rec->count; n++) {
+        if (n && ((rec->bno[n - 1] >= bc->blockmax) ||
+                  (readblk(bc, start + bc->jnl_head + n, data) < 0))) {
+            break;
+        }
+        for (uint32_t i = 0; i < bc->blocksize; i++) {
+            check = (check ^ p[i]) * FNV32_PRIME;
+        }
+        p = data;
+    }
+    free(data);
+    rec->checksum = sum;
+    return (check == sum) ? rec->count : 0;
+}
+
+mx_status_t bcache_journal_open(bcache_t* bc, uint32_t start, uint32_t count) {
+    if ((count < 2) || (start > bc->blockmax) || (count > (bc->blockmax - start))) {
+        return ERR_INVALID_ARGS;
+    }
+    if ((bc->jnl_buf = malloc(bc->blocksize)) == NULL) {
+        return ERR_NO_MEMORY;
+    }
+    bc->jnl_start = start;
+    minfs_journal_info_t* ji = bc->jnl_buf;
+    if ((readblk(bc, start, ji) < 0) || (ji->magic != MINFS_MAGIC_JOURNAL)) {
+        error("minfs: bad journal\n");
+        free(bc->jnl_buf);
+        bc->jnl_buf = NULL;
+        return ERR_IO;
+    }
+    bc->jnl_seq = ji->seq;
+    bc->jnl_head = 1;
+
+    // bring each valid record's blocks into the cache, dirty; each is
+    // read before its cache block is taken, so one that cannot be read
+    // leaves nothing wrong in the cache, and the mount fails rather
+    // than leave the record half replayed
+    mx_status_t status = NO_ERROR;
+    void* buf;
+    if ((buf = malloc(bc->blocksize)) == NULL) {
+        status = ERR_NO_MEMORY;
+    }
+    uint32_t records = 0;
+    uint32_t n;
+    while (status == NO_ERROR) {
+        minfs_journal_record_t* rec = bc->jnl_buf;
+        if ((bc->jnl_head >= count) ||
+            (readblk(bc, start + bc->jnl_head, rec) < 0) ||
+            ((n = bcache_journal_check(bc, start, count)) == 0)) {
+            break;
+        }
+        uint32_t* bnos;
+        if ((bnos = malloc(n * sizeof(uint32_t))) == NULL) {
+            status = ERR_NO_MEMORY;
+            break;
+        }
+        memcpy(bnos, rec->bno, n * sizeof(uint32_t));
+        for (uint32_t i = 0; i < n; i++) {
+            void* data;
+            block_t* blk;
+            if (readblk(bc, start + bc->jnl_head + 1 + i, buf) < 0) {
+                status = ERR_IO;
+                break;
+            }
+            if ((blk = bcache_get_zero(bc, bnos[i], &data)) == NULL) {
+                status = ERR_NO_RESOURCES;
+                break;
+            }
+            memcpy(data, buf, bc->blocksize);
+            bcache_put(bc, blk, BLOCK_DIRTY);
+        }
+        free(bnos);
+        bc->jnl_head += n + 1;
+        bc->jnl_seq++;
+        records++;
+    }
+    free(buf);
+    if (status < 0) {
+        error("minfs: cannot replay journal record %u: %d\n", records, status);
+        free(bc->jnl_buf);
+        bc->jnl_buf = NULL;
+        return status;
+    }
+
+    // write them in place, then start the journal over
+    mtx_lock(&bc->lock);
+    if (records > 0) {
+        info("minfs: replaying %u journal records\n", records);
+        uint32_t written;
+        if (((status = bcache_write_data_locked(bc, &written)) == NO_ERROR) &&
+            ((status = bcache_barrier(bc)) == NO_ERROR)) {
+            status = bcache_journal_reset_locked(bc, bc->jnl_seq);
+        }
+    }
+    if (status == NO_ERROR) {
+        bc->jnl_start = start;
+        bc->jnl_count = count;
+        bc->jnl_head = 1;
+    }
+    mtx_unlock(&bc->lock);
+    return status;
+}
+
 int bcache_create(bcache_t** out, int fd, uint32_t blockmax, uint32_t blocksize, uint32_t num) {
     bcache_t* bc;
     if ((bc = calloc(1, sizeof(bcache_t))) == NULL) {
         return -1;
     }
+    if (num < BCACHE_MIN_BLOCKS) {
+        num = BCACHE_MIN_BLOCKS;
+    }
+    // about one bucket per block, within what fnv1a_tiny() can do
+    bc->hashbits = MINFS_HASH_BITS;
+    while ((bc->hashbits < 16) && ((1U << bc->hashbits) < num)) {
+        bc->hashbits++;
+    }
+    if (((bc->hash = calloc(1U << bc->hashbits, sizeof(list_node_t))) == NULL) ||
+        ((bc->ghost_hash = calloc(1U << bc->hashbits, sizeof(list_node_t))) == NULL)) {
+        free(bc->hash);
+        free(bc);
+        return -1;
+    }
+    mtx_init(&bc->lock, mtx_plain);
+    cnd_init(&bc->idle);
+    cnd_init(&bc->txn_idle);
     bc->fd = fd;
     bc->blockmax = blockmax;
     bc->blocksize = blocksize;
+    bc->target = num;
+    bc->limit = num;
     list_initialize(&bc->list_busy);
     list_initialize(&bc->list_dirty);
-    list_initialize(&bc->list_lru);
+    list_initialize(&bc->list_cold);
+    list_initialize(&bc->list_hot);
     list_initialize(&bc->list_free);
-    for (int n = 0; n < MINFS_BUCKETS; n++) {
+    list_initialize(&bc->list_ghost);
+    list_initialize(&bc->list_logged);
+    for (uint32_t n = 0; n < (1U << bc->hashbits); n++) {
         list_initialize(bc->hash + n);
+        list_initialize(bc->ghost_hash + n);
     }
-    while (num > 0) {
-        block_t* blk;
-        if ((blk = calloc(1, sizeof(block_t))) == NULL) {
-            break;
-        }
-        if ((blk->data = malloc(bc->blocksize)) == NULL) {
-            free(blk);
-            break;
-        }
-        list_add_tail(&bc->list_free, &blk->listnode);
-        num--;
-    }
+    // blocks are allocated as they are needed
     *out = bc;
     return 0;
 }
@@ -22,6 +22,18 @@ mx_status_t bitmap_init(bitmap_t* bm, uint32_t max) {
         return ERR_NO_MEMORY;
     }
     bm->end = bm->map + bm->mapcount;
+
+    // add summary levels until one word covers everything
+    bm->levels = 0;
+    uint32_t count = bm->mapcount;
+    while (count > 1) {
+        count = (count + 63) / 64;
+        if ((bm->summary[bm->levels] = calloc(count, sizeof(uint64_t))) == NULL) {
+            bitmap_destroy(bm);
+            return ERR_NO_MEMORY;
+        }
+        bm->sumcount[bm->levels++] = count;
+    }
     return NO_ERROR;
 }
 
@@ -35,36 +47,168 @@ mx_status_t bitmap_resize(bitmap_t* bm, uint32_t max) {
 
 void bitmap_destroy(bitmap_t* bm) {
     free(bm->map);
+    for (uint32_t l = 0; l < bm->levels; l++) {
+        free(bm->summary[l]);
+    }
+}
+
+// word is now all ones
+void bitmap_summary_set(bitmap_t* bm, uint32_t word) {
+    for (uint32_t l = 0; l < bm->levels; l++) {
+        uint64_t* sum = bm->summary[l] + (word >> 6);
+        *sum |= (1ULL << (word & 63));
+        if (*sum != ~0ULL) {
+            break;
+        }
+        word >>= 6;
+    }
+}
+
+// word is about to stop being all ones
+void bitmap_summary_clr(bitmap_t* bm, uint32_t word) {
+    for (uint32_t l = 0; l < bm->levels; l++) {
+        uint64_t* sum = bm->summary[l] + (word >> 6);
+        bool full = (*sum == ~0ULL);
+        *sum &= ~(1ULL << (word & 63));
+        if (!full) {
+            break;
+        }
+        word >>= 6;
+    }
+}
+
+void bitmap_update_summary(bitmap_t* bm) {
+    for (uint32_t l = 0; l < bm->levels; l++) {
+        memset(bm->summary[l], 0, bm->sumcount[l] * sizeof(uint64_t));
+    }
+    for (uint32_t n = 0; n < bm->mapcount; n++) {
+        if (bm->map[n] == ~0ULL) {
+            bitmap_summary_set(bm, n);
+        }
+    }
 }
 
 static void bitmap_zero(bitmap_t* bm) {
     memset(bm->map, 0, bm->bitcount / 8);
+    bitmap_update_summary(bm);
+}
+
+// Index of the first word at or after word which is not all ones,
+// at level l of the bitmap: the map itself for 0, summary l-1 above.
+static uint32_t next_open_word(bitmap_t* bm, uint32_t l, uint32_t word) {
+    uint64_t* words = l ? bm->summary[l - 1] : bm->map;
+    uint32_t count = l ? bm->sumcount[l - 1] : bm->mapcount;
+    if (l == bm->levels) {
+        // the top level is a single word
+        for (; word < count; word++) {
+            if (words[word] != ~0ULL) {
+                return word;
+            }
+        }
+        return BITMAP_FAIL;
+    }
+    if (word >= count) {
+        return BITMAP_FAIL;
+    }
+    // look in the rest of the summary word covering this one,
+    // then ask the level above for the next summary word with room
+    uint64_t* sum = bm->summary[l];
+    uint32_t s = word >> 6;
+    uint64_t open = ~sum[s] & (~0ULL << (word & 63));
+    if (open == 0) {
+        if ((s = next_open_word(bm, l + 1, s + 1)) == BITMAP_FAIL) {
+            return BITMAP_FAIL;
+        }
+        open = ~sum[s];
+    }
+    word = (s << 6) + __builtin_ctzll(open);
+    return (word < count) ? word : BITMAP_FAIL;
+}
+
+uint32_t bitmap_find(bitmap_t* bm, uint32_t minbit) {
+    if (minbit >= bm->bitcount) {
+        return BITMAP_FAIL;
+    }
+    uint32_t word = minbit >> 6;
+    uint64_t open = ~bm->map[word] & (~0ULL << (minbit & 63));
+    if (open == 0) {
+        if ((word = next_open_word(bm, 0, word + 1)) == BITMAP_FAIL) {
+            return BITMAP_FAIL;
+        }
+        open = ~bm->map[word];
+    }
+    // bits past bitcount are always clear, so finding one
+    // means there was nothing free before it
+    uint32_t n = (word << 6) + __builtin_ctzll(open);
+    return (n < bm->bitcount) ? n : BITMAP_FAIL;
+}
+
+// number of clear bits starting at clear bit n, up to max
+static uint32_t bitmap_run(bitmap_t* bm, uint32_t n, uint32_t max) {
+    uint32_t end = n + max;
+    if ((end < n) || (end > bm->bitcount)) {
+        end = bm->bitcount;
+    }
+    uint32_t i = n;
+    while (i < end) {
+        uint64_t v = bm->map[i >> 6] >> (i & 63);
+        if (v != 0) {
+            i += __builtin_ctzll(v);
+            break;
+        }
+        i += 64 - (i & 63);
+    }
+    return ((i < end) ? i : end) - n;
+}
+
+// how many runs shorter than asked for bitmap_alloc_run() looks past
+#define BITMAP_RUN_TRIES 16
+
+uint32_t bitmap_alloc_run(bitmap_t* bm, uint32_t minbit, uint32_t max, uint32_t* count) {
+    if (max == 0) {
+        max = 1;
+    }
+    uint32_t best = BITMAP_FAIL;
+    uint32_t best_len = 0;
+    uint32_t n = minbit;
+    for (unsigned tries = 0; tries < BITMAP_RUN_TRIES; tries++) {
+        if ((n = bitmap_find(bm, n)) == BITMAP_FAIL) {
+            break;
+        }
+        uint32_t len = bitmap_run(bm, n, max);
+        if (len > best_len) {
+            best = n;
+            best_len = len;
+        }
+        // a run starting at minbit itself carries on from whatever
+        // is before it, so take it however short it is
+        if ((len == max) || (n == minbit)) {
+            break;
+        }
+        n += len;
+    }
+    if (best == BITMAP_FAIL) {
+        return BITMAP_FAIL;
+    }
+    for (uint32_t i = 0; i < best_len; i++) {
+        bitmap_set(bm, best + i);
+    }
+    *count = best_len;
+    return best;
 }
 
 // minbit specifies a bit number which is the minimum to allocate at
 // to avoid making all allocations suffer, we round to the nearest
 // multiple of the sub-bitmap storage unit (a uint64_t).
 uint32_t bitmap_alloc(bitmap_t* bm, uint32_t minbit) {
-    uint64_t* bits = bm->map + ((minbit + 63) >> 6);
-    uint64_t* end = bm->end;
-    while (bits < end) {
-        uint64_t v = *bits;
-        uint32_t n;
-        if ((n = __builtin_ffsll(~v)) != 0) {
-            n--;
-            uint32_t ret = ((bits - bm->map) << 6) + n;
-            // If this is end-1, and the map is full
-            // we might attempt to use a bit past the
-            // end.  Ensure that we do not.
-            if (ret >= bm->bitcount) {
-                break;
-            }
-            *bits = v | (1ULL << n);
-            return ret;
-        }
-        bits++;
+    uint32_t n;
+    if ((minbit + 63) < minbit) {
+        return BITMAP_FAIL;
+    }
+    if ((n = bitmap_find(bm, (minbit + 63) & ~63)) != BITMAP_FAIL) {
+        bitmap_set(bm, n);
     }
-    return BITMAP_FAIL;
+    return n;
 }
 
 #define FAIL_IF(c) do { if (c) { error("fail: %s\n", #c); return -1; } } while (0)
@@ -110,10 +254,46 @@ int do_bitmap_test(void) {
     for (n = 0; n < 10; n++) {
         bm.map[n] = -1;
     }
+    bitmap_update_summary(&bm);
     FAIL_IF(bitmap_alloc(&bm, 0) != 640);
 
     memset(bm.map, 0xFF, bm.bitcount / 8);
+    bitmap_update_summary(&bm);
+    FAIL_IF(bitmap_alloc(&bm, 0) != BITMAP_FAIL);
+
+    // runs: take the run at minbit, else pass over short ones
+    uint32_t count;
+    bitmap_zero(&bm);
+    bitmap_set(&bm, 10);
+    bitmap_set(&bm, 20);
+    FAIL_IF(bitmap_alloc_run(&bm, 5, 8, &count) != 5 || count != 5);
+    FAIL_IF(bitmap_alloc_run(&bm, 0, 8, &count) != 0 || count != 5);
+    FAIL_IF(bitmap_alloc_run(&bm, 1, 16, &count) != 21 || count != 16);
+    FAIL_IF(bitmap_alloc_run(&bm, 11, 16, &count) != 11 || count != 9);
+    FAIL_IF(bitmap_alloc_run(&bm, 1000, 100, &count) != 1000 || count != 24);
+    FAIL_IF(bitmap_alloc_run(&bm, 1000, 100, &count) != BITMAP_FAIL);
+    FAIL_IF(bitmap_alloc_run(&bm, 900, 100, &count) != 900 || count != 100);
+    bitmap_destroy(&bm);
+
+    // multi-level summary
+    const uint32_t big = 1 << 22;
+    if (bitmap_init(&bm, big)) {
+        error("init failed\n");
+        return -1;
+    }
+    FAIL_IF(bm.levels != 3);
+    for (n = 0; n < big; n++) {
+        bitmap_set(&bm, n);
+    }
+    FAIL_IF(bitmap_find(&bm, 0) != BITMAP_FAIL);
+    bitmap_clr(&bm, big - 3);
+    bitmap_clr(&bm, 77777);
+    FAIL_IF(bitmap_find(&bm, 0) != 77777);
+    FAIL_IF(bitmap_find(&bm, 77778) != big - 3);
+    FAIL_IF(bitmap_alloc(&bm, 0) != 77777);
+    FAIL_IF(bitmap_alloc(&bm, 0) != big - 3);
     FAIL_IF(bitmap_alloc(&bm, 0) != BITMAP_FAIL);
+    bitmap_destroy(&bm);
 
     warn("bitmap: ok\n");
     return 0;
@@ -10,18 +10,82 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#ifdef __Fuchsia__
+#include <threads.h>
+#include <magenta/syscalls.h>
+#endif
+
 #include "minfs-private.h"
 
+// default size of the block cache, which only allocates
+// memory for the blocks it actually holds
+#define MINFS_CACHE_SIZE (8 * 1024 * 1024)
+
+static uint32_t cache_blocks;
+
+// the volume is opened read-write, so the journal can be replayed
 int do_minfs_check(bcache_t* bc, int argc, char** argv) {
     return minfs_check(bc);
 }
 
 #ifdef __Fuchsia__
+// how often the flusher writes back dirty blocks
+#define MINFS_FLUSH_INTERVAL (5000000000ULL)
+
+static int minfs_flusher(void* arg) {
+    bcache_t* bc = arg;
+    for (;;) {
+        mx_nanosleep(MINFS_FLUSH_INTERVAL);
+        bcache_sync(bc);
+    }
+    return 0;
+}
+
+// Shrink the block cache to a quarter of its size when memory
+// runs low, to its minimum when it is critical, and let it grow
+// back once pressure is normal again.
+static int minfs_pressure_watcher(void* arg) {
+    bcache_t* bc = arg;
+    mx_handle_t h = mx_system_get_event(MX_SYSTEM_EVENT_MEMORY_PRESSURE);
+    if (h < 0) {
+        return 0;
+    }
+    const mx_signals_t levels = MX_MEMORY_PRESSURE_NORMAL |
+                                MX_MEMORY_PRESSURE_WARNING |
+                                MX_MEMORY_PRESSURE_CRITICAL;
+    mx_signals_t level = 0;
+    for (;;) {
+        mx_signals_state_t state;
+        if (mx_handle_wait_one(h, levels & (~level), MX_TIME_INFINITE, &state) < 0) {
+            break;
+        }
+        level = state.satisfied & levels;
+        if (level & MX_MEMORY_PRESSURE_CRITICAL) {
+            bcache_resize(bc, 0);
+        } else if (level & MX_MEMORY_PRESSURE_WARNING) {
+            bcache_resize(bc, cache_blocks / 4);
+        } else {
+            bcache_resize(bc, cache_blocks);
+        }
+    }
+    mx_handle_close(h);
+    return 0;
+}
+
 int do_minfs_mount(bcache_t* bc, int argc, char** argv) {
     vnode_t* vn = 0;
     if (minfs_mount(&vn, bc) < 0) {
         return -1;
     }
+    thrd_t t;
+    if (thrd_create_with_name(&t, minfs_flusher, bc, "minfs-flusher") != thrd_success) {
+        fprintf(stderr, "minfs: cannot start flusher\n");
+        return -1;
+    }
+    thrd_detach(t);
+    if (thrd_create_with_name(&t, minfs_pressure_watcher, bc, "minfs-pressure") == thrd_success) {
+        thrd_detach(t);
+    }
     vfs_rpc_server(vn, "fs:/data");
     return 0;
 }
@@ -30,11 +94,16 @@ int run_fs_tests(int argc, char** argv);
 
 static bcache_t* the_block_cache;
 void drop_cache(void) {
+    bcache_sync(the_block_cache);
     bcache_invalidate(the_block_cache);
 }
 
 extern vnode_t* fake_root;
 
+uint32_t fs_inode_count(void) {
+    return fake_root->fs->info.inode_count;
+}
+
 int io_setup(bcache_t* bc) {
     vnode_t* vn = 0;
     if (minfs_mount(&vn, bc) < 0) {
@@ -49,7 +118,18 @@ int do_minfs_test(bcache_t* bc, int argc, char** argv) {
     if (io_setup(bc)) {
         return -1;
     }
-    return run_fs_tests(argc, argv);
+    int r = run_fs_tests(argc, argv);
+    bcache_sync(bc);
+
+    vfs_cache_info_t ci;
+    bcache_get_info(bc, &ci);
+    fprintf(stderr, "minfs: cache: %u blocks, %llu hits, %llu misses, %llu read ahead, "
+            "%llu writes\n", ci.blocks, (unsigned long long)ci.hits,
+            (unsigned long long)ci.misses, (unsigned long long)ci.read_ahead,
+            (unsigned long long)ci.writes);
+    fprintf(stderr, "minfs: journal: %llu commits of %llu blocks, %u not yet in place\n",
+            (unsigned long long)ci.commits, (unsigned long long)ci.logged_writes, ci.logged);
+    return r;
 }
 
 int do_cp(bcache_t* bc, int argc, char** argv) {
@@ -95,13 +175,23 @@ int do_cp(bcache_t* bc, int argc, char** argv) {
 done:
     close(fdi);
     close(fdo);
+    bcache_sync(bc);
     return r;
 }
 
 #endif
 
 int do_minfs_mkfs(bcache_t* bc, int argc, char** argv) {
-    return minfs_mkfs(bc);
+    uint32_t inodes = 0;
+    if (argc > 0) {
+        char* end;
+        inodes = strtoul(argv[0], &end, 10);
+        if ((end == argv[0]) || end[0]) {
+            fprintf(stderr, "minfs: bad inode count: %s\n", argv[0]);
+            return -1;
+        }
+    }
+    return minfs_mkfs(bc, inodes);
 }
 
 struct {
@@ -110,10 +200,10 @@ struct {
     uint32_t flags;
     const char *help;
 } CMDS[] = {
-    { "create", do_minfs_mkfs,  O_RDWR | O_CREAT, "initialize filesystem" },
-    { "mkfs",   do_minfs_mkfs,  O_RDWR | O_CREAT, "initialize filesystem" },
-    { "check",  do_minfs_check, O_RDONLY,         "check filesystem integrity"},
-    { "fsck",   do_minfs_check, O_RDONLY,         "check filesystem integrity"},
+    { "create", do_minfs_mkfs,  O_RDWR | O_CREAT, "initialize filesystem [inode count]" },
+    { "mkfs",   do_minfs_mkfs,  O_RDWR | O_CREAT, "initialize filesystem [inode count]" },
+    { "check",  do_minfs_check, O_RDWR,           "check filesystem integrity"},
+    { "fsck",   do_minfs_check, O_RDWR,           "check filesystem integrity"},
 #ifdef __Fuchsia__
     { "mount",  do_minfs_mount, O_RDWR,           "mount filesystem at /data" },
 #else
@@ -128,6 +218,7 @@ int usage(void) {
             "\n"
             "options:  -v         some debug messages\n"
             "          -vv        all debug messages\n"
+            "          -c <size>  block cache size (default 8M)\n"
             "\n");
     for (unsigned n = 0; n < (sizeof(CMDS) / sizeof(CMDS[0])); n++) {
         fprintf(stderr, "%9s %-10s %s\n", n ? "" : "commands:",
@@ -147,10 +238,43 @@ off_t get_size(int fd) {
 }
 
 
+int parse_size(const char* str, off_t* out) {
+    char* end;
+    off_t size = strtoull(str, &end, 10);
+    if (end == str) {
+        fprintf(stderr, "minfs: bad size: %s\n", str);
+        return -1;
+    }
+    switch (end[0]) {
+    case 'K':
+    case 'k':
+        size *= 1024;
+        end++;
+        break;
+    case 'M':
+    case 'm':
+        size *= (1024*1024);
+        end++;
+        break;
+    case 'G':
+    case 'g':
+        size *= (1024*1024*1024);
+        end++;
+        break;
+    }
+    if (end[0]) {
+        fprintf(stderr, "minfs: bad size: %s\n", str);
+        return -1;
+    }
+    *out = size;
+    return 0;
+}
+
 int do_bitmap_test(void);
 
 int main(int argc, char** argv) {
     off_t size = 0;
+    off_t cache_size = MINFS_CACHE_SIZE;
 
     // handle options
     while (argc > 1) {
@@ -158,12 +282,19 @@ int main(int argc, char** argv) {
             trace_on(TRACE_SOME);
         } else if (!strcmp(argv[1], "-vv")) {
             trace_on(TRACE_ALL);
+        } else if (!strcmp(argv[1], "-c") && (argc > 2)) {
+            if (parse_size(argv[2], &cache_size) < 0) {
+                return usage();
+            }
+            argc--;
+            argv++;
         } else {
             break;
         }
         argc--;
         argv++;
     }
+    cache_blocks = cache_size / MINFS_BLOCK_SIZE;
 
     if (argc < 3) {
         return usage();
@@ -175,26 +306,7 @@ int main(int argc, char** argv) {
     char* sizestr;
     if ((sizestr = strchr(fn, '@')) != NULL) {
         *sizestr++ = 0;
-        char* end;
-        size = strtoull(sizestr, &end, 10);
-        if (end == sizestr) {
-            fprintf(stderr, "minfs: bad size: %s\n", sizestr);
-            return usage();
-        }
-        switch (end[0]) {
-        case 'M':
-        case 'm':
-            size *= (1024*1024);
-            end++;
-            break;
-        case 'G':
-        case 'g':
-            size *= (1024*1024*1024);
-            end++;
-            break;
-        }
-        if (end[0]) {
-            fprintf(stderr, "minfs: bad size: %s\n", sizestr);
+        if (parse_size(sizestr, &size) < 0) {
             return usage();
         }
     }
@@ -226,7 +338,7 @@ found:
     size /= MINFS_BLOCK_SIZE;
 
     bcache_t* bc;
-    if (bcache_create(&bc, fd, size, MINFS_BLOCK_SIZE, 64) < 0) {
+    if (bcache_create(&bc, fd, size, MINFS_BLOCK_SIZE, cache_blocks) < 0) {
         fprintf(stderr, "error: cannot create block cache\n");
         return -1;
     }
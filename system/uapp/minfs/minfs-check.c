@@ -14,8 +14,26 @@
 typedef struct check {
     bitmap_t checked_inodes;
     bitmap_t checked_blocks;
+
+    // how fragmented regular files are
+    uint32_t files;
+    uint32_t file_blocks;
+    uint32_t fragments;
 } check_t;
 
+// count the runs of contiguous blocks that make up a file
+static void check_fragments(check_t* chk, minfs_inode_t* inode,
+                            uint32_t* last, uint32_t bno, uint32_t count) {
+    if (inode->magic != MINFS_MAGIC_FILE) {
+        return;
+    }
+    if (bno != *last + 1) {
+        chk->fragments++;
+    }
+    chk->file_blocks += count;
+    *last = bno + count - 1;
+}
+
 static mx_status_t check_inode(check_t* chk, minfs_t* fs, uint32_t ino, uint32_t parent);
 
 static mx_status_t get_inode(minfs_t* fs, minfs_inode_t* inode, uint32_t ino) {
@@ -41,6 +59,9 @@ static mx_status_t get_inode(minfs_t* fs, minfs_inode_t* inode, uint32_t ino) {
 #define CD_RECURSE 2
 
 static mx_status_t get_inode_nth_bno(minfs_t* fs, minfs_inode_t* inode, uint32_t n, uint32_t* bno_out) {
+    if (minfs_has_extents(fs)) {
+        return minfs_extent_lookup(fs, inode, n, bno_out, NULL);
+    }
     if (n < MINFS_DIRECT) {
         *bno_out = inode->dnum[n];
         return NO_ERROR;
@@ -69,13 +90,65 @@ static mx_status_t get_inode_nth_bno(minfs_t* fs, minfs_inode_t* inode, uint32_t
     return NO_ERROR;
 }
 
+// Read the index of an indexed directory into data, returning
+// NULL if it has none or it is not usable.
+static minfs_dir_index_t* get_dir_index(minfs_t* fs, minfs_inode_t* inode, uint32_t ino,
+                                        void* data) {
+    if (!(inode->dir_flags & MINFS_DIR_INDEXED)) {
+        return NULL;
+    }
+    uint32_t bno;
+    if ((get_inode_nth_bno(fs, inode, 0, &bno) < 0) || (bno == 0)) {
+        error("check: ino#%u: cannot read directory index\n", ino);
+        return NULL;
+    }
+    minfs_dir_index_t* idx = data + MINFS_DIR_INDEX_DIRENT + MINFS_DIRENT_SIZE;
+    minfs_dirent_t* de = data + MINFS_DIR_INDEX_DIRENT;
+    if ((bcache_read(fs->bc, bno, data, 0, MINFS_BLOCK_SIZE) < 0) ||
+        (de->ino != 0) || (de->reclen != (MINFS_BLOCK_SIZE - MINFS_DIR_INDEX_DIRENT)) ||
+        (idx->magic != MINFS_MAGIC_DIR_INDEX) || (idx->count == 0) ||
+        (idx->count > MINFS_DIR_INDEX_MAX) || (idx->entries[0].hash != 0)) {
+        error("check: ino#%u: bad directory index\n", ino);
+        return NULL;
+    }
+    uint32_t blocks = inode->size / MINFS_BLOCK_SIZE;
+    for (uint32_t i = 0; i < idx->count; i++) {
+        if ((idx->entries[i].block == 0) || (idx->entries[i].block >= blocks) ||
+            ((i > 0) && (idx->entries[i].hash <= idx->entries[i - 1].hash))) {
+            error("check: ino#%u: bad directory index entry %u\n", ino, i);
+            return NULL;
+        }
+    }
+    return idx;
+}
+
+// the range of hashes the index allows in directory block n
+static bool dir_index_range(minfs_dir_index_t* idx, uint32_t n, uint32_t* lo, uint64_t* hi) {
+    for (uint32_t i = 0; i < idx->count; i++) {
+        if (idx->entries[i].block == n) {
+            *lo = idx->entries[i].hash;
+            *hi = (i + 1 < idx->count) ? idx->entries[i + 1].hash : (1ULL << 32);
+            return true;
+        }
+    }
+    return false;
+}
+
 static mx_status_t check_directory(check_t* chk, minfs_t* fs, minfs_inode_t* inode,
                                    uint32_t ino, uint32_t parent, uint32_t flags) {
     unsigned eno = 0;
     bool dot = false;
     bool dotdot = false;
     uint32_t dirent_count = 0;
-    for (unsigned n = 0; n < inode->block_count; n++) {
+    uint32_t index_data[MINFS_BLOCK_SIZE / sizeof(uint32_t)];
+    minfs_dir_index_t* idx = get_dir_index(fs, inode, ino, index_data);
+    for (unsigned n = 0; n < (inode->size / MINFS_BLOCK_SIZE); n++) {
+        uint32_t lo = 0;
+        uint64_t hi = 0;
+        if (idx && !dir_index_range(idx, n, &lo, &hi)) {
+            // only "." and ".." may be outside of the index
+            hi = 0;
+        }
         uint32_t bno;
         mx_status_t status;
         if ((status = get_inode_nth_bno(fs, inode, n, &bno)) < 0) {
@@ -122,6 +195,14 @@ static mx_status_t check_directory(check_t* chk, minfs_t* fs, minfs_inode_t* ino
                         error("check: ino#%u: de[%u]: '..' ino=%u (not parent!)\n", ino, eno, de->ino);
                     }
                 }
+                if (idx && !(((de->namelen == 1) || (de->namelen == 2)) && (de->name[0] == '.') &&
+                             (de->name[de->namelen - 1] == '.'))) {
+                    uint32_t hash = minfs_dir_hash(de->name, de->namelen);
+                    if ((hash < lo) || (hash >= hi)) {
+                        error("check: ino#%u: de[%u]: '%.*s' not in the block indexed for it\n",
+                              ino, eno, de->namelen, de->name);
+                    }
+                }
                 //TODO: check for cycles (non-dot/dotdot dir ref already in checked bitmap)
                 if (flags & CD_DUMP) {
                     info("ino#%u: de[%u]: ino=%u type=%u '%.*s'\n",
@@ -172,8 +253,99 @@ const char* check_data_block(check_t* chk, minfs_t* fs, uint32_t bno) {
     return NULL;
 }
 
+typedef struct {
+    check_t* chk;
+    minfs_t* fs;
+    uint32_t ino;
+    uint32_t blocks;
+    uint32_t max;   // one past the last file block mapped
+    uint32_t next;  // lowest file block the next extent may map
+    uint32_t last;  // last data block seen
+    minfs_inode_t* inode;
+} check_extent_t;
+
+static mx_status_t cb_check_extent(void* cookie, const minfs_extent_t* ext, bool leaf) {
+    check_extent_t* ce = cookie;
+    const char* msg;
+    if (leaf) {
+        if ((msg = check_data_block(ce->chk, ce->fs, ext->start)) != NULL) {
+            warn("check: ino#%u: extent block @%u: %s\n", ce->ino, ext->start, msg);
+        }
+        ce->blocks++;
+        return NO_ERROR;
+    }
+#if VERBOSE
+    info("%u+%u@%u, ", ext->fblk, ext->count, ext->start);
+#endif
+    if ((ext->count == 0) || ((ext->fblk + ext->count) < ext->fblk)) {
+        warn("check: ino#%u: extent %u+%u invalid\n", ce->ino, ext->fblk, ext->count);
+        return NO_ERROR;
+    }
+    if (ext->fblk < ce->next) {
+        warn("check: ino#%u: extent %u+%u out of order or overlapping\n",
+             ce->ino, ext->fblk, ext->count);
+    }
+    for (uint32_t n = 0; n < ext->count; n++) {
+        if ((msg = check_data_block(ce->chk, ce->fs, ext->start + n)) != NULL) {
+            warn("check: ino#%u: block %u(@%u): %s\n",
+                 ce->ino, ext->fblk + n, ext->start + n, msg);
+        }
+    }
+    check_fragments(ce->chk, ce->inode, &ce->last, ext->start, ext->count);
+    ce->blocks += ext->count;
+    ce->next = ext->fblk + ext->count;
+    ce->max = ce->next;
+    return NO_ERROR;
+}
+
+static void check_file_size(minfs_inode_t* inode, uint32_t ino, unsigned max) {
+    if (max) {
+        unsigned sizeblocks = inode->size / MINFS_BLOCK_SIZE;
+        if (sizeblocks > max) {
+            warn("check: ino#%u: filesize too large\n", ino);
+        } else if (sizeblocks < (max - 1)) {
+            warn("check: ino#%u: filesize too small\n", ino);
+        }
+    } else {
+        if (inode->size) {
+            warn("check: ino#%u: filesize too large\n", ino);
+        }
+    }
+}
+
+static mx_status_t check_file_extents(check_t* chk, minfs_t* fs,
+                                      minfs_inode_t* inode, uint32_t ino) {
+    if (inode->extent_depth > 1) {
+        error("check: ino#%u: extent depth %u unsupported\n", ino, inode->extent_depth);
+        return ERR_CHECKSUM_FAIL;
+    }
+    check_extent_t ce = {
+        .chk = chk,
+        .fs = fs,
+        .ino = ino,
+        .inode = inode,
+    };
+    mx_status_t status;
+    if ((status = minfs_extent_for_each(fs, inode, cb_check_extent, &ce)) < 0) {
+        error("check: ino#%u: extents not readable\n", ino);
+        return status;
+    }
+#if VERBOSE
+    info("...\n");
+#endif
+    check_file_size(inode, ino, ce.max);
+    if (ce.blocks != inode->block_count) {
+        warn("check: ino#%u: block count %u, actual blocks %u\n",
+             ino, inode->block_count, ce.blocks);
+    }
+    return NO_ERROR;
+}
+
 mx_status_t check_file(check_t* chk, minfs_t* fs,
                        minfs_inode_t* inode, uint32_t ino) {
+    if (minfs_has_extents(fs)) {
+        return check_file_extents(chk, fs, inode, ino);
+    }
 #if VERBOSE
     for (unsigned n = 0; n < MINFS_DIRECT; n++) {
         info("%d, ", inode->dnum[n]);
@@ -182,6 +354,7 @@ mx_status_t check_file(check_t* chk, minfs_t* fs,
 #endif
 
     uint32_t blocks = 0;
+    uint32_t last = 0;
 
     // count and sanity-check indirect blocks
     for (unsigned n = 0; n < MINFS_INDIRECT; n++) {
@@ -209,6 +382,7 @@ mx_status_t check_file(check_t* chk, minfs_t* fs,
             }
         }
         if (bno) {
+            check_fragments(chk, inode, &last, bno, 1);
             blocks++;
             const char* msg;
             if ((msg = check_data_block(chk, fs, bno)) != NULL) {
@@ -217,18 +391,7 @@ mx_status_t check_file(check_t* chk, minfs_t* fs,
             max = n + 1;
         }
     }
-    if (max) {
-        unsigned sizeblocks = inode->size / MINFS_BLOCK_SIZE;
-        if (sizeblocks > max) {
-            warn("check: ino#%u: filesize too large\n", ino);
-        } else if (sizeblocks < (max - 1)) {
-            warn("check: ino#%u: filesize too small\n", ino);
-        }
-    } else {
-        if (inode->size) {
-            warn("check: ino#%u: filesize too large\n", ino);
-        }
-    }
+    check_file_size(inode, ino, max);
     if (blocks != inode->block_count) {
         warn("check: ino#%u: block count %u, actual blocks %u\n",
              ino, inode->block_count, blocks);
@@ -266,6 +429,7 @@ mx_status_t check_inode(check_t* chk, minfs_t* fs, uint32_t ino, uint32_t parent
             return status;
         }
     } else {
+        chk->files++;
         info("ino#%u: FILE blks=%u links=%u size=%u\n",
              ino, inode.block_count, inode.link_count, inode.size);
         if ((status = check_file(chk, fs, &inode, ino)) < 0) {
@@ -289,6 +453,7 @@ mx_status_t minfs_check(bcache_t* bc) {
     }
 
     check_t chk;
+    memset(&chk, 0, sizeof(chk));
     if ((status = bitmap_init(&chk.checked_inodes, info.inode_count)) < 0) {
         return status;
     }
@@ -334,6 +499,12 @@ mx_status_t minfs_check(bcache_t* bc) {
               missing, missing > 1 ? "s" : "");
     }
 
+    if (chk.files) {
+        fprintf(stderr, "check: %u files, %u blocks in %u fragments (%u.%02u per file)\n",
+                chk.files, chk.file_blocks, chk.fragments, chk.fragments / chk.files,
+                (chk.fragments % chk.files) * 100 / chk.files);
+    }
+
     //TODO: check allocated inodes that were abandoned
     //TODO: check allocated blocks that were not accounted for
     //TODO: check unallocated inodes where magic != 0
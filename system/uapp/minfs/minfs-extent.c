@@ -0,0 +1,329 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "minfs-private.h"
+
+// Extent mapping for MINFS_VERSION_EXTENTS volumes.
+//
+// Small files keep their extents in the inode.  Once those run out
+// the inode's extents move to an extent block and the inode indexes
+// extent blocks instead, which are split in half as they fill up.
+// There is no deeper level, so once all MINFS_EXTENTS extent blocks
+// are in use, a full one cannot be split and inserting fails with
+// ERR_TOO_BIG.
+
+// index of the last extent with fblk <= n, or -1 if there is none
+static int extent_search(const minfs_extent_t* ext, uint32_t count, uint32_t n) {
+    uint32_t lo = 0;
+    uint32_t hi = count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (ext[mid].fblk <= n) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return (int)lo - 1;
+}
+
+// Add file block n at bno to the sorted extents ext[*count],
+// growing a neighbouring extent where possible.
+// Returns ERR_NO_RESOURCES if a new extent is needed and there
+// are already max of them.
+static mx_status_t extent_add(minfs_extent_t* ext, uint32_t* count, uint32_t max,
+                              uint32_t n, uint32_t bno) {
+    int i = extent_search(ext, *count, n);
+    uint32_t next = i + 1;
+    bool joins_prev = (i >= 0) && (ext[i].fblk + ext[i].count == n) &&
+                      (ext[i].start + ext[i].count == bno);
+    bool joins_next = (next < *count) && (ext[next].fblk == n + 1) &&
+                      (ext[next].start == bno + 1);
+    if (joins_prev) {
+        ext[i].count++;
+        if (joins_next) {
+            ext[i].count += ext[next].count;
+            memmove(ext + next, ext + next + 1, (*count - next - 1) * sizeof(minfs_extent_t));
+            (*count)--;
+        }
+        return NO_ERROR;
+    }
+    if (joins_next) {
+        ext[next].fblk = n;
+        ext[next].start = bno;
+        ext[next].count++;
+        return NO_ERROR;
+    }
+    if (*count == max) {
+        return ERR_NO_RESOURCES;
+    }
+    memmove(ext + next + 1, ext + next, (*count - next) * sizeof(minfs_extent_t));
+    ext[next].fblk = n;
+    ext[next].start = bno;
+    ext[next].count = 1;
+    (*count)++;
+    return NO_ERROR;
+}
+
+static block_t* extent_block_get(minfs_t* fs, uint32_t bno, minfs_extent_block_t** eb) {
+    block_t* blk;
+    if ((blk = bcache_get(fs->bc, bno, (void**) eb)) == NULL) {
+        return NULL;
+    }
+    if (((*eb)->magic != MINFS_MAGIC_EXTENTS) || ((*eb)->count > MINFS_EXTENTS_PER_BLOCK)) {
+        error("minfs: bad extent block @%u\n", bno);
+        bcache_put(fs->bc, blk, 0);
+        return NULL;
+    }
+    return blk;
+}
+
+mx_status_t minfs_extent_lookup(minfs_t* fs, minfs_inode_t* inode, uint32_t n,
+                                uint32_t* bno_out, uint32_t* goal_out) {
+    const minfs_extent_t* ext = inode->extents;
+    uint32_t count = inode->extent_count;
+    block_t* blk = NULL;
+    int i;
+
+    if (inode->extent_depth > 0) {
+        minfs_extent_block_t* eb;
+        if ((i = extent_search(ext, count, n)) < 0) {
+            return ERR_IO;
+        }
+        if ((blk = extent_block_get(fs, ext[i].start, &eb)) == NULL) {
+            return ERR_IO;
+        }
+        ext = eb->extents;
+        count = eb->count;
+    }
+
+    uint32_t bno = 0;
+    uint32_t goal = 0;
+    if ((i = extent_search(ext, count, n)) >= 0) {
+        uint32_t off = n - ext[i].fblk;
+        if (off < ext[i].count) {
+            bno = ext[i].start + off;
+        } else {
+            // keep the file where it would be had there been no hole
+            goal = ext[i].start + off;
+        }
+    }
+    if (blk) {
+        bcache_put(fs->bc, blk, 0);
+    }
+    *bno_out = bno;
+    if (goal_out) {
+        *goal_out = (goal < fs->info.block_count) ? goal : 0;
+    }
+    return NO_ERROR;
+}
+
+// move the extents in the inode to a new extent block
+static mx_status_t extent_push_down(vnode_t* vn) {
+    minfs_extent_block_t* eb;
+    block_t* blk;
+    uint32_t bno;
+    if ((blk = minfs_new_block(vn->fs, 0, &bno, (void**) &eb)) == NULL) {
+        return ERR_NO_RESOURCES;
+    }
+    eb->magic = MINFS_MAGIC_EXTENTS;
+    eb->count = vn->inode.extent_count;
+    memcpy(eb->extents, vn->inode.extents, eb->count * sizeof(minfs_extent_t));
+    bcache_put(vn->fs->bc, blk, BLOCK_DIRTY);
+
+    memset(vn->inode.extents, 0, sizeof(vn->inode.extents));
+    vn->inode.extents[0].fblk = 0;
+    vn->inode.extents[0].start = bno;
+    vn->inode.extents[0].count = eb->count;
+    vn->inode.extent_count = 1;
+    vn->inode.extent_depth = 1;
+    vn->inode.block_count++;
+    return NO_ERROR;
+}
+
+// split the ith extent block, adding its upper half after it
+static mx_status_t extent_split(vnode_t* vn, int i, minfs_extent_block_t* eb) {
+    uint32_t count = vn->inode.extent_count;
+    if (count == MINFS_EXTENTS) {
+        // file is too fragmented, see MINFS_EXTENTS_MAX
+        return ERR_TOO_BIG;
+    }
+    minfs_extent_block_t* neb;
+    block_t* blk;
+    uint32_t bno;
+    if ((blk = minfs_new_block(vn->fs, 0, &bno, (void**) &neb)) == NULL) {
+        return ERR_NO_RESOURCES;
+    }
+    uint32_t keep = eb->count / 2;
+    neb->magic = MINFS_MAGIC_EXTENTS;
+    neb->count = eb->count - keep;
+    memcpy(neb->extents, eb->extents + keep, neb->count * sizeof(minfs_extent_t));
+    eb->count = keep;
+    bcache_put(vn->fs->bc, blk, BLOCK_DIRTY);
+
+    minfs_extent_t* ext = vn->inode.extents;
+    memmove(ext + i + 2, ext + i + 1, (count - i - 1) * sizeof(minfs_extent_t));
+    ext[i].count = keep;
+    ext[i + 1].fblk = neb->extents[0].fblk;
+    ext[i + 1].start = bno;
+    ext[i + 1].count = neb->count;
+    vn->inode.extent_count++;
+    vn->inode.block_count++;
+    return NO_ERROR;
+}
+
+mx_status_t minfs_extent_insert(vnode_t* vn, uint32_t n, uint32_t bno) {
+    mx_status_t status;
+    uint32_t count;
+    if (vn->inode.extent_depth == 0) {
+        count = vn->inode.extent_count;
+        status = extent_add(vn->inode.extents, &count, MINFS_EXTENTS, n, bno);
+        if (status != ERR_NO_RESOURCES) {
+            vn->inode.extent_count = count;
+            return status;
+        }
+        if ((status = extent_push_down(vn)) < 0) {
+            return status;
+        }
+    }
+
+    for (;;) {
+        minfs_extent_t* ext = vn->inode.extents;
+        int i = extent_search(ext, vn->inode.extent_count, n);
+        minfs_extent_block_t* eb;
+        block_t* blk;
+        if ((i < 0) || ((blk = extent_block_get(vn->fs, ext[i].start, &eb)) == NULL)) {
+            return ERR_IO;
+        }
+        status = extent_add(eb->extents, &eb->count, MINFS_EXTENTS_PER_BLOCK, n, bno);
+        if (status == ERR_NO_RESOURCES) {
+            // make room, then try again in whichever half n is now in
+            status = extent_split(vn, i, eb);
+            bcache_put(vn->fs->bc, blk, BLOCK_DIRTY);
+            if (status < 0) {
+                return status;
+            }
+            continue;
+        }
+        ext[i].count = eb->count;
+        bcache_put(vn->fs->bc, blk, BLOCK_DIRTY);
+        return status;
+    }
+}
+
+mx_status_t minfs_extent_for_each(minfs_t* fs, minfs_inode_t* inode, minfs_extent_cb_t func,
+                                  void* cookie) {
+    mx_status_t status;
+    if (inode->extent_count > MINFS_EXTENTS) {
+        return ERR_IO;
+    }
+    if (inode->extent_depth == 0) {
+        for (uint32_t n = 0; n < inode->extent_count; n++) {
+            if ((status = func(cookie, inode->extents + n, false)) < 0) {
+                return status;
+            }
+        }
+        return NO_ERROR;
+    }
+    for (uint32_t n = 0; n < inode->extent_count; n++) {
+        minfs_extent_t leaf = {
+            .fblk = inode->extents[n].fblk,
+            .start = inode->extents[n].start,
+            .count = 1,
+        };
+        minfs_extent_block_t* eb;
+        block_t* blk;
+        if ((blk = extent_block_get(fs, leaf.start, &eb)) == NULL) {
+            return ERR_IO;
+        }
+        for (uint32_t m = 0; m < eb->count; m++) {
+            if ((status = func(cookie, eb->extents + m, false)) < 0) {
+                bcache_put(fs->bc, blk, 0);
+                return status;
+            }
+        }
+        bcache_put(fs->bc, blk, 0);
+        if ((status = func(cookie, &leaf, true)) < 0) {
+            return status;
+        }
+    }
+    return NO_ERROR;
+}
+
+// Unmap file blocks n and up from the sorted extents ext[*count],
+// passing each run unmapped to func.
+static mx_status_t extent_trim(minfs_extent_t* ext, uint32_t* count, uint32_t n,
+                               minfs_extent_cb_t func, void* cookie) {
+    mx_status_t status;
+    while (*count > 0) {
+        minfs_extent_t* last = ext + *count - 1;
+        if ((last->fblk + last->count) <= n) {
+            break;
+        }
+        minfs_extent_t drop = *last;
+        if (last->fblk < n) {
+            uint32_t keep = n - last->fblk;
+            drop.fblk += keep;
+            drop.start += keep;
+            drop.count -= keep;
+            last->count = keep;
+        } else {
+            memset(last, 0, sizeof(minfs_extent_t));
+            (*count)--;
+        }
+        if ((status = func(cookie, &drop, false)) < 0) {
+            return status;
+        }
+    }
+    return NO_ERROR;
+}
+
+mx_status_t minfs_extent_truncate(vnode_t* vn, uint32_t n, minfs_extent_cb_t func, void* cookie) {
+    minfs_inode_t* inode = &vn->inode;
+    if (inode->extent_count > MINFS_EXTENTS) {
+        return ERR_IO;
+    }
+    mx_status_t status;
+    if (inode->extent_depth == 0) {
+        uint32_t count = inode->extent_count;
+        status = extent_trim(inode->extents, &count, n, func, cookie);
+        inode->extent_count = count;
+        return status;
+    }
+
+    // trim extent blocks from the last one back, dropping those left
+    // empty, until one still maps something below n
+    while (inode->extent_count > 0) {
+        minfs_extent_t* ext = inode->extents + inode->extent_count - 1;
+        minfs_extent_block_t* eb;
+        block_t* blk;
+        if ((blk = extent_block_get(vn->fs, ext->start, &eb)) == NULL) {
+            return ERR_IO;
+        }
+        status = extent_trim(eb->extents, &eb->count, n, func, cookie);
+        ext->count = eb->count;
+        if ((status < 0) || (eb->count > 0)) {
+            bcache_put(vn->fs->bc, blk, BLOCK_DIRTY);
+            return status;
+        }
+        bcache_put(vn->fs->bc, blk, 0);
+        minfs_extent_t leaf = {
+            .fblk = ext->fblk,
+            .start = ext->start,
+            .count = 1,
+        };
+        memset(ext, 0, sizeof(minfs_extent_t));
+        inode->extent_count--;
+        if ((status = func(cookie, &leaf, true)) < 0) {
+            return status;
+        }
+    }
+    // nothing is left, so the extents fit in the inode again
+    inode->extent_depth = 0;
+    return NO_ERROR;
+}
@@ -10,52 +10,198 @@
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#ifdef __Fuchsia__
+#include <magenta/syscalls.h>
+#endif
 #include <mxio/vfs.h>
 
 #include "minfs-private.h"
 
-//TODO: better bitmap block read/write functions
-
-// Allocate a new data block from the block bitmap.
-// Return the underlying block (obtained via bcache_get()).
-// If hint is nonzero it indicates which block number
-// to start the search for free blocks from.
-block_t* minfs_new_block(minfs_t* fs, uint32_t hint, uint32_t* out_bno, void** bdata) {
-    uint32_t bno = bitmap_alloc(&fs->block_map, hint);
-    if ((bno == BITMAP_FAIL) && (hint != 0)) {
-        bno = bitmap_alloc(&fs->block_map, 0);
-    }
-    if (bno == BITMAP_FAIL) {
-        return NULL;
+// Copy block bmbno of the in-memory block bitmap into data, on its
+// way to disk.  Reserved blocks are set in memory but left clear here.
+static void minfs_bitmap_copy(minfs_t* fs, uint32_t bmbno, void* data) {
+    memcpy(data, minfs_bitmap_nth_block(&fs->block_map, bmbno), MINFS_BLOCK_SIZE);
+    uint32_t lo = bmbno * MINFS_BLOCK_BITS;
+    uint32_t hi = lo + MINFS_BLOCK_BITS;
+    uint64_t* bits = data;
+    vnode_t* vn;
+    list_for_every_entry(&fs->resv_list, vn, vnode_t, resvnode) {
+        uint32_t n = (vn->resv_start > lo) ? vn->resv_start : lo;
+        uint32_t end = vn->resv_start + vn->resv_count;
+        if (end > hi) {
+            end = hi;
+        }
+        if (n >= end) {
+            continue;
+        }
+        for (n -= lo, end -= lo; n < end;) {
+            // clear up to the end of the word at a time
+            uint32_t len = 64 - (n & 63);
+            if (len > (end - n)) {
+                len = end - n;
+            }
+            uint64_t mask = (len == 64) ? ~0ULL : ((1ULL << len) - 1);
+            bits[n >> 6] &= ~(mask << (n & 63));
+            n += len;
+        }
     }
+}
 
-    // obtain the in-memory bitmap block
-    uint32_t bmbno;
-    void *bmdata = minfs_bitmap_block(&fs->block_map, &bmbno, bno);
+// Write back the block bitmap after bno has been allocated in
+// memory, and return block bno (obtained via bcache_get_zero()).
+static block_t* minfs_commit_block(minfs_t* fs, uint32_t bno, void** bdata) {
+    uint32_t bmbno = bno / MINFS_BLOCK_BITS;
 
     // obtain the block of the alloc bitmap we need
     block_t* block_abm;
     void* bdata_abm;
     if ((block_abm = bcache_get(fs->bc, fs->info.abm_block + bmbno, &bdata_abm)) == NULL) {
-        bitmap_clr(&fs->block_map, bno);
         return NULL;
     }
 
     // obtain the block we're allocating
     block_t* block;
     if ((block = bcache_get_zero(fs->bc, bno, bdata)) == NULL) {
-        bitmap_clr(&fs->block_map, bno);
         bcache_put(fs->bc, block_abm, 0);
         return NULL;
     }
 
     // commit the bitmap
-    memcpy(bdata_abm, bmdata, MINFS_BLOCK_SIZE);
+    minfs_bitmap_copy(fs, bmbno, bdata_abm);
     bcache_put(fs->bc, block_abm, BLOCK_DIRTY);
+    return block;
+}
+
+static void minfs_vnode_unreserve_locked(vnode_t* vn) {
+    if (vn->resv_count == 0) {
+        return;
+    }
+    // never made it to disk, so only the in-memory bitmap changes
+    for (uint32_t n = 0; n < vn->resv_count; n++) {
+        bitmap_clr(&vn->fs->block_map, vn->resv_start + n);
+    }
+    vn->resv_count = 0;
+    list_delete(&vn->resvnode);
+}
+
+// Allocate up to want blocks in a row, preferably from goal on.
+// When the volume is full, everyone's reservations are given up.
+static uint32_t minfs_alloc_run(minfs_t* fs, uint32_t goal, uint32_t want, uint32_t* count) {
+    uint32_t bno;
+    if ((goal > fs->info.dat_block) && (goal < fs->info.block_count)) {
+        if ((bno = bitmap_alloc_run(&fs->block_map, goal, want, count)) != BITMAP_FAIL) {
+            return bno;
+        }
+    }
+    if ((bno = bitmap_alloc_run(&fs->block_map, fs->info.dat_block, want, count)) != BITMAP_FAIL) {
+        return bno;
+    }
+    if (list_is_empty(&fs->resv_list)) {
+        return BITMAP_FAIL;
+    }
+    vnode_t* vn;
+    while ((vn = list_peek_head_type(&fs->resv_list, vnode_t, resvnode)) != NULL) {
+        minfs_vnode_unreserve_locked(vn);
+    }
+    return bitmap_alloc_run(&fs->block_map, fs->info.dat_block, want, count);
+}
+
+// Allocate a new data block from the block bitmap.
+// Return the underlying block (obtained via bcache_get()).
+// If hint is nonzero it indicates which block number
+// to start the search for free blocks from.
+block_t* minfs_new_block(minfs_t* fs, uint32_t hint, uint32_t* out_bno, void** bdata) {
+    uint32_t count;
+    uint32_t bno;
+    block_t* block = NULL;
+    mtx_lock(&fs->alloc_lock);
+    if ((bno = minfs_alloc_run(fs, hint, 1, &count)) == BITMAP_FAIL) {
+        goto done;
+    }
+    if ((block = minfs_commit_block(fs, bno, bdata)) == NULL) {
+        bitmap_clr(&fs->block_map, bno);
+        goto done;
+    }
+    *out_bno = bno;
+done:
+    mtx_unlock(&fs->alloc_lock);
+    return block;
+}
+
+void minfs_vnode_unreserve(vnode_t* vn) {
+    mtx_lock(&vn->fs->alloc_lock);
+    minfs_vnode_unreserve_locked(vn);
+    mtx_unlock(&vn->fs->alloc_lock);
+}
+
+block_t* minfs_vnode_new_block(vnode_t* vn, uint32_t n, uint32_t goal,
+                               uint32_t* out_bno, void** bdata) {
+    minfs_t* fs = vn->fs;
+    uint32_t bno;
+    block_t* block = NULL;
+    mtx_lock(&fs->alloc_lock);
+    if ((vn->resv_count > 0) && ((goal == 0) || (goal == vn->resv_start))) {
+        bno = vn->resv_start++;
+        if (--vn->resv_count == 0) {
+            list_delete(&vn->resvnode);
+        }
+    } else {
+        // moving elsewhere, the old reservation will not be used
+        minfs_vnode_unreserve_locked(vn);
+
+        // allocate the rest of the write in progress in one go,
+        // and when appending, reserve some way past it too
+        uint32_t want = (vn->write_end > n) ? (vn->write_end - n) : 1;
+        if (n >= ((vn->inode.size + MINFS_BLOCK_SIZE - 1) / MINFS_BLOCK_SIZE)) {
+            if (vn->prealloc == 0) {
+                vn->prealloc = MINFS_PREALLOC_MIN;
+            } else if (vn->prealloc < MINFS_PREALLOC_MAX) {
+                vn->prealloc *= 2;
+            }
+            want += vn->prealloc;
+        }
+
+        uint32_t count;
+        if ((bno = minfs_alloc_run(fs, goal, want, &count)) == BITMAP_FAIL) {
+            goto done;
+        }
+        if (count > 1) {
+            vn->resv_start = bno + 1;
+            vn->resv_count = count - 1;
+            list_add_tail(&fs->resv_list, &vn->resvnode);
+        }
+    }
+
+    if ((block = minfs_commit_block(fs, bno, bdata)) == NULL) {
+        bitmap_clr(&fs->block_map, bno);
+        goto done;
+    }
     *out_bno = bno;
+done:
+    mtx_unlock(&fs->alloc_lock);
     return block;
 }
 
+mx_status_t minfs_block_free(minfs_t* fs, uint32_t bno) {
+    if (bno >= fs->block_map.bitcount) {
+        return ERR_OUT_OF_RANGE;
+    }
+    uint32_t bmbno = bno / MINFS_BLOCK_BITS;
+
+    block_t* block_abm;
+    void* bdata_abm;
+    mtx_lock(&fs->alloc_lock);
+    if ((block_abm = bcache_get(fs->bc, fs->info.abm_block + bmbno, &bdata_abm)) == NULL) {
+        mtx_unlock(&fs->alloc_lock);
+        return ERR_IO;
+    }
+    bitmap_clr(&fs->block_map, bno);
+    minfs_bitmap_copy(fs, bmbno, bdata_abm);
+    bcache_put(fs->bc, block_abm, BLOCK_DIRTY);
+    mtx_unlock(&fs->alloc_lock);
+    return NO_ERROR;
+}
+
 typedef struct {
     block_t* blk;
     uint32_t bno;
@@ -73,7 +219,7 @@ static mx_status_t get_bitmap_block(minfs_t* fs, gbb_ctxt_t* gbb, uint32_t n) {
             return NO_ERROR;
         }
         // write previous block to disk
-        memcpy(gbb->data, bitmap_data(&fs->block_map) + gbb->bno * MINFS_BLOCK_SIZE, MINFS_BLOCK_SIZE);
+        minfs_bitmap_copy(fs, gbb->bno, gbb->data);
         bcache_put(fs->bc, gbb->blk, BLOCK_DIRTY);
     }
     gbb->bno = bno;
@@ -86,45 +232,67 @@ static mx_status_t get_bitmap_block(minfs_t* fs, gbb_ctxt_t* gbb, uint32_t n) {
 
 static void put_bitmap_block(minfs_t* fs, gbb_ctxt_t* gbb) {
     if (gbb->blk) {
-        memcpy(gbb->data, bitmap_data(&fs->block_map) + gbb->bno * MINFS_BLOCK_SIZE, MINFS_BLOCK_SIZE);
+        minfs_bitmap_copy(fs, gbb->bno, gbb->data);
         bcache_put(fs->bc, gbb->blk, BLOCK_DIRTY);
     }
 }
 
-static mx_status_t minfs_inode_destroy(vnode_t* vn) {
+typedef struct {
+    minfs_t* fs;
+    gbb_ctxt_t gbb;
+    uint32_t count;     // blocks freed
+} free_extent_ctxt_t;
+
+static mx_status_t cb_free_extent(void* cookie, const minfs_extent_t* ext, bool leaf) {
+    free_extent_ctxt_t* fec = cookie;
+    for (uint32_t n = 0; n < ext->count; n++) {
+        mx_status_t status;
+        if ((status = get_bitmap_block(fec->fs, &fec->gbb, ext->start + n)) < 0) {
+            return status;
+        }
+        bitmap_clr(&fec->fs->block_map, ext->start + n);
+        fec->count++;
+    }
+    return NO_ERROR;
+}
+
+// Return the blocks of a destroyed inode to the block bitmap.
+// Called with the allocator lock held.
+static mx_status_t minfs_inode_free_blocks(minfs_t* fs, minfs_inode_t* inode) {
     mx_status_t status;
-    minfs_inode_t inode;
     gbb_ctxt_t gbb;
     memset(&gbb, 0, sizeof(gbb));
 
-    trace(MINFS, "inode_destroy() ino=%u\n", vn->ino);
-
-    // save local copy, destroy inode on disk
-    memcpy(&inode, &vn->inode, sizeof(inode));
-    memset(&vn->inode, 0, sizeof(inode));
-    minfs_sync_vnode(vn);
-    minfs_ino_free(vn->fs, vn->ino);
+    if (minfs_has_extents(fs)) {
+        // release all extents and extent blocks
+        free_extent_ctxt_t fec = {
+            .fs = fs,
+        };
+        status = minfs_extent_for_each(fs, inode, cb_free_extent, &fec);
+        put_bitmap_block(fs, &fec.gbb);
+        return status;
+    }
 
     // release all direct blocks
     for (unsigned n = 0; n < MINFS_DIRECT; n++) {
-        if (inode.dnum[n] == 0) {
+        if (inode->dnum[n] == 0) {
             continue;
         }
-        if ((status = get_bitmap_block(vn->fs, &gbb, inode.dnum[n])) < 0) {
+        if ((status = get_bitmap_block(fs, &gbb, inode->dnum[n])) < 0) {
             return status;
         }
-        bitmap_clr(&vn->fs->block_map, inode.dnum[n]);
+        bitmap_clr(&fs->block_map, inode->dnum[n]);
     }
 
     // release all indirect blocks
     for (unsigned n = 0; n < MINFS_INDIRECT; n++) {
-        if (inode.inum[n] == 0) {
+        if (inode->inum[n] == 0) {
             continue;
         }
         uint32_t* entry;
         block_t* blk;
-        if ((blk = bcache_get(vn->fs->bc, inode.inum[n], (void**) &entry)) == NULL) {
-            put_bitmap_block(vn->fs, &gbb);
+        if ((blk = bcache_get(fs->bc, inode->inum[n], (void**) &entry)) == NULL) {
+            put_bitmap_block(fs, &gbb);
             return ERR_IO;
         }
         // release the blocks pointed at by the entries in the indirect block
@@ -132,38 +300,171 @@ static mx_status_t minfs_inode_destroy(vnode_t* vn) {
             if (entry[m] == 0) {
                 continue;
             }
-            if ((status = get_bitmap_block(vn->fs, &gbb, entry[m])) < 0) {
-                put_bitmap_block(vn->fs, &gbb);
+            if ((status = get_bitmap_block(fs, &gbb, entry[m])) < 0) {
+                put_bitmap_block(fs, &gbb);
                 return status;
             }
-            bitmap_clr(&vn->fs->block_map, entry[m]);
+            bitmap_clr(&fs->block_map, entry[m]);
         }
-        bcache_put(vn->fs->bc, blk, 0);
+        bcache_put(fs->bc, blk, 0);
         // release the direct block itself
-        if ((status = get_bitmap_block(vn->fs, &gbb, inode.inum[n])) < 0) {
+        if ((status = get_bitmap_block(fs, &gbb, inode->inum[n])) < 0) {
             return status;
         }
-        bitmap_clr(&vn->fs->block_map, inode.inum[n]);
+        bitmap_clr(&fs->block_map, inode->inum[n]);
+    }
+
+    put_bitmap_block(fs, &gbb);
+    return NO_ERROR;
+}
+
+// Free the blocks of a file from block n on, including indirect
+// blocks left with nothing in them.  Called with the allocator lock
+// held, and does not write back the inode.
+static mx_status_t vn_free_blocks(vnode_t* vn, uint32_t n) {
+    minfs_t* fs = vn->fs;
+    free_extent_ctxt_t fec;
+    memset(&fec, 0, sizeof(fec));
+    fec.fs = fs;
+    mx_status_t status = NO_ERROR;
+
+    if (minfs_has_extents(fs)) {
+        status = minfs_extent_truncate(vn, n, cb_free_extent, &fec);
+        goto done;
+    }
+
+    // single blocks go through the extent callback too
+    minfs_extent_t ext = {
+        .count = 1,
+    };
+    for (uint32_t i = n; i < MINFS_DIRECT; i++) {
+        if (vn->inode.dnum[i] == 0) {
+            continue;
+        }
+        ext.start = vn->inode.dnum[i];
+        if ((status = cb_free_extent(&fec, &ext, false)) < 0) {
+            goto done;
+        }
+        vn->inode.dnum[i] = 0;
+    }
+
+    const uint32_t per = MINFS_BLOCK_SIZE / sizeof(uint32_t);
+    uint32_t first = (n > MINFS_DIRECT) ? (n - MINFS_DIRECT) : 0;
+    for (uint32_t i = first / per; i < MINFS_INDIRECT; i++) {
+        if (vn->inode.inum[i] == 0) {
+            continue;
+        }
+        uint32_t* entry;
+        block_t* blk;
+        if ((blk = bcache_get(fs->bc, vn->inode.inum[i], (void**) &entry)) == NULL) {
+            status = ERR_IO;
+            goto done;
+        }
+        uint32_t flags = 0;
+        for (uint32_t j = (i * per < first) ? (first % per) : 0; j < per; j++) {
+            if (entry[j] == 0) {
+                continue;
+            }
+            ext.start = entry[j];
+            if ((status = cb_free_extent(&fec, &ext, false)) < 0) {
+                break;
+            }
+            entry[j] = 0;
+            flags = BLOCK_DIRTY;
+        }
+        if ((status < 0) || (i * per < first)) {
+            // still maps blocks below n
+            bcache_put(fs->bc, blk, flags);
+            if (status < 0) {
+                goto done;
+            }
+            continue;
+        }
+        bcache_put(fs->bc, blk, 0);
+        ext.start = vn->inode.inum[i];
+        if ((status = cb_free_extent(&fec, &ext, true)) < 0) {
+            goto done;
+        }
+        vn->inode.inum[i] = 0;
     }
 
-    put_bitmap_block(vn->fs, &gbb);
+done:
+    put_bitmap_block(fs, &fec.gbb);
+    vn->inode.block_count -= fec.count;
+    return status;
+}
+
+static mx_status_t minfs_inode_destroy(vnode_t* vn) {
+    minfs_inode_t inode;
+
+    trace(MINFS, "inode_destroy() ino=%u\n", vn->ino);
+
+    // save local copy, destroy inode on disk
+    memcpy(&inode, &vn->inode, sizeof(inode));
+    memset(&vn->inode, 0, sizeof(inode));
+    minfs_sync_vnode(vn);
+    minfs_ino_free(vn->fs, vn->ino);
+
+    mtx_lock(&vn->fs->alloc_lock);
+    mx_status_t status = minfs_inode_free_blocks(vn->fs, &inode);
+    mtx_unlock(&vn->fs->alloc_lock);
+    return status;
+}
+
+static mx_status_t vn_alloc_block_extent(vnode_t* vn, uint32_t n, block_t** out, void** bdata) {
+    uint32_t bno;
+    uint32_t goal;
+    if (minfs_extent_lookup(vn->fs, &vn->inode, n, &bno, &goal) < 0) {
+        error("minfs: cannot map block %u of ino %u\n", n, vn->ino);
+        return ERR_IO;
+    }
+    if (bno != 0) {
+        return ((*out = bcache_get(vn->fs->bc, bno, bdata)) == NULL) ? ERR_IO : NO_ERROR;
+    }
+    block_t* blk;
+    if ((blk = minfs_vnode_new_block(vn, n, goal, &bno, bdata)) == NULL) {
+        return ERR_NO_RESOURCES;
+    }
+    mx_status_t status;
+    if ((status = minfs_extent_insert(vn, n, bno)) < 0) {
+        bcache_put(vn->fs->bc, blk, 0);
+        minfs_block_free(vn->fs, bno);
+        minfs_sync_vnode(vn);
+        return status;
+    }
+    vn->inode.block_count++;
+    minfs_sync_vnode(vn);
+    *out = blk;
     return NO_ERROR;
 }
 
+static block_t* vn_get_block_extent(vnode_t* vn, uint32_t n, void** bdata, bool alloc) {
+    block_t* blk;
+    if (alloc) {
+        return (vn_alloc_block_extent(vn, n, &blk, bdata) < 0) ? NULL : blk;
+    }
+    uint32_t bno;
+    if (minfs_extent_lookup(vn->fs, &vn->inode, n, &bno, NULL) < 0) {
+        error("minfs: cannot map block %u of ino %u\n", n, vn->ino);
+        return NULL;
+    }
+    return (bno != 0) ? bcache_get(vn->fs->bc, bno, bdata) : NULL;
+}
+
 // Obtain the nth block of a vnode.
 // If alloc is true, allocate that block if it doesn't already exist.
 static block_t* vn_get_block(vnode_t* vn, uint32_t n, void** bdata, bool alloc) {
-#if 0
-    uint32_t hint = ((vn->fs->info.block_count - vn->fs->info.dat_block) / 256) * (vn->ino % 256);
-#else
-    uint32_t hint = 0;
-#endif
+    if (minfs_has_extents(vn->fs)) {
+        return vn_get_block_extent(vn, n, bdata, alloc);
+    }
     // direct blocks are simple... is there an entry in dnum[]?
     if (n < MINFS_DIRECT) {
         uint32_t bno;
         if ((bno = vn->inode.dnum[n]) == 0) {
             if (alloc) {
-                block_t* blk = minfs_new_block(vn->fs, hint, &bno, bdata);
+                // try to follow on from the previous block
+                uint32_t goal = (n > 0) && vn->inode.dnum[n - 1] ? vn->inode.dnum[n - 1] + 1 : 0;
+                block_t* blk = minfs_vnode_new_block(vn, n, goal, &bno, bdata);
                 if (blk != NULL) {
                     vn->inode.dnum[n] = bno;
                     vn->inode.block_count++;
@@ -178,6 +479,7 @@ static block_t* vn_get_block(vnode_t* vn, uint32_t n, void** bdata, bool alloc)
     }
 
     // for indirect blocks, adjust past the direct blocks
+    uint32_t fblk = n;
     n -= MINFS_DIRECT;
 
     // determine indices into the indirect block list and into
@@ -219,7 +521,8 @@ static block_t* vn_get_block(vnode_t* vn, uint32_t n, void** bdata, bool alloc)
     if ((bno = ientry[j]) == 0) {
         if (alloc) {
             // allocate a new block
-            blk = minfs_new_block(vn->fs, hint, &bno, bdata);
+            uint32_t goal = (j > 0) && ientry[j - 1] ? ientry[j - 1] + 1 : 0;
+            blk = minfs_vnode_new_block(vn, fblk, goal, &bno, bdata);
             if (blk != NULL) {
                 vn->inode.block_count++;
                 ientry[j] = bno;
@@ -230,190 +533,888 @@ static block_t* vn_get_block(vnode_t* vn, uint32_t n, void** bdata, bool alloc)
         blk = bcache_get(vn->fs->bc, bno, bdata);
     }
 
-    // release indirect block, updating if necessary
-    // and update the inode as well if we changed it
-    bcache_put(vn->fs->bc, iblk, iflags);
-    if (iflags & BLOCK_DIRTY) {
-        minfs_sync_vnode(vn);
+    // release indirect block, updating if necessary
+    // and update the inode as well if we changed it
+    bcache_put(vn->fs->bc, iblk, iflags);
+    if (iflags & BLOCK_DIRTY) {
+        minfs_sync_vnode(vn);
+    }
+
+    return blk;
+}
+
+// Obtain the nth block of a vnode, allocating it if it does not exist,
+// with why it could not be had on failure: ERR_NO_RESOURCES when the
+// volume is full and ERR_TOO_BIG when the file cannot map more runs.
+static mx_status_t vn_alloc_block(vnode_t* vn, uint32_t n, block_t** blk, void** bdata) {
+    if (minfs_has_extents(vn->fs)) {
+        return vn_alloc_block_extent(vn, n, blk, bdata);
+    }
+    return ((*blk = vn_get_block(vn, n, bdata, true)) == NULL) ? ERR_NO_RESOURCES : NO_ERROR;
+}
+
+static inline void vn_put_block(vnode_t* vn, block_t* blk) {
+    bcache_put(vn->fs->bc, blk, 0);
+}
+
+static inline void vn_put_block_dirty(vnode_t* vn, block_t* blk) {
+    bcache_put(vn->fs->bc, blk, BLOCK_DIRTY);
+}
+
+// for blocks holding file contents, which bypass the journal
+static inline void vn_put_block_data(vnode_t* vn, block_t* blk) {
+    bcache_put(vn->fs->bc, blk, BLOCK_DIRTY | BLOCK_DATA);
+}
+
+#define DIR_CB_DONE 0
+#define DIR_CB_NEXT 1
+#define DIR_CB_SAVE 2
+#define DIR_CB_SAVE_SYNC 3
+
+typedef struct dir_args {
+    const char* name;
+    size_t len;
+    uint32_t ino;
+    uint32_t type;
+    uint32_t reclen;
+} dir_args_t;
+
+static mx_status_t cb_dir_find(vnode_t* vndir, minfs_dirent_t* de, dir_args_t* args) {
+    if ((de->ino != 0) && (de->namelen == args->len) &&
+        (!memcmp(de->name, args->name, args->len))) {
+        args->ino = de->ino;
+        args->type = de->type;
+        return DIR_CB_DONE;
+    } else {
+        return DIR_CB_NEXT;
+    }
+}
+
+// caller is expected to prevent unlink of "." or "..",
+// and to have checked that a directory being unlinked is empty
+static mx_status_t cb_dir_unlink(vnode_t* vndir, minfs_dirent_t* de, dir_args_t* args) {
+    if ((de->ino == 0) || (args->len != de->namelen) ||
+        memcmp(args->name, de->name, args->len)) {
+        return DIR_CB_NEXT;
+    }
+
+    // erase dirent (convert to empty entry), decrement dirent count
+    de->ino = 0;
+    vndir->inode.dirent_count--;
+    return DIR_CB_SAVE_SYNC;
+}
+
+static mx_status_t cb_dir_append(vnode_t* vndir, minfs_dirent_t* de, dir_args_t* args) {
+    if (de->ino == 0) {
+        // empty entry, do we fit?
+        if (args->reclen > de->reclen) {
+            return DIR_CB_NEXT;
+        }
+    } else {
+        // filled entry, can we sub-divide?
+        uint32_t size = SIZEOF_MINFS_DIRENT(de->namelen);
+        if (size > de->reclen) {
+            error("bad reclen %u < %u\n", de->reclen, size);
+            return DIR_CB_DONE;
+        }
+        uint32_t extra = de->reclen - size;
+        if (extra < args->reclen) {
+            return DIR_CB_NEXT;
+        }
+        // shrink existing entry
+        de->reclen = size;
+        // create new entry in the remaining space
+        de = ((void*)de) + size;
+        de->reclen = extra;
+    }
+    de->ino = args->ino;
+    de->type = args->type;
+    de->namelen = args->len;
+    memcpy(de->name, args->name, args->len);
+    vndir->inode.dirent_count++;
+    return DIR_CB_SAVE_SYNC;
+}
+
+// run func over the dirents of directory block n
+// returns DIR_CB_NEXT if func never stopped
+static mx_status_t vn_dir_block_for_each(vnode_t* vn, uint32_t n, dir_args_t* args,
+                                         mx_status_t (*func)(vnode_t*, minfs_dirent_t*, dir_args_t*)) {
+    block_t* blk;
+    void* data;
+    if ((blk = vn_get_block(vn, n, &data, false)) == NULL) {
+        error("vn_dir: vn=%p missing block %u\n", vn, n);
+        return ERR_NOT_FOUND;
+    }
+    uint32_t size = MINFS_BLOCK_SIZE;
+    minfs_dirent_t* de = data;
+    while (size > MINFS_DIRENT_SIZE) {
+        //fprintf(stderr,"DE ino=%u rlen=%u nlen=%u\n", de->ino, de->reclen, de->namelen);
+        uint32_t rlen = de->reclen;
+        if ((rlen > size) || (rlen & 3)) {
+            error("vn_dir: vn=%p bad reclen %u > %u\n", vn, rlen, size);
+            break;
+        }
+        if (de->ino != 0) {
+            if ((de->namelen == 0) || (de->namelen > (rlen - MINFS_DIRENT_SIZE))) {
+                error("vn_dir: vn=%p bad namelen %u / %u\n", vn, de->namelen, rlen);
+                break;
+            }
+        }
+        mx_status_t status;
+        switch ((status = func(vn, de, args))) {
+        case DIR_CB_NEXT:
+            break;
+        case DIR_CB_SAVE:
+            vn_put_block_dirty(vn, blk);
+            return NO_ERROR;
+        case DIR_CB_SAVE_SYNC:
+            vn->inode.seq_num++;
+            vn_put_block_dirty(vn, blk);
+            minfs_sync_vnode(vn);
+            return NO_ERROR;
+        case DIR_CB_DONE:
+        default:
+            vn_put_block(vn, blk);
+            return status;
+        }
+        de = ((void*) de) + rlen;
+        size -= rlen;
+    }
+    vn_put_block(vn, blk);
+    return DIR_CB_NEXT;
+}
+
+static inline uint32_t vn_dir_blocks(vnode_t* vn) {
+    return vn->inode.size / MINFS_BLOCK_SIZE;
+}
+
+static inline bool vn_dir_is_dots(const char* name, size_t len) {
+    return ((len == 1) || (len == 2)) && (name[0] == '.') && (name[len - 1] == '.');
+}
+
+static block_t* vn_dir_index_get(vnode_t* vn, minfs_dir_index_t** out) {
+    block_t* blk;
+    void* data;
+    if ((blk = vn_get_block(vn, 0, &data, false)) == NULL) {
+        return NULL;
+    }
+    minfs_dir_index_t* idx = data + MINFS_DIR_INDEX_DIRENT + MINFS_DIRENT_SIZE;
+    if ((idx->magic != MINFS_MAGIC_DIR_INDEX) || (idx->count == 0) ||
+        (idx->count > MINFS_DIR_INDEX_MAX)) {
+        error("minfs: ino#%u: bad directory index\n", vn->ino);
+        vn_put_block(vn, blk);
+        return NULL;
+    }
+    *out = idx;
+    return blk;
+}
+
+// position of the index entry whose block holds names hashing to hash
+static uint32_t dir_index_search(minfs_dir_index_t* idx, uint32_t hash) {
+    uint32_t lo = 1;
+    uint32_t hi = idx->count;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (idx->entries[mid].hash <= hash) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo - 1;
+}
+
+// find the directory block that holds, or would hold, name
+static mx_status_t vn_dir_index_find(vnode_t* vn, const char* name, size_t len, uint32_t* n) {
+    if (vn_dir_is_dots(name, len)) {
+        *n = 0;
+        return NO_ERROR;
+    }
+    minfs_dir_index_t* idx;
+    block_t* blk;
+    if ((blk = vn_dir_index_get(vn, &idx)) == NULL) {
+        return ERR_IO;
+    }
+    *n = idx->entries[dir_index_search(idx, minfs_dir_hash(name, len))].block;
+    vn_put_block(vn, blk);
+    return NO_ERROR;
+}
+
+static mx_status_t vn_dir_for_each(vnode_t* vn, dir_args_t* args,
+                                   mx_status_t (*func)(vnode_t*, minfs_dirent_t*, dir_args_t*)) {
+    mx_status_t status;
+    if (vn->inode.dir_flags & MINFS_DIR_INDEXED) {
+        uint32_t n;
+        if ((status = vn_dir_index_find(vn, args->name, args->len, &n)) < 0) {
+            return status;
+        }
+        status = vn_dir_block_for_each(vn, n, args, func);
+        return (status == DIR_CB_NEXT) ? ERR_NOT_FOUND : status;
+    }
+    for (unsigned n = 0; n < vn_dir_blocks(vn); n++) {
+        if ((status = vn_dir_block_for_each(vn, n, args, func)) != DIR_CB_NEXT) {
+            return status;
+        }
+    }
+    return ERR_NOT_FOUND;
+}
+
+// add an empty block to the end of a directory
+static block_t* vn_dir_new_block(vnode_t* vn, uint32_t* n, void** data) {
+    block_t* blk;
+    *n = vn_dir_blocks(vn);
+    if ((blk = vn_get_block(vn, *n, data, true)) == NULL) {
+        return NULL;
+    }
+    minfs_dirent_t* de = *data;
+    de->ino = 0;
+    de->reclen = MINFS_BLOCK_SIZE;
+    de->namelen = 0;
+    vn->inode.size += MINFS_BLOCK_SIZE;
+    minfs_sync_vnode(vn);
+    return blk;
+}
+
+// Fills a directory block with dirents one after another,
+// the last one taking up whatever space is left.
+typedef struct {
+    void* data;
+    uint32_t off;
+    minfs_dirent_t* last;
+} dir_packer_t;
+
+static void dir_pack(dir_packer_t* dp, const minfs_dirent_t* de) {
+    uint32_t reclen = SIZEOF_MINFS_DIRENT(de->namelen);
+    minfs_dirent_t* out = dp->data + dp->off;
+    memcpy(out, de, MINFS_DIRENT_SIZE + de->namelen);
+    out->reclen = reclen;
+    dp->off += reclen;
+    dp->last = out;
+}
+
+static void dir_pack_finish(dir_packer_t* dp) {
+    if (dp->last == NULL) {
+        minfs_dirent_t* de = dp->data + dp->off;
+        de->ino = 0;
+        de->reclen = MINFS_BLOCK_SIZE - dp->off;
+        de->namelen = 0;
+    } else {
+        dp->last->reclen += MINFS_BLOCK_SIZE - dp->off;
+    }
+}
+
+static int cmp_hash(const void* a, const void* b) {
+    uint32_t x = *(const uint32_t*)a;
+    uint32_t y = *(const uint32_t*)b;
+    return (x < y) ? -1 : ((x > y) ? 1 : 0);
+}
+
+#define DIR_BLOCK_MAX_DIRENTS (MINFS_BLOCK_SIZE / SIZEOF_MINFS_DIRENT(1))
+
+// Collect the names in a copy of a directory block (less "." and "..")
+// and pick a hash to split them at, so that some stay and some move.
+// Returns 0 if all the names hash the same.
+static uint32_t dir_split_hash(const void* data, uint32_t* hashes) {
+    uint32_t count = 0;
+    const minfs_dirent_t* de = data;
+    for (uint32_t off = 0; off < MINFS_BLOCK_SIZE; off += de->reclen) {
+        de = data + off;
+        if ((de->reclen < MINFS_DIRENT_SIZE) || (de->reclen > (MINFS_BLOCK_SIZE - off))) {
+            break;
+        }
+        if ((de->ino != 0) && !vn_dir_is_dots(de->name, de->namelen)) {
+            hashes[count++] = minfs_dir_hash(de->name, de->namelen);
+        }
+    }
+    if (count < 2) {
+        return 0;
+    }
+    qsort(hashes, count, sizeof(uint32_t), cmp_hash);
+    for (uint32_t n = count / 2; n < count; n++) {
+        if (hashes[n] != hashes[0]) {
+            return hashes[n];
+        }
+    }
+    return 0;
+}
+
+// Hand each name in a copy of a directory block to the lower or
+// upper packer depending on which side of split it hashes to.
+static void dir_split_names(const void* data, uint32_t split,
+                            dir_packer_t* lower, dir_packer_t* upper) {
+    const minfs_dirent_t* de = data;
+    for (uint32_t off = 0; off < MINFS_BLOCK_SIZE; off += de->reclen) {
+        de = data + off;
+        if ((de->reclen < MINFS_DIRENT_SIZE) || (de->reclen > (MINFS_BLOCK_SIZE - off))) {
+            break;
+        }
+        if ((de->ino != 0) && !vn_dir_is_dots(de->name, de->namelen)) {
+            if (minfs_dir_hash(de->name, de->namelen) < split) {
+                dir_pack(lower, de);
+            } else {
+                dir_pack(upper, de);
+            }
+        }
+    }
+}
+
+static void vn_dir_drop_index(vnode_t* vn) {
+    // the index becomes free space in block 0
+    trace(MINFS, "minfs: ino#%u: directory index dropped\n", vn->ino);
+    vn->inode.dir_flags = MINFS_DIR_LINEAR;
+    minfs_sync_vnode(vn);
+}
+
+// Turn a full, single block directory into an index in block 0
+// and two blocks holding its names, split by hash.
+static mx_status_t vn_dir_make_index(vnode_t* vn) {
+    uint32_t hashes[DIR_BLOCK_MAX_DIRENTS];
+    void* copy;
+    if ((copy = malloc(MINFS_BLOCK_SIZE)) == NULL) {
+        return ERR_NO_MEMORY;
+    }
+
+    block_t* blk0;
+    void* data0;
+    if ((blk0 = vn_get_block(vn, 0, &data0, false)) == NULL) {
+        free(copy);
+        return ERR_IO;
+    }
+    memcpy(copy, data0, MINFS_BLOCK_SIZE);
+
+    // block 0 must start with "." and ".."
+    minfs_dirent_t* dot = copy;
+    minfs_dirent_t* dotdot = copy + SIZEOF_MINFS_DIRENT(1);
+    uint32_t split = dir_split_hash(copy, hashes);
+    if ((split == 0) || (dot->reclen != SIZEOF_MINFS_DIRENT(1)) ||
+        (dot->namelen != 1) || (dotdot->namelen != 2) ||
+        !vn_dir_is_dots(dotdot->name, 2)) {
+        vn_put_block(vn, blk0);
+        free(copy);
+        vn->inode.dir_flags = MINFS_DIR_LINEAR;
+        return NO_ERROR;
+    }
+
+    uint32_t n1, n2;
+    block_t* blk1;
+    block_t* blk2;
+    dir_packer_t lower = { .off = 0 };
+    dir_packer_t upper = { .off = 0 };
+    if ((blk1 = vn_dir_new_block(vn, &n1, &lower.data)) == NULL) {
+        vn_put_block(vn, blk0);
+        free(copy);
+        return ERR_NO_RESOURCES;
+    }
+    if ((blk2 = vn_dir_new_block(vn, &n2, &upper.data)) == NULL) {
+        vn_put_block_dirty(vn, blk1);
+        vn_put_block(vn, blk0);
+        free(copy);
+        return ERR_NO_RESOURCES;
+    }
+    dir_split_names(copy, split, &lower, &upper);
+    dir_pack_finish(&lower);
+    dir_pack_finish(&upper);
+    vn_put_block_dirty(vn, blk1);
+    vn_put_block_dirty(vn, blk2);
+
+    // rewrite block 0 as ".", "..", and the index
+    memset(data0, 0, MINFS_BLOCK_SIZE);
+    dir_packer_t dp = { .data = data0 };
+    dir_pack(&dp, dot);
+    dir_pack(&dp, dotdot);
+    minfs_dirent_t* de = data0 + MINFS_DIR_INDEX_DIRENT;
+    de->ino = 0;
+    de->reclen = MINFS_BLOCK_SIZE - MINFS_DIR_INDEX_DIRENT;
+    minfs_dir_index_t* idx = data0 + MINFS_DIR_INDEX_DIRENT + MINFS_DIRENT_SIZE;
+    idx->magic = MINFS_MAGIC_DIR_INDEX;
+    idx->count = 2;
+    idx->entries[0].hash = 0;
+    idx->entries[0].block = n1;
+    idx->entries[1].hash = split;
+    idx->entries[1].block = n2;
+    vn_put_block_dirty(vn, blk0);
+    free(copy);
+
+    vn->inode.dir_flags = MINFS_DIR_INDEXED;
+    vn->inode.seq_num++;
+    minfs_sync_vnode(vn);
+    return NO_ERROR;
+}
+
+// Split the block that name would go in, moving its upper half
+// by hash to a new block.  If that cannot be done, fall back to
+// an unindexed directory.
+static mx_status_t vn_dir_split(vnode_t* vn, const char* name, size_t len) {
+    minfs_dir_index_t* idx;
+    block_t* blk0;
+    if ((blk0 = vn_dir_index_get(vn, &idx)) == NULL) {
+        return ERR_IO;
+    }
+    if (idx->count == MINFS_DIR_INDEX_MAX) {
+        vn_put_block(vn, blk0);
+        vn_dir_drop_index(vn);
+        return NO_ERROR;
+    }
+    uint32_t pos = dir_index_search(idx, minfs_dir_hash(name, len));
+
+    uint32_t hashes[DIR_BLOCK_MAX_DIRENTS];
+    void* copy;
+    if ((copy = malloc(MINFS_BLOCK_SIZE)) == NULL) {
+        vn_put_block(vn, blk0);
+        return ERR_NO_MEMORY;
+    }
+    block_t* blk;
+    dir_packer_t lower = { .off = 0 };
+    dir_packer_t upper = { .off = 0 };
+    if ((blk = vn_get_block(vn, idx->entries[pos].block, &lower.data, false)) == NULL) {
+        vn_put_block(vn, blk0);
+        free(copy);
+        return ERR_IO;
+    }
+    memcpy(copy, lower.data, MINFS_BLOCK_SIZE);
+    uint32_t split = dir_split_hash(copy, hashes);
+    if (split <= idx->entries[pos].hash) {
+        // every name in the block hashes the same
+        vn_put_block(vn, blk);
+        vn_put_block(vn, blk0);
+        free(copy);
+        vn_dir_drop_index(vn);
+        return NO_ERROR;
+    }
+
+    uint32_t n;
+    block_t* nblk;
+    if ((nblk = vn_dir_new_block(vn, &n, &upper.data)) == NULL) {
+        vn_put_block(vn, blk);
+        vn_put_block(vn, blk0);
+        free(copy);
+        return ERR_NO_RESOURCES;
+    }
+    memset(lower.data, 0, MINFS_BLOCK_SIZE);
+    dir_split_names(copy, split, &lower, &upper);
+    dir_pack_finish(&lower);
+    dir_pack_finish(&upper);
+    vn_put_block_dirty(vn, blk);
+    vn_put_block_dirty(vn, nblk);
+    free(copy);
+
+    memmove(idx->entries + pos + 2, idx->entries + pos + 1,
+            (idx->count - pos - 1) * sizeof(minfs_dir_index_entry_t));
+    idx->entries[pos + 1].hash = split;
+    idx->entries[pos + 1].block = n;
+    idx->count++;
+    vn_put_block_dirty(vn, blk0);
+
+    vn->inode.seq_num++;
+    minfs_sync_vnode(vn);
+    return NO_ERROR;
+}
+
+// add a name, making room in the directory if need be
+static mx_status_t vn_dir_append(vnode_t* vn, dir_args_t* args) {
+    for (;;) {
+        mx_status_t status;
+        if ((status = vn_dir_for_each(vn, args, cb_dir_append)) != ERR_NOT_FOUND) {
+            return status;
+        }
+        if (vn->inode.dir_flags & MINFS_DIR_INDEXED) {
+            status = vn_dir_split(vn, args->name, args->len);
+        } else if ((vn_dir_blocks(vn) == 1) && !(vn->inode.dir_flags & MINFS_DIR_LINEAR) &&
+                   minfs_has_dir_index(vn->fs)) {
+            status = vn_dir_make_index(vn);
+        } else {
+            uint32_t n;
+            void* data;
+            block_t* blk;
+            if ((blk = vn_dir_new_block(vn, &n, &data)) == NULL) {
+                return ERR_NO_RESOURCES;
+            }
+            vn_put_block_dirty(vn, blk);
+            status = NO_ERROR;
+        }
+        if (status < 0) {
+            return status;
+        }
+    }
+}
+
+static minfs_dcache_entry_t* vn_dcache_slot(vnode_t* vn, uint32_t hash) {
+    return vn->dcache + (hash % MINFS_DCACHE_SLOTS);
+}
+
+static bool vn_dcache_lookup(vnode_t* vn, dir_args_t* args) {
+    if (vn->dcache == NULL) {
+        return false;
+    }
+    uint32_t hash = minfs_dir_hash(args->name, args->len);
+    minfs_dcache_entry_t* e = vn_dcache_slot(vn, hash);
+    if ((e->ino == 0) || (e->hash != hash) || (e->namelen != args->len) ||
+        memcmp(e->name, args->name, args->len)) {
+        return false;
+    }
+    args->ino = e->ino;
+    args->type = e->type;
+    return true;
+}
+
+static void vn_dcache_insert(vnode_t* vn, dir_args_t* args) {
+    if (!(vn->inode.dir_flags & MINFS_DIR_INDEXED) || (args->len > MINFS_DCACHE_NAME_MAX)) {
+        return;
+    }
+    if ((vn->dcache == NULL) &&
+        ((vn->dcache = calloc(MINFS_DCACHE_SLOTS, sizeof(minfs_dcache_entry_t))) == NULL)) {
+        return;
+    }
+    uint32_t hash = minfs_dir_hash(args->name, args->len);
+    minfs_dcache_entry_t* e = vn_dcache_slot(vn, hash);
+    e->hash = hash;
+    e->ino = args->ino;
+    e->type = args->type;
+    e->namelen = args->len;
+    memcpy(e->name, args->name, args->len);
+}
+
+static void vn_dcache_remove(vnode_t* vn, const char* name, size_t len) {
+    if (vn->dcache == NULL) {
+        return;
+    }
+    uint32_t hash = minfs_dir_hash(name, len);
+    minfs_dcache_entry_t* e = vn_dcache_slot(vn, hash);
+    if ((e->hash == hash) && (e->namelen == len) && !memcmp(e->name, name, len)) {
+        e->ino = 0;
+    }
+}
+
+#ifdef __Fuchsia__
+static void vn_vmo_drop(vnode_t* vn) {
+    if (vn->vmo > 0) {
+        mx_handle_close(vn->vmo);
+        vn->vmo = 0;
+        bitmap_destroy(&vn->vmo_filled);
+    }
+}
+
+// VMOs cannot be resized, so once the file outgrows its VMO
+// that is dropped, and the next request gets a bigger one
+static void vn_vmo_grow(vnode_t* vn) {
+    if ((vn->vmo > 0) &&
+        (vn->inode.size > ((size_t)vn->vmo_filled.bitcount * MINFS_BLOCK_SIZE))) {
+        vn_vmo_drop(vn);
     }
+}
 
-    return blk;
+// copy a write to block n into the VMO, if the block is there
+static void vn_vmo_update(vnode_t* vn, uint32_t n, const void* data, size_t len, size_t off) {
+    if ((vn->vmo > 0) && bitmap_get(&vn->vmo_filled, n)) {
+        mx_vmo_write(vn->vmo, data, off, len);
+    }
 }
+#else
+static inline void vn_vmo_drop(vnode_t* vn) {}
+static inline void vn_vmo_grow(vnode_t* vn) {}
+static inline void vn_vmo_update(vnode_t* vn, uint32_t n, const void* data, size_t len,
+                                 size_t off) {}
+#endif
 
-static inline void vn_put_block(vnode_t* vn, block_t* blk) {
-    bcache_put(vn->fs->bc, blk, 0);
+static void fs_release(vnode_t* vn) {
+    minfs_t* fs = vn->fs;
+    // with the hash locked, nobody can look the vnode up again
+    mtx_lock(&fs->hash_lock);
+    if (__atomic_sub_fetch(&vn->refcount, 1, __ATOMIC_ACQ_REL) > 0) {
+        // looked up again before we got here
+        mtx_unlock(&fs->hash_lock);
+        return;
+    }
+    trace(MINFS, "minfs_release() vn=%p(#%u)%s\n", vn, vn->ino,
+          vn->inode.link_count ? "" : " link-count is zero");
+    if (vn->inode.link_count > 0) {
+        // stays in the hash, idle, until looked up again
+        minfs_vnode_unreserve(vn);
+        vn_vmo_drop(vn);
+        mtx_unlock(&fs->hash_lock);
+        return;
+    }
+    list_delete(&vn->hashnode);
+    mtx_unlock(&fs->hash_lock);
+
+    minfs_vnode_unreserve(vn);
+    bcache_txn_begin(fs->bc);
+    minfs_inode_destroy(vn);
+    bcache_txn_end(fs->bc);
+    vn_vmo_drop(vn);
+    free(vn->dcache);
+    free(vn);
 }
 
-static inline void vn_put_block_dirty(vnode_t* vn, block_t* blk) {
-    bcache_put(vn->fs->bc, blk, BLOCK_DIRTY);
+static mx_status_t fs_open(vnode_t** _vn, uint32_t flags) {
+    vnode_t* vn = *_vn;
+    trace(MINFS, "minfs_open() vn=%p(#%u)\n", vn, vn->ino);
+    return NO_ERROR;
 }
 
-#define DIR_CB_DONE 0
-#define DIR_CB_NEXT 1
-#define DIR_CB_SAVE 2
-#define DIR_CB_SAVE_SYNC 3
+static mx_status_t fs_close(vnode_t* vn) {
+    trace(MINFS, "minfs_close() vn=%p(#%u)\n", vn, vn->ino);
+    mtx_lock(&vn->lock);
+    minfs_vnode_unreserve(vn);
+    vn->prealloc = 0;
+    mtx_unlock(&vn->lock);
+    return NO_ERROR;
+}
 
-typedef struct dir_args {
-    const char* name;
-    size_t len;
-    uint32_t ino;
-    uint32_t type;
-    uint32_t reclen;
-} dir_args_t;
+// not possible to have a block at or past this one
+// due to the limitations of the inode and indirect blocks
+#define MAX_FILE_BLOCK (MINFS_DIRECT + MINFS_INDIRECT * (MINFS_BLOCK_SIZE / sizeof(uint32_t)))
 
-static mx_status_t cb_dir_find(vnode_t* vndir, minfs_dirent_t* de, dir_args_t* args) {
-    if ((de->ino != 0) && (de->namelen == args->len) &&
-        (!memcmp(de->name, args->name, args->len))) {
-        args->ino = de->ino;
-        args->type = de->type;
-        return DIR_CB_DONE;
-    } else {
-        return DIR_CB_NEXT;
+// extent mapped files are limited by their 32bit size
+#define MAX_FILE_BLOCK_EXTENTS (UINT32_MAX / MINFS_BLOCK_SIZE)
+
+static uint32_t vn_max_block(vnode_t* vn) {
+    return minfs_has_extents(vn->fs) ? MAX_FILE_BLOCK_EXTENTS : MAX_FILE_BLOCK;
+}
+
+// find the disk block holding block n of a vnode, 0 for a hole
+static mx_status_t vn_lookup_block(vnode_t* vn, uint32_t n, uint32_t* bno) {
+    *bno = 0;
+    if (minfs_has_extents(vn->fs)) {
+        return minfs_extent_lookup(vn->fs, &vn->inode, n, bno, NULL);
+    }
+    if (n < MINFS_DIRECT) {
+        *bno = vn->inode.dnum[n];
+        return NO_ERROR;
     }
+    n -= MINFS_DIRECT;
+    uint32_t i = n / (MINFS_BLOCK_SIZE / sizeof(uint32_t));
+    uint32_t j = n % (MINFS_BLOCK_SIZE / sizeof(uint32_t));
+    if ((i >= MINFS_INDIRECT) || (vn->inode.inum[i] == 0)) {
+        return NO_ERROR;
+    }
+    if (bcache_read(vn->fs->bc, vn->inode.inum[i], bno,
+                    j * sizeof(uint32_t), sizeof(uint32_t)) < 0) {
+        error("minfs: cannot read indirect block @%u\n", vn->inode.inum[i]);
+        return ERR_IO;
+    }
+    return NO_ERROR;
 }
 
-// caller is expected to prevent unlink of "." or ".."
-static mx_status_t cb_dir_unlink(vnode_t* vndir, minfs_dirent_t* de, dir_args_t* args) {
-    if ((de->ino == 0) || (args->len != de->namelen) ||
-        memcmp(args->name, de->name, args->len)) {
-        return DIR_CB_NEXT;
+// the disk block holding block n of a vnode, or 0 for a hole or
+// a block that cannot be looked up
+static uint32_t vn_map_block(vnode_t* vn, uint32_t n) {
+    uint32_t bno;
+    if (vn_lookup_block(vn, n, &bno) < 0) {
+        return 0;
     }
+    return bno;
+}
 
-    vnode_t* vn;
+// Obtain block n of a vnode to read, with *blk left NULL for a hole,
+// which reads as zeros, and an error if the block cannot be read.
+static mx_status_t vn_read_block(vnode_t* vn, uint32_t n, block_t** blk, void** bdata) {
+    uint32_t bno;
     mx_status_t status;
-    if ((status = minfs_vnode_get(vndir->fs, &vn, de->ino)) < 0) {
+    *blk = NULL;
+    if ((status = vn_lookup_block(vn, n, &bno)) < 0) {
         return status;
     }
+    if ((bno != 0) && ((*blk = bcache_get(vn->fs->bc, bno, bdata)) == NULL)) {
+        return ERR_IO;
+    }
+    return NO_ERROR;
+}
 
-    // directories must be empty (dirent_count == 2)
-    if (vn->inode.magic == MINFS_MAGIC_DIR) {
-        if (vn->inode.dirent_count != 2) {
-            // if we have more than "." and "..", not empty, cannot unlink
-            vn_release(vn);
-            return ERR_BAD_STATE;
+// Read blocks start..end-1 of a vnode into the cache, each run of
+// them contiguous on disk with one read.
+static void vn_prefetch(vnode_t* vn, uint32_t start, uint32_t end) {
+    uint32_t run_bno = 0;
+    uint32_t run_count = 0;
+    for (uint32_t i = start; i < end; i++) {
+        uint32_t bno = vn_map_block(vn, i);
+        if ((run_count > 0) && (bno == run_bno + run_count)) {
+            run_count++;
+            continue;
         }
+        if (run_count > 0) {
+            bcache_readahead(vn->fs->bc, run_bno, run_count);
+        }
+        run_bno = bno;
+        run_count = (bno != 0) ? 1 : 0;
+    }
+    if (run_count > 0) {
+        bcache_readahead(vn->fs->bc, run_bno, run_count);
     }
-    vn->inode.link_count--;
+}
 
-    //TODO: it would be safer to do this *after* we update the directory block
-    vn_release(vn);
+// Called before blocks n..last are read.  Once reads follow on from
+// each other, the window after them is read ahead, topped up each
+// time the reader gets half way into it.  Blocks contiguous on disk
+// are read together, including those about to be read now.
+static void vn_readahead(vnode_t* vn, uint32_t n, uint32_t last) {
+    if (n == vn->ra_next) {
+        if (vn->ra_size < MINFS_READAHEAD_MIN) {
+            vn->ra_size = MINFS_READAHEAD_MIN;
+        } else if (vn->ra_size < MINFS_READAHEAD_MAX) {
+            vn->ra_size *= 2;
+        }
+    } else {
+        vn->ra_size = 0;
+        vn->ra_end = 0;
+    }
+    vn->ra_next = last + 1;
+    if ((vn->ra_size == 0) || ((last + 1 + vn->ra_size / 2) <= vn->ra_end)) {
+        return;
+    }
 
-    // erase dirent (convert to empty entry), decrement dirent count
-    de->ino = 0;
-    vndir->inode.dirent_count--;
-    return DIR_CB_SAVE_SYNC;
+    uint32_t start = (vn->ra_end > n) ? vn->ra_end : n;
+    uint32_t end = last + 1 + vn->ra_size;
+    uint32_t eof = (vn->inode.size + MINFS_BLOCK_SIZE - 1) / MINFS_BLOCK_SIZE;
+    if (end > eof) {
+        end = eof;
+    }
+    vn->ra_end = end;
+    vn_prefetch(vn, start, end);
 }
 
-static mx_status_t cb_dir_append(vnode_t* vndir, minfs_dirent_t* de, dir_args_t* args) {
-    if (de->ino == 0) {
-        // empty entry, do we fit?
-        if (args->reclen > de->reclen) {
-            return DIR_CB_NEXT;
+#ifdef __Fuchsia__
+// copy off..off+len into a VMO of its own, for a large read, so
+// that nothing of it stays behind in the server once that is done
+static mx_status_t vn_vmo_range(vnode_t* vn, size_t off, size_t len, mx_handle_t* out) {
+    if (off >= vn->inode.size) {
+        len = 0;
+    } else if (len > (vn->inode.size - off)) {
+        len = vn->inode.size - off;
+    }
+
+    mx_handle_t vmo;
+    if ((vmo = mx_vmo_create(len)) < 0) {
+        return vmo;
+    }
+    if (len > 0) {
+        vn_readahead(vn, off / MINFS_BLOCK_SIZE, (off + len - 1) / MINFS_BLOCK_SIZE);
+    }
+
+    // holes are left as the zeros they read as
+    uint32_t n = off / MINFS_BLOCK_SIZE;
+    size_t adjust = off % MINFS_BLOCK_SIZE;
+    size_t pos = 0;
+    while (pos < len) {
+        size_t xfer = MINFS_BLOCK_SIZE - adjust;
+        if (xfer > (len - pos)) {
+            xfer = len - pos;
         }
-    } else {
-        // filled entry, can we sub-divide?
-        uint32_t size = SIZEOF_MINFS_DIRENT(de->namelen);
-        if (size > de->reclen) {
-            error("bad reclen %u < %u\n", de->reclen, size);
-            return DIR_CB_DONE;
+        block_t* blk;
+        void* bdata;
+        mx_status_t r;
+        if ((r = vn_read_block(vn, n, &blk, &bdata)) < 0) {
+            mx_handle_close(vmo);
+            return r;
         }
-        uint32_t extra = de->reclen - size;
-        if (extra < args->reclen) {
-            return DIR_CB_NEXT;
+        if (blk != NULL) {
+            r = mx_vmo_write(vmo, bdata + adjust, pos, xfer);
+            vn_put_block(vn, blk);
+            if (r < 0) {
+                mx_handle_close(vmo);
+                return r;
+            }
         }
-        // shrink existing entry
-        de->reclen = size;
-        // create new entry in the remaining space
-        de = ((void*)de) + size;
-        de->reclen = extra;
+        adjust = 0;
+        pos += xfer;
+        n++;
     }
-    de->ino = args->ino;
-    de->type = args->type;
-    de->namelen = args->len;
-    memcpy(de->name, args->name, args->len);
-    vndir->inode.dirent_count++;
-    return DIR_CB_SAVE_SYNC;
+
+    *out = mx_handle_duplicate(vmo, MX_RIGHT_READ | MX_RIGHT_DUPLICATE | MX_RIGHT_TRANSFER);
+    mx_handle_close(vmo);
+    return (*out < 0) ? *out : NO_ERROR;
 }
 
-static mx_status_t vn_dir_for_each(vnode_t* vn, dir_args_t* args,
-                                   mx_status_t (*func)(vnode_t*, minfs_dirent_t*, dir_args_t*)) {
-    for (unsigned n = 0; n < vn->inode.block_count; n++) {
-        block_t* blk;
-        void* data;
-        if ((blk = vn_get_block(vn, n, &data, false)) == NULL) {
-            error("vn_dir: vn=%p missing block %u\n", vn, n);
-            return ERR_NOT_FOUND;
-        }
-        uint32_t size = MINFS_BLOCK_SIZE;
-        minfs_dirent_t* de = data;
-        while (size > MINFS_DIRENT_SIZE) {
-            //fprintf(stderr,"DE ino=%u rlen=%u nlen=%u\n", de->ino, de->reclen, de->namelen);
-            uint32_t rlen = de->reclen;
-            if ((rlen > size) || (rlen & 3)) {
-                error("vn_dir: vn=%p bad reclen %u > %u\n", vn, rlen, size);
-                break;
+static mx_status_t fs_get_vmo(vnode_t* vn, size_t off, size_t len, uint32_t flags,
+                              mx_handle_t* out, size_t* size) {
+    trace(MINFS, "minfs_get_vmo() vn=%p(#%u) len=%zd off=%zd flags=%x\n",
+          vn, vn->ino, len, off, flags);
+    if (vn->inode.magic == MINFS_MAGIC_DIR) {
+        // so that large reads of directories go the usual way
+        return ERR_NOT_SUPPORTED;
+    }
+
+    mx_status_t status = NO_ERROR;
+    mtx_lock(&vn->lock);
+    if (flags & MXRIO_MMAP_RANGE) {
+        if ((status = vn_vmo_range(vn, off, len, out)) == NO_ERROR) {
+            *size = vn->inode.size;
+        }
+        goto done;
+    }
+
+    // the VMO of the whole file, kept for as long as the vnode is in
+    // use, is only built for mappings, which need one that stays put
+    if (vn->vmo <= 0) {
+        uint32_t count = (vn->inode.size + MINFS_BLOCK_SIZE - 1) / MINFS_BLOCK_SIZE;
+        if (count == 0) {
+            count = 1;
+        }
+        if ((vn->vmo = mx_vmo_create((uint64_t)count * MINFS_BLOCK_SIZE)) < 0) {
+            status = vn->vmo;
+            vn->vmo = 0;
+            goto done;
+        }
+        if ((status = bitmap_init(&vn->vmo_filled, count)) < 0) {
+            mx_handle_close(vn->vmo);
+            vn->vmo = 0;
+            goto done;
+        }
+    }
+
+    // copy in the blocks of the range the file holds, which are
+    // zero past its end, leaving holes as the zeros they read as
+    if (off < vn->inode.size) {
+        if (len > (vn->inode.size - off)) {
+            len = vn->inode.size - off;
+        }
+        uint32_t last = (off + len + MINFS_BLOCK_SIZE - 1) / MINFS_BLOCK_SIZE;
+        uint32_t ahead = 0;
+        for (uint32_t n = off / MINFS_BLOCK_SIZE; n < last; n++) {
+            if (bitmap_get(&vn->vmo_filled, n)) {
+                continue;
             }
-            if (de->ino != 0) {
-                if ((de->namelen == 0) || (de->namelen > (rlen - MINFS_DIRENT_SIZE))) {
-                    error("vn_dir: vn=%p bad namelen %u / %u\n", vn, de->namelen, rlen);
-                    break;
-                }
+            if (n >= ahead) {
+                ahead = ((last - n) > MINFS_READAHEAD_MAX) ? (n + MINFS_READAHEAD_MAX) : last;
+                vn_prefetch(vn, n, ahead);
             }
-            mx_status_t status;
-            switch ((status = func(vn, de, args))) {
-            case DIR_CB_NEXT:
-                break;
-            case DIR_CB_SAVE:
-                vn_put_block_dirty(vn, blk);
-                return NO_ERROR;
-            case DIR_CB_SAVE_SYNC:
-                vn->inode.seq_num++;
-                vn_put_block_dirty(vn, blk);
-                minfs_sync_vnode(vn);
-                return NO_ERROR;
-            case DIR_CB_DONE:
-            default:
+            block_t* blk;
+            void* bdata;
+            if ((status = vn_read_block(vn, n, &blk, &bdata)) < 0) {
+                goto done;
+            }
+            if (blk != NULL) {
+                mx_ssize_t r = mx_vmo_write(vn->vmo, bdata, (uint64_t)n * MINFS_BLOCK_SIZE,
+                                            MINFS_BLOCK_SIZE);
                 vn_put_block(vn, blk);
-                return status;
+                if (r < 0) {
+                    status = r;
+                    goto done;
+                }
             }
-            de = ((void*) de) + rlen;
-            size -= rlen;
+            bitmap_set(&vn->vmo_filled, n);
         }
-        vn_put_block(vn, blk);
     }
-    return ERR_NOT_FOUND;
-}
 
-static void fs_release(vnode_t* vn) {
-    trace(MINFS, "minfs_release() vn=%p(#%u)%s\n", vn, vn->ino,
-          vn->inode.link_count ? "" : " link-count is zero");
-    if (vn->inode.link_count == 0) {
-        minfs_inode_destroy(vn);
-        list_delete(&vn->hashnode);
-        free(vn);
+    if ((*out = mx_handle_duplicate(vn->vmo, MX_RIGHT_READ | MX_RIGHT_DUPLICATE |
+                                             MX_RIGHT_TRANSFER)) < 0) {
+        status = *out;
+        goto done;
     }
+    *size = vn->inode.size;
+done:
+    mtx_unlock(&vn->lock);
+    return status;
 }
-
-static mx_status_t fs_open(vnode_t** _vn, uint32_t flags) {
-    vnode_t* vn = *_vn;
-    trace(MINFS, "minfs_open() vn=%p(#%u)\n", vn, vn->ino);
-    return NO_ERROR;
-}
-
-static mx_status_t fs_close(vnode_t* vn) {
-    trace(MINFS, "minfs_close() vn=%p(#%u)\n", vn, vn->ino);
-    return NO_ERROR;
-}
-
-// not possible to have a block at or past this one
-// due to the limitations of the inode and indirect blocks
-#define MAX_FILE_BLOCK (MINFS_DIRECT + MINFS_INDIRECT * (MINFS_BLOCK_SIZE / sizeof(uint32_t)))
+#endif
 
 static ssize_t fs_read(vnode_t* vn, void* data, size_t len, size_t off) {
     trace(MINFS, "minfs_read() vn=%p(#%u) len=%zd off=%zd\n", vn, vn->ino, len, off);
 
+    mtx_lock(&vn->lock);
     // clip to EOF
     if (off >= vn->inode.size) {
+        mtx_unlock(&vn->lock);
         return 0;
     }
     if (len > (vn->inode.size - off)) {
@@ -423,8 +1424,12 @@ static ssize_t fs_read(vnode_t* vn, void* data, size_t len, size_t off) {
     void* start = data;
     uint32_t n = off / MINFS_BLOCK_SIZE;
     size_t adjust = off % MINFS_BLOCK_SIZE;
+    uint32_t max = vn_max_block(vn);
 
-    while ((len > 0) && (n < MAX_FILE_BLOCK)) {
+    vn_readahead(vn, n, (off + len - 1) / MINFS_BLOCK_SIZE);
+
+    mx_status_t status = NO_ERROR;
+    while ((len > 0) && (n < max)) {
         size_t xfer;
         if (len > (MINFS_BLOCK_SIZE - adjust)) {
             xfer = MINFS_BLOCK_SIZE - adjust;
@@ -434,17 +1439,27 @@ static ssize_t fs_read(vnode_t* vn, void* data, size_t len, size_t off) {
 
         block_t* blk;
         void* bdata;
-        if ((blk = vn_get_block(vn, n, &bdata, true)) == NULL) {
+        if ((status = vn_read_block(vn, n, &blk, &bdata)) < 0) {
+            // a short read, up to the block that could not be read
             break;
         }
-        memcpy(data, bdata + adjust, xfer);
-        vn_put_block(vn, blk);
+        if (blk == NULL) {
+            // a hole, which reads as zeros and stays unallocated
+            memset(data, 0, xfer);
+        } else {
+            memcpy(data, bdata + adjust, xfer);
+            vn_put_block(vn, blk);
+        }
 
         adjust = 0;
         len -= xfer;
         data += xfer;
         n++;
     }
+    mtx_unlock(&vn->lock);
+    if ((data == start) && (status < 0)) {
+        return status;
+    }
     return data - start;
 }
 
@@ -454,8 +1469,16 @@ static ssize_t fs_write(vnode_t* vn, const void* data, size_t len, size_t off) {
     const void* start = data;
     uint32_t n = off / MINFS_BLOCK_SIZE;
     size_t adjust = off % MINFS_BLOCK_SIZE;
+    uint32_t max = vn_max_block(vn);
 
-    while ((len > 0) && (n < MAX_FILE_BLOCK)) {
+    mtx_lock(&vn->lock);
+    // let block allocation see how far this write goes
+    size_t end = (off + len + MINFS_BLOCK_SIZE - 1) / MINFS_BLOCK_SIZE;
+    vn->write_end = (end < max) ? end : max;
+
+    bcache_txn_begin(vn->fs->bc);
+    mx_status_t status = NO_ERROR;
+    while ((len > 0) && (n < max)) {
         size_t xfer;
         if (len > (MINFS_BLOCK_SIZE - adjust)) {
             xfer = MINFS_BLOCK_SIZE - adjust;
@@ -465,11 +1488,13 @@ static ssize_t fs_write(vnode_t* vn, const void* data, size_t len, size_t off) {
 
         block_t* blk;
         void* bdata;
-        if ((blk = vn_get_block(vn, n, &bdata, true)) == NULL) {
+        if ((status = vn_alloc_block(vn, n, &blk, &bdata)) < 0) {
+            // a short write, up to the block that could not be had
             break;
         }
         memcpy(bdata + adjust, data, xfer);
-        vn_put_block_dirty(vn, blk);
+        vn_put_block_data(vn, blk);
+        vn_vmo_update(vn, n, data, xfer, off + (data - start));
 
         adjust = 0;
         len -= xfer;
@@ -477,12 +1502,105 @@ static ssize_t fs_write(vnode_t* vn, const void* data, size_t len, size_t off) {
         n++;
     }
 
+    vn->write_end = 0;
+
     len = data - start;
-    if ((off + len) > vn->inode.size) {
+    if ((len > 0) && ((off + len) > vn->inode.size)) {
         vn->inode.size = off + len;
         minfs_sync_vnode(vn);
+        vn_vmo_grow(vn);
     }
-    return data - start;
+    bcache_txn_end(vn->fs->bc);
+    mtx_unlock(&vn->lock);
+    if ((len == 0) && (status < 0)) {
+        return status;
+    }
+    return len;
+}
+
+static mx_status_t fs_truncate(vnode_t* vn, size_t len) {
+    trace(MINFS, "minfs_truncate() vn=%p(#%u) len=%zd\n", vn, vn->ino, len);
+    if (vn->inode.magic == MINFS_MAGIC_DIR) {
+        return ERR_NOT_FILE;
+    }
+    if (len > ((size_t)vn_max_block(vn) * MINFS_BLOCK_SIZE)) {
+        return ERR_TOO_BIG;
+    }
+
+    mx_status_t status = NO_ERROR;
+    mtx_lock(&vn->lock);
+    bcache_txn_begin(vn->fs->bc);
+    if (len < vn->inode.size) {
+        // the part of the last block past the end must read as
+        // zeros should the file grow again
+        uint32_t adjust = len % MINFS_BLOCK_SIZE;
+        block_t* blk;
+        void* bdata;
+        if ((adjust != 0) &&
+            ((blk = vn_get_block(vn, len / MINFS_BLOCK_SIZE, &bdata, false)) != NULL)) {
+            memset(bdata + adjust, 0, MINFS_BLOCK_SIZE - adjust);
+            vn_put_block_data(vn, blk);
+        }
+        mtx_lock(&vn->fs->alloc_lock);
+        minfs_vnode_unreserve_locked(vn);
+        status = vn_free_blocks(vn, (len + MINFS_BLOCK_SIZE - 1) / MINFS_BLOCK_SIZE);
+        mtx_unlock(&vn->fs->alloc_lock);
+        vn->ra_end = 0;
+    }
+    // growing leaves a hole
+    if (len != vn->inode.size) {
+        // what a VMO holds past the new end would be stale
+        vn_vmo_drop(vn);
+    }
+    vn->inode.size = len;
+    minfs_sync_vnode(vn);
+    bcache_txn_end(vn->fs->bc);
+    mtx_unlock(&vn->lock);
+    return status;
+}
+
+// Allocate the blocks of a range of a file that are holes, zeroed,
+// and grow the file to cover the range.
+static mx_status_t vn_allocate(vnode_t* vn, uint64_t off, uint64_t len) {
+    trace(MINFS, "minfs_allocate() vn=%p(#%u) len=%llu off=%llu\n", vn, vn->ino,
+          (unsigned long long)len, (unsigned long long)off);
+    if (vn->inode.magic == MINFS_MAGIC_DIR) {
+        return ERR_NOT_FILE;
+    }
+    uint64_t end = off + len;
+    if ((len == 0) || (end < off)) {
+        return ERR_INVALID_ARGS;
+    }
+    if (end > ((uint64_t)vn_max_block(vn) * MINFS_BLOCK_SIZE)) {
+        return ERR_TOO_BIG;
+    }
+
+    mx_status_t status = NO_ERROR;
+    uint32_t last = (end + MINFS_BLOCK_SIZE - 1) / MINFS_BLOCK_SIZE;
+    mtx_lock(&vn->lock);
+    // so that the whole range is allocated in one run if it can be
+    vn->write_end = last;
+    bcache_txn_begin(vn->fs->bc);
+    for (uint32_t n = off / MINFS_BLOCK_SIZE; n < last; n++) {
+        if (vn_map_block(vn, n) != 0) {
+            continue;
+        }
+        block_t* blk;
+        void* bdata;
+        if ((status = vn_alloc_block(vn, n, &blk, &bdata)) < 0) {
+            break;
+        }
+        vn_put_block(vn, blk);
+    }
+    vn->write_end = 0;
+    if ((status == NO_ERROR) && (end > vn->inode.size)) {
+        vn->inode.size = end;
+        minfs_sync_vnode(vn);
+        vn_vmo_grow(vn);
+    }
+    bcache_txn_end(vn->fs->bc);
+    mtx_unlock(&vn->lock);
+    return status;
 }
 
 static mx_status_t fs_lookup(vnode_t* vn, vnode_t** out, const char* name, size_t len) {
@@ -496,21 +1614,27 @@ static mx_status_t fs_lookup(vnode_t* vn, vnode_t** out, const char* name, size_
         .len = len,
     };
     mx_status_t status;
-    if ((status = vn_dir_for_each(vn, &args, cb_dir_find)) < 0) {
-        return status;
-    }
-    if ((status = minfs_vnode_get(vn->fs, &vn, args.ino)) < 0) {
-        return status;
+    mtx_lock(&vn->lock);
+    if (!vn_dcache_lookup(vn, &args)) {
+        if ((status = vn_dir_for_each(vn, &args, cb_dir_find)) < 0) {
+            goto done;
+        }
+        vn_dcache_insert(vn, &args);
     }
-    *out = vn;
-    return NO_ERROR;
+    // still locked, so that the name cannot be unlinked meanwhile
+    status = minfs_vnode_get(vn->fs, out, args.ino);
+done:
+    mtx_unlock(&vn->lock);
+    return status;
 }
 
 static mx_status_t fs_getattr(vnode_t* vn, vnattr_t* a) {
     trace(MINFS, "minfs_getattr() vn=%p(#%u)\n", vn, vn->ino);
+    mtx_lock(&vn->lock);
     a->inode = vn->ino;
     a->size = vn->inode.size;
     a->mode = DTYPE_TO_VTYPE(MINFS_MAGIC_TYPE(vn->inode.magic));
+    mtx_unlock(&vn->lock);
     return NO_ERROR;
 }
 
@@ -530,6 +1654,7 @@ static mx_status_t fs_readdir(vnode_t* vn, void* cookie, void* dirents, size_t l
         return ERR_NOT_SUPPORTED;
     }
 
+    mtx_lock(&vn->lock);
     uint32_t idx;
     uint32_t sz;
     if (dc->used) {
@@ -537,6 +1662,7 @@ static mx_status_t fs_readdir(vnode_t* vn, void* cookie, void* dirents, size_t l
             // directory has been modified
             // stop returning entries
             dc->index = -1;
+            mtx_unlock(&vn->lock);
             return 0;
         }
         idx = dc->index;
@@ -587,12 +1713,14 @@ done:
     dc->index = idx;
     dc->size = sz;
     dc->seqno = vn->inode.seq_num;
+    mtx_unlock(&vn->lock);
     return ((void*) out) - dirents;
 
 fail:
     // mark dircookie so further reads return 0
     dc->index = -1;
     dc->used = 1;
+    mtx_unlock(&vn->lock);
     return ERR_IO;
 }
 
@@ -607,10 +1735,21 @@ static mx_status_t fs_create(vnode_t* vndir, vnode_t** out,
         .name = name,
         .len = len,
     };
-    // ensure file does not exist
     mx_status_t status;
+    mtx_lock(&vndir->lock);
+    if (vndir->inode.link_count == 0) {
+        // unlinked while we waited for the lock
+        mtx_unlock(&vndir->lock);
+        return ERR_BAD_STATE;
+    }
+    // ensure file does not exist
+    if (vn_dcache_lookup(vndir, &args)) {
+        mtx_unlock(&vndir->lock);
+        return ERR_ALREADY_EXISTS;
+    }
     if ((status = vn_dir_for_each(vndir, &args, cb_dir_find)) != ERR_NOT_FOUND) {
-        return ERR_IO; //TODO: err exists
+        mtx_unlock(&vndir->lock);
+        return (status < 0) ? status : ERR_ALREADY_EXISTS;
     }
 
     // creating a directory?
@@ -618,40 +1757,60 @@ static mx_status_t fs_create(vnode_t* vndir, vnode_t** out,
 
     // mint a new inode and vnode for it
     vnode_t* vn;
+    bcache_txn_begin(vndir->fs->bc);
     if ((status = minfs_vnode_new(vndir->fs, &vn, type)) < 0) {
-        return status;
+        goto done;
     }
 
     // add directory entry for the new child node
     args.ino = vn->ino;
     args.type = type;
     args.reclen = SIZEOF_MINFS_DIRENT(len);
-    if ((status = vn_dir_for_each(vndir, &args, cb_dir_append)) < 0) {
-        //TODO: handle "block full" by creating a new directory block
+    if ((status = vn_dir_append(vndir, &args)) < 0) {
         error("minfs_create() dir append failed %d\n", status);
-        return status;
+        goto done;
     }
+    vn_dcache_insert(vndir, &args);
 
     if (type == MINFS_TYPE_DIR) {
         void* bdata;
         block_t* blk;
-        if ((blk = minfs_new_block(vndir->fs, 0, vn->inode.dnum + 0, &bdata)) == NULL) {
+        if ((blk = vn_get_block(vn, 0, &bdata, true)) == NULL) {
             panic("failed to create directory");
         }
         minfs_dir_init(bdata, vn->ino, vndir->ino);
         bcache_put(vndir->fs->bc, blk, BLOCK_DIRTY);
-        vn->inode.block_count = 1;
         vn->inode.dirent_count = 2;
         vn->inode.size = MINFS_BLOCK_SIZE;
         minfs_sync_vnode(vn);
     }
     *out = vn;
-    return NO_ERROR;
+    status = NO_ERROR;
+done:
+    bcache_txn_end(vndir->fs->bc);
+    mtx_unlock(&vndir->lock);
+    return status;
 }
 
 static ssize_t fs_ioctl(vnode_t* vn, uint32_t op, const void* in_buf,
                         size_t in_len, void* out_buf, size_t out_len) {
-    return ERR_NOT_SUPPORTED;
+    switch (op) {
+    case IOCTL_VFS_GET_CACHE_INFO:
+        if (out_len < sizeof(vfs_cache_info_t)) {
+            return ERR_NOT_ENOUGH_BUFFER;
+        }
+        bcache_get_info(vn->fs->bc, out_buf);
+        return sizeof(vfs_cache_info_t);
+    case IOCTL_VFS_ALLOCATE: {
+        if (in_len < sizeof(vfs_allocate_t)) {
+            return ERR_INVALID_ARGS;
+        }
+        const vfs_allocate_t* req = in_buf;
+        return vn_allocate(vn, req->offset, req->length);
+    }
+    default:
+        return ERR_NOT_SUPPORTED;
+    }
 }
 
 static mx_status_t fs_unlink(vnode_t* vn, const char* name, size_t len) {
@@ -669,7 +1828,45 @@ static mx_status_t fs_unlink(vnode_t* vn, const char* name, size_t len) {
         .name = name,
         .len = len,
     };
-    return vn_dir_for_each(vn, &args, cb_dir_unlink);
+    // the child is locked, after the directory, before the
+    // transaction begins, as threads may wait for the lock
+    // outside of one but not inside
+    mtx_lock(&vn->lock);
+    vnode_t* child;
+    mx_status_t status;
+    if (((status = vn_dir_for_each(vn, &args, cb_dir_find)) < 0) ||
+        ((status = minfs_vnode_get(vn->fs, &child, args.ino)) < 0)) {
+        mtx_unlock(&vn->lock);
+        return status;
+    }
+    mtx_lock(&child->lock);
+
+    // directories must be empty (dirent_count == 2)
+    if ((child->inode.magic == MINFS_MAGIC_DIR) && (child->inode.dirent_count != 2)) {
+        // if we have more than "." and "..", not empty, cannot unlink
+        mtx_unlock(&child->lock);
+        vn_release(child);
+        mtx_unlock(&vn->lock);
+        return ERR_BAD_STATE;
+    }
+
+    vn_dcache_remove(vn, name, len);
+    bcache_txn_begin(vn->fs->bc);
+    if ((status = vn_dir_for_each(vn, &args, cb_dir_unlink)) == NO_ERROR) {
+        child->inode.link_count--;
+    }
+    mtx_unlock(&child->lock);
+    // if that was the last link, the inode goes with the same transaction
+    vn_release(child);
+    bcache_txn_end(vn->fs->bc);
+    mtx_unlock(&vn->lock);
+    return status;
+}
+
+static mx_status_t fs_sync(vnode_t* vn) {
+    trace(MINFS, "minfs_sync() vn=%p(#%u)\n", vn, vn->ino);
+    // the block cache does not track which blocks belong to which file
+    return bcache_sync(vn->fs->bc);
 }
 
 vnode_ops_t minfs_ops = {
@@ -684,5 +1881,10 @@ vnode_ops_t minfs_ops = {
     .create = fs_create,
     .ioctl = fs_ioctl,
     .unlink = fs_unlink,
+    .sync = fs_sync,
+    .truncate = fs_truncate,
+#ifdef __Fuchsia__
+    .get_vmo = fs_get_vmo,
+#endif
 };
 
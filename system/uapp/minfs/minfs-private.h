@@ -4,14 +4,23 @@
 
 #pragma once
 
+#include <threads.h>
+
 #include "vfs.h"
 #include "minfs.h"
 
 #define MINFS_HASH_BITS (8)
 #define MINFS_BUCKETS (1 << MINFS_HASH_BITS)
 
+#define MINFS_DEFAULT_INODES 32768
+
 typedef struct minfs minfs_t;
 
+// Requests may be served by several threads at once.  Each vnode's
+// lock serializes the operations on it, a directory's lock being
+// taken before that of a child.  The allocator lock guards both
+// bitmaps and every vnode's reservation, and the hash lock guards
+// the vnode hash.  Neither is held while taking a vnode lock.
 struct minfs {
     bitmap_t block_map;
     bitmap_t inode_map;
@@ -19,9 +28,41 @@ struct minfs {
     uint32_t abmblks;
     uint32_t ibmblks;
     minfs_info_t info;
+    mtx_t hash_lock;
     list_node_t vnode_hash[MINFS_BUCKETS];
+
+    mtx_t alloc_lock;
+    // vnodes holding block reservations
+    list_node_t resv_list;
 };
 
+// Appending writers reserve blocks ahead of what they are writing,
+// starting with MINFS_PREALLOC_MIN blocks and doubling each time,
+// up to MINFS_PREALLOC_MAX.  Reserved blocks are marked in the
+// in-memory block bitmap only, so other files are allocated
+// around them and a crash leaves nothing to clean up.
+#define MINFS_PREALLOC_MIN 8
+#define MINFS_PREALLOC_MAX 256
+
+// Reads following on from the previous one have the blocks after
+// them read ahead, starting with MINFS_READAHEAD_MIN blocks and
+// doubling each time, up to MINFS_READAHEAD_MAX.
+#define MINFS_READAHEAD_MIN 4
+#define MINFS_READAHEAD_MAX 64
+
+// Names recently found in an indexed directory, direct-mapped
+// by the same hash the on-disk index uses.
+#define MINFS_DCACHE_SLOTS 256
+#define MINFS_DCACHE_NAME_MAX 54
+
+typedef struct {
+    uint32_t hash;
+    uint32_t ino;                   // 0 if the slot is empty
+    uint8_t type;
+    uint8_t namelen;
+    char name[MINFS_DCACHE_NAME_MAX];
+} minfs_dcache_entry_t;
+
 struct vnode {
     // ops, flags, refcount
     VNODE_BASE_FIELDS
@@ -33,6 +74,35 @@ struct vnode {
 
     list_node_t hashnode;
 
+    // held across each operation on the vnode
+    mtx_t lock;
+
+    // blocks reserved for this vnode's next allocations,
+    // guarded by the allocator lock
+    list_node_t resvnode;
+    uint32_t resv_start;
+    uint32_t resv_count;
+    uint32_t prealloc;
+
+    // block after the last one the write in progress covers
+    uint32_t write_end;
+
+    // read ahead state: where the next sequential read would start,
+    // the current window, and the block after the last one read ahead
+    uint32_t ra_next;
+    uint32_t ra_size;
+    uint32_t ra_end;
+
+    // for indexed directories, allocated on first lookup
+    minfs_dcache_entry_t* dcache;
+
+    // the file as a VMO, for mapping and large reads, created on
+    // first use with room for the blocks the file has then.  Blocks
+    // are copied in as they are asked for, and kept in step with
+    // writes after that.
+    mx_handle_t vmo;
+    bitmap_t vmo_filled;
+
     minfs_inode_t inode;
 };
 
@@ -50,9 +120,58 @@ mx_status_t minfs_vnode_new(minfs_t* fs, vnode_t** out, uint32_t type);
 // allocate a new data block and bcache_get_zero() it
 block_t* minfs_new_block(minfs_t* fs, uint32_t hint, uint32_t* out_bno, void** bdata);
 
+// allocate block n of a file, at goal if possible, from or
+// adding to the vnode's reservation
+block_t* minfs_vnode_new_block(vnode_t* vn, uint32_t n, uint32_t goal,
+                               uint32_t* out_bno, void** bdata);
+
+// return the vnode's reserved blocks to the free pool
+void minfs_vnode_unreserve(vnode_t* vn);
+
 // free ino in inode bitmap
 mx_status_t minfs_ino_free(minfs_t* fs, uint32_t ino);
 
+// free bno in block bitmap
+mx_status_t minfs_block_free(minfs_t* fs, uint32_t bno);
+
+static inline bool minfs_has_extents(minfs_t* fs) {
+    return fs->info.version >= MINFS_VERSION_EXTENTS;
+}
+
+// older versions would add names to the wrong block of an index
+static inline bool minfs_has_dir_index(minfs_t* fs) {
+    return fs->info.version >= MINFS_VERSION_EXTENTS;
+}
+
+static inline uint32_t minfs_dir_hash(const char* name, size_t len) {
+    return fnv1a32(name, len);
+}
+
+// Extent Mapping (minfs-extent.c)
+
+// find the block holding block n of the file, or 0 if n is a hole
+// if goal_out is not NULL, it is set to where block n would best
+// be allocated, or 0 for no preference
+mx_status_t minfs_extent_lookup(minfs_t* fs, minfs_inode_t* inode, uint32_t n,
+                                uint32_t* bno_out, uint32_t* goal_out);
+
+// record that block n of the file, a hole, is now bno
+// may allocate extent blocks, updating the inode's block_count,
+// but does not write back the inode
+mx_status_t minfs_extent_insert(vnode_t* vn, uint32_t n, uint32_t bno);
+
+// called for each extent of data and, with leaf set, for each
+// extent block (as an extent of count 1)
+typedef mx_status_t (*minfs_extent_cb_t)(void* cookie, const minfs_extent_t* ext, bool leaf);
+
+mx_status_t minfs_extent_for_each(minfs_t* fs, minfs_inode_t* inode, minfs_extent_cb_t func,
+                                  void* cookie);
+
+// unmap file blocks n and up, handing what is unmapped, extent
+// blocks included, to func to be freed
+// does not update the inode's block_count or write back the inode
+mx_status_t minfs_extent_truncate(vnode_t* vn, uint32_t n, minfs_extent_cb_t func, void* cookie);
+
 // write the inode data of this vnode to disk
 void minfs_sync_vnode(vnode_t* vn);
 
@@ -63,7 +182,8 @@ mx_status_t minfs_create(minfs_t** out, bcache_t* bc, minfs_info_t* info);
 mx_status_t minfs_load_bitmaps(minfs_t* fs);
 void minfs_destroy(minfs_t* fs);
 
-int minfs_mkfs(bcache_t* bc);
+// inodes of 0 picks the default
+int minfs_mkfs(bcache_t* bc, uint32_t inodes);
 
 mx_status_t minfs_check(bcache_t* bc);
 
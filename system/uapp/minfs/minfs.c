@@ -12,11 +12,13 @@
 #include "minfs-private.h"
 
 void minfs_dump_info(minfs_info_t* info) {
+    printf("minfs: version: %10u\n", info->version);
     printf("minfs: blocks:  %10u (size %u)\n", info->block_count, info->block_size);
     printf("minfs: inodes:  %10u (size %u)\n", info->inode_count, info->inode_size);
     printf("minfs: inode bitmap @ %10u\n", info->ibm_block);
     printf("minfs: alloc bitmap @ %10u\n", info->abm_block);
     printf("minfs: inode table  @ %10u\n", info->ino_block);
+    printf("minfs: journal      @ %10u (%u blocks)\n", info->jnl_block, info->jnl_blocks);
     printf("minfs: data blocks  @ %10u\n", info->dat_block);
 }
 
@@ -26,7 +28,8 @@ mx_status_t minfs_check_info(minfs_info_t* info, uint32_t max) {
         error("minfs: bad magic\n");
         return ERR_INVALID_ARGS;
     }
-    if (info->version != MINFS_VERSION) {
+    if ((info->version != MINFS_VERSION_BLOCKMAP) &&
+        (info->version != MINFS_VERSION_EXTENTS)) {
         error("minfs: bad version %08x\n", info->version);
         return ERR_INVALID_ARGS;
     }
@@ -39,6 +42,12 @@ mx_status_t minfs_check_info(minfs_info_t* info, uint32_t max) {
         error("minfs: too large for device\n");
         return ERR_INVALID_ARGS;
     }
+    if ((info->jnl_blocks > 0) &&
+        ((info->jnl_block < info->ino_block) || (info->jnl_blocks > MINFS_JOURNAL_MAX) ||
+         (info->jnl_block + info->jnl_blocks > info->dat_block))) {
+        error("minfs: bad journal location\n");
+        return ERR_INVALID_ARGS;
+    }
     //TODO: validate layout
     return 0;
 }
@@ -69,7 +78,9 @@ mx_status_t minfs_ino_free(minfs_t* fs, uint32_t ino) {
     // obtain the block of the inode bitmap we need
     block_t* block_ibm;
     void* bdata_ibm;
+    mtx_lock(&fs->alloc_lock);
     if ((block_ibm = bcache_get(fs->bc, fs->info.ibm_block + bmbno, &bdata_ibm)) == NULL) {
+        mtx_unlock(&fs->alloc_lock);
         return ERR_IO;
     }
 
@@ -77,11 +88,12 @@ mx_status_t minfs_ino_free(minfs_t* fs, uint32_t ino) {
     bitmap_clr(&fs->inode_map, ino);
     memcpy(bdata_ibm, bmdata, MINFS_BLOCK_SIZE);
     bcache_put(fs->bc, block_ibm, BLOCK_DIRTY);
+    mtx_unlock(&fs->alloc_lock);
 
     return NO_ERROR;
 }
 
-mx_status_t minfs_ino_alloc(minfs_t* fs, minfs_inode_t* inode, uint32_t* ino_out) {
+static mx_status_t minfs_ino_alloc_locked(minfs_t* fs, minfs_inode_t* inode, uint32_t* ino_out) {
     uint32_t ino = bitmap_alloc(&fs->inode_map, 0);
     if (ino == BITMAP_FAIL) {
         return ERR_NO_RESOURCES;
@@ -128,6 +140,13 @@ mx_status_t minfs_ino_alloc(minfs_t* fs, minfs_inode_t* inode, uint32_t* ino_out
     return NO_ERROR;
 }
 
+mx_status_t minfs_ino_alloc(minfs_t* fs, minfs_inode_t* inode, uint32_t* ino_out) {
+    mtx_lock(&fs->alloc_lock);
+    mx_status_t status = minfs_ino_alloc_locked(fs, inode, ino_out);
+    mtx_unlock(&fs->alloc_lock);
+    return status;
+}
+
 mx_status_t minfs_vnode_new(minfs_t* fs, vnode_t** out, uint32_t type) {
     vnode_t* vn;
     if ((type != MINFS_TYPE_FILE) && (type != MINFS_TYPE_DIR)) {
@@ -145,7 +164,10 @@ mx_status_t minfs_vnode_new(minfs_t* fs, vnode_t** out, uint32_t type) {
         return ERR_NO_RESOURCES;
     }
     vn->fs = fs;
+    mtx_init(&vn->lock, mtx_plain);
+    mtx_lock(&fs->hash_lock);
     list_add_tail(fs->vnode_hash + INO_HASH(vn->ino), &vn->hashnode);
+    mtx_unlock(&fs->hash_lock);
 
     trace(MINFS, "new_vnode() %p(#%u) { magic=%#08x }\n",
           vn, vn->ino, vn->inode.magic);
@@ -160,20 +182,28 @@ mx_status_t minfs_vnode_get(minfs_t* fs, vnode_t** out, uint32_t ino) {
     }
     vnode_t* vn;
     uint32_t bucket = INO_HASH(ino);
+    mtx_lock(&fs->hash_lock);
     list_for_every_entry(fs->vnode_hash + bucket, vn, vnode_t, hashnode) {
         if (vn->ino == ino) {
+            // may be idle, fs_release() drops the last ref under the same lock
             vn_acquire(vn);
+            mtx_unlock(&fs->hash_lock);
             *out = vn;
             return NO_ERROR;
         }
     }
+    // the inode is read with the hash locked so that nobody else
+    // brings in a vnode for it meanwhile
     if ((vn = calloc(1, sizeof(vnode_t))) == NULL) {
+        mtx_unlock(&fs->hash_lock);
         return ERR_NO_MEMORY;
     }
     mx_status_t status;
     uint32_t ino_per_blk = fs->info.block_size / MINFS_INODE_SIZE;
     if ((status = bcache_read(fs->bc, fs->info.ino_block + ino / ino_per_blk, &vn->inode,
                               MINFS_INODE_SIZE * (ino % ino_per_blk), MINFS_INODE_SIZE)) < 0) {
+        mtx_unlock(&fs->hash_lock);
+        free(vn);
         return status;
     }
     trace(MINFS, "get_vnode() %p(#%u) { magic=%#08x size=%u blks=%u dn=%u,%u,%u,%u... }\n",
@@ -184,7 +214,9 @@ mx_status_t minfs_vnode_get(minfs_t* fs, vnode_t** out, uint32_t ino) {
     vn->ino = ino;
     vn->refcount = 1;
     vn->ops = &minfs_ops;
+    mtx_init(&vn->lock, mtx_plain);
     list_add_tail(fs->vnode_hash + bucket, &vn->hashnode);
+    mtx_unlock(&fs->hash_lock);
 
     *out = vn;
     return NO_ERROR;
@@ -227,9 +259,19 @@ mx_status_t minfs_create(minfs_t** out, bcache_t* bc, minfs_info_t* info) {
     for (int n = 0; n < MINFS_BUCKETS; n++) {
         list_initialize(fs->vnode_hash + n);
     }
+    list_initialize(&fs->resv_list);
+    mtx_init(&fs->hash_lock, mtx_plain);
+    mtx_init(&fs->alloc_lock, mtx_plain);
     memcpy(&fs->info, info, sizeof(minfs_info_t));
     fs->bc = bc;
 
+    // bring the volume up to date before anything else is read
+    if ((info->jnl_blocks > 0) &&
+        ((status = bcache_journal_open(bc, info->jnl_block, info->jnl_blocks)) < 0)) {
+        free(fs);
+        return status;
+    }
+
     // determine how many blocks of inodes, allocation bitmaps,
     // and inode bitmaps there are
     //uint32_t inoblks = (inodes + MINFS_INODES_PER_BLOCK - 1) / MINFS_INODES_PER_BLOCK;
@@ -270,6 +312,8 @@ mx_status_t minfs_load_bitmaps(minfs_t* fs) {
             error("minfs: failed reading inode bitmap\n");
         }
     }
+    bitmap_update_summary(&fs->block_map);
+    bitmap_update_summary(&fs->inode_map);
     return NO_ERROR;
 }
 
@@ -303,15 +347,23 @@ mx_status_t minfs_mount(vnode_t** out, bcache_t* bc) {
     return NO_ERROR;
 }
 
-int minfs_mkfs(bcache_t* bc) {
+int minfs_mkfs(bcache_t* bc, uint32_t inodes) {
     uint32_t blocks = bcache_max_block(bc);
-    uint32_t inodes = 32768;
+    if (inodes == 0) {
+        inodes = MINFS_DEFAULT_INODES;
+    }
 
     // determine how many blocks of inodes, allocation bitmaps,
     // and inode bitmaps there are
     uint32_t inoblks = (inodes + MINFS_INODES_PER_BLOCK - 1) / MINFS_INODES_PER_BLOCK;
     uint32_t abmblks = (blocks + MINFS_BLOCK_BITS - 1) / MINFS_BLOCK_BITS;
     uint32_t ibmblks = (inodes + MINFS_BLOCK_BITS - 1) / MINFS_BLOCK_BITS;
+    uint32_t jnlblks = blocks / 128;
+    if (jnlblks < MINFS_JOURNAL_MIN) {
+        jnlblks = MINFS_JOURNAL_MIN;
+    } else if (jnlblks > MINFS_JOURNAL_MAX) {
+        jnlblks = MINFS_JOURNAL_MAX;
+    }
 
     minfs_info_t info;
     memset(&info, 0x00, sizeof(info));
@@ -325,8 +377,14 @@ int minfs_mkfs(bcache_t* bc) {
     info.inode_count = inodes;
     info.ibm_block = 8;
     info.abm_block = 16;
+    if (ibmblks > (info.abm_block - info.ibm_block)) {
+        error("minfs: too many inodes (%u)\n", inodes);
+        return -1;
+    }
     info.ino_block = info.abm_block + ((abmblks + 8) & (~7));
-    info.dat_block = info.ino_block + inoblks;
+    info.jnl_block = info.ino_block + inoblks;
+    info.jnl_blocks = jnlblks;
+    info.dat_block = info.jnl_block + jnlblks;
     minfs_dump_info(&info);
 
     bitmap_t abm;
@@ -380,6 +438,10 @@ int minfs_mkfs(bcache_t* bc) {
         bcache_put(bc, blk, BLOCK_DIRTY);
     }
 
+    if (bcache_journal_init(bc, info.jnl_block, info.jnl_blocks) < 0) {
+        return -1;
+    }
+
 
     // setup root inode
     blk = bcache_get(bc, info.ino_block, &bdata);
@@ -389,11 +451,14 @@ int minfs_mkfs(bcache_t* bc) {
     ino[1].block_count = 1;
     ino[1].link_count = 1;
     ino[1].dirent_count = 2;
-    ino[1].dnum[0] = info.dat_block;
+    ino[1].extent_count = 1;
+    ino[1].extents[0].fblk = 0;
+    ino[1].extents[0].start = info.dat_block;
+    ino[1].extents[0].count = 1;
     bcache_put(bc, blk, BLOCK_DIRTY);
 
     blk = bcache_get_zero(bc, 0, &bdata);
     memcpy(bdata, &info, sizeof(info));
     bcache_put(bc, blk, BLOCK_DIRTY);
-    return 0;
+    return bcache_sync(bc);
 }
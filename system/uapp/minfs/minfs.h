@@ -12,7 +12,9 @@
 
 #define MINFS_MAGIC0         (0x002153466e694d21ULL)
 #define MINFS_MAGIC1         (0x385000d3d3d3d304ULL)
-#define MINFS_VERSION        0x00000001
+#define MINFS_VERSION_BLOCKMAP 0x00000001
+#define MINFS_VERSION_EXTENTS  0x00000002
+#define MINFS_VERSION        MINFS_VERSION_EXTENTS
 
 #define MINFS_FLAG_CLEAN     1
 #define MINFS_BLOCK_SIZE     8192
@@ -22,6 +24,7 @@
 
 #define MINFS_DIRECT         16
 #define MINFS_INDIRECT       32
+#define MINFS_EXTENTS        16
 
 #define MINFS_TYPE_FILE      8
 #define MINFS_TYPE_DIR       4
@@ -30,6 +33,13 @@
 #define MINFS_MAGIC_DIR      MINFS_MAGIC(MINFS_TYPE_DIR)
 #define MINFS_MAGIC_FILE     MINFS_MAGIC(MINFS_TYPE_FILE)
 #define MINFS_MAGIC_TYPE(n)  ((n) & 0xFF)
+#define MINFS_MAGIC_EXTENTS  0xAA6f6e45
+#define MINFS_MAGIC_DIR_INDEX 0xAA6f6e49
+#define MINFS_MAGIC_JOURNAL  0xAA6f6e4a
+#define MINFS_MAGIC_JOURNAL_REC 0xAA6f6e52
+
+#define MINFS_DIR_INDEXED    1  // block 0 holds a hash index of the others
+#define MINFS_DIR_LINEAR     2  // not indexed, and never to be
 
 typedef struct {
     uint64_t magic0;
@@ -44,10 +54,12 @@ typedef struct {
     uint32_t abm_block;     // first blockno of block allocation bitmap
     uint32_t ino_block;     // first blockno of inode table
     uint32_t dat_block;     // first blockno available for file data
+    uint32_t jnl_block;     // first blockno of the journal
+    uint32_t jnl_blocks;    // size of the journal, 0 if there is none
 } minfs_info_t;
 
 // Notes:
-// - the ibm, abm, ino, and dat regions must be in that order
+// - the ibm, abm, ino, jnl, and dat regions must be in that order
 //   and may not overlap
 // - the abm has an entry for every block on the volume, including
 //   the info block (0), the bitmaps, etc
@@ -60,6 +72,12 @@ typedef struct {
 //   at offset: ino % MINFS_INODES_PER_BLOCK
 // - inode 0 is never used, should be marked allocated but ignored
 
+typedef struct {
+    uint32_t fblk;                  // first block of the file covered
+    uint32_t start;                 // first block on the volume
+    uint32_t count;                 // number of blocks
+} minfs_extent_t;
+
 typedef struct {
     uint32_t magic;
     uint32_t size;
@@ -70,14 +88,52 @@ typedef struct {
     uint32_t seq_num;               // bumped when modified
     uint32_t gen_num;               // bumped when deleted
     uint32_t dirent_count;           // for directories
-    uint32_t rsvd[5];
-    uint32_t dnum[MINFS_DIRECT];    // direct blocks
-    uint32_t inum[MINFS_INDIRECT];  // indirect blocks
+    uint16_t extent_count;          // entries in use in extents[]
+    uint16_t extent_depth;          // 0: extents[] maps data, 1: extent blocks
+    uint32_t dir_flags;             // MINFS_DIR_* for directories
+    uint32_t rsvd[3];
+    union {
+        struct {
+            uint32_t dnum[MINFS_DIRECT];    // direct blocks
+            uint32_t inum[MINFS_INDIRECT];  // indirect blocks
+        };
+        minfs_extent_t extents[MINFS_EXTENTS];
+    };
 } minfs_inode_t;
 
 static_assert(sizeof(minfs_inode_t) == MINFS_INODE_SIZE,
               "minfs inode size is wrong");
 
+typedef struct {
+    uint32_t magic;                 // MINFS_MAGIC_EXTENTS
+    uint32_t count;                 // entries in use in extents[]
+    minfs_extent_t extents[];
+} minfs_extent_block_t;
+
+#define MINFS_EXTENTS_PER_BLOCK \
+    ((MINFS_BLOCK_SIZE - sizeof(minfs_extent_block_t)) / sizeof(minfs_extent_t))
+
+// the most extents a file may have; split extent blocks are left half
+// full, so a file may run out of room for more well before this
+#define MINFS_EXTENTS_MAX (MINFS_EXTENTS * MINFS_EXTENTS_PER_BLOCK)
+
+// Notes:
+// - inodes on MINFS_VERSION_BLOCKMAP volumes map their data with
+//   dnum[] and inum[]; on MINFS_VERSION_EXTENTS volumes the same
+//   space holds extents[] instead
+// - extents are sorted by fblk and do not overlap; blocks of the
+//   file not covered by an extent are holes
+// - with extent_depth 0, extents[] maps the file directly
+// - with extent_depth 1, each entry of extents[] describes an
+//   extent block: fblk is the lowest file block it may map, start
+//   is its block number, and count is the number of extents in it;
+//   extents[0].fblk is always 0
+// - there is no deeper level: writes that would need a new extent
+//   once all MINFS_EXTENTS extent blocks are full fail with
+//   ERR_TOO_BIG, which caps a file at MINFS_EXTENTS_MAX runs of
+//   blocks, and at about half that when they are added in order
+// - extent blocks count toward the inode's block_count
+
 typedef struct {
     uint32_t ino;                   // inode number
     uint16_t reclen;                // length of this record
@@ -98,6 +154,76 @@ typedef struct {
 //   skipped over on lookup
 // - reclen must be a multiple of 4
 
+typedef struct {
+    uint32_t hash;                  // lowest name hash in the block
+    uint32_t block;                 // directory block holding those names
+} minfs_dir_index_entry_t;
+
+typedef struct {
+    uint32_t magic;                 // MINFS_MAGIC_DIR_INDEX
+    uint32_t count;                 // entries in use in entries[]
+    minfs_dir_index_entry_t entries[];
+} minfs_dir_index_t;
+
+// offset of the dirent holding the index in block 0
+#define MINFS_DIR_INDEX_DIRENT (SIZEOF_MINFS_DIRENT(1) + SIZEOF_MINFS_DIRENT(2))
+
+#define MINFS_DIR_INDEX_MAX \
+    ((MINFS_BLOCK_SIZE - MINFS_DIR_INDEX_DIRENT - MINFS_DIRENT_SIZE - \
+      sizeof(minfs_dir_index_t)) / sizeof(minfs_dir_index_entry_t))
+
+// Notes:
+// - only MINFS_VERSION_EXTENTS volumes index directories
+// - block 0 of an indexed directory holds "." and "..", each
+//   exactly as long as needed, and then a free (ino 0) dirent
+//   covering the rest of the block, whose name area holds the
+//   index, so anything reading dirents in order skips over it
+// - the hash of a name is its 32bit FNV-1a hash
+// - index entries are sorted by hash; entries[0].hash is 0; a
+//   name is in the block of the last entry whose hash is not
+//   greater than the name's
+
+typedef struct {
+    uint32_t magic;                 // MINFS_MAGIC_JOURNAL
+    uint32_t reserved;
+    uint64_t seq;                   // sequence number of the first record
+} minfs_journal_info_t;
+
+typedef struct {
+    uint32_t magic;                 // MINFS_MAGIC_JOURNAL_REC
+    uint32_t count;                 // blocks in the record
+    uint64_t seq;
+    uint32_t checksum;              // of this block and the count that follow
+    uint32_t reserved;
+    uint32_t bno[];                 // where each block belongs
+} minfs_journal_record_t;
+
+#define MINFS_JOURNAL_RECORD_MAX \
+    ((MINFS_BLOCK_SIZE - sizeof(minfs_journal_record_t)) / sizeof(uint32_t))
+
+// mkfs makes the journal 1/128th of the volume, within these bounds
+#define MINFS_JOURNAL_MIN    32
+#define MINFS_JOURNAL_MAX    1024
+
+static_assert(MINFS_JOURNAL_MAX <= MINFS_JOURNAL_RECORD_MAX,
+              "minfs journal too large for one record");
+
+// Notes:
+// - volumes made before the journal have jnl_blocks of 0
+// - block 0 of the journal holds a minfs_journal_info_t, and
+//   records follow it from block 1, each a minfs_journal_record_t
+//   block and then count blocks of metadata
+// - record checksums are FNV-1a, computed with the checksum
+//   field set to 0
+// - a record is valid if its magic, seq (one more than that of
+//   the record before it), count, and checksum are; the first
+//   invalid record ends the journal
+// - every block in a valid record is written to its bno on mount,
+//   in order, after which the journal is emptied by writing a new
+//   minfs_journal_info_t with a higher seq than any record
+// - file data is never in the journal, but is written in place
+//   before the records that refer to it
+
 
 // blocksize   8K    16K    32K
 // 16 dir =  128K   256K   512K
@@ -28,6 +28,12 @@ typedef struct iostate {
     size_t io_off;
 } iostate_t;
 
+// Requests are handled by a pool of worker threads shared by all
+// connections, so those on different connections may run at the same
+// time, and one blocked holds up only its own, while those on the
+// same connection stay in order.
+#define VFS_MAX_WORKERS 8
+
 static mxio_dispatcher_t* vfs_dispatcher;
 
 static mx_status_t vfs_handler(mxrio_msg_t* msg, mx_handle_t rh, void* cookie);
@@ -86,6 +92,15 @@ mx_handle_t vfs_rpc_server(vnode_t* vn, const char* where) {
         free(ios);
         return r;
     }
+    uint32_t count = mx_num_cpus();
+    if (count > VFS_MAX_WORKERS) {
+        count = VFS_MAX_WORKERS;
+    }
+    if ((r = mxio_dispatcher_add_workers(vfs_dispatcher, count)) < 0) {
+        free(ios);
+        return r;
+    }
+    trace(RPC, "minfs: serving with %u threads\n", count);
 
     mx_handle_t h;
     if ((h = devmgr_connect(where)) < 0) {
@@ -268,6 +283,10 @@ static mx_status_t vfs_handler(mxrio_msg_t* msg, mx_handle_t rh, void* cookie) {
     }
     case MXRIO_UNLINK:
         return vn->ops->unlink(vn, (const char*)msg->data, len);
+    case MXRIO_SYNC:
+    case MXRIO_TRUNCATE:
+    case MXRIO_MMAP:
+        return vfs_handle_rio(vn, msg, len, &ios->io_off);
     default:
         return ERR_NOT_SUPPORTED;
     }
@@ -23,6 +23,7 @@ MODULE_SRCS += \
 MODULE_SRCS += \
     $(LOCAL_DIR)/minfs.c \
     $(LOCAL_DIR)/minfs-ops.c \
+    $(LOCAL_DIR)/minfs-extent.c \
     $(LOCAL_DIR)/minfs-check.c \
 
 MODULE_LIBS := ulib/magenta ulib/mxio ulib/musl
@@ -10,12 +10,19 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <threads.h>
+#include <time.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
+#include <magenta/types.h>
+
+#include "minfs.h"
 #include "misc.h"
 
 void drop_cache(void);
+uint32_t fs_inode_count(void);
+int do_bitmap_test(void);
 
 #define TRY(func) ({\
     int ret = (func); \
@@ -126,6 +133,11 @@ int worker_verify(worker_t* w) {
 int worker_writer(worker_t* w) {
     int r = worker_rw(w, false);
     if (r == DONE) {
+        if (fsync(w->fd) < 0) {
+            fprintf(stderr, "worker('%s') fsync failed: %s\n",
+                    w->name, strerror(errno));
+            return FAIL;
+        }
         if (lseek(w->fd, 0, SEEK_SET) != 0) {
             fprintf(stderr, "worker('%s') seek failed: %s\n",
                     w->name, strerror(errno));
@@ -252,6 +264,302 @@ int test_maxfile(void) {
     return (r < 0) ? -1 : 0;
 }
 
+static void expect_bytes(int fd, off_t off, size_t len, uint8_t val, const char* what) {
+    uint8_t buf[KB(16)];
+    assert(len <= sizeof(buf));
+    TRY(lseek(fd, off, SEEK_SET));
+    if (TRY(read(fd, buf, len)) != len) {
+        fprintf(stderr, "sparse: short read of %s\n", what);
+        exit(1);
+    }
+    for (size_t n = 0; n < len; n++) {
+        if (buf[n] != val) {
+            fprintf(stderr, "sparse: %s has %#x at %zu, not %#x\n", what, buf[n], n, val);
+            exit(1);
+        }
+    }
+}
+
+static void expect_size(int fd, off_t size) {
+    struct stat s;
+    TRY(fstat(fd, &s));
+    if (s.st_size != size) {
+        fprintf(stderr, "sparse: size is %lld, not %lld\n",
+                (long long)s.st_size, (long long)size);
+        exit(1);
+    }
+}
+
+#define SPARSE_RUNS 300
+
+// Holes read as zeros, shrinking frees what is past the new end and
+// zeros the rest of its last block, and allocated ranges read as
+// zeros until written.  Run "check" afterwards to see that the
+// block counts add up.
+int test_sparse(void) {
+    uint8_t data[KB(16)];
+    memset(data, 0x5a, sizeof(data));
+
+    int fd = TRY(open("::sparse", O_CREAT|O_RDWR, 0644));
+    TRY(lseek(fd, MB(1), SEEK_SET));
+    TRY(write(fd, data, sizeof(data)));
+    expect_bytes(fd, KB(512), KB(16), 0, "hole");
+    expect_bytes(fd, MB(1), KB(16), 0x5a, "data");
+
+    TRY(ftruncate(fd, MB(1) + 100));
+    TRY(ftruncate(fd, MB(1) + KB(16)));
+    expect_size(fd, MB(1) + KB(16));
+    expect_bytes(fd, MB(1), 100, 0x5a, "data kept");
+    expect_bytes(fd, MB(1) + 100, KB(16) - 100, 0, "data cut off");
+
+    // enough separate runs to need extent blocks
+    for (unsigned n = 0; n < SPARSE_RUNS; n++) {
+        TRY(lseek(fd, (off_t)n * KB(16), SEEK_SET));
+        TRY(write(fd, data, 1));
+    }
+    TRY(ftruncate(fd, (SPARSE_RUNS / 2) * KB(16) + 1));
+    expect_bytes(fd, (SPARSE_RUNS / 2 - 1) * KB(16) + 1, KB(16) - 1, 0, "hole");
+    TRY(ftruncate(fd, 0));
+    expect_size(fd, 0);
+    close(fd);
+
+    fd = TRY(open("::prealloc", O_CREAT|O_RDWR, 0644));
+    int r;
+    if ((r = posix_fallocate(fd, KB(4), MB(2))) != 0) {
+        fprintf(stderr, "sparse: cannot allocate: %s\n", strerror(r));
+        exit(1);
+    }
+    expect_size(fd, KB(4) + MB(2));
+    expect_bytes(fd, MB(1), KB(16), 0, "allocated");
+    TRY(lseek(fd, KB(8), SEEK_SET));
+    TRY(write(fd, data, sizeof(data)));
+    expect_bytes(fd, KB(8), KB(16), 0x5a, "allocated and written");
+    close(fd);
+    return 0;
+}
+
+// Write one block at every other block of a file, each a run of its
+// own, until the file has more runs than its extents can map, which
+// has to fail as the file being too big rather than the volume being
+// full, and leave the runs written readable and writable.  Run
+// "check" afterwards to see that the extent blocks add up.
+int test_extents(void) {
+    char data[MINFS_BLOCK_SIZE];
+    memset(data, 0x5a, sizeof(data));
+
+    int fd = TRY(open("::extents", O_CREAT|O_RDWR, 0644));
+    unsigned runs;
+    ssize_t r = 0;
+    for (runs = 0; runs <= MINFS_EXTENTS_MAX; runs++) {
+        TRY(lseek(fd, (off_t)runs * 2 * sizeof(data), SEEK_SET));
+        if ((r = write(fd, data, 1)) != 1) {
+            break;
+        }
+    }
+    if (r != ERR_TOO_BIG) {
+        fprintf(stderr, "extents: write of run %u returned %zd, not %d\n", runs, r, ERR_TOO_BIG);
+        exit(1);
+    }
+    if (runs < (MINFS_EXTENTS_MAX / 2)) {
+        fprintf(stderr, "extents: only %u runs fit\n", runs);
+        exit(1);
+    }
+    expect_size(fd, (off_t)(runs - 1) * 2 * sizeof(data) + 1);
+    expect_bytes(fd, 0, 1, 0x5a, "first run");
+    expect_bytes(fd, (off_t)(runs - 1) * 2 * sizeof(data), 1, 0x5a, "last run");
+    TRY(lseek(fd, 0, SEEK_SET));
+    if (TRY(write(fd, data, sizeof(data))) != sizeof(data)) {
+        fprintf(stderr, "extents: cannot rewrite the first run\n");
+        exit(1);
+    }
+    close(fd);
+    fprintf(stderr, "extents: %u runs of at most %zu\n", runs, (size_t)MINFS_EXTENTS_MAX);
+    return 0;
+}
+
+#define FRAG_SMALL 256
+#define FRAG_WRITERS 8
+
+// Fragmentation benchmark: fill the volume with small files, delete
+// every other one, then append to several large files in lockstep.
+// Run "check" afterwards to see how many fragments the files ended up in.
+int test_frag(void) {
+    char name[64];
+    char data[KB(8)];
+    memset(data, 0x5a, sizeof(data));
+
+    clock_t t0 = clock();
+    for (unsigned n = 0; n < FRAG_SMALL; n++) {
+        snprintf(name, sizeof(name), "::small%04u", n);
+        int fd = TRY(open(name, O_CREAT|O_WRONLY, 0644));
+        for (unsigned m = 0; m < (n % 4) + 1; m++) {
+            TRY(write(fd, data, sizeof(data)));
+        }
+        close(fd);
+    }
+    for (unsigned n = 0; n < FRAG_SMALL; n += 2) {
+        snprintf(name, sizeof(name), "::small%04u", n);
+        TRY(unlink(name));
+    }
+
+    int fd[FRAG_WRITERS];
+    for (unsigned n = 0; n < FRAG_WRITERS; n++) {
+        snprintf(name, sizeof(name), "::big%04u", n);
+        fd[n] = TRY(open(name, O_CREAT|O_WRONLY, 0644));
+    }
+    size_t total = 0;
+    for (unsigned i = 0; i < (MB(4) / sizeof(data)); i++) {
+        for (unsigned n = 0; n < FRAG_WRITERS; n++) {
+            // alternate between single block and larger writes
+            size_t len = (n & 1) ? sizeof(data) : sizeof(data) / 2;
+            TRY(write(fd[n], data, len));
+            total += len;
+        }
+    }
+    for (unsigned n = 0; n < FRAG_WRITERS; n++) {
+        close(fd[n]);
+    }
+    uint64_t ms = (uint64_t)(clock() - t0) * 1000 / CLOCKS_PER_SEC;
+    fprintf(stderr, "frag: wrote %zu bytes to %u files in %llu ms\n",
+            total, FRAG_WRITERS, (unsigned long long)ms);
+    return 0;
+}
+
+static uint64_t ms_since(clock_t t0) {
+    return (uint64_t)(clock() - t0) * 1000 / CLOCKS_PER_SEC;
+}
+
+static void report_rate(const char* what, unsigned count, uint64_t ms) {
+    fprintf(stderr, "dir: %u %s in %llu ms (%llu/s)\n", count, what,
+            (unsigned long long)ms, (unsigned long long)(count * 1000ULL / (ms ? ms : 1)));
+}
+
+// inodes test_dir() leaves free by default, for the root and ::spool
+#define DIR_SPARE_INODES 16
+
+// Directory benchmark: create, look up, and unlink count files
+// in one directory.  Needs a filesystem with enough inodes; by
+// default it uses nearly all of them.
+int test_dir(unsigned count) {
+    char name[64];
+    TRY(mkdir("::spool", 0755));
+
+    clock_t t0 = clock();
+    for (unsigned n = 0; n < count; n++) {
+        snprintf(name, sizeof(name), "::spool/msg%08x.eml", n * 2654435761U);
+        int fd = TRY(open(name, O_CREAT|O_EXCL|O_WRONLY, 0644));
+        close(fd);
+    }
+    report_rate("creates", count, ms_since(t0));
+
+    t0 = clock();
+    for (unsigned n = 0; n < count; n++) {
+        snprintf(name, sizeof(name), "::spool/msg%08x.eml", n * 2654435761U);
+        int fd = TRY(open(name, O_RDONLY, 0644));
+        close(fd);
+    }
+    report_rate("lookups", count, ms_since(t0));
+
+    t0 = clock();
+    for (unsigned n = 0; n < count; n++) {
+        snprintf(name, sizeof(name), "::spool/msg%08x.eml", n * 2654435761U);
+        TRY(unlink(name));
+    }
+    report_rate("unlinks", count, ms_since(t0));
+
+    TRY(unlink("::spool"));
+    return 0;
+}
+
+// Commit a directory of files, then stop part way through adding
+// more, as a crash would, leaving "check" to replay the journal.
+int test_crash(void) {
+    char name[64];
+    char buf[4096];
+    memset(buf, 0x5a, sizeof(buf));
+    TRY(mkdir("::crash", 0755));
+    for (unsigned n = 0; n < 1000; n++) {
+        if (n == 500) {
+            int fd = TRY(open("::crash", O_RDONLY, 0644));
+            TRY(fsync(fd));
+            close(fd);
+        }
+        snprintf(name, sizeof(name), "::crash/file%04u", n);
+        int fd = TRY(open(name, O_CREAT|O_EXCL|O_WRONLY, 0644));
+        TRY(write(fd, buf, (n % 4) * 1024 + 100));
+        close(fd);
+        if ((n % 3) == 0) {
+            TRY(unlink(name));
+        }
+    }
+    fprintf(stderr, "crash: leaving without a sync\n");
+    _exit(0);
+}
+
+#define MT_THREADS 4
+#define MT_FILES 200
+
+// Each thread fills a directory of its own with files, reading each
+// back, while also adding and removing files in a shared directory
+// and now and then syncing.
+static int mt_worker(void* arg) {
+    unsigned id = (uintptr_t) arg;
+    char name[64];
+    uint8_t out[KB(12)];
+    uint8_t in[KB(12)];
+    snprintf(name, sizeof(name), "::mt%u", id);
+    TRY(mkdir(name, 0755));
+    for (unsigned n = 0; n < MT_FILES; n++) {
+        size_t len = KB(4) + (n % 3) * KB(4) - id;
+        memset(out, id * MT_FILES + n, len);
+        snprintf(name, sizeof(name), "::mt%u/file%04u", id, n);
+        int fd = TRY(open(name, O_CREAT|O_EXCL|O_RDWR, 0644));
+        if (TRY(write(fd, out, len)) != len) {
+            fprintf(stderr, "mt: short write to '%s'\n", name);
+            exit(1);
+        }
+        TRY(lseek(fd, 0, SEEK_SET));
+        if ((TRY(read(fd, in, sizeof(in))) != len) || memcmp(in, out, len)) {
+            fprintf(stderr, "mt: '%s' did not read back\n", name);
+            exit(1);
+        }
+        close(fd);
+        if (n & 1) {
+            TRY(unlink(name));
+        }
+
+        snprintf(name, sizeof(name), "::shared/t%u.%04u", id, n);
+        fd = TRY(open(name, O_CREAT|O_EXCL|O_WRONLY, 0644));
+        if ((n % 50) == 0) {
+            TRY(fsync(fd));
+        }
+        close(fd);
+        if (n > 0) {
+            snprintf(name, sizeof(name), "::shared/t%u.%04u", id, n - 1);
+            TRY(unlink(name));
+        }
+    }
+    return 0;
+}
+
+int test_threads(void) {
+    thrd_t t[MT_THREADS];
+    TRY(mkdir("::shared", 0755));
+    clock_t t0 = clock();
+    for (unsigned n = 0; n < MT_THREADS; n++) {
+        if (thrd_create(t + n, mt_worker, (void*)(uintptr_t) n) != thrd_success) {
+            fprintf(stderr, "mt: cannot start thread %u\n", n);
+            return -1;
+        }
+    }
+    for (unsigned n = 0; n < MT_THREADS; n++) {
+        thrd_join(t[n], NULL);
+    }
+    fprintf(stderr, "mt: %u threads done in %llu ms of cpu\n", MT_THREADS,
+            (unsigned long long)ms_since(t0));
+    return 0;
+}
+
 int test_basic(void) {
     TRY(mkdir("::alpha", 0755));
     TRY(mkdir("::alpha/bravo", 0755));
@@ -283,6 +591,28 @@ int run_fs_tests(int argc, char** argv) {
         if (!strcmp(argv[0], "basic")) {
             return test_basic();
         }
+        if (!strcmp(argv[0], "bitmap")) {
+            return do_bitmap_test();
+        }
+        if (!strcmp(argv[0], "frag")) {
+            return test_frag();
+        }
+        if (!strcmp(argv[0], "crash")) {
+            return test_crash();
+        }
+        if (!strcmp(argv[0], "mt")) {
+            return test_threads();
+        }
+        if (!strcmp(argv[0], "sparse")) {
+            return test_sparse();
+        }
+        if (!strcmp(argv[0], "extents")) {
+            return test_extents();
+        }
+        if (!strcmp(argv[0], "dir")) {
+            return test_dir((argc > 1) ? strtoul(argv[1], NULL, 0) :
+                            fs_inode_count() - DIR_SPARE_INODES);
+        }
         fprintf(stderr, "unknown test: %s\n", argv[0]);
         return -1;
     }
@@ -122,19 +122,27 @@ mx_status_t vfs_fill_dirent(vdirent_t* de, size_t delen,
     return sz;
 }
 
+// Vnodes are shared by the threads serving requests, so their
+// refcounts are atomic.  The last ref is handed to the release op
+// to drop, so that the filesystem can do so under whatever lock it
+// looks up vnodes with, and nobody brings the vnode back meanwhile.
 void vn_acquire(vnode_t* vn) {
-    trace(REFS, "acquire vn=%p ref=%u\n", vn, vn->refcount);
-    vn->refcount++;
+    uint32_t ref = __atomic_fetch_add(&vn->refcount, 1, __ATOMIC_RELAXED);
+    trace(REFS, "acquire vn=%p ref=%u\n", vn, ref);
 }
 
 void vn_release(vnode_t* vn) {
-    trace(REFS, "release vn=%p ref=%u\n", vn, vn->refcount);
-    if (vn->refcount == 0) {
-        panic("vn %p: ref underflow\n", vn);
-    }
-    vn->refcount--;
-    if (vn->refcount == 0) {
-        trace(VFS, "vfs_release: vn=%p\n", vn);
-        vn->ops->release(vn);
-    }
+    uint32_t ref = __atomic_load_n(&vn->refcount, __ATOMIC_RELAXED);
+    trace(REFS, "release vn=%p ref=%u\n", vn, ref);
+    do {
+        if (ref == 0) {
+            panic("vn %p: ref underflow\n", vn);
+        }
+        if (ref == 1) {
+            trace(VFS, "vfs_release: vn=%p\n", vn);
+            vn->ops->release(vn);
+            return;
+        }
+    } while (!__atomic_compare_exchange_n(&vn->refcount, &ref, ref - 1, false,
+                                          __ATOMIC_RELEASE, __ATOMIC_RELAXED));
 }
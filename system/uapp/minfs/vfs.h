@@ -6,6 +6,7 @@
 
 #include <stdint.h>
 #include <magenta/types.h>
+#include <magenta/device/vfs.h>
 #include <mxio/vfs.h>
 
 #include "misc.h"
@@ -23,6 +24,10 @@ mx_status_t vfs_find(vnode_t* vndir, vnode_t** out,
 
 mx_status_t vfs_close(vnode_t* vn);
 
+// Unlike devmgr's, minfs's vn_release() calls the release op with the
+// last ref still held, refcount one, and the op drops it itself; see
+// vfs.c.  The ops in minfs-ops.c are written for that.
+
 mx_status_t vfs_fill_dirent(vdirent_t* de, size_t delen,
                             const char* name, size_t len, uint32_t type);
 
@@ -34,11 +39,22 @@ mx_handle_t vfs_rpc_server(vnode_t* vn, const char* where);
 // Allocation Bitmap (bitmap.c)
 
 typedef struct bitmap bitmap_t;
+
+// A map of up to 2^32 bits needs at most this many summary levels
+#define BITMAP_LEVELS 5
+
 struct bitmap {
     uint32_t bitcount;
     uint32_t mapcount;
     uint64_t *map;
     uint64_t *end;
+
+    // Bit n of summary level 0 is set when word n of the map is
+    // all ones, bit n of level 1 when word n of level 0 is, and
+    // so on, so a clear bit can be found without a linear scan.
+    uint32_t levels;
+    uint32_t sumcount[BITMAP_LEVELS];
+    uint64_t *summary[BITMAP_LEVELS];
 };
 
 mx_status_t bitmap_init(bitmap_t* bm, uint32_t maxbits);
@@ -51,15 +67,29 @@ void bitmap_destroy(bitmap_t* bm);
 // to a maximum allowed bit smaller than the storage)
 mx_status_t bitmap_resize(bitmap_t* bm, uint32_t maxbits);
 
+// Recompute the summary after changing the map through bitmap_data()
+void bitmap_update_summary(bitmap_t* bm);
+
+void bitmap_summary_set(bitmap_t* bm, uint32_t word);
+void bitmap_summary_clr(bitmap_t* bm, uint32_t word);
+
 static inline void bitmap_set(bitmap_t* bm, uint32_t n) {
     if (n < bm->bitcount) {
-        bm->map[n >> 6] |= (1ULL << (n & 63));
+        uint64_t* word = bm->map + (n >> 6);
+        *word |= (1ULL << (n & 63));
+        if (*word == ~0ULL) {
+            bitmap_summary_set(bm, n >> 6);
+        }
     }
 }
 
 static inline void bitmap_clr(bitmap_t* bm, uint32_t n) {
     if (n < bm->bitcount) {
-        bm->map[n >> 6] &= ~((1ULL << (n & 63)));
+        uint64_t* word = bm->map + (n >> 6);
+        if (*word == ~0ULL) {
+            bitmap_summary_clr(bm, n >> 6);
+        }
+        *word &= ~((1ULL << (n & 63)));
     }
 }
 
@@ -81,15 +111,35 @@ static inline void* bitmap_data(bitmap_t* bm) {
 // returns BITMAP_FAIL if no bit is found
 uint32_t bitmap_alloc(bitmap_t* bm, uint32_t minbit);
 
+// find the first clear bit at or after minbit
+// returns BITMAP_FAIL if there is none
+uint32_t bitmap_find(bitmap_t* bm, uint32_t minbit);
+
+// find a run of up to max clear bits at or after minbit, set them,
+// and return the first bitnumber, with the run length in *count.
+// Short runs are passed over for a while in search of one that is
+// max bits long.  Returns BITMAP_FAIL if no bit is found.
+uint32_t bitmap_alloc_run(bitmap_t* bm, uint32_t minbit, uint32_t max, uint32_t* count);
+
 
 // Block Cache (bcache.c)
 
 typedef struct bcache bcache_t;
 typedef struct block block_t;
 
+// create a cache of up to num blocks of the device fd, which
+// has blockmax blocks
+// blocks are allocated as they are first needed
 int bcache_create(bcache_t** out, int fd, uint32_t blockmax, uint32_t blocksize, uint32_t num);
 
+// change how many blocks the cache may hold, up to the number
+// given at creation; idle blocks over the new size are freed
+void bcache_resize(bcache_t* bc, uint32_t num);
+
+void bcache_get_info(bcache_t* bc, vfs_cache_info_t* info);
+
 #define BLOCK_DIRTY 1
+#define BLOCK_DATA 2
 
 // acquire a block, reading from disk if necessary,
 // returning a handle and a pointer to the data
@@ -100,11 +150,38 @@ block_t* bcache_get(bcache_t* bc, uint32_t bno, void** bdata);
 block_t* bcache_get_zero(bcache_t* bc, uint32_t bno, void** block);
 
 // release a block back to the cache
-// flags *must* contain BLOCK_DIRTY if it was modified
+// flags *must* contain BLOCK_DIRTY if it was modified, and
+// should contain BLOCK_DATA as well if it holds file contents
+// dirty blocks are written back later, not by this call
 void bcache_put(bcache_t* bc, block_t* blk, uint32_t flags);
 
+// write all dirty blocks back to disk, or, with a journal, file
+// data back to disk and everything else to the journal
+// waits for any transactions in progress to end first
+mx_status_t bcache_sync(bcache_t* bc);
+
+// Use blocks [start, start + count) of the device as a journal,
+// first replaying whatever it holds.  From then on, dirty blocks
+// without BLOCK_DATA reach the disk only by way of the journal,
+// and blocks dirtied between the start of a transaction and the
+// end of the last one in progress are committed together.
+mx_status_t bcache_journal_open(bcache_t* bc, uint32_t start, uint32_t count);
+
+// prepare an empty journal, for mkfs
+mx_status_t bcache_journal_init(bcache_t* bc, uint32_t start, uint32_t count);
+
+// transactions nest, and may be in progress on several threads
+// an outermost one may wait for a commit before it begins, so no
+// lock another thread may hold while beginning one may be taken
+// while a transaction is in progress
+void bcache_txn_begin(bcache_t* bc);
+void bcache_txn_end(bcache_t* bc);
+
 mx_status_t bcache_read(bcache_t* bc, uint32_t bno, void* data, uint32_t off, uint32_t len);
 
+// start reading count blocks from bno on that are not cached yet
+void bcache_readahead(bcache_t* bc, uint32_t bno, uint32_t count);
+
 uint32_t bcache_max_block(bcache_t* bc);
 
 // drop all non-busy, non-dirty blocks
@@ -8,9 +8,11 @@
 #include <errno.h>
 #include <fcntl.h>
 #include <string.h>
+#include <threads.h>
 #include <unistd.h>
 #include <sys/stat.h>
 
+#include <magenta/device/vfs.h>
 #include <mxio/vfs.h>
 #include "vfs.h"
 
@@ -43,6 +45,14 @@ typedef struct {
 
 static file_t fdtab[MAXFD];
 
+// guards which fdtab slots are in use, for tests running threads
+static mtx_t fdtab_lock;
+static once_flag fdtab_once = ONCE_FLAG_INIT;
+
+static void fdtab_init(void) {
+    mtx_init(&fdtab_lock, mtx_plain);
+}
+
 #define FD_MAGIC 0x45AB0000
 
 static file_t* file_get(int fd) {
@@ -93,28 +103,37 @@ static inline int check_path(const char* path) {
 
 int FL(open)(const char* path, int flags, mode_t mode);
 int FN(open)(const char* path, int flags, mode_t mode) {
-    //TODO: fdtab lock
     PATH_WRAP(path, open, path, flags, mode);
+    vnode_t* vn;
+    mx_status_t status = vfs_open(fake_root, &vn, path + PREFIX_SIZE, flags, mode);
+    if (status < 0) {
+        STATUS(status);
+    }
+    call_once(&fdtab_once, fdtab_init);
+    mtx_lock(&fdtab_lock);
     int fd;
     for (fd = 0; fd < MAXFD; fd++) {
         if (fdtab[fd].vn == NULL) {
-            mx_status_t status = vfs_open(fake_root, &fdtab[fd].vn, path + PREFIX_SIZE, flags, mode);
-            if (status < 0) {
-                STATUS(status);
-            }
+            fdtab[fd].vn = vn;
+            mtx_unlock(&fdtab_lock);
             return fd | FD_MAGIC;
         }
     }
+    mtx_unlock(&fdtab_lock);
+    vfs_close(vn);
     FAIL(EMFILE);
 }
 
 int FL(close)(int fd);
 int FN(close)(int fd) {
-    //TODO: fdtab lock
     file_t* f;
     FILE_WRAP(f, fd, close, fd);
-    vfs_close(f->vn);
+    vnode_t* vn = f->vn;
+    call_once(&fdtab_once, fdtab_init);
+    mtx_lock(&fdtab_lock);
     memset(f, 0, sizeof(file_t));
+    mtx_unlock(&fdtab_lock);
+    vfs_close(vn);
     return 0;
 }
 
@@ -193,6 +212,39 @@ int FN(fstat)(int fd, struct stat* s) {
     STATUS(do_stat(f->vn, s));
 }
 
+int FL(fsync)(int fd);
+int FN(fsync)(int fd) {
+    file_t* f;
+    FILE_WRAP(f, fd, fsync, fd);
+    if (f->vn->ops->sync == NULL) {
+        return 0;
+    }
+    STATUS(f->vn->ops->sync(f->vn));
+}
+
+int FL(ftruncate)(int fd, off_t len);
+int FN(ftruncate)(int fd, off_t len) {
+    file_t* f;
+    FILE_WRAP(f, fd, ftruncate, fd, len);
+    if (len < 0) FAIL(EINVAL);
+    STATUS(f->vn->ops->truncate(f->vn, len));
+}
+
+int FL(posix_fallocate)(int fd, off_t offset, off_t len);
+int FN(posix_fallocate)(int fd, off_t offset, off_t len) {
+    file_t* f;
+    FILE_WRAP(f, fd, posix_fallocate, fd, offset, len);
+    if ((offset < 0) || (len <= 0)) {
+        return EINVAL;
+    }
+    vfs_allocate_t req = {
+        .offset = offset,
+        .length = len,
+    };
+    ssize_t r = f->vn->ops->ioctl(f->vn, IOCTL_VFS_ALLOCATE, &req, sizeof(req), NULL, 0);
+    return (r < 0) ? status_to_errno(r) : 0;
+}
+
 int FL(unlink)(const char* path);
 int FN(unlink)(const char* path) {
     PATH_WRAP(path, unlink, path);
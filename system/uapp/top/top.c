@@ -0,0 +1,227 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+// Shows which processes (or, with -t, threads) are using the CPUs.
+// Every interval it samples the kernel's per-task accounting and prints
+// what changed since the previous sample, busiest first.
+
+#include <inttypes.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <magenta/syscalls.h>
+
+#define MAX_TASKS 1024
+#define MAX_THREADS_PER_PROCESS 256
+
+typedef struct task {
+    mx_koid_t koid;
+    mx_koid_t pkoid;
+    char name[MX_MAX_NAME_LEN];
+    uint32_t threads;
+    uint64_t committed_bytes;       // processes only
+    mx_task_stats_t stats;
+} task_t;
+
+typedef struct sample {
+    mx_time_t time;
+    size_t count;
+    task_t tasks[MAX_TASKS];
+} sample_t;
+
+typedef struct row {
+    const task_t* task;
+    mx_task_stats_t delta;
+} row_t;
+
+static sample_t samples[2];
+static row_t rows[MAX_TASKS];
+
+static task_t* add_task(sample_t* s, mx_koid_t koid, mx_koid_t pkoid) {
+    if (s->count == MAX_TASKS)
+        return NULL;
+    task_t* t = &s->tasks[s->count++];
+    memset(t, 0, sizeof(*t));
+    t->koid = koid;
+    t->pkoid = pkoid;
+    return t;
+}
+
+static void sample_threads(sample_t* s, mx_handle_t process, mx_koid_t pkoid) {
+    mx_koid_t koids[MAX_THREADS_PER_PROCESS];
+    mx_ssize_t n = mx_debug_task_get_children(process, koids, MAX_THREADS_PER_PROCESS);
+    if (n > MAX_THREADS_PER_PROCESS)
+        n = MAX_THREADS_PER_PROCESS;
+    for (mx_ssize_t i = 0; i < n; i++) {
+        mx_handle_t thread = mx_debug_task_get_child(process, koids[i]);
+        if (thread < 0)
+            continue; // it exited
+        mx_thread_stats_info_t info;
+        if (mx_object_get_info(thread, MX_INFO_THREAD_STATS, &info, sizeof(info)) ==
+            (mx_ssize_t)sizeof(info)) {
+            task_t* t = add_task(s, koids[i], pkoid);
+            if (t != NULL) {
+                memcpy(t->name, info.name, sizeof(t->name));
+                t->threads = 1;
+                t->stats = info.stats;
+            }
+        }
+        mx_handle_close(thread);
+    }
+}
+
+static int take_sample(sample_t* s, bool threads) {
+    static mx_koid_t koids[MAX_TASKS];
+    mx_ssize_t n = mx_debug_task_get_children(MX_HANDLE_INVALID, koids, MAX_TASKS);
+    if (n < 0) {
+        fprintf(stderr, "top: cannot list processes: %zd\n", n);
+        return -1;
+    }
+    if (n > MAX_TASKS)
+        n = MAX_TASKS;
+
+    s->count = 0;
+    s->time = mx_current_time();
+    for (mx_ssize_t i = 0; i < n; i++) {
+        mx_handle_t process = mx_debug_task_get_child(MX_HANDLE_INVALID, koids[i]);
+        if (process < 0)
+            continue; // it exited
+        if (threads) {
+            sample_threads(s, process, koids[i]);
+        } else {
+            mx_process_stats_info_t info;
+            if (mx_object_get_info(process, MX_INFO_PROCESS_STATS, &info, sizeof(info)) ==
+                (mx_ssize_t)sizeof(info)) {
+                task_t* t = add_task(s, koids[i], 0);
+                if (t != NULL) {
+                    memcpy(t->name, info.name, sizeof(t->name));
+                    t->threads = info.thread_count;
+                    t->stats = info.stats;
+
+                    mx_process_memory_info_t mem;
+                    if (mx_object_get_info(process, MX_INFO_PROCESS_MEMORY, &mem, sizeof(mem)) ==
+                        (mx_ssize_t)sizeof(mem))
+                        t->committed_bytes = mem.committed_bytes;
+                }
+            }
+        }
+        mx_handle_close(process);
+    }
+    return 0;
+}
+
+static const task_t* find_task(const sample_t* s, mx_koid_t koid) {
+    for (size_t i = 0; i < s->count; i++) {
+        if (s->tasks[i].koid == koid)
+            return &s->tasks[i];
+    }
+    return NULL;
+}
+
+static int compare_rows(const void* a, const void* b) {
+    const row_t* ra = a;
+    const row_t* rb = b;
+    if (ra->delta.runtime != rb->delta.runtime)
+        return ra->delta.runtime < rb->delta.runtime ? 1 : -1;
+    return ra->task->koid < rb->task->koid ? -1 : 1;
+}
+
+static void print_delta(const sample_t* prev, const sample_t* cur, bool threads,
+                        size_t max_rows) {
+    mx_time_t elapsed = cur->time - prev->time;
+    if (elapsed == 0)
+        elapsed = 1;
+
+    uint64_t busy = 0;
+    for (size_t i = 0; i < cur->count; i++) {
+        const task_t* t = &cur->tasks[i];
+        const task_t* p = find_task(prev, t->koid);
+        row_t* r = &rows[i];
+        r->task = t;
+        r->delta = t->stats;
+        if (p != NULL) {
+            r->delta.runtime -= p->stats.runtime;
+            r->delta.wait_time -= p->stats.wait_time;
+            r->delta.voluntary_switches -= p->stats.voluntary_switches;
+            r->delta.involuntary_switches -= p->stats.involuntary_switches;
+            r->delta.page_faults -= p->stats.page_faults;
+            r->delta.syscalls -= p->stats.syscalls;
+        }
+        busy += r->delta.runtime;
+    }
+    qsort(rows, cur->count, sizeof(row_t), compare_rows);
+
+    unsigned cpus = mx_num_cpus();
+    printf("\n%zu %s, %u cpus, %" PRIu64 "%% busy over %" PRIu64 " ms\n",
+           cur->count, threads ? "threads" : "processes", cpus,
+           busy * 100 / (elapsed * cpus), elapsed / 1000000);
+    printf("%8s %8s %5s %9s %9s %7s %7s %7s %8s %9s %s\n",
+           threads ? "TID" : "PID", threads ? "PID" : "THREADS", "CPU%",
+           "RUN(ms)", "WAIT(ms)", "VCSW", "ICSW", "FAULTS", "SYSCALLS",
+           threads ? "" : "MEM(KB)", "NAME");
+    if (max_rows > cur->count)
+        max_rows = cur->count;
+    for (size_t i = 0; i < max_rows; i++) {
+        const row_t* r = &rows[i];
+        char mem[16] = "";
+        if (!threads)
+            snprintf(mem, sizeof(mem), "%" PRIu64, r->task->committed_bytes / 1024);
+        printf("%8" PRIu64 " %8" PRIu64 " %5" PRIu64 " %9" PRIu64 " %9" PRIu64
+               " %7" PRIu64 " %7" PRIu64 " %7" PRIu64 " %8" PRIu64 " %9s %s\n",
+               r->task->koid, threads ? r->task->pkoid : (uint64_t)r->task->threads,
+               r->delta.runtime * 100 / elapsed,
+               r->delta.runtime / 1000000, r->delta.wait_time / 1000000,
+               r->delta.voluntary_switches, r->delta.involuntary_switches,
+               r->delta.page_faults, r->delta.syscalls, mem, r->task->name);
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr,
+            "usage: top [-t] [-d <seconds>] [-n <iterations>] [-r <rows>]\n"
+            "  -t  show threads instead of processes\n"
+            "  -d  seconds between samples (default 2)\n"
+            "  -n  number of samples to show (default: forever)\n"
+            "  -r  rows to show per sample (default 20)\n");
+}
+
+int main(int argc, char** argv) {
+    bool threads = false;
+    int delay = 2;
+    int iterations = -1;
+    size_t max_rows = 20;
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "-t")) {
+            threads = true;
+        } else if (i + 1 < argc && !strcmp(argv[i], "-d")) {
+            delay = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-n")) {
+            iterations = atoi(argv[++i]);
+        } else if (i + 1 < argc && !strcmp(argv[i], "-r")) {
+            max_rows = atoi(argv[++i]);
+        } else {
+            usage();
+            return 1;
+        }
+    }
+    if (delay <= 0 || iterations == 0) {
+        usage();
+        return 1;
+    }
+
+    int cur = 0;
+    if (take_sample(&samples[cur], threads) < 0)
+        return 1;
+    while (iterations < 0 || iterations-- > 0) {
+        mx_nanosleep(MX_SEC(delay));
+        if (take_sample(&samples[cur ^ 1], threads) < 0)
+            return 1;
+        print_delta(&samples[cur], &samples[cur ^ 1], threads, max_rows);
+        cur ^= 1;
+    }
+    return 0;
+}
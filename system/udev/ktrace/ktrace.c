@@ -0,0 +1,81 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <ddk/device.h>
+#include <ddk/driver.h>
+
+#include <magenta/device/ktrace.h>
+#include <magenta/ktrace.h>
+#include <magenta/syscalls.h>
+#include <magenta/types.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+// ktrace is the /dev/ktrace device, which gives access to the kernel
+// trace buffer without handing out the root resource.
+
+static ssize_t ktrace_read(mx_device_t* dev, void* buf, size_t count, mx_off_t off) {
+    if (off > UINT32_MAX)
+        return 0;
+    if (count > UINT32_MAX)
+        count = UINT32_MAX;
+    uint32_t actual;
+    mx_status_t status = mx_ktrace_read(get_root_resource(), buf, off, count, &actual);
+    if (status < 0)
+        return status;
+    return actual;
+}
+
+static mx_off_t ktrace_get_size(mx_device_t* dev) {
+    uint32_t size;
+    if (mx_ktrace_read(get_root_resource(), NULL, 0, 0, &size) < 0)
+        return 0;
+    return size;
+}
+
+static ssize_t ktrace_ioctl(mx_device_t* dev, uint32_t op,
+                            const void* in_buf, size_t in_len,
+                            void* out_buf, size_t out_len) {
+    switch (op) {
+    case IOCTL_KTRACE_START: {
+        if (in_len != sizeof(uint32_t))
+            return ERR_INVALID_ARGS;
+        uint32_t grpmask;
+        memcpy(&grpmask, in_buf, sizeof(grpmask));
+        return mx_ktrace_control(get_root_resource(), KTRACE_ACTION_START, grpmask);
+    }
+    case IOCTL_KTRACE_STOP:
+        return mx_ktrace_control(get_root_resource(), KTRACE_ACTION_STOP, 0);
+    case IOCTL_KTRACE_REWIND:
+        return mx_ktrace_control(get_root_resource(), KTRACE_ACTION_REWIND, 0);
+    default:
+        return ERR_NOT_SUPPORTED;
+    }
+}
+
+static mx_protocol_device_t ktrace_device_proto = {
+    .read = ktrace_read,
+    .get_size = ktrace_get_size,
+    .ioctl = ktrace_ioctl,
+};
+
+// implement driver object:
+
+mx_status_t ktrace_init(mx_driver_t* driver) {
+    mx_device_t* dev;
+    if (device_create(&dev, driver, "ktrace", &ktrace_device_proto) == NO_ERROR) {
+        if (device_add(dev, NULL) < 0) {
+            free(dev);
+        }
+    }
+    return NO_ERROR;
+}
+
+mx_driver_t _driver_ktrace BUILTIN_DRIVER = {
+    .name = "ktrace",
+    .ops = {
+        .init = ktrace_init,
+    },
+};
@@ -0,0 +1,45 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <magenta/syscalls.h>
+#include <magenta/vdso-data.h>
+
+// Defined in vdso-data.c.  As far as the compiler knows it is constant
+// zero, so it must only be read through a volatile pointer.
+extern const union vdso_data_page vdso_data_page
+    __attribute__((visibility("hidden")));
+
+// The syscall stub for mx_current_time gets this name instead;
+// see syscalls-x86-64.S.
+mx_time_t SYSCALL_mx_current_time(void) __attribute__((visibility("hidden")));
+
+static inline uint64_t read_counter(void) {
+    uint32_t lo, hi;
+    __asm__ volatile("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
+
+mx_time_t _mx_current_time(void) {
+    const volatile struct vdso_time_data* time =
+        (const volatile struct vdso_time_data*)&vdso_data_page.data.time;
+    uint32_t seq;
+    uint64_t now = 0;
+    do {
+        seq = time->seq;
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (seq & 1)
+            continue;
+        if (!(time->flags & VDSO_TIME_USERMODE_COUNTER))
+            return SYSCALL_mx_current_time();
+        uint64_t ticks = read_counter() - time->base_ticks;
+        now = time->base_ns +
+            (uint64_t)(((unsigned __int128)ticks * time->ticks_to_ns_mult) >>
+                       time->ticks_to_ns_shift);
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    } while ((seq & 1) || seq != time->seq);
+    return now;
+}
+
+__typeof(_mx_current_time) mx_current_time
+    __attribute__((weak, alias("_mx_current_time")));
@@ -11,13 +11,17 @@ MODULE_TYPE := userlib
 # This library should not depend on libc.
 MODULE_COMPILEFLAGS := -ffreestanding
 
+MODULE_SRCS += $(LOCAL_DIR)/vdso-data.c
+
 ifeq ($(ARCH),arm)
 MODULE_SRCS += $(LOCAL_DIR)/syscalls-arm32.S
 else ifeq ($(ARCH),arm64)
 MODULE_SRCS += $(LOCAL_DIR)/syscalls-arm64.S
 else ifeq ($(ARCH),x86)
     ifeq ($(SUBARCH),x86-64)
-    MODULE_SRCS += $(LOCAL_DIR)/syscalls-x86-64.S
+    MODULE_SRCS += \
+        $(LOCAL_DIR)/current-time.c \
+        $(LOCAL_DIR)/syscalls-x86-64.S
     else
     MODULE_SRCS += $(LOCAL_DIR)/syscalls-x86.S
     endif
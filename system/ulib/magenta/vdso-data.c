@@ -0,0 +1,13 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <magenta/vdso-data.h>
+
+// The kernel fills this in; see <magenta/vdso-data.h>.  It is defined on
+// every architecture, even where nothing in the vDSO reads it yet, so that
+// DATA_START is always a page of its own.  It must be hidden so that
+// references to it are PC-relative, since this DSO cannot have any
+// dynamic relocations.
+__attribute__((section(".vdso_data"), aligned(4096), visibility("hidden")))
+const union vdso_data_page vdso_data_page;
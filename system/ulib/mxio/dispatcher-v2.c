@@ -2,6 +2,7 @@
 // Use of this source code is governed by a BSD-style license that can be
 // found in the LICENSE file.
 
+#include <stdbool.h>
 #include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
@@ -20,9 +21,16 @@ typedef struct {
     uint32_t flags;
     void* cb;
     void* cookie;
+
+    // with workers, the messages not yet handled and the
+    // handler's place on the work list
+    uint32_t readable;
+    list_node_t work_node;
 } handler_t;
 
 #define FLAG_DISCONNECTED 1
+#define FLAG_PEER_CLOSED 2 // the peer closed, not yet handled
+#define FLAG_BUSY 4        // on the work list, or being handled by a worker
 
 struct mxio_dispatcher {
     mtx_t lock;
@@ -30,6 +38,11 @@ struct mxio_dispatcher {
     mx_handle_t ioport;
     mxio_dispatcher_cb_t cb;
     thrd_t t;
+
+    // handlers with work for the worker threads, if there are any
+    list_node_t work;
+    cnd_t work_cnd;
+    uint32_t workers;
 };
 
 static void mxio_dispatcher_destroy(mxio_dispatcher_t* md) {
@@ -58,6 +71,96 @@ static void disconnect_handler(mxio_dispatcher_t* md, handler_t* handler) {
     handler->flags |= FLAG_DISCONNECTED;
 }
 
+// run the callback for signals on a handler, returning true
+// if the handler is to be disconnected
+static bool dispatch(mxio_dispatcher_t* md, handler_t* handler, mx_signals_t signals) {
+    mx_status_t r;
+    if (signals & MX_SIGNAL_READABLE) {
+        if ((r = md->cb(handler->h, handler->cb, handler->cookie)) != 0) {
+            if (r == ERR_DISPATCHER_NO_WORK) {
+                printf("mxio: dispatcher found no work to do!\n");
+            } else {
+                if (r < 0) {
+                    // generate a synthetic close.
+                    md->cb(0, handler->cb, handler->cookie);
+                }
+                return true;
+            }
+        }
+    }
+    if (signals & MX_SIGNAL_PEER_CLOSED) {
+        // synthesize a close
+        md->cb(0, handler->cb, handler->cookie);
+        return true;
+    }
+    return false;
+}
+
+// With workers, only the dispatcher thread waits on the port, so only
+// it ever holds a handler it has not been handed under the lock, and a
+// handler is freed once the synthetic "destroy" event reaches it.
+static void queue_work(mxio_dispatcher_t* md, handler_t* handler, mx_signals_t signals) {
+    mtx_lock(&md->lock);
+    if (handler->flags & FLAG_DISCONNECTED) {
+        if (signals & MX_SIGNAL_SIGNALED) {
+            list_delete(&handler->node);
+            mtx_unlock(&md->lock);
+            free(handler);
+            return;
+        }
+    } else {
+        if (signals & MX_SIGNAL_READABLE) {
+            handler->readable++;
+        }
+        if (signals & MX_SIGNAL_PEER_CLOSED) {
+            handler->flags |= FLAG_PEER_CLOSED;
+        }
+        if (!(handler->flags & FLAG_BUSY)) {
+            handler->flags |= FLAG_BUSY;
+            list_add_tail(&md->work, &handler->work_node);
+            cnd_signal(&md->work_cnd);
+        }
+    }
+    mtx_unlock(&md->lock);
+}
+
+// A handler stays busy until a worker has done all of its work, so
+// the callbacks for any one pipe run one at a time and in order.
+static int mxio_dispatcher_worker(void* _md) {
+    mxio_dispatcher_t* md = _md;
+
+    mtx_lock(&md->lock);
+    for (;;) {
+        handler_t* handler;
+        while ((handler = list_remove_head_type(&md->work, handler_t, work_node)) == NULL) {
+            cnd_wait(&md->work_cnd, &md->lock);
+        }
+        for (;;) {
+            mx_signals_t signals;
+            if (handler->readable > 0) {
+                handler->readable--;
+                signals = MX_SIGNAL_READABLE;
+            } else if (handler->flags & FLAG_PEER_CLOSED) {
+                signals = MX_SIGNAL_PEER_CLOSED;
+            } else {
+                handler->flags &= ~FLAG_BUSY;
+                break;
+            }
+            mtx_unlock(&md->lock);
+            bool done = dispatch(md, handler, signals);
+            mtx_lock(&md->lock);
+            if (done) {
+                // the dispatcher thread frees the handler once this
+                // reaches it, so it is not to be touched after this
+                handler->flags = FLAG_DISCONNECTED;
+                disconnect_handler(md, handler);
+                break;
+            }
+        }
+    }
+    return NO_ERROR;
+}
+
 static int mxio_dispatcher_thread(void* _md) {
     mxio_dispatcher_t* md = _md;
     mx_status_t r;
@@ -70,6 +173,10 @@ again:
             break;
         }
         handler_t* handler = (void*)(uintptr_t)packet.hdr.key;
+        if (md->workers > 0) {
+            queue_work(md, handler, packet.signals);
+            continue;
+        }
         if (handler->flags & FLAG_DISCONNECTED) {
             // handler is awaiting gc
             // ignore events for it until we get the synthetic "destroy" event
@@ -78,23 +185,7 @@ again:
             }
             continue;
         }
-        if (packet.signals & MX_SIGNAL_READABLE) {
-            if ((r = md->cb(handler->h, handler->cb, handler->cookie)) != 0) {
-                if (r == ERR_DISPATCHER_NO_WORK) {
-                    printf("mxio: dispatcher found no work to do!\n");
-                } else {
-                    if (r < 0) {
-                        // generate a synthetic close.
-                        md->cb(0, handler->cb, handler->cookie);
-                    }
-                    disconnect_handler(md, handler);
-                    continue;
-                }
-            }
-        }
-        if (packet.signals & MX_SIGNAL_PEER_CLOSED) {
-            // synthesize a close
-            md->cb(0, handler->cb, handler->cookie);
+        if (dispatch(md, handler, packet.signals)) {
             disconnect_handler(md, handler);
         }
     }
@@ -111,7 +202,9 @@ mx_status_t mxio_dispatcher_create(mxio_dispatcher_t** out, mxio_dispatcher_cb_t
     }
     xprintf("mxio_dispatcher_create: %p\n", md);
     list_initialize(&md->list);
+    list_initialize(&md->work);
     mtx_init(&md->lock, mtx_plain);
+    cnd_init(&md->work_cnd);
     if ((md->ioport = mx_port_create(0u)) < 0) {
         free(md);
         return md->ioport;
@@ -139,6 +232,18 @@ mx_status_t mxio_dispatcher_start(mxio_dispatcher_t* md) {
     return r;
 }
 
+mx_status_t mxio_dispatcher_add_workers(mxio_dispatcher_t* md, uint32_t count) {
+    for (uint32_t n = 0; n < count; n++) {
+        thrd_t t;
+        if (thrd_create_with_name(&t, mxio_dispatcher_worker, md, "mxio-worker") != thrd_success) {
+            return (n > 0) ? NO_ERROR : ERR_NO_RESOURCES;
+        }
+        thrd_detach(t);
+        md->workers++;
+    }
+    return NO_ERROR;
+}
+
 void mxio_dispatcher_run(mxio_dispatcher_t* md) {
     mxio_dispatcher_thread(md);
 }
@@ -154,6 +259,7 @@ mx_status_t mxio_dispatcher_add(mxio_dispatcher_t* md, mx_handle_t h, void* cb,
     handler->flags = 0;
     handler->cb = cb;
     handler->cookie = cookie;
+    handler->readable = 0;
 
     mtx_lock(&md->lock);
     list_add_tail(&md->list, &handler->node);
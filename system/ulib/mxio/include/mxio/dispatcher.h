@@ -29,6 +29,12 @@ mx_status_t mxio_dispatcher_create(mxio_dispatcher_t** out, mxio_dispatcher_cb_t
 // create a thread for a dispatcher and start it running
 mx_status_t mxio_dispatcher_start(mxio_dispatcher_t* md);
 
+// create count threads to run the handler, rather than the dispatcher
+// thread, so that one blocked in it holds up only its own pipe; those
+// for any one pipe still run one at a time and in order.  Must be
+// called before the dispatcher is started or run.
+mx_status_t mxio_dispatcher_add_workers(mxio_dispatcher_t* md, uint32_t count);
+
 // run the dispatcher loop on the current thread, never to return
 void mxio_dispatcher_run(mxio_dispatcher_t* md);
 
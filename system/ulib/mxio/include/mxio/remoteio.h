@@ -31,16 +31,27 @@ __BEGIN_CDECLS
 #define MXRIO_UNLINK       0x0000000b
 #define MXRIO_READ_AT      0x0000000c
 #define MXRIO_WRITE_AT     0x0000000d
-#define MXRIO_NUM_OPS      14
+#define MXRIO_SYNC         0x0000000e
+#define MXRIO_TRUNCATE     0x0000000f
+#define MXRIO_MMAP         0x00000010
+#define MXRIO_NUM_OPS      17
 
 #define MXRIO_OP(n)        ((n) & 0xFFFF)
 #define MXRIO_REPLY_PIPE   0x01000000
 
+// MMAP flags
+#define MXRIO_MMAP_SEEK    0x00000001 // start at the seek offset and move it past the range
+#define MXRIO_MMAP_RANGE   0x00000002 // a VMO of just the range, which the server does not keep
+
+// the most a RANGE request is given at once
+#define MXRIO_MMAP_RANGE_MAX (1024 * 1024)
+
 #define MXRIO_OPNAMES { \
     "status", "close", "clone", "open", \
     "misc", "read", "write", "seek", \
     "stat", "readdir", "ioctl", "unlink", \
-    "read_at", "write_at" }
+    "read_at", "write_at", "sync", "truncate", \
+    "mmap" }
 
 typedef struct mxrio_msg mxrio_msg_t;
 
@@ -101,6 +112,13 @@ struct mxrio_msg {
 // READDIR   maxreply   0       -                0           <vndirent_t[]>  -
 // IOCTL     out_len    opcode  <in_bytes>       0           <out_bytes>     -
 // UNLINK    0          0       <name>           0           -               -
+// MMAP      flags      offset  <uint64:len>     offset      <uint64:len>    vmohandle
+//
+// MMAP replies with a read-only VMO holding the file, with at least
+// the requested range filled in, and the length of that range which
+// lies within the file.  With MXRIO_MMAP_RANGE the VMO instead holds
+// just that much of the range, from VMO offset 0, and is freed once
+// the caller closes it.
 //
 // proposed:
 //
@@ -109,7 +127,6 @@ struct mxrio_msg {
 // RENAME*   name1len   0       <name1><name2>   0           -               -
 // SYMLINK   namelen    0       <name><path>     0           -               -
 // READLINK  maxreply   0       -                0           <path>          -
-// MMAP      flags      offset  <uint64:len>     offset      -               vmohandle
 // FLUSH     0          0       -                0           -               -
 // SYNC      0          0       -                0           -               -
 // LINK**    0          0       <name>           0           -               -
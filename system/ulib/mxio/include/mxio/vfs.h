@@ -7,6 +7,7 @@
 #include <magenta/types.h>
 #include <magenta/listnode.h>
 #include <magenta/compiler.h>
+#include <mxio/remoteio.h>
 
 // ssize_t?
 #include <stdio.h>
@@ -93,6 +94,22 @@ struct vnode_ops {
 
     mx_status_t (*unlink)(vnode_t* vn, const char* name, size_t len);
     // Removes name from directory vn
+
+    mx_status_t (*sync)(vnode_t* vn);
+    // Writes any data and metadata of vn held in memory to storage.
+    // May be NULL if the filesystem has nothing to write back.
+
+    mx_status_t (*truncate)(vnode_t* vn, size_t len);
+    // Sets the size of file vn, freeing any storage past the new end.
+    // May be NULL if the filesystem cannot change the size of files.
+
+    mx_status_t (*get_vmo)(vnode_t* vn, size_t off, size_t len, uint32_t flags,
+                           mx_handle_t* out, size_t* size);
+    // Returns a read-only VMO of file vn, with at least off..off+len
+    // filled in, and the size of the file.  If flags has
+    // MXRIO_MMAP_RANGE, the VMO holds just off..off+len, from VMO
+    // offset 0, and the filesystem keeps no reference to it.
+    // May be NULL if the filesystem cannot share files as VMOs.
 };
 
 struct vnattr {
@@ -140,4 +157,10 @@ struct vdirent {
 void vn_acquire(vnode_t* vn);
 void vn_release(vnode_t* vn);
 
+// Handles the MXRIO ops that map straight onto vnode ops (SYNC,
+// TRUNCATE and MMAP) for a connection whose seek offset is *io_off.
+// len is the request's datalen. Returns ERR_NOT_SUPPORTED for any
+// other op.
+mx_status_t vfs_handle_rio(vnode_t* vn, mxrio_msg_t* msg, uint32_t len, size_t* io_off);
+
 __END_CDECLS
@@ -25,6 +25,96 @@ ssize_t mxio_default_write(mxio_t* io, const void* _data, size_t len) {
     return len;
 }
 
+ssize_t mxio_default_read_at(mxio_t* io, void* _data, size_t len, off_t offset) {
+    return ERR_NOT_SUPPORTED;
+}
+
+ssize_t mxio_default_write_at(mxio_t* io, const void* _data, size_t len, off_t offset) {
+    return ERR_NOT_SUPPORTED;
+}
+
+// the default vectored io hooks issue one read or write per
+// iovec, stopping early at a short transfer or an error
+ssize_t mxio_default_readv(mxio_t* io, const struct iovec* iov, int num) {
+    ssize_t count = 0;
+    ssize_t r;
+    while (num > 0) {
+        if (iov->iov_len != 0) {
+            r = io->ops->read(io, iov->iov_base, iov->iov_len);
+            if (r < 0) {
+                return count ? count : r;
+            }
+            if ((size_t)r < iov->iov_len) {
+                return count + r;
+            }
+            count += r;
+        }
+        iov++;
+        num--;
+    }
+    return count;
+}
+
+ssize_t mxio_default_writev(mxio_t* io, const struct iovec* iov, int num) {
+    ssize_t count = 0;
+    ssize_t r;
+    while (num > 0) {
+        if (iov->iov_len != 0) {
+            r = io->ops->write(io, iov->iov_base, iov->iov_len);
+            if (r < 0) {
+                return count ? count : r;
+            }
+            if ((size_t)r < iov->iov_len) {
+                return count + r;
+            }
+            count += r;
+        }
+        iov++;
+        num--;
+    }
+    return count;
+}
+
+ssize_t mxio_default_readv_at(mxio_t* io, const struct iovec* iov, int num, off_t offset) {
+    ssize_t count = 0;
+    ssize_t r;
+    while (num > 0) {
+        if (iov->iov_len != 0) {
+            r = io->ops->read_at(io, iov->iov_base, iov->iov_len, offset + count);
+            if (r < 0) {
+                return count ? count : r;
+            }
+            if ((size_t)r < iov->iov_len) {
+                return count + r;
+            }
+            count += r;
+        }
+        iov++;
+        num--;
+    }
+    return count;
+}
+
+ssize_t mxio_default_writev_at(mxio_t* io, const struct iovec* iov, int num, off_t offset) {
+    ssize_t count = 0;
+    ssize_t r;
+    while (num > 0) {
+        if (iov->iov_len != 0) {
+            r = io->ops->write_at(io, iov->iov_base, iov->iov_len, offset + count);
+            if (r < 0) {
+                return count ? count : r;
+            }
+            if ((size_t)r < iov->iov_len) {
+                return count + r;
+            }
+            count += r;
+        }
+        iov++;
+        num--;
+    }
+    return count;
+}
+
 off_t mxio_default_seek(mxio_t* io, off_t offset, int whence) {
     return ERR_NOT_SUPPORTED;
 }
@@ -54,9 +144,19 @@ ssize_t mxio_default_ioctl(mxio_t* io, uint32_t op, const void* in_buf,
     return ERR_NOT_SUPPORTED;
 }
 
+mx_status_t mxio_default_get_vmo(mxio_t* io, uint64_t offset, uint64_t len, mx_handle_t* out) {
+    return ERR_NOT_SUPPORTED;
+}
+
 static mxio_ops_t mx_null_ops = {
     .read = mxio_default_read,
+    .read_at = mxio_default_read_at,
     .write = mxio_default_write,
+    .write_at = mxio_default_write_at,
+    .readv = mxio_default_readv,
+    .writev = mxio_default_writev,
+    .readv_at = mxio_default_readv_at,
+    .writev_at = mxio_default_writev_at,
     .seek = mxio_default_seek,
     .misc = mxio_default_misc,
     .close = mxio_default_close,
@@ -64,6 +164,7 @@ static mxio_ops_t mx_null_ops = {
     .clone = mxio_default_clone,
     .wait = mxio_default_wait,
     .ioctl = mxio_default_ioctl,
+    .get_vmo = mxio_default_get_vmo,
 };
 
 mxio_t* mxio_null_create(void) {
@@ -18,10 +18,10 @@ typedef struct mx_pipe {
     mx_handle_t h;
 } mx_pipe_t;
 
-static ssize_t _blocking_read(mx_handle_t h, void* data, size_t len) {
+static ssize_t _blocking_read(mx_handle_t h, const mx_iovec_t* iov, uint32_t count) {
     for (;;) {
         ssize_t r;
-        if ((r = mx_socket_read(h, 0, len, data)) >= 0) {
+        if ((r = mx_socket_readv(h, 0, iov, count)) >= 0) {
             return r;
         }
         if (r == ERR_SHOULD_WAIT) {
@@ -44,10 +44,10 @@ static ssize_t _blocking_read(mx_handle_t h, void* data, size_t len) {
     }
 }
 
-static ssize_t _blocking_write(mx_handle_t h, const void* data, size_t len) {
+static ssize_t _blocking_write(mx_handle_t h, const mx_iovec_t* iov, uint32_t count) {
     for (;;) {
         ssize_t r;
-        if ((r = mx_socket_write(h, 0, len, data)) >= 0) {
+        if ((r = mx_socket_writev(h, 0, iov, count)) >= 0) {
             return r;
         }
         if (r == ERR_SHOULD_WAIT) {
@@ -70,15 +70,54 @@ static ssize_t _blocking_write(mx_handle_t h, const void* data, size_t len) {
     }
 }
 
+// copies a posix iovec array into the kernel's layout, returning
+// the number of non-empty entries, or -1 if there are too many
+static int _to_mx_iovec(const struct iovec* iov, int num, mx_iovec_t* out) {
+    int count = 0;
+    while (num-- > 0) {
+        if (iov->iov_len != 0) {
+            if (count == MX_IOVEC_MAX) {
+                return -1;
+            }
+            out[count].base = iov->iov_base;
+            out[count].len = iov->iov_len;
+            count++;
+        }
+        iov++;
+    }
+    return count;
+}
 
 static ssize_t mx_pipe_write(mxio_t* io, const void* data, size_t len) {
     mx_pipe_t* p = (mx_pipe_t*)io;
-    return _blocking_write(p->h, data, len);
+    mx_iovec_t iov = {(void*)data, len};
+    return _blocking_write(p->h, &iov, 1);
 }
 
 static ssize_t mx_pipe_read(mxio_t* io, void* data, size_t len) {
     mx_pipe_t* p = (mx_pipe_t*)io;
-    return _blocking_read(p->h, data, len);
+    mx_iovec_t iov = {data, len};
+    return _blocking_read(p->h, &iov, 1);
+}
+
+static ssize_t mx_pipe_writev(mxio_t* io, const struct iovec* iov, int num) {
+    mx_pipe_t* p = (mx_pipe_t*)io;
+    mx_iovec_t mxiov[MX_IOVEC_MAX];
+    int count = _to_mx_iovec(iov, num, mxiov);
+    if (count < 0) {
+        return mxio_default_writev(io, iov, num);
+    }
+    return _blocking_write(p->h, mxiov, count);
+}
+
+static ssize_t mx_pipe_readv(mxio_t* io, const struct iovec* iov, int num) {
+    mx_pipe_t* p = (mx_pipe_t*)io;
+    mx_iovec_t mxiov[MX_IOVEC_MAX];
+    int count = _to_mx_iovec(iov, num, mxiov);
+    if (count < 0) {
+        return mxio_default_readv(io, iov, num);
+    }
+    return _blocking_read(p->h, mxiov, count);
 }
 
 static mx_status_t mx_pipe_close(mxio_t* io) {
@@ -135,7 +174,13 @@ static mx_status_t mx_pipe_clone(mxio_t* io, mx_handle_t* handles, uint32_t* typ
 
 static mxio_ops_t mx_pipe_ops = {
     .read = mx_pipe_read,
+    .read_at = mxio_default_read_at,
     .write = mx_pipe_write,
+    .write_at = mxio_default_write_at,
+    .readv = mx_pipe_readv,
+    .writev = mx_pipe_writev,
+    .readv_at = mxio_default_readv_at,
+    .writev_at = mxio_default_writev_at,
     .seek = mxio_default_seek,
     .misc = mxio_default_misc,
     .close = mx_pipe_close,
@@ -143,6 +188,7 @@ static mxio_ops_t mx_pipe_ops = {
     .clone = mx_pipe_clone,
     .wait = mx_pipe_wait,
     .ioctl = mxio_default_ioctl,
+    .get_vmo = mxio_default_get_vmo,
 };
 
 mxio_t* mxio_pipe_create(mx_handle_t h) {
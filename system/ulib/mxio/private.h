@@ -7,6 +7,7 @@
 #include <magenta/types.h>
 #include <stdint.h>
 #include <sys/types.h>
+#include <sys/uio.h>
 
 #include <stdatomic.h>
 
@@ -28,6 +29,10 @@ typedef struct mxio_ops {
     ssize_t (*read_at)(mxio_t* io, void* data, size_t len, off_t offset);
     ssize_t (*write)(mxio_t* io, const void* data, size_t len);
     ssize_t (*write_at)(mxio_t* io, const void* data, size_t len, off_t offset);
+    ssize_t (*readv)(mxio_t* io, const struct iovec* iov, int num);
+    ssize_t (*writev)(mxio_t* io, const struct iovec* iov, int num);
+    ssize_t (*readv_at)(mxio_t* io, const struct iovec* iov, int num, off_t offset);
+    ssize_t (*writev_at)(mxio_t* io, const struct iovec* iov, int num, off_t offset);
     off_t (*seek)(mxio_t* io, off_t offset, int whence);
     mx_status_t (*misc)(mxio_t* io, uint32_t op, uint32_t maxreply, void* data, size_t len);
     mx_status_t (*close)(mxio_t* io);
@@ -35,6 +40,7 @@ typedef struct mxio_ops {
     mx_status_t (*clone)(mxio_t* io, mx_handle_t* out_handles, uint32_t* out_types);
     mx_status_t (*wait)(mxio_t* io, uint32_t events, uint32_t* pending, mx_time_t timeout);
     ssize_t (*ioctl)(mxio_t* io, uint32_t op, const void* in_buf, size_t in_len, void* out_buf, size_t out_len);
+    mx_status_t (*get_vmo)(mxio_t* io, uint64_t offset, uint64_t len, mx_handle_t* out);
 } mxio_ops_t;
 
 // mxio_t flags
@@ -90,12 +96,27 @@ static inline ssize_t mxio_write(mxio_t* io, const void* data, size_t len) {
 static inline ssize_t mxio_write_at(mxio_t* io, const void* data, size_t len, off_t offset) {
     return io->ops->write_at(io, data, len, offset);
 }
+static inline ssize_t mxio_readv(mxio_t* io, const struct iovec* iov, int num) {
+    return io->ops->readv(io, iov, num);
+}
+static inline ssize_t mxio_writev(mxio_t* io, const struct iovec* iov, int num) {
+    return io->ops->writev(io, iov, num);
+}
+static inline ssize_t mxio_readv_at(mxio_t* io, const struct iovec* iov, int num, off_t offset) {
+    return io->ops->readv_at(io, iov, num, offset);
+}
+static inline ssize_t mxio_writev_at(mxio_t* io, const struct iovec* iov, int num, off_t offset) {
+    return io->ops->writev_at(io, iov, num, offset);
+}
 static inline off_t mxio_seek(mxio_t* io, off_t offset, int whence) {
     return io->ops->seek(io, offset, whence);
 }
 static inline mx_status_t mxio_misc(mxio_t* io, uint32_t op, uint32_t maxreply, void* data, size_t len) {
     return io->ops->misc(io, op, maxreply, data, len);
 }
+static inline mx_status_t mxio_get_vmo(mxio_t* io, uint64_t offset, uint64_t len, mx_handle_t* out) {
+    return io->ops->get_vmo(io, offset, len, out);
+}
 static inline mx_status_t mxio_open(mxio_t* io, const char* path, int32_t flags, uint32_t mode, mxio_t** out) {
     return io->ops->open(io, path, flags, mode, out);
 }
@@ -127,6 +148,10 @@ ssize_t mxio_default_read(mxio_t* io, void* _data, size_t len);
 ssize_t mxio_default_read_at(mxio_t* io, void* _data, size_t len, off_t offset);
 ssize_t mxio_default_write(mxio_t* io, const void* _data, size_t len);
 ssize_t mxio_default_write_at(mxio_t* io, const void* _data, size_t len, off_t offset);
+ssize_t mxio_default_readv(mxio_t* io, const struct iovec* iov, int num);
+ssize_t mxio_default_writev(mxio_t* io, const struct iovec* iov, int num);
+ssize_t mxio_default_readv_at(mxio_t* io, const struct iovec* iov, int num, off_t offset);
+ssize_t mxio_default_writev_at(mxio_t* io, const struct iovec* iov, int num, off_t offset);
 off_t mxio_default_seek(mxio_t* io, off_t offset, int whence);
 mx_status_t mxio_default_misc(mxio_t* io, uint32_t op, uint32_t arg, void* data, size_t len);
 mx_status_t mxio_default_close(mxio_t* io);
@@ -134,6 +159,7 @@ mx_status_t mxio_default_open(mxio_t* io, const char* path, int32_t flags, uint3
 mx_handle_t mxio_default_clone(mxio_t* io, mx_handle_t* handles, uint32_t* types);
 mx_status_t mxio_default_wait(mxio_t* io, uint32_t events, uint32_t* pending, mx_time_t timeout);
 ssize_t mxio_default_ioctl(mxio_t* io, uint32_t op, const void* in_buf, size_t in_len, void* out_buf, size_t out_len);
+mx_status_t mxio_default_get_vmo(mxio_t* io, uint64_t offset, uint64_t len, mx_handle_t* out);
 
 void __mxio_startup_handles_init(uint32_t num, mx_handle_t handles[],
                                  uint32_t handle_info[])
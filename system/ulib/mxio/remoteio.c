@@ -21,6 +21,13 @@
 
 #define MXDEBUG 0
 
+// mxrio_t flags
+#define MXRIO_FLAG_NO_VMO 1 // the server has no VMOs to hand out
+
+// reads at least this long are copied out of a VMO of the file,
+// which costs one request, rather than a chunk per request
+#define MXRIO_VMO_READ_MIN (4 * MXIO_CHUNK_SIZE)
+
 typedef struct mxrio mxrio_t;
 struct mxrio {
     // base mxio io object
@@ -176,12 +183,20 @@ mx_status_t mxrio_txn_handoff(mx_handle_t srv, mx_handle_t rh, mxrio_msg_t* msg)
 }
 
 #if WITH_REPLY_PIPE
-#define mxrio_txn_locked mxrio_txn
+#define mxrio_txnv_locked mxrio_txnv
 #endif
 
 // on success, msg->hcount indicates number of valid handles in msg->handle
 // on error there are never any handles
-static mx_status_t mxrio_txn_locked(mxrio_t* rio, mxrio_msg_t* msg) {
+//
+// if wcount is nonzero the request payload is gathered from wdata
+// (at most MXRIO_WRITE_SEGS entries, totalling msg->datalen) instead
+// of msg->data.  if rcount is nonzero the reply payload is scattered
+// into rdata (at most MXRIO_READ_SEGS entries), with anything beyond
+// their total landing in msg->data past that point.
+static mx_status_t mxrio_txnv_locked(mxrio_t* rio, mxrio_msg_t* msg,
+                                     const mx_iovec_t* wdata, uint32_t wcount,
+                                     const mx_iovec_t* rdata, uint32_t rcount) {
     msg->magic = MXRIO_MAGIC;
     if (!is_message_valid(msg)) {
         return ERR_INVALID_ARGS;
@@ -204,7 +219,16 @@ static mx_status_t mxrio_txn_locked(mxrio_t* rio, mxrio_msg_t* msg) {
     mx_handle_t rh = rio->h;
 #endif
 
-    if ((r = mx_msgpipe_write(rio->h, msg, dsize, msg->handle, msg->hcount, 0)) < 0) {
+    mx_iovec_t iov[MX_IOVEC_MAX];
+    if (wcount) {
+        iov[0].base = msg;
+        iov[0].len = MXRIO_HDR_SZ;
+        memcpy(iov + 1, wdata, wcount * sizeof(mx_iovec_t));
+        r = mx_msgpipe_writev(rio->h, iov, wcount + 1, msg->handle, msg->hcount, 0);
+    } else {
+        r = mx_msgpipe_write(rio->h, msg, dsize, msg->handle, msg->hcount, 0);
+    }
+    if (r < 0) {
         goto fail_discard_handles;
     }
 
@@ -221,7 +245,21 @@ static mx_status_t mxrio_txn_locked(mxrio_t* rio, mxrio_msg_t* msg) {
 
     dsize = MXRIO_HDR_SZ + MXIO_CHUNK_SIZE;
     msg->hcount = MXIO_MAX_HANDLES + 1;
-    if ((r = mx_msgpipe_read(rh, msg, &dsize, msg->handle, &msg->hcount, 0)) < 0) {
+    if (rcount) {
+        size_t rlen = 0;
+        iov[0].base = msg;
+        iov[0].len = MXRIO_HDR_SZ;
+        for (uint32_t n = 0; n < rcount; n++) {
+            iov[n + 1] = rdata[n];
+            rlen += rdata[n].len;
+        }
+        iov[rcount + 1].base = msg->data + rlen;
+        iov[rcount + 1].len = MXIO_CHUNK_SIZE - rlen;
+        r = mx_msgpipe_readv(rh, iov, rcount + 2, &dsize, msg->handle, &msg->hcount, 0);
+    } else {
+        r = mx_msgpipe_read(rh, msg, &dsize, msg->handle, &msg->hcount, 0);
+    }
+    if (r < 0) {
         goto done;
     }
 #if WITH_REPLY_PIPE
@@ -252,17 +290,23 @@ done:
 }
 
 #if WITH_REPLY_PIPE
-#undef mxrio_txn_locked
+#undef mxrio_txnv_locked
 #else
-static mx_status_t mxrio_txn(mxrio_t* rio, mxrio_msg_t* msg) {
+static mx_status_t mxrio_txnv(mxrio_t* rio, mxrio_msg_t* msg,
+                              const mx_iovec_t* wdata, uint32_t wcount,
+                              const mx_iovec_t* rdata, uint32_t rcount) {
     mx_status_t r;
     mtx_lock(&rio->lock);
-    r = mxrio_txn_locked(rio, msg);
+    r = mxrio_txnv_locked(rio, msg, wdata, wcount, rdata, rcount);
     mtx_unlock(&rio->lock);
     return r;
 }
 #endif
 
+static mx_status_t mxrio_txn(mxrio_t* rio, mxrio_msg_t* msg) {
+    return mxrio_txnv(rio, msg, NULL, 0, NULL, 0);
+}
+
 static ssize_t mxrio_ioctl(mxio_t* io, uint32_t op, const void* in_buf,
                            size_t in_len, void* out_buf, size_t out_len) {
     mxrio_t* rio = (mxrio_t*)io;
@@ -309,40 +353,88 @@ static ssize_t mxrio_ioctl(mxio_t* io, uint32_t op, const void* in_buf,
     return r;
 }
 
-static ssize_t write_common(uint32_t op, mxio_t* io, const void* _data, size_t len, off_t offset) {
+// request payloads share the message with the header; replies
+// also need a trailing entry for any excess payload
+#define MXRIO_WRITE_SEGS (MX_IOVEC_MAX - 1)
+#define MXRIO_READ_SEGS (MX_IOVEC_MAX - 2)
+
+// a position within a caller's iovec array
+typedef struct {
+    const struct iovec* iov;
+    int num;
+    size_t off;
+} iov_cursor_t;
+
+// describe up to max bytes at the cursor with at most count
+// kernel iovecs, returning how many were used and the total
+static uint32_t iov_cursor_slice(const iov_cursor_t* cur, mx_iovec_t* out,
+                                 uint32_t count, size_t max, size_t* _len) {
+    const struct iovec* iov = cur->iov;
+    size_t off = cur->off;
+    size_t len = 0;
+    uint32_t n = 0;
+    for (int i = 0; (i < cur->num) && (n < count) && (len < max); i++, iov++) {
+        if (iov->iov_len > off) {
+            size_t xfer = iov->iov_len - off;
+            if (xfer > (max - len)) {
+                xfer = max - len;
+            }
+            out[n].base = (uint8_t*)iov->iov_base + off;
+            out[n].len = xfer;
+            len += xfer;
+            n++;
+        }
+        off = 0;
+    }
+    *_len = len;
+    return n;
+}
+
+static void iov_cursor_advance(iov_cursor_t* cur, size_t len) {
+    while ((cur->num > 0) && ((cur->off + len) >= cur->iov->iov_len)) {
+        len -= cur->iov->iov_len - cur->off;
+        cur->off = 0;
+        cur->iov++;
+        cur->num--;
+    }
+    cur->off += len;
+}
+
+static ssize_t write_common(uint32_t op, mxio_t* io, const struct iovec* iov, int num,
+                            off_t offset) {
     mxrio_t* rio = (mxrio_t*)io;
-    const uint8_t* data = _data;
+    iov_cursor_t cur = { iov, num, 0 };
     ssize_t count = 0;
     mx_status_t r = 0;
     mxrio_msg_t msg;
-    ssize_t xfer;
-
-    while (len > 0) {
-        xfer = (len > MXIO_CHUNK_SIZE) ? MXIO_CHUNK_SIZE : len;
+    mx_iovec_t data[MXRIO_WRITE_SEGS];
+    uint32_t n;
+    size_t xfer;
 
+    // the payload goes straight from the caller's buffers into the
+    // message, so the only copy is the one the kernel makes
+    while ((n = iov_cursor_slice(&cur, data, MXRIO_WRITE_SEGS, MXIO_CHUNK_SIZE, &xfer)) > 0) {
         memset(&msg, 0, MXRIO_HDR_SZ);
         msg.op = op;
         msg.datalen = xfer;
         if (op == MXRIO_WRITE_AT)
             msg.arg2.off = offset;
-        memcpy(msg.data, data, xfer);
 
-        if ((r = mxrio_txn(rio, &msg)) < 0) {
+        if ((r = mxrio_txnv(rio, &msg, data, n, NULL, 0)) < 0) {
             break;
         }
         discard_handles(msg.handle, msg.hcount);
 
-        if (r > xfer) {
+        if ((size_t)r > xfer) {
             r = ERR_IO;
             break;
         }
         count += r;
-        data += r;
-        len -= r;
+        iov_cursor_advance(&cur, r);
         if (op == MXRIO_WRITE_AT)
             offset += r;
         // stop at short read
-        if (r < xfer) {
+        if ((size_t)r < xfer) {
             break;
         }
     }
@@ -350,48 +442,147 @@ static ssize_t write_common(uint32_t op, mxio_t* io, const void* _data, size_t l
 }
 
 static ssize_t mxrio_write(mxio_t* io, const void* _data, size_t len) {
-    return write_common(MXRIO_WRITE, io, _data, len, 0);
+    struct iovec iov = { (void*)_data, len };
+    return write_common(MXRIO_WRITE, io, &iov, 1, 0);
 }
 
 static ssize_t mxrio_write_at(mxio_t* io, const void* _data, size_t len, off_t offset) {
-    return write_common(MXRIO_WRITE_AT, io, _data, len, offset);
+    struct iovec iov = { (void*)_data, len };
+    return write_common(MXRIO_WRITE_AT, io, &iov, 1, offset);
+}
+
+static ssize_t mxrio_writev(mxio_t* io, const struct iovec* iov, int num) {
+    return write_common(MXRIO_WRITE, io, iov, num, 0);
+}
+
+static ssize_t mxrio_writev_at(mxio_t* io, const struct iovec* iov, int num, off_t offset) {
+    return write_common(MXRIO_WRITE_AT, io, iov, num, offset);
 }
 
-static ssize_t read_common(uint32_t op, mxio_t* io, void* _data, size_t len, off_t offset) {
+// ask for a VMO of the file with *len bytes at *offset filled in,
+// returning the offset used and how much of the range the file holds
+static mx_status_t mxrio_mmap(mxrio_t* rio, uint32_t flags, uint64_t* offset, uint64_t* len,
+                              mx_handle_t* out) {
+    mxrio_msg_t msg;
+    mx_status_t r;
+
+    memset(&msg, 0, MXRIO_HDR_SZ);
+    msg.op = MXRIO_MMAP;
+    msg.arg = flags;
+    msg.arg2.off = *offset;
+    msg.datalen = sizeof(uint64_t);
+    memcpy(msg.data, len, sizeof(uint64_t));
+
+    if ((r = mxrio_txn(rio, &msg)) < 0) {
+        if (r == ERR_NOT_SUPPORTED) {
+            // readers on other threads test this without the lock
+            __atomic_fetch_or(&rio->flags, MXRIO_FLAG_NO_VMO, __ATOMIC_RELAXED);
+        }
+        return r;
+    }
+    if ((msg.hcount != 1) || (msg.datalen != sizeof(uint64_t))) {
+        discard_handles(msg.handle, msg.hcount);
+        return ERR_IO;
+    }
+    *offset = msg.arg2.off;
+    memcpy(len, msg.data, sizeof(uint64_t));
+    *out = msg.handle[0];
+    return NO_ERROR;
+}
+
+static mx_status_t mxrio_get_vmo(mxio_t* io, uint64_t offset, uint64_t len, mx_handle_t* out) {
+    return mxrio_mmap((mxrio_t*)io, 0, &offset, &len, out);
+}
+
+// copy a read out of VMOs holding a range of the file each, returning
+// ERR_NOT_SUPPORTED if the server cannot provide them
+static ssize_t read_vmo(mxrio_t* rio, uint32_t op, const struct iovec* iov, int num,
+                        size_t len, off_t offset) {
+    uint32_t flags = MXRIO_MMAP_RANGE | ((op == MXRIO_READ) ? MXRIO_MMAP_SEEK : 0);
+    iov_cursor_t cur = { iov, num, 0 };
+    ssize_t count = 0;
+    mx_iovec_t data[MX_IOVEC_MAX];
+    mx_status_t r = 0;
+
+    while ((size_t)count < len) {
+        uint64_t off = offset + count;
+        uint64_t avail = len - count;
+        mx_handle_t vmo;
+        if ((r = mxrio_mmap(rio, flags, &off, &avail, &vmo)) < 0) {
+            break;
+        }
+        uint64_t got = 0;
+        uint32_t n;
+        size_t xfer;
+        while ((n = iov_cursor_slice(&cur, data, MX_IOVEC_MAX, avail - got, &xfer)) > 0) {
+            if ((r = mx_vmo_readv(vmo, data, n, got)) < 0) {
+                break;
+            }
+            got += r;
+            iov_cursor_advance(&cur, r);
+            if ((size_t)r < xfer) {
+                break;
+            }
+        }
+        mx_handle_close(vmo);
+        count += got;
+        // stop at the end of the file, or at a short copy
+        if ((r < 0) || (got == 0) || (got < avail)) {
+            break;
+        }
+        r = 0;
+    }
+    return count ? count : r;
+}
+
+static ssize_t read_common(uint32_t op, mxio_t* io, const struct iovec* iov, int num,
+                           off_t offset) {
     mxrio_t* rio = (mxrio_t*)io;
-    uint8_t* data = _data;
+    iov_cursor_t cur = { iov, num, 0 };
     ssize_t count = 0;
     mx_status_t r = 0;
     mxrio_msg_t msg;
-    ssize_t xfer;
-
-    while (len > 0) {
-        xfer = (len > MXIO_CHUNK_SIZE) ? MXIO_CHUNK_SIZE : len;
+    mx_iovec_t data[MXRIO_READ_SEGS];
+    uint32_t n;
+    size_t xfer;
+
+    if (!(__atomic_load_n(&rio->flags, __ATOMIC_RELAXED) & MXRIO_FLAG_NO_VMO)) {
+        size_t len = 0;
+        for (int i = 0; i < num; i++) {
+            len += iov[i].iov_len;
+        }
+        if (len >= MXRIO_VMO_READ_MIN) {
+            if ((r = read_vmo(rio, op, iov, num, len, offset)) != ERR_NOT_SUPPORTED) {
+                return r;
+            }
+            r = 0;
+        }
+    }
 
+    // the reply payload is scattered straight into the caller's buffers
+    while ((n = iov_cursor_slice(&cur, data, MXRIO_READ_SEGS, MXIO_CHUNK_SIZE, &xfer)) > 0) {
         memset(&msg, 0, MXRIO_HDR_SZ);
         msg.op = op;
         msg.arg = xfer;
         if (op == MXRIO_READ_AT)
             msg.arg2.off = offset;
 
-        if ((r = mxrio_txn(rio, &msg)) < 0) {
+        if ((r = mxrio_txnv(rio, &msg, NULL, 0, data, n)) < 0) {
             break;
         }
         discard_handles(msg.handle, msg.hcount);
 
-        if ((r > (int)msg.datalen) || (r > xfer)) {
+        if ((r > (int)msg.datalen) || ((size_t)r > xfer)) {
             r = ERR_IO;
             break;
         }
-        memcpy(data, msg.data, r);
         count += r;
-        data += r;
-        len -= r;
+        iov_cursor_advance(&cur, r);
         if (op == MXRIO_READ_AT)
             offset += r;
 
         // stop at short read
-        if (r < xfer) {
+        if ((size_t)r < xfer) {
             break;
         }
     }
@@ -399,11 +590,21 @@ static ssize_t read_common(uint32_t op, mxio_t* io, void* _data, size_t len, off
 }
 
 static ssize_t mxrio_read(mxio_t* io, void* _data, size_t len) {
-    return read_common(MXRIO_READ, io, _data, len, 0);
+    struct iovec iov = { _data, len };
+    return read_common(MXRIO_READ, io, &iov, 1, 0);
 }
 
 static ssize_t mxrio_read_at(mxio_t* io, void* _data, size_t len, off_t offset) {
-    return read_common(MXRIO_READ_AT, io, _data, len, offset);
+    struct iovec iov = { _data, len };
+    return read_common(MXRIO_READ_AT, io, &iov, 1, offset);
+}
+
+static ssize_t mxrio_readv(mxio_t* io, const struct iovec* iov, int num) {
+    return read_common(MXRIO_READ, io, iov, num, 0);
+}
+
+static ssize_t mxrio_readv_at(mxio_t* io, const struct iovec* iov, int num, off_t offset) {
+    return read_common(MXRIO_READ_AT, io, iov, num, offset);
 }
 
 static off_t mxrio_seek(mxio_t* io, off_t offset, int whence) {
@@ -590,6 +791,10 @@ static mxio_ops_t mx_remote_ops = {
     .read_at = mxrio_read_at,
     .write = mxrio_write,
     .write_at = mxrio_write_at,
+    .readv = mxrio_readv,
+    .writev = mxrio_writev,
+    .readv_at = mxrio_readv_at,
+    .writev_at = mxrio_writev_at,
     .misc = mxrio_misc,
     .seek = mxrio_seek,
     .close = mxrio_close,
@@ -597,6 +802,7 @@ static mxio_ops_t mx_remote_ops = {
     .clone = mxrio_clone,
     .wait = mxrio_wait,
     .ioctl = mxrio_ioctl,
+    .get_vmo = mxrio_get_vmo,
 };
 
 mxio_t* mxio_remote_create(mx_handle_t h, mx_handle_t e) {
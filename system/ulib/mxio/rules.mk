@@ -17,6 +17,7 @@ MODULE_SRCS += \
     $(LOCAL_DIR)/remoteio.c \
     $(LOCAL_DIR)/socket.c \
     $(LOCAL_DIR)/unistd.c \
+    $(LOCAL_DIR)/vfs-rio.c \
     $(LOCAL_DIR)/startup-handles.c \
     $(LOCAL_DIR)/stubs.c \
     $(LOCAL_DIR)/loader-service.c \
@@ -16,7 +16,13 @@ typedef struct mx_socket {
 
 static mxio_ops_t mx_socket_ops = {
     .read = mxio_default_read,
+    .read_at = mxio_default_read_at,
     .write = mxio_default_write,
+    .write_at = mxio_default_write_at,
+    .readv = mxio_default_readv,
+    .writev = mxio_default_writev,
+    .readv_at = mxio_default_readv_at,
+    .writev_at = mxio_default_writev_at,
     .seek = mxio_default_seek,
     .misc = mxio_default_misc,
     .close = mxio_default_close,
@@ -24,6 +30,7 @@ static mxio_ops_t mx_socket_ops = {
     .clone = mxio_default_clone,
     .wait = mxio_default_wait,
     .ioctl = mxio_default_ioctl,
+    .get_vmo = mxio_default_get_vmo,
 };
 
 mxio_t* mxio_socket_create(mx_handle_t h) {
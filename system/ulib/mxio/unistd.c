@@ -10,11 +10,14 @@
 #include <stdarg.h>
 #include <stdlib.h>
 #include <string.h>
+#include <sys/mman.h>
 #include <sys/stat.h>
 #include <sys/uio.h>
 #include <threads.h>
 #include <unistd.h>
 
+#include <magenta/device/vfs.h>
+#include <magenta/process.h>
 #include <magenta/processargs.h>
 #include <magenta/syscalls.h>
 
@@ -369,6 +372,7 @@ static int status_to_errno(mx_status_t status) {
     case ERR_BAD_PATH: return ENAMETOOLONG;
     case ERR_IO: return EIO;
     case ERR_NOT_DIR: return ENOTDIR;
+    case ERR_NOT_FILE: return EISDIR;
     case ERR_NOT_SUPPORTED: return ENOTSUP;
     case ERR_TOO_BIG: return E2BIG;
     case ERR_CANCELLED: return ECANCELED;
@@ -411,43 +415,59 @@ static inline int ERRNO(int e) {
 // centric posix-y io operations.
 
 ssize_t readv(int fd, const struct iovec* iov, int num) {
-    ssize_t count = 0;
-    ssize_t r;
-    while (num > 0) {
-        if (iov->iov_len != 0) {
-            r = read(fd, iov->iov_base, iov->iov_len);
-            if (r < 0) {
-                return count ? count : r;
-            }
-            if ((size_t)r < iov->iov_len) {
-                return count + r;
-            }
-            count += r;
-        }
-        iov++;
-        num--;
+    if ((iov == NULL) || (num < 0)) {
+        return ERRNO(EINVAL);
     }
-    return count;
+
+    mxio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        return ERRNO(EBADF);
+    }
+    ssize_t r = STATUS(io->ops->readv(io, iov, num));
+    mxio_release(io);
+    return r;
 }
 
 ssize_t writev(int fd, const struct iovec* iov, int num) {
-    ssize_t count = 0;
-    ssize_t r;
-    while (num > 0) {
-        if (iov->iov_len != 0) {
-            r = write(fd, iov->iov_base, iov->iov_len);
-            if (r < 0) {
-                return count ? count : r;
-            }
-            if ((size_t)r < iov->iov_len) {
-                return count + r;
-            }
-            count += r;
-        }
-        iov++;
-        num--;
+    if ((iov == NULL) || (num < 0)) {
+        return ERRNO(EINVAL);
     }
-    return count;
+
+    mxio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        return ERRNO(EBADF);
+    }
+    ssize_t r = STATUS(io->ops->writev(io, iov, num));
+    mxio_release(io);
+    return r;
+}
+
+ssize_t preadv(int fd, const struct iovec* iov, int num, off_t offset) {
+    if ((iov == NULL) || (num < 0) || (offset < 0)) {
+        return ERRNO(EINVAL);
+    }
+
+    mxio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        return ERRNO(EBADF);
+    }
+    ssize_t r = STATUS(io->ops->readv_at(io, iov, num, offset));
+    mxio_release(io);
+    return r;
+}
+
+ssize_t pwritev(int fd, const struct iovec* iov, int num, off_t offset) {
+    if ((iov == NULL) || (num < 0) || (offset < 0)) {
+        return ERRNO(EINVAL);
+    }
+
+    mxio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        return ERRNO(EBADF);
+    }
+    ssize_t r = STATUS(io->ops->writev_at(io, iov, num, offset));
+    mxio_release(io);
+    return r;
 }
 
 int unlinkat(int fd, const char* path, int flag) {
@@ -482,6 +502,34 @@ ssize_t write(int fd, const void* buf, size_t count) {
     return r;
 }
 
+ssize_t pread(int fd, void* buf, size_t count, off_t offset) {
+    if ((buf == NULL) || (offset < 0)) {
+        return ERRNO(EINVAL);
+    }
+
+    mxio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        return ERRNO(EBADF);
+    }
+    ssize_t r = STATUS(io->ops->read_at(io, buf, count, offset));
+    mxio_release(io);
+    return r;
+}
+
+ssize_t pwrite(int fd, const void* buf, size_t count, off_t offset) {
+    if ((buf == NULL) || (offset < 0)) {
+        return ERRNO(EINVAL);
+    }
+
+    mxio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        return ERRNO(EBADF);
+    }
+    ssize_t r = STATUS(io->ops->write_at(io, buf, count, offset));
+    mxio_release(io);
+    return r;
+}
+
 int close(int fd) {
     mtx_lock(&mxio_lock);
     if ((fd < 0) || (fd >= MAX_MXIO_FD) || (mxio_fdtab[fd] == NULL)) {
@@ -617,6 +665,126 @@ int unlink(const char* path) {
     return STATUS(r);
 }
 
+int fsync(int fd) {
+    mxio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        return ERRNO(EBADF);
+    }
+    mx_status_t r = io->ops->misc(io, MXRIO_SYNC, 0, NULL, 0);
+    mxio_release(io);
+    // objects that do not cache anything have nothing to sync
+    if (r == ERR_NOT_SUPPORTED) {
+        r = NO_ERROR;
+    }
+    return STATUS(r);
+}
+
+int fdatasync(int fd) {
+    return fsync(fd);
+}
+
+int ftruncate(int fd, off_t len) {
+    if (len < 0) {
+        return ERRNO(EINVAL);
+    }
+    mxio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        return ERRNO(EBADF);
+    }
+    uint64_t size = len;
+    mx_status_t r = io->ops->misc(io, MXRIO_TRUNCATE, 0, &size, sizeof(size));
+    mxio_release(io);
+    return STATUS(r);
+}
+
+int truncate(const char* path, off_t len) {
+    int fd = open(path, O_WRONLY);
+    if (fd < 0) {
+        return -1;
+    }
+    int r = ftruncate(fd, len);
+    int err = errno;
+    close(fd);
+    errno = err;
+    return r;
+}
+
+// unlike most calls, this returns the error rather than setting errno
+int posix_fallocate(int fd, off_t offset, off_t len) {
+    if ((offset < 0) || (len <= 0)) {
+        return EINVAL;
+    }
+    mxio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        return EBADF;
+    }
+    vfs_allocate_t req = {
+        .offset = offset,
+        .length = len,
+    };
+    ssize_t r = io->ops->ioctl(io, IOCTL_VFS_ALLOCATE, &req, sizeof(req), NULL, 0);
+    mxio_release(io);
+    return (r < 0) ? status_to_errno(r) : 0;
+}
+
+// hook into libc mmap, which maps anonymous memory itself
+void* __libc_extensions_mmap(void* start, size_t len, int prot, int flags, int fd, off_t off) {
+    if (flags & MAP_ANON) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+    // files are handed out as read-only VMOs, so nothing written
+    // through a shared mapping could reach the file
+    if ((flags & MAP_SHARED) && (prot & PROT_WRITE)) {
+        errno = EACCES;
+        return MAP_FAILED;
+    }
+    mxio_t* io = fd_to_io(fd);
+    if (io == NULL) {
+        errno = EBADF;
+        return MAP_FAILED;
+    }
+    mx_handle_t vmo;
+    mx_status_t r = mxio_get_vmo(io, off, len, &vmo);
+    mxio_release(io);
+    if (r < 0) {
+        errno = (r == ERR_NOT_SUPPORTED) ? ENODEV : status_to_errno(r);
+        return MAP_FAILED;
+    }
+
+    uint32_t mx_flags = 0;
+    mx_flags |= (prot & PROT_READ) ? MX_VM_FLAG_PERM_READ : 0;
+    mx_flags |= (prot & PROT_EXEC) ? MX_VM_FLAG_PERM_EXECUTE : 0;
+    mx_flags |= (flags & MAP_FIXED) ? MX_VM_FLAG_FIXED : 0;
+    uintptr_t ptr = (uintptr_t)start;
+    if (prot & PROT_WRITE) {
+        // there are no copy-on-write VMOs, so a writable private
+        // mapping gets a copy of the file up front
+        mx_handle_t copy = mx_vmo_create((len + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+        if ((r = copy) >= 0) {
+            mx_flags |= MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE;
+            r = mx_process_map_vm(mx_process_self(), copy, 0, len, &ptr, mx_flags);
+            mx_handle_close(copy);
+        }
+        if (r >= 0) {
+            // past the end of the file the copy stays zero
+            mx_ssize_t n = mx_vmo_read(vmo, (void*)ptr, off, len);
+            if (n < 0) {
+                mx_process_unmap_vm(mx_process_self(), ptr, 0);
+                r = n;
+            }
+        }
+    } else {
+        r = mx_process_map_vm(mx_process_self(), vmo, off, len, &ptr, mx_flags);
+    }
+    mx_handle_close(vmo);
+    if (r < 0) {
+        errno = status_to_errno(r);
+        return MAP_FAILED;
+    }
+    return (void*)ptr;
+}
+
 int open(const char* path, int flags, ...) {
     mxio_t* io = NULL;
     mx_status_t r;
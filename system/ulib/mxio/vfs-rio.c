@@ -0,0 +1,67 @@
+// Copyright 2016 The Fuchsia Authors. All rights reserved.
+// Use of this source code is governed by a BSD-style license that can be
+// found in the LICENSE file.
+
+#include <string.h>
+
+#include <magenta/types.h>
+
+#include <mxio/remoteio.h>
+#include <mxio/vfs.h>
+
+struct vnode {
+    VNODE_BASE_FIELDS
+};
+
+mx_status_t vfs_handle_rio(vnode_t* vn, mxrio_msg_t* msg, uint32_t len, size_t* io_off) {
+    int32_t arg = msg->arg;
+
+    switch (MXRIO_OP(msg->op)) {
+    case MXRIO_SYNC:
+        return vn->ops->sync ? vn->ops->sync(vn) : NO_ERROR;
+    case MXRIO_TRUNCATE: {
+        uint64_t size;
+        if (len != sizeof(size)) {
+            return ERR_INVALID_ARGS;
+        }
+        memcpy(&size, msg->data, sizeof(size));
+        return vn->ops->truncate ? vn->ops->truncate(vn, size) : ERR_NOT_SUPPORTED;
+    }
+    case MXRIO_MMAP: {
+        uint64_t want;
+        if ((len != sizeof(want)) || (msg->arg2.off < 0)) {
+            return ERR_INVALID_ARGS;
+        }
+        if (vn->ops->get_vmo == NULL) {
+            return ERR_NOT_SUPPORTED;
+        }
+        memcpy(&want, msg->data, sizeof(want));
+        if ((arg & MXRIO_MMAP_RANGE) && (want > MXRIO_MMAP_RANGE_MAX)) {
+            want = MXRIO_MMAP_RANGE_MAX;
+        }
+        size_t off = (arg & MXRIO_MMAP_SEEK) ? *io_off : (size_t)msg->arg2.off;
+        size_t size;
+        mx_status_t r;
+        if ((r = vn->ops->get_vmo(vn, off, want, arg & MXRIO_MMAP_RANGE,
+                                  &msg->handle[0], &size)) < 0) {
+            return r;
+        }
+        // report how much of the range the file holds
+        if (off >= size) {
+            want = 0;
+        } else if (want > (size - off)) {
+            want = size - off;
+        }
+        if (arg & MXRIO_MMAP_SEEK) {
+            *io_off = off + want;
+        }
+        msg->arg2.off = off;
+        memcpy(msg->data, &want, sizeof(want));
+        msg->datalen = sizeof(want);
+        msg->hcount = 1;
+        return NO_ERROR;
+    }
+    default:
+        return ERR_NOT_SUPPORTED;
+    }
+}
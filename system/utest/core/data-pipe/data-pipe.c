@@ -339,6 +339,49 @@ static bool loop_begin_write_read(void) {
     END_TEST;
 }
 
+static bool begin_write_read_reuses_mapping(void) {
+    BEGIN_TEST;
+    mx_handle_t producer;
+    mx_handle_t consumer;
+    mx_status_t status;
+
+    // Large capacity; only the pages actually touched should get committed.
+    producer = mx_datapipe_create(0u, 1u, KB_(64 * 1024), &consumer);
+    ASSERT_GT(producer, 0, "could not create producer data pipe");
+    ASSERT_GT(consumer, 0, "could not create consumer data pipe");
+
+    uintptr_t write_base = 0;
+    uintptr_t read_base = 0;
+    for (int ix = 0; ix < 16; ++ix) {
+        uintptr_t buffer = 0;
+        mx_ssize_t avail = mx_datapipe_begin_write(producer, 0u, &buffer);
+        ASSERT_GT(avail, KB_(4), "begin_write failed");
+        if (ix == 0)
+            write_base = buffer;
+        ASSERT_EQ(buffer, write_base + ix * KB_(4), "producer mapping moved");
+
+        memset((void*)buffer, ix, KB_(4));
+        status = mx_datapipe_end_write(producer, KB_(4));
+        ASSERT_EQ(status, NO_ERROR, "failed to end write");
+
+        avail = mx_datapipe_begin_read(consumer, 0u, &buffer);
+        ASSERT_EQ(avail, KB_(4), "begin_read failed");
+        if (ix == 0)
+            read_base = buffer;
+        ASSERT_EQ(buffer, read_base + ix * KB_(4), "consumer mapping moved");
+        ASSERT_EQ(*(const char*)buffer, ix, "incorrect data from begin_read");
+
+        status = mx_datapipe_end_read(consumer, KB_(4));
+        ASSERT_EQ(status, NO_ERROR, "failed to end read");
+    }
+
+    status = mx_handle_close(consumer);
+    ASSERT_GE(status, NO_ERROR, "failed to close data pipe");
+    status = mx_handle_close(producer);
+    ASSERT_GE(status, NO_ERROR, "failed to close data pipe");
+    END_TEST;
+}
+
 static bool consumer_signals_when_producer_closed(void) {
     BEGIN_TEST;
 
@@ -661,6 +704,7 @@ RUN_TEST(write_read)
 RUN_TEST(begin_write_read)
 RUN_TEST(loop_write_read)
 RUN_TEST(loop_begin_write_read)
+RUN_TEST(begin_write_read_reuses_mapping)
 RUN_TEST(consumer_signals_when_producer_closed)
 RUN_TEST(nontrivial_element_size);
 RUN_TEST(element_size_errors);
@@ -315,12 +315,81 @@ static bool bind_pipes_test(void)
     END_TEST;
 }
 
+static bool async_wait_test(void)
+{
+    BEGIN_TEST;
+    mx_status_t status;
+
+    mx_handle_t once_port = mx_port_create(0u);
+    EXPECT_GT(once_port, 0, "could not create io port");
+    mx_handle_t repeat_port = mx_port_create(0u);
+    EXPECT_GT(repeat_port, 0, "could not create io port");
+
+    mx_handle_t event = mx_event_create(0u);
+    EXPECT_GT(event, 0, "could not create event");
+
+    status = mx_object_wait_async(event, once_port, 1u, MX_SIGNAL_SIGNALED, MX_WAIT_ASYNC_ONCE);
+    EXPECT_EQ(status, NO_ERROR, "failed to register one-shot wait");
+    status = mx_object_wait_async(event, repeat_port, 2u, MX_SIGNAL_SIGNALED,
+                                  MX_WAIT_ASYNC_REPEATING);
+    EXPECT_EQ(status, NO_ERROR, "failed to register repeating wait");
+    status = mx_object_wait_async(event, repeat_port, 3u, 0u, MX_WAIT_ASYNC_ONCE);
+    EXPECT_EQ(status, ERR_INVALID_ARGS, "empty signal set allowed");
+
+    mx_io_packet_t io_pkt;
+    for (int i = 0; i < 2; i++) {
+        status = mx_object_signal(event, 0u, MX_SIGNAL_SIGNALED);
+        EXPECT_EQ(status, NO_ERROR, "failed to signal event");
+
+        status = mx_port_wait(repeat_port, &io_pkt, sizeof(io_pkt));
+        EXPECT_EQ(status, NO_ERROR, "failed to wait on port");
+        EXPECT_EQ(io_pkt.hdr.key, 2u, "key mismatch");
+        EXPECT_EQ(io_pkt.hdr.type, MX_PORT_PKT_TYPE_IOSN, "type mismatch");
+        EXPECT_TRUE(io_pkt.signals & MX_SIGNAL_SIGNALED, "signal mismatch");
+
+        status = mx_object_signal(event, MX_SIGNAL_SIGNALED, 0u);
+        EXPECT_EQ(status, NO_ERROR, "failed to clear event");
+    }
+
+    // The one-shot wait delivered exactly one packet, so a user packet queued now is next.
+    status = mx_port_wait(once_port, &io_pkt, sizeof(io_pkt));
+    EXPECT_EQ(status, NO_ERROR, "failed to wait on port");
+    EXPECT_EQ(io_pkt.hdr.key, 1u, "key mismatch");
+
+    mx_user_packet_t us_pkt = {{10u, MX_PORT_PKT_TYPE_USER, 0u}, {0}};
+    status = mx_port_queue(once_port, &us_pkt, sizeof(us_pkt));
+    EXPECT_EQ(status, NO_ERROR, "failed to queue packet");
+    status = mx_port_wait(once_port, &us_pkt, sizeof(us_pkt));
+    EXPECT_EQ(status, NO_ERROR, "failed to wait on port");
+    EXPECT_EQ(us_pkt.hdr.key, 10u, "one-shot wait fired twice");
+
+    status = mx_object_wait_cancel(event, repeat_port, 2u);
+    EXPECT_EQ(status, NO_ERROR, "failed to cancel wait");
+    status = mx_object_wait_cancel(event, repeat_port, 2u);
+    EXPECT_EQ(status, ERR_NOT_FOUND, "wait cancelled twice");
+
+    // Closing the handle drops any remaining waits.
+    status = mx_object_wait_async(event, repeat_port, 4u, MX_SIGNAL_SIGNALED,
+                                  MX_WAIT_ASYNC_REPEATING);
+    EXPECT_EQ(status, NO_ERROR, "failed to register repeating wait");
+
+    status = mx_handle_close(event);
+    EXPECT_EQ(status, NO_ERROR, "failed to close event");
+    status = mx_handle_close(once_port);
+    EXPECT_EQ(status, NO_ERROR, "failed to close io port");
+    status = mx_handle_close(repeat_port);
+    EXPECT_EQ(status, NO_ERROR, "failed to close io port");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(io_port_tests)
 RUN_TEST(basic_test)
 RUN_TEST(queue_and_close_test)
 RUN_TEST(thread_pool_test)
 RUN_TEST(bind_basic_test)
 RUN_TEST(bind_pipes_test)
+RUN_TEST(async_wait_test)
 END_TEST_CASE(io_port_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -7,6 +7,7 @@
 #include <unittest/unittest.h>
 #include <stdbool.h>
 #include <stdio.h>
+#include <string.h>
 #include <test-utils/test-utils.h>
 #include <unistd.h>
 
@@ -275,12 +276,65 @@ bool message_pipe_duplicate_handles(void) {
     END_TEST;
 }
 
+bool message_pipe_vectored(void) {
+    BEGIN_TEST;
+
+    mx_handle_t pipe[2];
+    ASSERT_EQ(mx_msgpipe_create(pipe, 0), NO_ERROR, "");
+
+    char hdr[4] = "hdr:";
+    char payload[6] = "abcdef";
+    mx_iovec_t wiov[3] = {
+        { hdr, sizeof(hdr) },
+        { NULL, 0u },
+        { payload, sizeof(payload) },
+    };
+    ASSERT_EQ(mx_msgpipe_writev(pipe[0], wiov, 3u, NULL, 0u, 0u), NO_ERROR, "");
+    ASSERT_EQ(mx_msgpipe_writev(pipe[0], wiov, 3u, NULL, 0u, 0u), NO_ERROR, "");
+
+    // The whole message arrives in a single contiguous read.
+    char buf[16];
+    uint32_t num_bytes = sizeof(buf);
+    ASSERT_EQ(mx_msgpipe_read(pipe[1], buf, &num_bytes, NULL, NULL, 0u), NO_ERROR, "");
+    ASSERT_EQ(num_bytes, 10u, "");
+    EXPECT_EQ(memcmp(buf, "hdr:abcdef", 10), 0, "gathered message mismatch");
+
+    // Too little room fails and leaves the message queued.
+    char rhdr[4];
+    char rbody[8];
+    mx_iovec_t riov[2] = {
+        { rhdr, sizeof(rhdr) },
+        { rbody, 4u },
+    };
+    num_bytes = 0u;
+    EXPECT_EQ(mx_msgpipe_readv(pipe[1], riov, 2u, &num_bytes, NULL, NULL, 0u),
+              ERR_NOT_ENOUGH_BUFFER, "");
+    EXPECT_EQ(num_bytes, 10u, "");
+
+    riov[1].len = sizeof(rbody);
+    ASSERT_EQ(mx_msgpipe_readv(pipe[1], riov, 2u, &num_bytes, NULL, NULL, 0u), NO_ERROR, "");
+    EXPECT_EQ(num_bytes, 10u, "");
+    EXPECT_EQ(memcmp(rhdr, "hdr:", 4), 0, "scattered header mismatch");
+    EXPECT_EQ(memcmp(rbody, "abcdef", 6), 0, "scattered payload mismatch");
+
+    mx_iovec_t too_many[MX_IOVEC_MAX + 1];
+    memset(too_many, 0, sizeof(too_many));
+    EXPECT_EQ(mx_msgpipe_writev(pipe[0], too_many, MX_IOVEC_MAX + 1, NULL, 0u, 0u),
+              ERR_INVALID_ARGS, "");
+
+    EXPECT_EQ(mx_handle_close(pipe[0]), NO_ERROR, "");
+    EXPECT_EQ(mx_handle_close(pipe[1]), NO_ERROR, "");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(message_pipe_tests)
 RUN_TEST(message_pipe_test)
 RUN_TEST(message_pipe_read_error_test)
 RUN_TEST(message_pipe_close_test)
 RUN_TEST(message_pipe_non_transferable)
 RUN_TEST(message_pipe_duplicate_handles)
+RUN_TEST(message_pipe_vectored)
 END_TEST_CASE(message_pipe_tests)
 
 #ifndef BUILD_COMBINED_TESTS
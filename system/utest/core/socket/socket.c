@@ -18,6 +18,7 @@
 #include <stdbool.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <unistd.h>
 
 static mx_signals_t get_satisfied_signals(mx_handle_t handle) {
@@ -163,11 +164,122 @@ static bool socket_oob(void) {
     END_TEST;
 }
 
+static bool socket_buffer_size(void) {
+    BEGIN_TEST;
+
+    mx_status_t status;
+    mx_ssize_t ssize;
+
+    mx_handle_t h[2];
+    status = mx_socket_create(h, MX_SOCKET_SIZE_LOG2(MX_SOCKET_MIN_SIZE_LOG2 - 1));
+    ASSERT_EQ(status, ERR_INVALID_ARGS, "");
+    status = mx_socket_create(h, MX_SOCKET_SIZE_LOG2(MX_SOCKET_MAX_SIZE_LOG2 + 1));
+    ASSERT_EQ(status, ERR_INVALID_ARGS, "");
+
+    status = mx_socket_create(h, MX_SOCKET_SIZE_LOG2(12));
+    ASSERT_EQ(status, NO_ERROR, "");
+
+    static char buf[8192];
+    memset(buf, 0x5a, sizeof(buf));
+
+    // One byte of the ring always stays empty.
+    ssize = mx_socket_write(h[0], 0u, sizeof(buf), buf);
+    ASSERT_EQ(ssize, 4095, "");
+    ssize = mx_socket_write(h[0], 0u, 1u, buf);
+    ASSERT_EQ(ssize, ERR_SHOULD_WAIT, "");
+    ASSERT_EQ(get_satisfied_signals(h[0]), 0u, "");
+
+    ssize = mx_socket_read(h[1], 0u, sizeof(buf), buf);
+    ASSERT_EQ(ssize, 4095, "");
+    ASSERT_EQ(get_satisfied_signals(h[0]), MX_SIGNAL_WRITABLE, "");
+
+    mx_handle_close(h[0]);
+    mx_handle_close(h[1]);
+    END_TEST;
+}
+
+static bool socket_vectored(void) {
+    BEGIN_TEST;
+
+    mx_status_t status;
+    mx_ssize_t ssize;
+
+    mx_handle_t h[2];
+    status = mx_socket_create(h, 0);
+    ASSERT_EQ(status, NO_ERROR, "");
+
+    char hdr[4] = "abc";
+    char body[6] = "12345";
+    mx_iovec_t wiov[] = {
+        { hdr, 3 },
+        { NULL, 0 },
+        { body, 5 },
+    };
+    ssize = mx_socket_writev(h[0], 0u, wiov, 3u);
+    ASSERT_EQ(ssize, 8, "");
+
+    char a[2], b[16];
+    mx_iovec_t riov[] = {
+        { a, sizeof(a) },
+        { b, sizeof(b) },
+    };
+    ssize = mx_socket_readv(h[1], 0u, riov, 2u);
+    ASSERT_EQ(ssize, 8, "");
+    ASSERT_EQ(memcmp(a, "ab", 2), 0, "");
+    ASSERT_EQ(memcmp(b, "c12345", 6), 0, "");
+
+    ssize = mx_socket_writev(h[0], 0u, wiov, MX_IOVEC_MAX + 1);
+    ASSERT_EQ(ssize, ERR_INVALID_ARGS, "");
+
+    mx_handle_close(h[0]);
+    mx_handle_close(h[1]);
+    END_TEST;
+}
+
+static bool socket_move_pages(void) {
+    BEGIN_TEST;
+
+    const mx_size_t kLen = 4 * 4096;
+
+    mx_handle_t vmo = mx_vmo_create(kLen * 2);
+    ASSERT_GT(vmo, 0, "");
+    uintptr_t ptr;
+    mx_status_t status = mx_process_map_vm(0, vmo, 0, kLen * 2, &ptr,
+                                           MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE);
+    ASSERT_EQ(status, NO_ERROR, "");
+    char* src = (char*)ptr;
+    char* dst = src + kLen;
+
+    for (mx_size_t i = 0; i < kLen; ++i)
+        src[i] = (char)(i / 4096 + 1);
+    memset(dst, 0xff, kLen);
+
+    mx_handle_t h[2];
+    status = mx_socket_create(h, 0);
+    ASSERT_EQ(status, NO_ERROR, "");
+
+    mx_ssize_t ssize = mx_socket_write(h[0], MX_SOCKET_MOVE_PAGES, kLen, src);
+    ASSERT_EQ(ssize, (mx_ssize_t)kLen, "");
+
+    ssize = mx_socket_read(h[1], 0u, kLen, dst);
+    ASSERT_EQ(ssize, (mx_ssize_t)kLen, "");
+    for (mx_size_t i = 0; i < kLen; i += 4096)
+        ASSERT_EQ(dst[i], (char)(i / 4096 + 1), "");
+
+    mx_handle_close(h[0]);
+    mx_handle_close(h[1]);
+    mx_process_unmap_vm(0, ptr, 0);
+    mx_handle_close(vmo);
+    END_TEST;
+}
 
 BEGIN_TEST_CASE(socket_tests)
 RUN_TEST(socket_basic)
 RUN_TEST(socket_signals)
 RUN_TEST(socket_oob)
+RUN_TEST(socket_buffer_size)
+RUN_TEST(socket_vectored)
+RUN_TEST(socket_move_pages)
 END_TEST_CASE(socket_tests)
 
 #ifndef BUILD_COMBINED_TESTS
@@ -148,11 +148,79 @@ bool vmo_resize_test(void) {
     END_TEST;
 }
 
+bool vmo_op_range_test(void) {
+    BEGIN_TEST;
+
+    mx_status_t status;
+    mx_ssize_t sstatus;
+    mx_handle_t vmo;
+
+    const size_t len = PAGE_SIZE * 4;
+    vmo = mx_vmo_create(len);
+    EXPECT_LT(0, vmo, "vm_object_create");
+
+    // nothing is committed yet, so there is nothing to look up
+    mx_paddr_t pa[4];
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_LOOKUP, 0, len, pa, sizeof(pa));
+    EXPECT_EQ(ERR_BAD_STATE, status, "lookup uncommitted");
+
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_COMMIT, 0, len, NULL, 0);
+    EXPECT_EQ(NO_ERROR, status, "commit");
+
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_LOOKUP, 0, len, pa, sizeof(pa));
+    EXPECT_EQ(NO_ERROR, status, "lookup");
+    for (size_t i = 0; i < countof(pa); i++)
+        EXPECT_NEQ(0u, pa[i], "lookup");
+
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_LOOKUP, 0, len, pa, sizeof(pa) - 1);
+    EXPECT_EQ(ERR_NOT_ENOUGH_BUFFER, status, "lookup short buffer");
+
+    // the range is not trimmed, so a lookup past the end fills nothing
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_LOOKUP, PAGE_SIZE, len, pa, sizeof(pa));
+    EXPECT_EQ(ERR_OUT_OF_RANGE, status, "lookup past end");
+
+    // write a page, decommit it, and it should read back as zeros
+    char buf[PAGE_SIZE];
+    memset(buf, 0x99, sizeof(buf));
+    sstatus = mx_vmo_write(vmo, buf, PAGE_SIZE, sizeof(buf));
+    EXPECT_EQ((mx_ssize_t)sizeof(buf), sstatus, "vm_object_write");
+
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_DECOMMIT, PAGE_SIZE, PAGE_SIZE, NULL, 0);
+    EXPECT_EQ(NO_ERROR, status, "decommit");
+
+    sstatus = mx_vmo_read(vmo, buf, PAGE_SIZE, sizeof(buf));
+    EXPECT_EQ((mx_ssize_t)sizeof(buf), sstatus, "vm_object_read");
+    for (size_t i = 0; i < sizeof(buf); i++) {
+        if (buf[i] != 0) {
+            EXPECT_EQ(0, buf[i], "decommitted page not zero");
+            break;
+        }
+    }
+
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_LOOKUP, 0, len, pa, sizeof(pa));
+    EXPECT_EQ(ERR_BAD_STATE, status, "lookup after decommit");
+
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_CACHE_CLEAN, 0, len, NULL, 0);
+    EXPECT_EQ(NO_ERROR, status, "cache clean");
+
+    status = mx_vmo_op_range(vmo, MX_VMO_OP_DECOMMIT, 1, PAGE_SIZE, NULL, 0);
+    EXPECT_EQ(ERR_INVALID_ARGS, status, "unaligned decommit");
+
+    status = mx_vmo_op_range(vmo, 0, 0, len, NULL, 0);
+    EXPECT_EQ(ERR_INVALID_ARGS, status, "bad op");
+
+    status = mx_handle_close(vmo);
+    EXPECT_EQ(NO_ERROR, status, "handle_close");
+
+    END_TEST;
+}
+
 BEGIN_TEST_CASE(vmo_tests)
 RUN_TEST(vmo_create_test);
 RUN_TEST(vmo_read_write_test);
 RUN_TEST(vmo_read_only_map_test);
 RUN_TEST(vmo_resize_test);
+RUN_TEST(vmo_op_range_test);
 END_TEST_CASE(vmo_tests)
 
 int main(int argc, char** argv) {
@@ -269,7 +269,6 @@ LOCAL_SRCS := \
     $(LOCAL_DIR)/src/fcntl/creat.c \
     $(LOCAL_DIR)/src/fcntl/openat.c \
     $(LOCAL_DIR)/src/fcntl/posix_fadvise.c \
-    $(LOCAL_DIR)/src/fcntl/posix_fallocate.c \
     $(LOCAL_DIR)/src/fenv/__flt_rounds.c \
     $(LOCAL_DIR)/src/fenv/fegetexceptflag.c \
     $(LOCAL_DIR)/src/fenv/feholdexcept.c \
@@ -975,10 +974,6 @@ LOCAL_SRCS := \
     $(LOCAL_DIR)/src/unistd/nice.c \
     $(LOCAL_DIR)/src/unistd/pause.c \
     $(LOCAL_DIR)/src/unistd/posix_close.c \
-    $(LOCAL_DIR)/src/unistd/pread.c \
-    $(LOCAL_DIR)/src/unistd/preadv.c \
-    $(LOCAL_DIR)/src/unistd/pwrite.c \
-    $(LOCAL_DIR)/src/unistd/pwritev.c \
     $(LOCAL_DIR)/src/unistd/readlinkat.c \
     $(LOCAL_DIR)/src/unistd/renameat.c \
     $(LOCAL_DIR)/src/unistd/setpgrp.c \
@@ -27,3 +27,8 @@ struct chunk {
 
 void __donate_heap(void* start, void* end)
     __attribute__((visibility("hidden")));
+
+// Release the pages in [start, start + len) back to the system. They read as
+// zero when next touched. The range must be page aligned and within the heap.
+void __heap_decommit(void* start, size_t len)
+    __attribute__((visibility("hidden")));
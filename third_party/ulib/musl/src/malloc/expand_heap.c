@@ -1,10 +1,72 @@
+#include "atomic.h"
 #include "libc.h"
+#include "malloc_impl.h"
 #include <errno.h>
 #include <limits.h>
+#include <magenta/syscalls.h>
 #include <stdint.h>
 #include <sys/mman.h>
 
-void* __mmap(void*, size_t, int, int, int, off_t);
+/* Each heap area is its own VMO, and the handle is kept so that free can
+ * hand the pages of large free chunks back to the system with
+ * __heap_decommit.  Areas grow exponentially, so a small table covers
+ * any realistic heap; areas past the end of it are simply never
+ * decommitted. */
+#define HEAP_AREAS_MAX 64
+
+static struct heap_area {
+    uintptr_t base;
+    size_t len;
+    mx_handle_t vmo;
+} heap_areas[HEAP_AREAS_MAX];
+
+/* Entries are filled in before the count is published, so readers need
+ * no lock. */
+static volatile int heap_area_count;
+
+static void* heap_map(void* base, size_t len) {
+    mx_handle_t vmo = _mx_vmo_create(len);
+    if (vmo < 0) {
+        errno = ENOMEM;
+        return MAP_FAILED;
+    }
+
+    uintptr_t ptr = (uintptr_t)base;
+    mx_status_t status = _mx_process_map_vm(libc.proc, vmo, 0, len, &ptr,
+                                            MX_VM_FLAG_PERM_READ | MX_VM_FLAG_PERM_WRITE |
+                                            MX_VM_FLAG_FIXED);
+    if (status < 0) {
+        _mx_handle_close(vmo);
+        errno = ENOMEM;
+        return MAP_FAILED;
+    }
+
+    int i = heap_area_count;
+    if (i < HEAP_AREAS_MAX) {
+        heap_areas[i].base = ptr;
+        heap_areas[i].len = len;
+        heap_areas[i].vmo = vmo;
+        a_store(&heap_area_count, i + 1);
+    } else {
+        _mx_handle_close(vmo);
+    }
+    return (void*)ptr;
+}
+
+/* Areas are usually contiguous and chunks can span them, so the range is
+ * clipped against every area in turn. */
+void __heap_decommit(void* start, size_t len) {
+    uintptr_t a = (uintptr_t)start;
+    uintptr_t b = a + len;
+    int count = heap_area_count;
+    for (int i = 0; i < count; i++) {
+        struct heap_area* area = &heap_areas[i];
+        uintptr_t lo = a > area->base ? a : area->base;
+        uintptr_t hi = b < area->base + area->len ? b : area->base + area->len;
+        if (lo < hi)
+            _mx_vmo_op_range(area->vmo, MX_VMO_OP_DECOMMIT, lo - area->base, hi - lo, NULL, 0);
+    }
+}
 
 /* Expand the heap in-place if brk can be used, or otherwise via mmap,
  * using an exponential lower bound on growth by mmap to make
@@ -37,7 +99,7 @@ void* __expand_heap(size_t* pn) {
     size_t min = (size_t)PAGE_SIZE << mmap_step / 2;
     if (n < min)
         n = min;
-    void* area = __mmap(next_base, n, PROT_READ | PROT_WRITE, MAP_FIXED | MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    void* area = heap_map(next_base, n);
     if (area == MAP_FAILED)
         return 0;
     *pn = n;
@@ -17,7 +17,6 @@
 void* __mmap(void*, size_t, int, int, int, off_t);
 int __munmap(void*, size_t);
 void* __mremap(void*, size_t, size_t, int, ...);
-int __madvise(void*, size_t, int);
 
 struct bin {
     mtx_t lock;
@@ -501,12 +500,8 @@ static void internal_free(void* p) {
     if (reclaim) {
         uintptr_t a = (uintptr_t)self + SIZE_ALIGN + PAGE_SIZE - 1 & -PAGE_SIZE;
         uintptr_t b = (uintptr_t)next - SIZE_ALIGN & -PAGE_SIZE;
-#if 1
-        __madvise((void*)a, b - a, MADV_DONTNEED);
-#else
-        __mmap((void*)a, b - a, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED, -1,
-               0);
-#endif
+        if (b > a)
+            __heap_decommit((void*)a, b - a);
     }
 
     unlock_bin(i);
@@ -11,6 +11,10 @@
 static void dummy(void) {}
 weak_alias(dummy, __vm_wait);
 
+// mxio maps files, when it is linked in
+void* __libc_extensions_mmap(void* start, size_t len, int prot, int flags, int fd, off_t off)
+    __attribute__((weak));
+
 #define UNIT SYSCALL_MMAP2_UNIT
 #define OFF_MASK ((-0x2000ULL << (8 * sizeof(long) - 1)) | (UNIT - 1))
 
@@ -69,8 +73,10 @@ void* __mmap(void* start, size_t len, int prot, int flags, int fd, off_t off) {
         }
 
         return (void*)ptr;
+    } else if (&__libc_extensions_mmap != NULL) {
+        return __libc_extensions_mmap(start, len, prot, flags, fd, off);
     } else {
-        // TODO(kulakowski) mxio file mapping
+        errno = ENODEV;
         return MAP_FAILED;
     }
 }